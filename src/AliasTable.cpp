@@ -0,0 +1,38 @@
+#include "AliasTable.h"
+
+std::vector<AliasEntry> BuildAliasTable(const std::vector<float>& weights) {
+    size_t n = weights.size();
+    std::vector<AliasEntry> table(n);
+    double sum = 0.0;
+    for (float w : weights) {
+        sum += w > 0.0f ? w : 0.0f;
+    }
+
+    // Scaled weights average 1; split buckets into under- and overfull
+    std::vector<double> scaled(n);
+    std::vector<uint32_t> small, large;
+    for (size_t i = 0; i < n; ++i) {
+        scaled[i] = sum > 0.0 ? (weights[i] > 0.0f ? weights[i] : 0.0f) * n / sum : 1.0;
+        (scaled[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+    }
+
+    // Fill each underfull bucket from an overfull one
+    while (!small.empty() && !large.empty()) {
+        uint32_t s = small.back(), l = large.back();
+        small.pop_back();
+        table[s] = {static_cast<float>(scaled[s]), l};
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // Leftovers are full up to rounding
+    for (uint32_t i : large) {
+        table[i] = {1.0f, i};
+    }
+    for (uint32_t i : small) {
+        table[i] = {1.0f, i};
+    }
+    return table;
+}
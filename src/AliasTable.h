@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One bucket of a Walker/Vose alias table (matches HLSL AliasEntry): pick
+// bucket i uniformly, keep it with the given probability, otherwise take alias
+struct AliasEntry {
+    float probability;
+    uint32_t alias;
+};
+
+// Build an alias table for sampling index i with probability weights[i] / sum.
+// All-zero weights give a uniform table.
+std::vector<AliasEntry> BuildAliasTable(const std::vector<float>& weights);
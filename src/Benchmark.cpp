@@ -0,0 +1,176 @@
+#include "Benchmark.h"
+#include "app.h"
+#include "Json.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double SecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Block until the GPU has finished the submitted frames
+void WaitForFrame(Application* app) {
+    float pixel[4];
+    app->GetFilm()->GetAccumulatedColorImage()->DownloadData(pixel, grassland::graphics::Offset2D{0, 0},
+                                                             grassland::graphics::Extent2D{1, 1});
+}
+}
+
+size_t Benchmark::GetPeakResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);         // Bytes
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;  // Kilobytes
+#endif
+#endif
+}
+
+int Benchmark::Run(const BenchmarkSettings& settings) {
+    if (settings.width <= 0 || settings.height <= 0 || settings.spp <= 0 || settings.warmup_frames < 0) {
+        grassland::LogError("Invalid benchmark settings: {}x{}, {} spp, {} warm-up frames",
+                            settings.width, settings.height, settings.spp, settings.warmup_frames);
+        return 1;
+    }
+    TRACE_THREAD_NAME("main");
+    auto start = Clock::now();
+
+    Application app{settings.api};
+    double device_seconds = SecondsSince(start);
+    app.SetHeadless(settings.width, settings.height);
+    if (!settings.scene_path.empty()) {
+        app.SetScenePath(settings.scene_path);
+    }
+    app.OnInit();
+
+    // First frame as the interactive app would show it (placeholder sky if the skybox is still loading)
+    app.OnUpdate();
+    app.OnRender();
+    WaitForFrame(&app);
+    double first_pixel_seconds = SecondsSince(start);
+
+    while (app.IsLoadingAssets()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        app.OnUpdate();
+    }
+    double assets_ready_seconds = SecondsSince(start);
+
+    for (int i = 0; i < settings.warmup_frames; ++i) {
+        app.OnUpdate();
+        app.OnRender();
+    }
+    WaitForFrame(&app);
+
+    // Timed run: spp frames into a fresh accumulation, rays counted on the GPU
+    app.GetFilm()->Reset();
+    app.SetRayCounting(true);
+    app.ResetRayCounts();
+    std::vector<double> frame_seconds;
+    frame_seconds.reserve(settings.spp);
+    auto render_start = Clock::now();
+    for (int i = 0; i < settings.spp; ++i) {
+        auto frame_start = Clock::now();
+        app.OnUpdate();
+        app.OnRender();  // Reading the ray counters back waits for the frame
+        frame_seconds.push_back(SecondsSince(frame_start));
+    }
+    WaitForFrame(&app);
+    double render_seconds = SecondsSince(render_start);
+    app.SetRayCounting(false);
+
+    RayCounts rays = app.GetRayCounts();
+    uint64_t total_rays = rays.primary + rays.secondary + rays.shadow;
+    double samples = static_cast<double>(settings.width) * settings.height * settings.spp;
+    std::vector<double> sorted_frames = frame_seconds;
+    std::sort(sorted_frames.begin(), sorted_frames.end());
+    double median_frame = sorted_frames[sorted_frames.size() / 2];
+
+    if (!settings.image_path.empty()) {
+        app.SaveAccumulatedOutput(settings.image_path);
+    }
+
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(6);
+    json << "{\n";
+    json << "  \"scene\": \"" << EscapeJson(settings.scene_path.empty() ? "built-in" : settings.scene_path) << "\",\n";
+    json << "  \"width\": " << settings.width << ",\n";
+    json << "  \"height\": " << settings.height << ",\n";
+    json << "  \"spp\": " << settings.spp << ",\n";
+    json << "  \"warmup_frames\": " << settings.warmup_frames << ",\n";
+    json << "  \"startup\": {\n";
+    json << "    \"device_seconds\": " << device_seconds << ",\n";
+    for (const auto& phase : app.GetStartupPhases()) {
+        json << "    \"" << phase.name << "_seconds\": " << phase.seconds << ",\n";
+    }
+    json << "    \"time_to_first_pixel_seconds\": " << first_pixel_seconds << ",\n";
+    json << "    \"assets_ready_seconds\": " << assets_ready_seconds << "\n";
+    json << "  },\n";
+    json << "  \"render_seconds\": " << render_seconds << ",\n";
+    json << "  \"frame_ms\": { \"min\": " << sorted_frames.front() * 1e3 << ", \"median\": " << median_frame * 1e3
+         << ", \"max\": " << sorted_frames.back() * 1e3 << " },\n";
+    json << "  \"samples_per_second\": " << samples / render_seconds << ",\n";
+    json << "  \"rays\": { \"primary\": " << rays.primary << ", \"secondary\": " << rays.secondary
+         << ", \"shadow\": " << rays.shadow << ", \"total\": " << total_rays << " },\n";
+    json << "  \"mrays_per_second\": { \"primary\": " << rays.primary / render_seconds * 1e-6
+         << ", \"secondary\": " << rays.secondary / render_seconds * 1e-6
+         << ", \"shadow\": " << rays.shadow / render_seconds * 1e-6
+         << ", \"total\": " << total_rays / render_seconds * 1e-6 << " },\n";
+    json << "  \"memory_bytes\": " << app.GetMemoryReport().ToJson() << ",\n";
+    json << "  \"peak_rss_bytes\": " << GetPeakResidentBytes() << "\n";
+    json << "}\n";
+
+    app.OnClose();
+    if (!settings.trace_path.empty()) {
+        Trace::WriteChromeTrace(settings.trace_path);
+    }
+
+    grassland::LogInfo("Benchmark: {} spp at {}x{} in {:.3f} s ({:.2f} Mrays/s, median frame {:.2f} ms)",
+                       settings.spp, settings.width, settings.height, render_seconds,
+                       total_rays / render_seconds * 1e-6, median_frame * 1e3);
+    if (settings.output_path.empty()) {
+        std::cout << json.str();
+        return 0;
+    }
+    std::ofstream file(settings.output_path);
+    if (!file) {
+        grassland::LogError("Failed to write benchmark report {}", settings.output_path);
+        return 1;
+    }
+    file << json.str();
+    grassland::LogInfo("Benchmark report written to {}", settings.output_path);
+    return 0;
+}
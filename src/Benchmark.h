@@ -0,0 +1,30 @@
+#pragma once
+#include "long_march.h"
+#include <string>
+
+struct BenchmarkSettings {
+    grassland::graphics::BackendAPI api = grassland::graphics::BACKEND_API_DEFAULT;
+    std::string scene_path;   // Empty renders the built-in scene
+    int width = 640;
+    int height = 360;
+    int spp = 64;             // Timed frames, one sample per pixel each
+    int warmup_frames = 8;    // Untimed frames first (pipeline warm-up, texture pages streamed in)
+    std::string output_path;  // JSON report; empty prints it to stdout
+    std::string image_path;   // Optional PNG of the timed accumulation
+    std::string trace_path;   // Optional Chrome trace of the run (needs SHORTMARCH_ENABLE_TRACING)
+};
+
+// Headless benchmark: loads a scene without a window, waits for background
+// loads, then renders a fixed number of samples per pixel from the scene's
+// camera at a fixed resolution and writes a JSON report with the startup
+// phase timings, time to first pixel, ray throughput per ray type (counted on
+// the GPU), samples/s, frame time statistics, bytes per memory category and
+// peak resident memory.
+class Benchmark {
+public:
+    // Returns the process exit code
+    static int Run(const BenchmarkSettings& settings);
+
+    // Peak resident set size of this process in bytes (0 if unavailable)
+    static size_t GetPeakResidentBytes();
+};
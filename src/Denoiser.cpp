@@ -0,0 +1,165 @@
+#include "Denoiser.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SHORTMARCH_DENOISE_SSE2 1
+#endif
+
+namespace {
+constexpr float kKernel[5] = {1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+constexpr float kMinAlbedo = 1e-3f;
+
+float Luminance(const float* c) {
+    return 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2];
+}
+
+// sum += weight * value for one RGBA pixel
+inline void AccumulatePixel(float* sum, const float* value, float weight) {
+#ifdef SHORTMARCH_DENOISE_SSE2
+    _mm_storeu_ps(sum, _mm_add_ps(_mm_loadu_ps(sum), _mm_mul_ps(_mm_set1_ps(weight), _mm_loadu_ps(value))));
+#else
+    for (int c = 0; c < 4; ++c) {
+        sum[c] += weight * value[c];
+    }
+#endif
+}
+
+inline float Dot3(const float* a, const float* b) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// 3x3 Gaussian of the variance around (x, y), steadier than a single pixel
+float BlurredVariance(const std::vector<float>& variance, int width, int height, int x, int y) {
+    static const float kGauss[3] = {0.25f, 0.5f, 0.25f};
+    float sum = 0.0f, weight_sum = 0.0f;
+    for (int j = -1; j <= 1; ++j) {
+        for (int i = -1; i <= 1; ++i) {
+            int qx = x + i, qy = y + j;
+            if (qx >= 0 && qx < width && qy >= 0 && qy < height) {
+                float weight = kGauss[i + 1] * kGauss[j + 1];
+                sum += weight * variance[static_cast<size_t>(qy) * width + qx];
+                weight_sum += weight;
+            }
+        }
+    }
+    return sum / weight_sum;
+}
+
+// One a-trous pass with the given tap spacing
+void FilterPass(const DenoiserSettings& settings, const DenoiserFrame& frame, int step, bool guided,
+                const std::vector<float>& in, const std::vector<float>& in_variance,
+                std::vector<float>* out, std::vector<float>* out_variance) {
+    TRACE_SCOPE("Denoiser::FilterPass");
+    int width = frame.width, height = frame.height;
+    ThreadPool::Global().ParallelFor(height, [&](size_t row) {
+        int y = static_cast<int>(row);
+        for (int x = 0; x < width; ++x) {
+            size_t p = static_cast<size_t>(y) * width + x;
+            const float* normal_p = &frame.normal[p * 4];
+            float depth_p = frame.albedo[p * 4 + 3];
+            float lum_p = Luminance(&in[p * 4]);
+            float sigma_p = guided ? std::sqrt(std::max(BlurredVariance(in_variance, width, height, x, y), 0.0f)) : 0.0f;
+            float depth_scale = settings.depth_sigma * depth_p * step;
+            bool sky = depth_p <= 0.0f;
+
+            alignas(16) float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            float weight_sum = 0.0f, variance_sum = 0.0f;
+            for (int j = 0; j < 5; ++j) {
+                int qy = y + (j - 2) * step;
+                if (qy < 0 || qy >= height) {
+                    continue;
+                }
+                for (int i = 0; i < 5; ++i) {
+                    int qx = x + (i - 2) * step;
+                    if (qx < 0 || qx >= width) {
+                        continue;
+                    }
+                    size_t q = static_cast<size_t>(qy) * width + qx;
+                    float weight = kKernel[i] * kKernel[j];
+                    if (q != p) {
+                        // The sky is left as is (it only carries anti-aliasing noise)
+                        float depth_q = frame.albedo[q * 4 + 3];
+                        if (sky || depth_q <= 0.0f) {
+                            continue;
+                        }
+                        float n_dot = Dot3(normal_p, &frame.normal[q * 4]);
+                        if (n_dot <= 0.0f) {
+                            continue;
+                        }
+                        // Without variance the tolerance is relative to the brighter pixel
+                        float lum_q = Luminance(&in[q * 4]);
+                        float lum_scale = settings.color_sigma * (guided ? sigma_p : 0.1f * std::max(lum_p, lum_q));
+                        // n_dot^normal_power * exp(-depth term) * exp(-luminance term) in one exp
+                        weight *= std::exp(settings.normal_power * std::log(n_dot) -
+                                           std::abs(depth_p - depth_q) / (depth_scale + 1e-6f) -
+                                           std::abs(lum_p - lum_q) / (lum_scale + 1e-6f));
+                    }
+                    AccumulatePixel(sum, &in[q * 4], weight);
+                    weight_sum += weight;
+                    if (guided) {
+                        variance_sum += weight * weight * in_variance[q];
+                    }
+                }
+            }
+
+            float inv = 1.0f / weight_sum;  // The center tap always contributes
+            for (int c = 0; c < 4; ++c) {
+                (*out)[p * 4 + c] = sum[c] * inv;
+            }
+            if (guided) {
+                (*out_variance)[p] = variance_sum * inv * inv;
+            }
+        }
+    });
+}
+}
+
+void Denoiser::Denoise(const DenoiserSettings& settings, DenoiserFrame* frame) {
+    TRACE_SCOPE("Denoiser::Denoise");
+    size_t pixel_count = static_cast<size_t>(frame->width) * frame->height;
+    if (pixel_count == 0 || frame->color.size() < pixel_count * 4 || frame->albedo.size() < pixel_count * 4 ||
+        frame->normal.size() < pixel_count * 4) {
+        return;
+    }
+    bool guided = settings.variance_guided && frame->variance.size() >= pixel_count;
+
+    // Demodulate the albedo of hit pixels so the filter only sees illumination
+    std::vector<float> illumination(pixel_count * 4), variance(guided ? pixel_count : 0);
+    ThreadPool::Global().ParallelFor(frame->height, [&](size_t y) {
+        for (size_t p = y * frame->width; p < (y + 1) * frame->width; ++p) {
+            bool sky = frame->albedo[p * 4 + 3] <= 0.0f;
+            for (int c = 0; c < 3; ++c) {
+                float albedo = sky ? 1.0f : std::max(frame->albedo[p * 4 + c], kMinAlbedo);
+                illumination[p * 4 + c] = frame->color[p * 4 + c] / albedo;
+            }
+            illumination[p * 4 + 3] = frame->color[p * 4 + 3];
+            if (guided) {
+                float albedo = sky ? 1.0f : std::max(Luminance(&frame->albedo[p * 4]), kMinAlbedo);
+                variance[p] = frame->variance[p] / (albedo * albedo);
+            }
+        }
+    });
+
+    std::vector<float> filtered(pixel_count * 4), filtered_variance(variance.size());
+    for (int i = 0; i < settings.iterations; ++i) {
+        FilterPass(settings, *frame, 1 << i, guided, illumination, variance, &filtered, &filtered_variance);
+        illumination.swap(filtered);
+        variance.swap(filtered_variance);
+    }
+
+    // Remodulate
+    ThreadPool::Global().ParallelFor(frame->height, [&](size_t y) {
+        for (size_t p = y * frame->width; p < (y + 1) * frame->width; ++p) {
+            bool sky = frame->albedo[p * 4 + 3] <= 0.0f;
+            for (int c = 0; c < 3; ++c) {
+                float albedo = sky ? 1.0f : std::max(frame->albedo[p * 4 + c], kMinAlbedo);
+                frame->color[p * 4 + c] = illumination[p * 4 + c] * albedo;
+            }
+        }
+    });
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+
+struct DenoiserSettings {
+    bool enabled = false;
+    bool variance_guided = true;  // Scale the luminance edge-stopping by the per-pixel noise
+    int iterations = 5;           // A-trous passes (tap spacing 1, 2, 4, ...)
+    float color_sigma = 4.0f;     // Luminance tolerance (in standard deviations when variance guided)
+    float normal_power = 64.0f;   // Exponent of the normal similarity
+    float depth_sigma = 0.05f;    // Depth tolerance relative to the center distance (per unit of tap spacing)
+};
+
+// Per-pixel inputs, all averaged over the accumulated samples
+struct DenoiserFrame {
+    int width = 0;
+    int height = 0;
+    std::vector<float> color;     // RGBA linear radiance, filtered in place
+    std::vector<float> albedo;    // RGBA: first-hit albedo, A = first-hit distance (0 for the sky)
+    std::vector<float> normal;    // RGBA: first-hit world normal (zero for the sky)
+    std::vector<float> variance;  // Variance of the mean luminance per pixel (empty when not guided)
+};
+
+// Edge-avoiding a-trous wavelet filter (5x5 B3-spline kernel with growing
+// spacing). Radiance is divided by the albedo so texture detail bypasses the
+// filter, and taps are weighted down across normal, depth and luminance
+// edges; with variance guidance the luminance tolerance follows the
+// per-pixel noise, which is filtered alongside. Rows are split over the
+// global thread pool and the weighted sums use SSE2 when available.
+class Denoiser {
+public:
+    static void Denoise(const DenoiserSettings& settings, DenoiserFrame* frame);
+};
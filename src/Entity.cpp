@@ -1,4 +1,6 @@
 #include "Entity.h"
+#include "Trace.h"
+#include <cfloat>
 #include <fstream>
 #include <sstream>
 #include <filesystem>
@@ -10,13 +12,39 @@ Entity::Entity(const std::string& obj_file_path,
     , transform_(transform)
     , mesh_loaded_(false)
     , has_uv_coords_(false)
-    , has_material_ids_(false)
-    , material_offset_(0) {
+    , has_material_ids_(false) {
     
     LoadMesh(obj_file_path);
 }
 
+Entity::Entity(const Entity& source, const Material& default_material, const glm::mat4& transform)
+    : mesh_path_(source.mesh_path_)
+    , mesh_(source.mesh_)
+    , material_ids_(source.material_ids_)
+    , mesh_file_(source.mesh_file_)
+    , bounds_min_(source.bounds_min_)
+    , bounds_max_(source.bounds_max_)
+    , default_material_(default_material)
+    , materials_(source.materials_)
+    , material_name_to_index_(source.material_name_to_index_)
+    , transform_(transform)
+    , mesh_loaded_(source.mesh_loaded_)
+    , has_uv_coords_(source.has_uv_coords_)
+    , has_material_ids_(source.has_material_ids_) {
+}
+
 Entity::~Entity() {
+    ReleaseGPUResources();
+}
+
+void Entity::ReleaseGPUResources(GpuRetireQueue* retired) {
+    if (retired) {
+        retired->Retire(std::move(blas_));
+        retired->Retire(std::move(material_id_buffer_));
+        retired->Retire(std::move(uv_buffer_));
+        retired->Retire(std::move(index_buffer_));
+        retired->Retire(std::move(vertex_buffer_));
+    }
     blas_.reset();
     material_id_buffer_.reset();
     uv_buffer_.reset();
@@ -25,8 +53,19 @@ Entity::~Entity() {
 }
 
 bool Entity::LoadMesh(const std::string& obj_file_path) {
+    TRACE_SCOPE("Entity::LoadMesh");
+    mesh_path_ = obj_file_path;
     // Try to load the OBJ file
     std::string full_path = grassland::FindAssetFile(obj_file_path);
+
+    // Out-of-core scenes map the optimized mesh when it is already cached
+    if (auto cached = MeshCache::Open(full_path)) {
+        if (LoadCachedMesh(std::move(cached))) {
+            return true;
+        }
+        grassland::LogWarning("Mesh cache entry of {} has a corrupt material table, parsing the OBJ", obj_file_path);
+    }
+    mesh_file_.reset();
     
     if (mesh_.LoadObjFile(full_path) != 0) {
         grassland::LogError("Failed to load mesh from: {}", obj_file_path);
@@ -41,8 +80,10 @@ bool Entity::LoadMesh(const std::string& obj_file_path) {
     
     // Check if the mesh has material IDs
     const int* mtlid = mesh_.MaterialIds();
+    material_ids_.clear();
     if(mtlid != nullptr && mtlid[0] != -1){
         has_material_ids_=1;
+        material_ids_.assign(mtlid, mtlid + mesh_.NumIndices() / 3);
         grassland::LogInfo("legal material IDs found with first value {}", mtlid[0]);
     }
     else grassland::LogInfo("Material ID not found");
@@ -93,62 +134,164 @@ bool Entity::LoadMesh(const std::string& obj_file_path) {
         grassland::LogInfo("Loaded {} materials from MTL file", materials_.size());
     }
     else grassland::LogInfo("MTL file not detected");
+
+    // Weld and reorder (rebuilds mesh_, so material data must be read before)
+    MeshData data;
+    if (!OptimizeMesh(&data)) {
+        grassland::LogError("Failed to load mesh from: {}", obj_file_path);
+        mesh_loaded_ = false;
+        has_uv_coords_ = false;
+        has_material_ids_ = false;
+        return false;
+    }
+    bounds_min_ = glm::vec3(FLT_MAX);
+    bounds_max_ = glm::vec3(-FLT_MAX);
+    for (const auto& p : data.positions) {
+        bounds_min_ = glm::min(bounds_min_, glm::vec3(p[0], p[1], p[2]));
+        bounds_max_ = glm::max(bounds_max_, glm::vec3(p[0], p[1], p[2]));
+    }
+
+    // With the mesh cache enabled, store the optimized mesh and map it instead of keeping a heap copy
+    std::vector<std::string> material_names(materials_.size());
+    for (const auto& [name, index] : material_name_to_index_) {
+        material_names[index] = name;
+    }
+    if (MeshCache::Store(full_path, data, materials_, material_names)) {
+        mesh_file_ = MeshCache::Open(full_path);
+    }
+    if (mesh_file_) {
+        mesh_ = grassland::Mesh<float>();
+        material_ids_ = std::vector<int>();
+    } else {
+        // Normals are not carried over: shading uses the geometric normal
+        mesh_ = grassland::Mesh<float>(data.NumVertices(), data.indices.size(), data.indices.data(),
+                                       data.positions.data(), nullptr,
+                                       data.uvs.empty() ? nullptr : data.uvs.data());
+        material_ids_ = std::move(data.material_ids);
+    }
     
     if (has_uv_coords_) {
         grassland::LogInfo("Successfully loaded mesh: {} ({} vertices, {} indices, {} UV coords)", 
-                          obj_file_path, mesh_.NumVertices(), mesh_.NumIndices(), mesh_.NumVertices());
+                          obj_file_path, GetNumVertices(), GetNumIndices(), GetNumVertices());
     } else {
         grassland::LogInfo("Successfully loaded mesh: {} ({} vertices, {} indices, no UV coords)", 
-                          obj_file_path, mesh_.NumVertices(), mesh_.NumIndices());
+                          obj_file_path, GetNumVertices(), GetNumIndices());
     }
     grassland::LogInfo("Till now, has_material_ids= {}" ,has_material_ids_);
     mesh_loaded_ = true;
     return true;
 }
 
-void Entity::BuildBLAS(grassland::graphics::Core* core) {
+bool Entity::LoadCachedMesh(std::shared_ptr<const MeshCacheFile> file) {
+    std::vector<std::string> names;
+    if (!file->ReadMaterials(&materials_, &names)) {
+        materials_.clear();
+        return false;
+    }
+    material_name_to_index_.clear();
+    for (size_t i = 0; i < names.size(); ++i) {
+        material_name_to_index_[names[i]] = static_cast<int>(i);
+    }
+
+    mesh_ = grassland::Mesh<float>();
+    material_ids_.clear();
+    mesh_file_ = std::move(file);
+    has_uv_coords_ = mesh_file_->HasUVs();
+    has_material_ids_ = mesh_file_->HasMaterialIDs();
+    bounds_min_ = mesh_file_->GetBoundsMin();
+    bounds_max_ = mesh_file_->GetBoundsMax();
+    mesh_loaded_ = true;
+    grassland::LogInfo("Mapped cached mesh: {} ({} vertices, {} triangles, {} materials)", mesh_path_,
+                       GetNumVertices(), GetNumTriangles(), materials_.size());
+    return true;
+}
+
+bool Entity::OptimizeMesh(MeshData* out) {
+    TRACE_SCOPE("Entity::OptimizeMesh");
+    MeshData& data = *out;
+    const auto* positions = mesh_.Positions();
+    data.positions.assign(positions, positions + mesh_.NumVertices());
+    if (has_uv_coords_) {
+        const auto* uvs = mesh_.TexCoords();
+        data.uvs.assign(uvs, uvs + mesh_.NumVertices());
+    }
+    data.indices.assign(mesh_.Indices(), mesh_.Indices() + mesh_.NumIndices());
+    data.material_ids = std::move(material_ids_);
+
+    const WeldSettings& weld = MeshOptimizer::GetWeldSettings();
+    if (weld.enabled) {
+        size_t vertices_before = data.NumVertices(), triangles_before = data.NumTriangles();
+        size_t welded = MeshOptimizer::WeldVertices(&data, weld);
+        MeshOptimizer::RemoveDegenerateTriangles(&data, weld.position_epsilon);
+        size_t unused = MeshOptimizer::RemoveUnusedVertices(&data);
+        grassland::LogInfo("Welded mesh: {} -> {} vertices ({} merged, {} unused), {} -> {} triangles",
+                           vertices_before, data.NumVertices(), welded, unused,
+                           triangles_before, data.NumTriangles());
+        if (data.indices.empty()) {
+            grassland::LogError("Mesh has no non-degenerate triangles");
+            return false;
+        }
+    }
+
+    double acmr_before = MeshOptimizer::ComputeACMR(data);
+    MeshOptimizer::OptimizeLocality(&data);
+    grassland::LogInfo("Reordered mesh for locality: ACMR {:.3f} -> {:.3f}",
+                       acmr_before, MeshOptimizer::ComputeACMR(data));
+
+    return true;
+}
+
+bool Entity::BuildBLAS(grassland::graphics::Core* core) {
+    TRACE_SCOPE("Entity::BuildBLAS");
     if (!mesh_loaded_) {
         grassland::LogError("Cannot build BLAS: mesh not loaded");
-        return;
+        return false;
+    }
+    // Mapped streams are checked on first use rather than when the cache file is opened
+    if (mesh_file_ && !mesh_file_->CheckStreams()) {
+        grassland::LogError("Cannot build BLAS: the mesh cache entry of {} is corrupt (delete it to reparse the OBJ)",
+                            mesh_path_);
+        return false;
     }
 
     // Create vertex buffer
-    size_t vertex_buffer_size = mesh_.NumVertices() * sizeof(glm::vec3);
+    size_t vertex_buffer_size = GetNumVertices() * sizeof(glm::vec3);
     core->CreateBuffer(vertex_buffer_size, 
                       grassland::graphics::BUFFER_TYPE_DYNAMIC, 
                       &vertex_buffer_);
-    vertex_buffer_->UploadData(mesh_.Positions(), vertex_buffer_size);
+    vertex_buffer_->UploadData(GetPositions(), vertex_buffer_size);
 
     // Create index buffer
-    size_t index_buffer_size = mesh_.NumIndices() * sizeof(uint32_t);
+    size_t index_buffer_size = GetNumIndices() * sizeof(uint32_t);
     core->CreateBuffer(index_buffer_size, 
                       grassland::graphics::BUFFER_TYPE_DYNAMIC, 
                       &index_buffer_);
-    index_buffer_->UploadData(mesh_.Indices(), index_buffer_size);
+    index_buffer_->UploadData(GetIndices(), index_buffer_size);
 
     // Create UV buffer if UV coordinates exist
     if (has_uv_coords_) {
-        size_t uv_buffer_size = mesh_.NumVertices() * sizeof(glm::vec2);
+        size_t uv_buffer_size = GetNumVertices() * sizeof(glm::vec2);
         core->CreateBuffer(uv_buffer_size,
                           grassland::graphics::BUFFER_TYPE_DYNAMIC,
                           &uv_buffer_);
-        uv_buffer_->UploadData(mesh_.TexCoords(), uv_buffer_size);
-        grassland::LogInfo("Created UV buffer with {} texture coordinates", mesh_.NumVertices());
+        uv_buffer_->UploadData(GetUVCoordinates(), uv_buffer_size);
+        grassland::LogInfo("Created UV buffer with {} texture coordinates", GetNumVertices());
     } else {
         grassland::LogInfo("No UV coordinates in mesh, skipping UV buffer creation");
     }
 
     // Create material ID buffer if material IDs exist
     if (has_material_ids_) {
-        size_t num_triangles = mesh_.NumIndices() / 3;
+        size_t num_triangles = GetNumTriangles();
         
-        // Apply material offset to create global material IDs
+        // Map local material IDs to global material slots (identity until Scene assigns slots)
         std::vector<int> global_material_ids;
         global_material_ids.reserve(num_triangles);
         
-        const int* local_material_ids = mesh_.MaterialIds();
+        const int* local_material_ids = GetMaterialIDs();
         for (size_t i = 0; i < num_triangles; ++i) {
-            global_material_ids.push_back(local_material_ids[i] + material_offset_);
+            global_material_ids.push_back(material_slots_.empty() ? local_material_ids[i]
+                                                                  : GetMaterialSlot(local_material_ids[i]));
         }
         
         size_t material_id_buffer_size = num_triangles * sizeof(int);
@@ -156,8 +299,7 @@ void Entity::BuildBLAS(grassland::graphics::Core* core) {
                           grassland::graphics::BUFFER_TYPE_DYNAMIC,
                           &material_id_buffer_);
         material_id_buffer_->UploadData(global_material_ids.data(), material_id_buffer_size);
-        grassland::LogInfo("Created material ID buffer with {} triangles (offset: {})", 
-                          num_triangles, material_offset_);
+        grassland::LogInfo("Created material ID buffer with {} triangles", num_triangles);
     } else {
         grassland::LogInfo("No material IDs in mesh, skipping material ID buffer creation");
     }
@@ -170,6 +312,26 @@ void Entity::BuildBLAS(grassland::graphics::Core* core) {
         &blas_);
 
     grassland::LogInfo("Built BLAS for entity");
+    return true;
+}
+
+EntityMemoryUsage Entity::GetMemoryUsage() const {
+    EntityMemoryUsage usage;
+    usage.mesh_path = mesh_path_;
+    if (mesh_loaded_) {
+        usage.mesh.cpu_bytes = mesh_.NumVertices() * (sizeof(glm::vec3) + (has_uv_coords_ ? sizeof(glm::vec2) : 0)) +
+                               mesh_.NumIndices() * sizeof(uint32_t);
+    }
+    usage.mesh.cpu_bytes += MemoryReport::GetVectorBytes(material_ids_) + MemoryReport::GetVectorBytes(materials_);
+    if (mesh_file_) {
+        // Split between the entities sharing the mapping
+        usage.mesh.mapped_bytes = mesh_file_->GetFileSize() / static_cast<size_t>(mesh_file_.use_count());
+    }
+    usage.buffers.gpu_bytes = MemoryReport::GetBufferBytes(vertex_buffer_.get()) +
+                              MemoryReport::GetBufferBytes(index_buffer_.get()) +
+                              MemoryReport::GetBufferBytes(uv_buffer_.get()) +
+                              MemoryReport::GetBufferBytes(material_id_buffer_.get());
+    return usage;
 }
 
 const Material* Entity::GetMaterial(const std::string& name) const {
@@ -180,6 +342,17 @@ const Material* Entity::GetMaterial(const std::string& name) const {
     return nullptr;
 }
 
+int Entity::GetMaterialSlot(int local_index) const {
+    if (material_slots_.empty()) {
+        return 0;
+    }
+    // Faces without a valid material fall back to the first material
+    if (local_index < 0 || local_index >= static_cast<int>(material_slots_.size())) {
+        local_index = 0;
+    }
+    return material_slots_[local_index];
+}
+
 const Material* Entity::GetMaterial(int index) const {
     if (index >= 0 && index < static_cast<int>(materials_.size())) {
         return &materials_[index];
@@ -1,17 +1,29 @@
 #pragma once
 #include "long_march.h"
+#include "GpuRetireQueue.h"
 #include "Material.h"
+#include "MemoryReport.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include <memory>
 #include <vector>
 #include <unordered_map>
 
 // Entity represents a mesh instance with materials and transform
 // Supports multiple materials from MTL files
+// With the mesh cache enabled the geometry is read from a mapped cache file
+// instead of a heap copy, and the GPU buffers and BLAS can be released and
+// rebuilt as the Scene pages the entity out and in.
 class Entity {
 public:
     Entity(const std::string& obj_file_path, 
            const Material& default_material = Material(),
            const glm::mat4& transform = glm::mat4(1.0f));
 
+    // Another instance of a loaded entity's mesh: shares its mapping (or copies
+    // its optimized heap mesh) and MTL materials without reading the OBJ again
+    Entity(const Entity& source, const Material& default_material, const glm::mat4& transform);
+
     ~Entity();
 
     // Load mesh from OBJ file (and MTL if referenced)
@@ -51,8 +63,18 @@ public:
     void SetDefaultMaterial(const Material& material) { default_material_ = material; }
     void SetTransform(const glm::mat4& transform) { transform_ = transform; }
 
-    // Create BLAS for this entity's mesh
-    void BuildBLAS(grassland::graphics::Core* core);
+    // Create BLAS for this entity's mesh. Fails for mapped meshes whose streams are out of range.
+    bool BuildBLAS(grassland::graphics::Core* core);
+
+    // Drop the per-entity GPU buffers and BLAS (the mesh stays loaded, BuildBLAS() restores them).
+    // With a retire queue they stay alive until frames in flight no longer trace against them.
+    void ReleaseGPUResources(GpuRetireQueue* retired = nullptr);
+
+    // Whether the BLAS and its buffers are on the GPU
+    bool IsResident() const { return blas_ != nullptr; }
+
+    // Whether the mesh is read from a mapped mesh cache file
+    bool IsMeshMapped() const { return mesh_file_ != nullptr; }
 
     // Check if mesh is loaded
     bool IsValid() const { return mesh_loaded_; }
@@ -67,21 +89,59 @@ public:
     bool HasMaterialIDs() const { return has_material_ids_; }
     
     // Get mesh statistics
-    size_t GetNumVertices() const { return mesh_.NumVertices(); }
-    size_t GetNumIndices() const { return mesh_.NumIndices(); }
-    size_t GetNumTriangles() const { return mesh_.NumIndices() / 3; }
+    size_t GetNumVertices() const { return mesh_file_ ? mesh_file_->GetVertexCount() : mesh_.NumVertices(); }
+    size_t GetNumIndices() const { return mesh_file_ ? mesh_file_->GetTriangleCount() * 3 : mesh_.NumIndices(); }
+    size_t GetNumTriangles() const { return GetNumIndices() / 3; }
+
+    // Object-space bounds of the mesh
+    const glm::vec3& GetBoundsMin() const { return bounds_min_; }
+    const glm::vec3& GetBoundsMax() const { return bounds_max_; }
     
-    // Get/Set material index offset (for multi-entity scenes)
-    int GetMaterialOffset() const { return material_offset_; }
-    void SetMaterialOffset(int offset) { material_offset_ = offset; }
+    // Path the mesh was loaded from (as given, before the asset lookup)
+    const std::string& GetMeshPath() const { return mesh_path_; }
 
-    // Get raw UV and material ID data (returns nullptr if not available)
-    const auto* GetUVCoordinates() const { return mesh_.TexCoords(); }
-    const int* GetMaterialIDs() const { return mesh_.MaterialIds(); }
-    const uint32_t* GetIndices() const { return mesh_.Indices(); }  // Get index data
+    // CPU mesh data and per-entity GPU buffers (entity index and global streams are left to the Scene)
+    EntityMemoryUsage GetMemoryUsage() const;
+
+    // Number of material slots this entity needs (MTL materials, or 1 for the default material)
+    size_t GetNumMaterialSlots() const { return materials_.empty() ? 1 : materials_.size(); }
+
+    // Get/Set the global material slot of each local material (Scene deduplicates identical materials)
+    int GetMaterialSlot(int local_index) const;
+    const std::vector<int>& GetMaterialSlots() const { return material_slots_; }
+    void SetMaterialSlots(std::vector<int> slots) { material_slots_ = std::move(slots); }
+
+    // Get raw position, UV and material ID data (returns nullptr if not available)
+    const grassland::Vector3<float>* GetPositions() const {
+        return mesh_file_ ? mesh_file_->GetPositions() : mesh_.Positions();
+    }
+    const grassland::Vector2<float>* GetUVCoordinates() const {
+        return mesh_file_ ? mesh_file_->GetUVs() : mesh_.TexCoords();
+    }
+    const int* GetMaterialIDs() const {
+        if (mesh_file_) {
+            return mesh_file_->GetMaterialIDs();
+        }
+        return material_ids_.empty() ? nullptr : material_ids_.data();
+    }
+    const uint32_t* GetIndices() const {  // Get index data
+        return mesh_file_ ? mesh_file_->GetIndices() : mesh_.Indices();
+    }
 
 private:
-    grassland::Mesh<float> mesh_;
+    // Run the load-time mesh passes on a copy of mesh_ and material_ids_
+    // (fails if welding leaves no triangles)
+    bool OptimizeMesh(MeshData* data);
+
+    // Use the cached mesh and its materials instead of parsing the OBJ
+    bool LoadCachedMesh(std::shared_ptr<const MeshCacheFile> file);
+
+    std::string mesh_path_;
+    grassland::Mesh<float> mesh_;    // Empty when the mesh is mapped
+    std::vector<int> material_ids_;  // Per-triangle local material IDs (kept in sync with mesh_ triangles)
+    std::shared_ptr<const MeshCacheFile> mesh_file_;  // Mapped mesh, shared by entities of the same source
+    glm::vec3 bounds_min_{0.0f};
+    glm::vec3 bounds_max_{0.0f};
     Material default_material_;  // Default material (used if no MTL)
     std::vector<Material> materials_;  // Materials from MTL file (indexed by material_id)
     std::unordered_map<std::string, int> material_name_to_index_;  // Material name to index mapping
@@ -97,6 +157,6 @@ private:
     bool has_uv_coords_;
     bool has_material_ids_;
     
-    int material_offset_;  // Offset for global material indexing
+    std::vector<int> material_slots_;  // Local material index -> global material slot
 };
 
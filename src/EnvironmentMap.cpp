@@ -0,0 +1,112 @@
+#include "EnvironmentMap.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include "glm/gtc/packing.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr float kPi = 3.14159265358979f;
+
+// Sampling weight of a pixel: luminance times the solid angle of its row
+float PixelWeight(const uint16_t* rgba, float sin_theta) {
+    float lum = 0.2126f * glm::unpackHalf1x16(rgba[0]) + 0.7152f * glm::unpackHalf1x16(rgba[1]) +
+                0.0722f * glm::unpackHalf1x16(rgba[2]);
+    return lum > 0.0f && std::isfinite(lum) ? lum * sin_theta : 0.0f;
+}
+
+float RowSinTheta(size_t y, int height) {
+    return std::sin(kPi * (static_cast<float>(y) + 0.5f) / height);
+}
+}
+
+EnvironmentMap::EnvironmentMap(grassland::graphics::Core* core) : core_(core) {
+}
+
+EnvironmentTables EnvironmentMap::ComputeTables(const uint16_t* rgba, int width, int height) {
+    TRACE_SCOPE("EnvironmentMap::ComputeTables");
+    EnvironmentTables tables;
+    if (!rgba || width <= 0 || height <= 0) {
+        return tables;
+    }
+
+    // 1. Conditional CDF of each row
+    size_t row_stride = static_cast<size_t>(width) + 1;
+    std::vector<float>& conditional = tables.conditional_cdf;
+    conditional.resize(row_stride * height);
+    std::vector<double> row_sums(height);
+    ThreadPool::Global().ParallelFor(height, [&](size_t y) {
+        const uint16_t* row = rgba + y * width * 4;
+        float sin_theta = RowSinTheta(y, height);
+        float* cdf = &conditional[y * row_stride];
+        double sum = 0.0;
+        cdf[0] = 0.0f;
+        for (int x = 0; x < width; ++x) {
+            sum += PixelWeight(row + x * 4, sin_theta);
+            cdf[x + 1] = static_cast<float>(sum);
+        }
+        row_sums[y] = sum;
+        for (int x = 1; x <= width; ++x) {
+            // Black rows are never picked by the marginal, keep them well-formed anyway
+            cdf[x] = sum > 0.0 ? static_cast<float>(cdf[x] / sum) : static_cast<float>(x) / width;
+        }
+        cdf[width] = 1.0f;
+    });
+
+    // 2. Marginal CDF over rows
+    std::vector<float>& marginal = tables.marginal_cdf;
+    marginal.resize(height + 1);
+    double total = 0.0;
+    marginal[0] = 0.0f;
+    for (int y = 0; y < height; ++y) {
+        total += row_sums[y];
+        marginal[y + 1] = static_cast<float>(total);
+    }
+    for (int y = 1; y <= height; ++y) {
+        marginal[y] = total > 0.0 ? static_cast<float>(marginal[y] / total) : static_cast<float>(y) / height;
+    }
+    marginal[height] = 1.0f;
+
+    // 3. Pdf of each pixel in UV space (integrates to 1 over [0,1]^2)
+    std::vector<float>& pdf = tables.pdf;
+    pdf.resize(static_cast<size_t>(width) * height);
+    double scale = total > 0.0 ? static_cast<double>(width) * height / total : 0.0;
+    ThreadPool::Global().ParallelFor(height, [&](size_t y) {
+        const uint16_t* row = rgba + y * width * 4;
+        float sin_theta = RowSinTheta(y, height);
+        for (int x = 0; x < width; ++x) {
+            pdf[y * width + x] = total > 0.0 ? static_cast<float>(PixelWeight(row + x * 4, sin_theta) * scale) : 1.0f;
+        }
+    });
+
+    tables.width = width;
+    tables.height = height;
+    return tables;
+}
+
+void EnvironmentMap::AccumulateMemory(MemoryReport* report) const {
+    report->AddGpu(MEMORY_CATEGORY_SKYBOX, MemoryReport::GetBufferBytes(marginal_cdf_buffer_.get()) +
+                                               MemoryReport::GetBufferBytes(conditional_cdf_buffer_.get()) +
+                                               MemoryReport::GetBufferBytes(pdf_buffer_.get()));
+}
+
+void EnvironmentMap::Upload(const EnvironmentTables& tables) {
+    width_ = height_ = 0;
+    if (tables.width <= 0 || tables.height <= 0) {
+        return;
+    }
+
+    auto upload = [this](std::unique_ptr<grassland::graphics::Buffer>& buffer, const std::vector<float>& data) {
+        core_->CreateBuffer(data.size() * sizeof(float), grassland::graphics::BUFFER_TYPE_STATIC, &buffer);
+        buffer->UploadData(data.data(), data.size() * sizeof(float));
+    };
+    upload(marginal_cdf_buffer_, tables.marginal_cdf);
+    upload(conditional_cdf_buffer_, tables.conditional_cdf);
+    upload(pdf_buffer_, tables.pdf);
+
+    width_ = tables.width;
+    height_ = tables.height;
+    grassland::LogInfo("Uploaded environment sampling tables for {}x{} map", width_, height_);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "long_march.h"
+#include "MemoryReport.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// CPU side of the sampling tables, computed off the main thread
+struct EnvironmentTables {
+    int width = 0;
+    int height = 0;
+    std::vector<float> marginal_cdf;     // height + 1
+    std::vector<float> conditional_cdf;  // height * (width + 1)
+    std::vector<float> pdf;              // width * height, in UV space
+};
+
+// Importance sampling tables for an equirectangular HDR environment. Each
+// pixel is weighted by its luminance times sin(theta) (the solid angle it
+// covers), and stored as a marginal CDF over rows plus one conditional CDF per
+// row, so the shader can draw directions proportional to the incoming light
+// and evaluate the matching pdf for multiple importance sampling.
+class EnvironmentMap {
+public:
+    explicit EnvironmentMap(grassland::graphics::Core* core);
+
+    // Compute the tables from half-float RGBA pixels (rows are split over the
+    // thread pool; safe to call from a pool worker)
+    static EnvironmentTables ComputeTables(const uint16_t* rgba, int width, int height);
+
+    // Upload tables from ComputeTables (empty tables disable explicit sampling)
+    void Upload(const EnvironmentTables& tables);
+
+    bool IsValid() const { return width_ > 0; }
+    int GetWidth() const { return width_; }
+    int GetHeight() const { return height_; }
+
+    // Bound to space17: marginal CDF (height + 1), conditional CDFs
+    // (height * (width + 1)), per-pixel pdf in UV space (width * height)
+    grassland::graphics::Buffer* GetMarginalCdfBuffer() const { return marginal_cdf_buffer_.get(); }
+    grassland::graphics::Buffer* GetConditionalCdfBuffer() const { return conditional_cdf_buffer_.get(); }
+    grassland::graphics::Buffer* GetPdfBuffer() const { return pdf_buffer_.get(); }
+
+    void AccumulateMemory(MemoryReport* report) const;
+
+private:
+    grassland::graphics::Core* core_;
+    int width_ = 0;
+    int height_ = 0;
+
+    std::unique_ptr<grassland::graphics::Buffer> marginal_cdf_buffer_;
+    std::unique_ptr<grassland::graphics::Buffer> conditional_cdf_buffer_;
+    std::unique_ptr<grassland::graphics::Buffer> pdf_buffer_;
+};
@@ -1,4 +1,10 @@
 #include "Film.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "stb_image_write.h"
+
+#include <algorithm>
+#include <cmath>
 
 Film::Film(grassland::graphics::Core* core, int width, int height)
     : core_(core)
@@ -11,44 +17,68 @@ Film::Film(grassland::graphics::Core* core, int width, int height)
 }
 
 Film::~Film() {
-    accumulated_color_image_.reset();
-    accumulated_samples_image_.reset();
-    output_image_.reset();
+    ReleaseImages();
 }
 
 void Film::CreateImages() {
-    // Create accumulated color image (RGBA32F for high precision accumulation)
-    core_->CreateImage(width_, height_, 
-                      grassland::graphics::IMAGE_FORMAT_R32G32B32A32_SFLOAT,
-                      &accumulated_color_image_);
-    
-    // Create accumulated samples image (R32_SINT to count samples)
-    core_->CreateImage(width_, height_, 
-                      grassland::graphics::IMAGE_FORMAT_R32_SINT,
-                      &accumulated_samples_image_);
-    
+    for (int i = 0; i < 2; i++) {
+        // Create accumulated color image (RGBA32F for high precision accumulation)
+        core_->CreateImage(width_, height_, 
+                          grassland::graphics::IMAGE_FORMAT_R32G32B32A32_SFLOAT,
+                          &accumulated_color_images_[i]);
+        
+        // Create accumulated samples image (R32_SINT to count samples)
+        core_->CreateImage(width_, height_, 
+                          grassland::graphics::IMAGE_FORMAT_R32_SINT,
+                          &accumulated_samples_images_[i]);
+        
+        // Create first-hit AOV images (RGBA32F, summed like the color)
+        core_->CreateImage(width_, height_,
+                          grassland::graphics::IMAGE_FORMAT_R32G32B32A32_SFLOAT,
+                          &accumulated_albedo_images_[i]);
+        core_->CreateImage(width_, height_,
+                          grassland::graphics::IMAGE_FORMAT_R32G32B32A32_SFLOAT,
+                          &accumulated_normal_images_[i]);
+    }
+
     // Create output image (RGBA32F for final result)
     core_->CreateImage(width_, height_, 
                       grassland::graphics::IMAGE_FORMAT_R32G32B32A32_SFLOAT,
                       &output_image_);
 }
 
+void Film::ReleaseImages() {
+    for (int i = 0; i < 2; i++) {
+        accumulated_color_images_[i].reset();
+        accumulated_samples_images_[i].reset();
+        accumulated_albedo_images_[i].reset();
+        accumulated_normal_images_[i].reset();
+    }
+    output_image_.reset();
+}
+
 void Film::Reset() {
     // Clear accumulated color to black
     std::unique_ptr<grassland::graphics::CommandContext> cmd_context;
     core_->CreateCommandContext(&cmd_context);
-    cmd_context->CmdClearImage(accumulated_color_image_.get(), { {0.0f, 0.0f, 0.0f, 0.0f} });
-    cmd_context->CmdClearImage(accumulated_samples_image_.get(), { {0, 0, 0, 0} });
+    for (int i = 0; i < 2; i++) {
+        cmd_context->CmdClearImage(accumulated_color_images_[i].get(), { {0.0f, 0.0f, 0.0f, 0.0f} });
+        cmd_context->CmdClearImage(accumulated_samples_images_[i].get(), { {0, 0, 0, 0} });
+        cmd_context->CmdClearImage(accumulated_albedo_images_[i].get(), { {0.0f, 0.0f, 0.0f, 0.0f} });
+        cmd_context->CmdClearImage(accumulated_normal_images_[i].get(), { {0.0f, 0.0f, 0.0f, 0.0f} });
+    }
     cmd_context->CmdClearImage(output_image_.get(), { {0.0f, 0.0f, 0.0f, 0.0f} });
     core_->SubmitCommandContext(cmd_context.get());
     
     sample_count_ = 0;
+    denoised_output_ = false;
     grassland::LogInfo("Film accumulation reset");
 }
 
 float toneMapping(float x) { x *= 2; return x / (1 + x); }
 
 void Film::DevelopToOutput() {
+    TRACE_SCOPE("Film::DevelopToOutput");
     // This would ideally be done in a compute shader for efficiency
     // For now, we'll do it on the CPU (simple but potentially slow)
     
@@ -56,20 +86,179 @@ void Film::DevelopToOutput() {
         return;
     }
 
-    // Download accumulated color and samples
-    size_t color_size = width_ * height_ * sizeof(float) * 4;
-    std::vector<float> accumulated_colors(width_ * height_ * 4);
-    accumulated_color_image_->DownloadData(accumulated_colors.data());
+    // Denoising every frame would stall the preview, keep the last result in between
+    if (denoiser_settings_.enabled && denoised_output_ &&
+        (sample_count_ & (sample_count_ - 1)) != 0 && sample_count_ % 64 != 0) {
+        return;
+    }
 
-    // Divide by sample count to get average
-    std::vector<float> output_colors(width_ * height_ * 4);
-    for (int i = 0; i < width_ * height_ * 4; i++) {
-        output_colors[i] = accumulated_colors[i] / static_cast<float>(sample_count_);
-        output_colors[i] = toneMapping(output_colors[i]);
+    std::vector<float> output_colors;
+    Develop(&output_colors);
+    for (size_t i = 0; i < output_colors.size(); i++) {
+        output_colors[i] = (i & 3) == 3 ? 1.0f : toneMapping(output_colors[i]);
     }
 
     // Upload to output image
     output_image_->UploadData(output_colors.data());
+    denoised_output_ = denoiser_settings_.enabled;
+}
+
+void Film::Develop(std::vector<float>* colors) {
+    TRACE_SCOPE("Film::Develop");
+    size_t pixel_count = static_cast<size_t>(width_) * height_;
+    colors->assign(pixel_count * 4, 0.0f);
+    if (sample_count_ == 0) {
+        return;
+    }
+
+    // Download accumulated color and divide by the sample count of each pixel
+    // (reprojected history leaves different counts across the image)
+    GetAccumulatedColorImage()->DownloadData(colors->data());
+    std::vector<int32_t> samples(pixel_count);
+    GetAccumulatedSamplesImage()->DownloadData(samples.data());
+    ThreadPool::Global().ParallelFor(height_, [&](size_t y) {
+        for (size_t p = y * width_; p < (y + 1) * width_; ++p) {
+            float inv_samples = 1.0f / static_cast<float>(std::max(samples[p], 1));
+            for (int c = 0; c < 4; ++c) {
+                (*colors)[p * 4 + c] *= inv_samples;
+            }
+        }
+    });
+    if (!denoiser_settings_.enabled) {
+        return;
+    }
+
+    DenoiserFrame frame;
+    frame.width = width_;
+    frame.height = height_;
+    frame.color.swap(*colors);
+    frame.albedo.resize(pixel_count * 4);
+    frame.normal.resize(pixel_count * 4);
+    GetAccumulatedAlbedoImage()->DownloadData(frame.albedo.data());
+    GetAccumulatedNormalImage()->DownloadData(frame.normal.data());
+
+    bool guided = denoiser_settings_.variance_guided;
+    if (guided) {
+        frame.variance.resize(pixel_count);
+    }
+    ThreadPool::Global().ParallelFor(height_, [&](size_t y) {
+        for (size_t p = y * width_; p < (y + 1) * width_; ++p) {
+            float n = static_cast<float>(std::max(samples[p], 1));
+            for (int c = 0; c < 4; ++c) {
+                frame.albedo[p * 4 + c] /= n;
+            }
+            float* normal = &frame.normal[p * 4];
+            float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            for (int c = 0; c < 3; ++c) {
+                normal[c] = length > 0.0f ? normal[c] / length : 0.0f;
+            }
+            if (guided) {
+                const float* color = &frame.color[p * 4];
+                float mean = 0.2126f * color[0] + 0.7152f * color[1] + 0.0722f * color[2];
+                // The sample variance needs a few samples to mean anything; treat
+                // fresh pixels (e.g. disoccluded by reprojection) as fully noisy
+                frame.variance[p] = n >= 4.0f ? std::max(color[3] - mean * mean, 0.0f) / n : mean * mean;
+            }
+        }
+    });
+
+    Denoiser::Denoise(denoiser_settings_, &frame);
+    colors->swap(frame.color);
+}
+
+bool Film::SavePng(const std::string& filename) {
+    if (sample_count_ == 0) {
+        grassland::LogWarning("Cannot save {}: no samples accumulated yet", filename);
+        return false;
+    }
+
+    std::vector<float> colors;
+    Develop(&colors);
+
+    // Clamp to [0, 1] and convert to 8-bit, opaque
+    std::vector<uint8_t> bytes(colors.size());
+    for (size_t i = 0; i < colors.size(); i++) {
+        float value = (i & 3) == 3 ? 1.0f : colors[i];
+        bytes[i] = static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, value)) * 255.0f);
+    }
+    if (!stbi_write_png(filename.c_str(), width_, height_, 4, bytes.data(), width_ * 4)) {
+        grassland::LogError("Failed to write {}", filename);
+        return false;
+    }
+    return true;
+}
+
+void Film::Download(FilmData* data) const {
+    TRACE_SCOPE("Film::Download");
+    size_t pixel_count = static_cast<size_t>(width_) * height_;
+    data->width = width_;
+    data->height = height_;
+    data->sample_count = sample_count_;
+    data->color.resize(pixel_count * 4);
+    data->samples.resize(pixel_count);
+    data->albedo.resize(pixel_count * 4);
+    data->normal.resize(pixel_count * 4);
+    GetAccumulatedColorImage()->DownloadData(data->color.data());
+    GetAccumulatedSamplesImage()->DownloadData(data->samples.data());
+    GetAccumulatedAlbedoImage()->DownloadData(data->albedo.data());
+    GetAccumulatedNormalImage()->DownloadData(data->normal.data());
+}
+
+bool Film::Upload(const FilmData& data) {
+    TRACE_SCOPE("Film::Upload");
+    size_t pixel_count = static_cast<size_t>(width_) * height_;
+    if (data.width != width_ || data.height != height_ || data.color.size() != pixel_count * 4 ||
+        data.samples.size() != pixel_count || data.albedo.size() != pixel_count * 4 ||
+        data.normal.size() != pixel_count * 4) {
+        grassland::LogError("Film data of {}x{} does not fit a {}x{} film", data.width, data.height, width_, height_);
+        return false;
+    }
+    // Only the accumulated set is read as history, the target is overwritten by the next dispatch
+    GetAccumulatedColorImage()->UploadData(data.color.data());
+    GetAccumulatedSamplesImage()->UploadData(data.samples.data());
+    GetAccumulatedAlbedoImage()->UploadData(data.albedo.data());
+    GetAccumulatedNormalImage()->UploadData(data.normal.data());
+    sample_count_ = data.sample_count;
+    denoised_output_ = false;
+    return true;
+}
+
+bool FilmData::Merge(const FilmData& other) {
+    if (color.empty()) {
+        *this = other;
+        return true;
+    }
+    if (other.width != width || other.height != height || other.color.size() != color.size() ||
+        other.samples.size() != samples.size() || other.albedo.size() != albedo.size() ||
+        other.normal.size() != normal.size()) {
+        return false;
+    }
+    sample_count += other.sample_count;
+    for (size_t i = 0; i < color.size(); i++) {
+        color[i] += other.color[i];
+        albedo[i] += other.albedo[i];
+    }
+    for (size_t p = 0; p < samples.size(); p++) {
+        samples[p] += other.samples[p];
+        for (int c = 0; c < 3; c++) {
+            normal[p * 4 + c] += other.normal[p * 4 + c];
+        }
+        // The instance ID is a label, not a sum: keep one that hit something
+        if (normal[p * 4 + 3] == 0.0f) {
+            normal[p * 4 + 3] = other.normal[p * 4 + 3];
+        }
+    }
+    return true;
+}
+
+void Film::AccumulateMemory(MemoryReport* report) const {
+    using grassland::graphics::IMAGE_FORMAT_R32G32B32A32_SFLOAT;
+    using grassland::graphics::IMAGE_FORMAT_R32_SINT;
+    // Per set: color, albedo and normal (RGBA32F) and the sample count (R32_SINT)
+    size_t set_bytes = 3 * MemoryReport::GetImageBytes(width_, height_, IMAGE_FORMAT_R32G32B32A32_SFLOAT) +
+                       MemoryReport::GetImageBytes(width_, height_, IMAGE_FORMAT_R32_SINT);
+    report->AddGpu(MEMORY_CATEGORY_FILM,
+                   2 * set_bytes + MemoryReport::GetImageBytes(width_, height_, IMAGE_FORMAT_R32G32B32A32_SFLOAT));
 }
 
 void Film::Resize(int width, int height) {
@@ -81,10 +270,7 @@ void Film::Resize(int width, int height) {
     height_ = height;
 
     // Recreate images with new dimensions
-    accumulated_color_image_.reset();
-    accumulated_samples_image_.reset();
-    output_image_.reset();
-
+    ReleaseImages();
     CreateImages();
     Reset();
     
@@ -1,21 +1,55 @@
 #pragma once
 #include "long_march.h"
+#include "Denoiser.h"
+#include "MemoryReport.h"
+
+// CPU copy of a film's accumulation (see Film::Download). Every channel is a
+// per-pixel sum, so films rendering disjoint samples of the same view merge by
+// adding them up.
+struct FilmData {
+    int width = 0;
+    int height = 0;
+    int sample_count = 0;          // Frames accumulated
+    std::vector<float> color;      // RGB sum, A = sum of squared luminance
+    std::vector<int32_t> samples;  // Samples per pixel
+    std::vector<float> albedo;     // First-hit albedo sum, A = hit distance sum
+    std::vector<float> normal;     // First-hit normal sum, W = instance ID + 1 of the last sample
+
+    // Add the samples of other (same size); returns false on a size mismatch
+    bool Merge(const FilmData& other);
+};
 
 // Film class for accumulating ray tracing samples over time
-// Used for progressive rendering when camera is stationary
+// Used for progressive rendering when camera is stationary. The accumulation
+// images are double-buffered: each dispatch reads the last result as history
+// (reprojected into the new view when the camera moved) and writes the target
+// set, then Advance() makes the target the accumulated result.
 class Film {
 public:
     Film(grassland::graphics::Core* core, int width, int height);
     ~Film();
 
-    // Reset accumulation (call when camera moves or scene changes)
+    // Reset accumulation (call when the scene changes)
     void Reset();
 
-    // Get the accumulated color image (for display)
-    grassland::graphics::Image* GetAccumulatedColorImage() const { return accumulated_color_image_.get(); }
+    // Get the accumulated color image (for display, and as history for the shader)
+    grassland::graphics::Image* GetAccumulatedColorImage() const { return accumulated_color_images_[current_].get(); }
     
-    // Get the sample count image (for shader)
-    grassland::graphics::Image* GetAccumulatedSamplesImage() const { return accumulated_samples_image_.get(); }
+    // Get the sample count image (per pixel, varies after reprojection)
+    grassland::graphics::Image* GetAccumulatedSamplesImage() const { return accumulated_samples_images_[current_].get(); }
+
+    // First-hit AOVs summed like the color: albedo + hit distance, world normal + last instance ID + 1
+    grassland::graphics::Image* GetAccumulatedAlbedoImage() const { return accumulated_albedo_images_[current_].get(); }
+    grassland::graphics::Image* GetAccumulatedNormalImage() const { return accumulated_normal_images_[current_].get(); }
+
+    // Images the next dispatch writes (for shader)
+    grassland::graphics::Image* GetTargetColorImage() const { return accumulated_color_images_[1 - current_].get(); }
+    grassland::graphics::Image* GetTargetSamplesImage() const { return accumulated_samples_images_[1 - current_].get(); }
+    grassland::graphics::Image* GetTargetAlbedoImage() const { return accumulated_albedo_images_[1 - current_].get(); }
+    grassland::graphics::Image* GetTargetNormalImage() const { return accumulated_normal_images_[1 - current_].get(); }
+
+    // Make the images written by the last dispatch the accumulated ones
+    void Advance() { current_ = 1 - current_; }
     
     // Get the final output image (averaged result)
     grassland::graphics::Image* GetOutputImage() const { return output_image_.get(); }
@@ -23,12 +57,33 @@ public:
     // Get current sample count
     int GetSampleCount() const { return sample_count_; }
 
+    // Accumulation (both ping-pong sets), AOV and output images
+    void AccumulateMemory(MemoryReport* report) const;
+
     // Increment sample count
     void IncrementSampleCount() { sample_count_++; }
 
-    // Convert accumulated data to final output image (divide by sample count)
+    // Convert accumulated data to final output image (divide by the per-pixel sample count).
+    // With the denoiser on, the output is refreshed at power-of-two sample
+    // counts and every 64 samples after that.
     void DevelopToOutput();
 
+    // Averaged linear RGBA of every pixel, denoised when enabled (for export)
+    void Develop(std::vector<float>* colors);
+
+    // Develop and write an 8-bit PNG; returns false (and logs) on failure
+    bool SavePng(const std::string& filename);
+
+    // Copy the accumulation to the CPU, or replace it (and the sample count) with data of
+    // the film's size, e.g. to merge the results of several processes
+    void Download(FilmData* data) const;
+    bool Upload(const FilmData& data);
+
+    DenoiserSettings& GetDenoiserSettings() { return denoiser_settings_; }
+
+    // Redevelop on the next DevelopToOutput (call after changing the denoiser settings)
+    void InvalidateOutput() { denoised_output_ = false; }
+
     // Resize the film (call when window resizes)
     void Resize(int width, int height);
 
@@ -39,17 +94,27 @@ private:
     grassland::graphics::Core* core_;
     int width_;
     int height_;
-    int sample_count_; // Number of accumulated samples
+    int sample_count_; // Number of frames accumulated since the last reset
+    int current_ = 0;  // Index of the accumulated set, the other one is the target
 
-    // Accumulated color (sum of all samples)
-    std::unique_ptr<grassland::graphics::Image> accumulated_color_image_;
+    // Accumulated color (sum of all samples, alpha holds the sum of squared luminance)
+    std::unique_ptr<grassland::graphics::Image> accumulated_color_images_[2];
     
     // Accumulated sample count per pixel
-    std::unique_ptr<grassland::graphics::Image> accumulated_samples_image_;
+    std::unique_ptr<grassland::graphics::Image> accumulated_samples_images_[2];
+
+    // Accumulated first-hit albedo (alpha: hit distance, 0 for the sky) and
+    // world normal (w: instance ID + 1 of the last sample, 0 for the sky)
+    std::unique_ptr<grassland::graphics::Image> accumulated_albedo_images_[2];
+    std::unique_ptr<grassland::graphics::Image> accumulated_normal_images_[2];
+
+    DenoiserSettings denoiser_settings_;
+    bool denoised_output_ = false;  // Output image holds a denoised frame
     
     // Final output image (accumulated_color / accumulated_samples)
     std::unique_ptr<grassland::graphics::Image> output_image_;
 
     void CreateImages();
+    void ReleaseImages();
 };
 
@@ -0,0 +1,284 @@
+#include "FilmCheckpoint.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Deflate from stb_image_write (implemented in app.cpp); the result is released with free()
+extern "C" unsigned char* stbi_zlib_compress(unsigned char* data, int data_len, int* out_len, int quality);
+
+namespace {
+// Bump when the file layout changes
+constexpr uint32_t kCheckpointVersion = 2;
+
+struct ChunkEntry {
+    uint32_t raw_size;
+    uint32_t stored_size;  // Equal to raw_size for chunks stored uncompressed
+};
+
+template <typename Byte>
+struct ChunkSpan {
+    Byte* data;
+    uint32_t size;
+};
+
+// The film's channels cut into chunks, in file order
+template <typename Byte, typename Data>
+std::vector<ChunkSpan<Byte>> GetChunks(Data& data) {
+    std::pair<Byte*, size_t> channels[] = {
+        {reinterpret_cast<Byte*>(data.color.data()), data.color.size() * sizeof(float)},
+        {reinterpret_cast<Byte*>(data.samples.data()), data.samples.size() * sizeof(int32_t)},
+        {reinterpret_cast<Byte*>(data.albedo.data()), data.albedo.size() * sizeof(float)},
+        {reinterpret_cast<Byte*>(data.normal.data()), data.normal.size() * sizeof(float)},
+    };
+    std::vector<ChunkSpan<Byte>> chunks;
+    for (const auto& channel : channels) {
+        for (size_t offset = 0; offset < channel.second; offset += FilmCheckpoint::kChunkBytes) {
+            size_t size = std::min(FilmCheckpoint::kChunkBytes, channel.second - offset);
+            chunks.push_back({channel.first + offset, static_cast<uint32_t>(size)});
+        }
+    }
+    return chunks;
+}
+
+// Group byte b of every 32-bit value into plane b, and back
+void ShuffleBytes(const uint8_t* in, size_t size, uint8_t* out) {
+    size_t count = size / 4;
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t b = 0; b < 4; ++b) {
+            out[b * count + i] = in[i * 4 + b];
+        }
+    }
+}
+
+void UnshuffleBytes(const uint8_t* in, size_t size, uint8_t* out) {
+    size_t count = size / 4;
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t b = 0; b < 4; ++b) {
+            out[i * 4 + b] = in[b * count + i];
+        }
+    }
+}
+
+// Empty if deflating does not make the chunk smaller
+std::vector<uint8_t> CompressChunk(const uint8_t* data, uint32_t size) {
+    std::vector<uint8_t> shuffled(size);
+    ShuffleBytes(data, size, shuffled.data());
+    int compressed_size = 0;
+    unsigned char* compressed = stbi_zlib_compress(shuffled.data(), static_cast<int>(size), &compressed_size, 5);
+    std::vector<uint8_t> result;
+    if (compressed && static_cast<uint32_t>(compressed_size) < size) {
+        result.assign(compressed, compressed + compressed_size);
+    }
+    free(compressed);
+    return result;
+}
+
+bool DecompressChunk(const uint8_t* stored, uint32_t stored_size, uint8_t* out, uint32_t raw_size) {
+    std::vector<uint8_t> shuffled(raw_size);
+    int decoded = stbi_zlib_decode_buffer(reinterpret_cast<char*>(shuffled.data()), static_cast<int>(raw_size),
+                                          reinterpret_cast<const char*>(stored), static_cast<int>(stored_size));
+    if (decoded != static_cast<int>(raw_size)) {
+        return false;
+    }
+    UnshuffleBytes(shuffled.data(), raw_size, out);
+    return true;
+}
+}  // namespace
+
+bool FilmCheckpoint::Write(const std::string& path, const FilmData& data, const FilmCheckpointInfo& info,
+                           bool compress) {
+    TRACE_SCOPE("FilmCheckpoint::Write");
+    auto chunks = GetChunks<const uint8_t>(data);
+    std::vector<std::vector<uint8_t>> compressed(chunks.size());
+    if (compress) {
+        ThreadPool::Global().ParallelFor(chunks.size(), [&](size_t i) {
+            compressed[i] = CompressChunk(chunks[i].data, chunks[i].size);
+        });
+    }
+
+    std::vector<ChunkEntry> table(chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        table[i].raw_size = chunks[i].size;
+        table[i].stored_size = compressed[i].empty() ? chunks[i].size : static_cast<uint32_t>(compressed[i].size());
+    }
+    auto stored_bytes = [&](size_t i) { return compressed[i].empty() ? chunks[i].data : compressed[i].data(); };
+
+    FilmCheckpointHeader header{};
+    std::memcpy(header.magic, "SMCK", 4);
+    header.version = kCheckpointVersion;
+    header.view_hash = info.view_hash;
+    header.width = data.width;
+    header.height = data.height;
+    header.sample_count = data.sample_count;
+    header.first_sample = info.first_sample;
+    header.sequence_seed = info.sequence_seed;
+    header.frame_index = info.frame_index;
+    header.flags = compress ? static_cast<uint32_t>(FILM_CHECKPOINT_COMPRESSED) : 0u;
+    header.chunk_count = static_cast<uint32_t>(chunks.size());
+    header.data_hash = HashBytes(table.data(), table.size() * sizeof(ChunkEntry));
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        header.data_hash = HashBytes(stored_bytes(i), table[i].stored_size, header.data_hash);
+    }
+
+    // Written through a temporary file so a crash never leaves a partial checkpoint
+    std::vector<FileSpan> spans = {{&header, sizeof(header)}, {table.data(), table.size() * sizeof(ChunkEntry)}};
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        spans.push_back({stored_bytes(i), table[i].stored_size});
+    }
+    std::string error;
+    if (!WriteFileAtomically(path, spans, &error)) {
+        grassland::LogError("Cannot write film checkpoint {}: {}", path, error);
+        return false;
+    }
+    return true;
+}
+
+bool FilmCheckpoint::Read(const std::string& path, FilmData* data, FilmCheckpointInfo* info) {
+    TRACE_SCOPE("FilmCheckpoint::Read");
+    MappedFile file;
+    if (!file.Open(path) || file.Size() < sizeof(FilmCheckpointHeader)) {
+        grassland::LogError("Cannot read film checkpoint {}", path);
+        return false;
+    }
+    FilmCheckpointHeader header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+    size_t table_bytes = static_cast<size_t>(header.chunk_count) * sizeof(ChunkEntry);
+    if (std::memcmp(header.magic, "SMCK", 4) != 0 || header.version != kCheckpointVersion ||
+        header.width <= 0 || header.height <= 0 || file.Size() - sizeof(header) < table_bytes) {
+        grassland::LogError("{} is not a film checkpoint of this version", path);
+        return false;
+    }
+
+    size_t pixel_count = static_cast<size_t>(header.width) * header.height;
+    data->width = header.width;
+    data->height = header.height;
+    data->sample_count = header.sample_count;
+    data->color.resize(pixel_count * 4);
+    data->samples.resize(pixel_count);
+    data->albedo.resize(pixel_count * 4);
+    data->normal.resize(pixel_count * 4);
+    auto chunks = GetChunks<uint8_t>(*data);
+
+    std::vector<ChunkEntry> table(header.chunk_count);
+    std::memcpy(table.data(), file.Data() + sizeof(header), table_bytes);
+    std::vector<size_t> offsets(table.size());
+    size_t offset = sizeof(header) + table_bytes;
+    bool valid = table.size() == chunks.size();
+    for (size_t i = 0; valid && i < table.size(); ++i) {
+        offsets[i] = offset;
+        offset += table[i].stored_size;
+        valid = table[i].raw_size == chunks[i].size && table[i].stored_size <= table[i].raw_size &&
+                offset <= file.Size();
+    }
+    if (!valid || offset != file.Size()) {
+        grassland::LogError("Film checkpoint {} is truncated or does not match its {}x{} header", path,
+                            header.width, header.height);
+        return false;
+    }
+    uint64_t data_hash = HashBytes(file.Data() + sizeof(header), table_bytes);
+    for (size_t i = 0; i < table.size(); ++i) {
+        data_hash = HashBytes(file.Data() + offsets[i], table[i].stored_size, data_hash);
+    }
+    if (data_hash != header.data_hash) {
+        grassland::LogError("Film checkpoint {} is corrupted", path);
+        return false;
+    }
+
+    std::atomic<bool> decoded{true};
+    ThreadPool::Global().ParallelFor(chunks.size(), [&](size_t i) {
+        const uint8_t* stored = file.Data() + offsets[i];
+        if (table[i].stored_size == table[i].raw_size) {
+            std::memcpy(chunks[i].data, stored, table[i].raw_size);
+        } else if (!DecompressChunk(stored, table[i].stored_size, chunks[i].data, table[i].raw_size)) {
+            decoded = false;
+        }
+    });
+    if (!decoded) {
+        grassland::LogError("Failed to decompress film checkpoint {}", path);
+        return false;
+    }
+
+    info->view_hash = header.view_hash;
+    info->first_sample = header.first_sample;
+    info->sequence_seed = header.sequence_seed;
+    info->frame_index = header.frame_index;
+    return true;
+}
+
+bool FilmCheckpoint::Merge(const std::vector<std::string>& paths, FilmData* data, FilmCheckpointInfo* info) {
+    TRACE_SCOPE("FilmCheckpoint::Merge");
+    *data = FilmData{};
+    *info = FilmCheckpointInfo{};
+    struct SequenceRange {
+        uint32_t seed;
+        uint32_t first;
+        uint32_t end;
+    };
+    std::vector<SequenceRange> ranges;
+    uint32_t sequence_end = 0;
+    FilmData part;
+    FilmCheckpointInfo part_info;
+    for (const std::string& path : paths) {
+        if (!Read(path, &part, &part_info)) {
+            return false;
+        }
+        if (!ranges.empty() && part_info.view_hash != info->view_hash) {
+            grassland::LogError("Cannot merge {}: rendered from a different camera, scene or resolution", path);
+            return false;
+        }
+        if (!data->Merge(part)) {
+            grassland::LogError("Cannot merge {}: {}x{} does not match {}x{}", path, part.width, part.height,
+                                data->width, data->height);
+            return false;
+        }
+        // The same samples twice would be correlated, not new information
+        uint32_t part_end = part_info.first_sample + static_cast<uint32_t>(part.sample_count);
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            if (ranges[i].seed == part_info.sequence_seed && part_info.first_sample < ranges[i].end &&
+                ranges[i].first < part_end) {
+                grassland::LogWarning("{} repeats samples of {} (same sequence range)", path, paths[i]);
+            }
+        }
+        if (ranges.empty()) {
+            *info = part_info;
+        }
+        info->frame_index = std::max(info->frame_index, part_info.frame_index);
+        sequence_end = std::max(sequence_end, part_end);
+        ranges.push_back({part_info.sequence_seed, part_info.first_sample, part_end});
+    }
+    if (ranges.empty()) {
+        return false;
+    }
+    // Resuming the merged film continues after every input's range
+    uint32_t merged_count = static_cast<uint32_t>(data->sample_count);
+    info->first_sample = sequence_end > merged_count ? sequence_end - merged_count : 0;
+    return true;
+}
+
+bool FilmCheckpointWriter::WriteAsync(const std::string& path, FilmData data, const FilmCheckpointInfo& info,
+                                      bool compress) {
+    bool expected = false;
+    if (!state_->writing.compare_exchange_strong(expected, true)) {
+        return false;
+    }
+    auto state = state_;
+    auto film = std::make_shared<FilmData>(std::move(data));
+    ThreadPool::Global().Enqueue([state, film, path, info, compress]() {
+        if (FilmCheckpoint::Write(path, *film, info, compress)) {
+            grassland::LogInfo("Film checkpoint written: {} ({} samples)", path, film->sample_count);
+        }
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->writing = false;
+        state->done.notify_all();
+    });
+    return true;
+}
+
+void FilmCheckpointWriter::Wait() {
+    std::unique_lock<std::mutex> lock(state_->mutex);
+    state_->done.wait(lock, [this] { return !state_->writing; });
+}
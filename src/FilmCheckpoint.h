@@ -0,0 +1,77 @@
+#pragma once
+#include "Film.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// What a checkpoint needs besides the film to continue or merge a render
+struct FilmCheckpointInfo {
+    uint64_t view_hash = 0;      // Camera, resolution, scene and sampler (see Application::GetViewHash)
+    uint32_t first_sample = 0;   // Sequence index of the film's first sample
+    uint32_t sequence_seed = 0;  // Scramble of the sample sequence
+    uint32_t frame_index = 0;    // Frames the writing process had rendered
+};
+
+// On-disk layout: header, chunk table ({raw size, stored size} per chunk),
+// then the chunks. The film's channels (color, samples, albedo, normal) are
+// cut into chunks of at most kChunkBytes; compressed chunks are byte-shuffled
+// (the four bytes of every 32-bit value grouped into planes, which puts the
+// similar exponent bytes together) and deflated.
+struct FilmCheckpointHeader {
+    char magic[4];          // "SMCK"
+    uint32_t version;
+    uint64_t view_hash;
+    int32_t width;
+    int32_t height;
+    int32_t sample_count;
+    uint32_t first_sample;
+    uint32_t sequence_seed;
+    uint32_t frame_index;
+    uint32_t flags;         // FILM_CHECKPOINT_COMPRESSED
+    uint32_t chunk_count;
+    uint64_t data_hash;     // Hash of the chunk table and chunks, rejects truncated or corrupted files
+};
+
+enum FilmCheckpointFlags : uint32_t {
+    FILM_CHECKPOINT_COMPRESSED = 1,
+};
+
+// Film checkpoints for long renders: written atomically (temporary file,
+// then rename) so a crash mid-write leaves the previous checkpoint intact.
+class FilmCheckpoint {
+public:
+    static constexpr size_t kChunkBytes = 4 << 20;
+
+    static bool Write(const std::string& path, const FilmData& data, const FilmCheckpointInfo& info, bool compress);
+    static bool Read(const std::string& path, FilmData* data, FilmCheckpointInfo* info);
+
+    // Sum checkpoints of the same view (same view hash and size). The merged
+    // info continues the sequence after the last sample of any input.
+    static bool Merge(const std::vector<std::string>& paths, FilmData* data, FilmCheckpointInfo* info);
+};
+
+// Writes checkpoints on the global thread pool, one at a time
+class FilmCheckpointWriter {
+public:
+    ~FilmCheckpointWriter() { Wait(); }
+
+    // Start writing data to path; returns false (and drops the request) while a write is running
+    bool WriteAsync(const std::string& path, FilmData data, const FilmCheckpointInfo& info, bool compress);
+
+    bool IsWriting() const { return state_->writing; }
+
+    // Block until the running write has finished
+    void Wait();
+
+private:
+    struct State {
+        std::atomic<bool> writing{false};
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    std::shared_ptr<State> state_ = std::make_shared<State>();
+};
@@ -0,0 +1,8 @@
+#include "GpuRetireQueue.h"
+
+void GpuRetireQueue::NextFrame() {
+    frame_++;
+    while (!retired_.empty() && retired_.front().first + kRetireFrames <= frame_) {
+        retired_.pop_front();
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
+
+// Keeps GPU objects alive while frames that may still reference them are in
+// flight. Objects dropped by CPU-side updates (replaced buffers, evicted
+// BLASes, removed entities) are retired instead of destroyed, and released
+// once kRetireFrames more frames have begun.
+class GpuRetireQueue {
+public:
+    // Frames an object outlives its retirement by. Like the virtual texture
+    // feedback ring, this assumes the previous frame may still be running
+    // while the next one is recorded.
+    static constexpr uint64_t kRetireFrames = 3;
+
+    template <typename T>
+    void Retire(T object) {
+        if (object) {
+            retired_.emplace_back(frame_, std::shared_ptr<void>(std::move(object)));
+        }
+    }
+
+    // Call once per frame before recording it; releases what no frame can reference anymore
+    void NextFrame();
+
+    // Release everything (only once the GPU is idle)
+    void Clear() { retired_.clear(); }
+
+    size_t GetRetiredCount() const { return retired_.size(); }
+
+private:
+    uint64_t frame_ = 0;
+    std::deque<std::pair<uint64_t, std::shared_ptr<void>>> retired_;  // Frame retired in, object
+};
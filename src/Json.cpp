@@ -0,0 +1,223 @@
+#include "Json.h"
+
+#include <cstdlib>
+
+namespace {
+// Minimal recursive-descent JSON reader (no \u escapes beyond ASCII)
+class JsonParser {
+public:
+    JsonParser(const std::string& text) : text_(text) {}
+
+    bool Parse(JsonValue* value) {
+        SkipWhitespace();
+        if (!ParseValue(value, 0)) {
+            return false;
+        }
+        SkipWhitespace();
+        return pos_ == text_.size() || Fail("unexpected trailing characters");
+    }
+
+    const std::string& GetError() const { return error_; }
+
+private:
+    static constexpr int kMaxDepth = 64;
+
+    bool Fail(const std::string& message) {
+        if (error_.empty()) {
+            error_ = "line " + std::to_string(line_) + ": " + message;
+        }
+        return false;
+    }
+
+    void SkipWhitespace() {
+        while (pos_ < text_.size()) {
+            char c = text_[pos_];
+            if (c == '\n') {
+                line_++;
+            } else if (c != ' ' && c != '\t' && c != '\r') {
+                return;
+            }
+            pos_++;
+        }
+    }
+
+    bool Consume(char c) {
+        SkipWhitespace();
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            pos_++;
+            return true;
+        }
+        return false;
+    }
+
+    bool ParseValue(JsonValue* value, int depth) {
+        if (depth > kMaxDepth) {
+            return Fail("nesting too deep");
+        }
+        SkipWhitespace();
+        value->line = line_;
+        if (pos_ >= text_.size()) {
+            return Fail("unexpected end of file");
+        }
+        char c = text_[pos_];
+        if (c == '{') {
+            return ParseObject(value, depth);
+        }
+        if (c == '[') {
+            return ParseArray(value, depth);
+        }
+        if (c == '"') {
+            value->type = JsonValue::STRING;
+            return ParseString(&value->string);
+        }
+        if (text_.compare(pos_, 4, "true") == 0 || text_.compare(pos_, 5, "false") == 0) {
+            value->type = JsonValue::BOOLEAN;
+            value->boolean = c == 't';
+            pos_ += value->boolean ? 4 : 5;
+            return true;
+        }
+        if (text_.compare(pos_, 4, "null") == 0) {
+            value->type = JsonValue::NUL;
+            pos_ += 4;
+            return true;
+        }
+        const char* begin = text_.c_str() + pos_;
+        char* end = nullptr;
+        value->number = std::strtod(begin, &end);
+        if (end == begin) {
+            return Fail(std::string("unexpected character '") + c + "'");
+        }
+        value->type = JsonValue::NUMBER;
+        pos_ += end - begin;
+        return true;
+    }
+
+    bool ParseString(std::string* out) {
+        pos_++;  // Opening quote
+        while (pos_ < text_.size()) {
+            char c = text_[pos_++];
+            if (c == '"') {
+                return true;
+            }
+            if (c == '\n') {
+                return Fail("newline in string");
+            }
+            if (c == '\\') {
+                if (pos_ >= text_.size()) {
+                    break;
+                }
+                char e = text_[pos_++];
+                switch (e) {
+                    case 'n': c = '\n'; break;
+                    case 't': c = '\t'; break;
+                    case 'r': c = '\r'; break;
+                    case 'b': c = '\b'; break;
+                    case 'f': c = '\f'; break;
+                    case 'u': {
+                        if (pos_ + 4 > text_.size()) {
+                            return Fail("truncated \\u escape");
+                        }
+                        long code = std::strtol(text_.substr(pos_, 4).c_str(), nullptr, 16);
+                        if (code > 0x7f) {
+                            return Fail("only ASCII \\u escapes are supported");
+                        }
+                        c = static_cast<char>(code);
+                        pos_ += 4;
+                        break;
+                    }
+                    default: c = e; break;  // \" \\ \/
+                }
+            }
+            out->push_back(c);
+        }
+        return Fail("unterminated string");
+    }
+
+    bool ParseArray(JsonValue* value, int depth) {
+        value->type = JsonValue::ARRAY;
+        pos_++;
+        if (Consume(']')) {
+            return true;
+        }
+        do {
+            value->array.emplace_back();
+            if (!ParseValue(&value->array.back(), depth + 1)) {
+                return false;
+            }
+        } while (Consume(','));
+        return Consume(']') || Fail("expected ',' or ']'");
+    }
+
+    bool ParseObject(JsonValue* value, int depth) {
+        value->type = JsonValue::OBJECT;
+        pos_++;
+        if (Consume('}')) {
+            return true;
+        }
+        do {
+            SkipWhitespace();
+            if (pos_ >= text_.size() || text_[pos_] != '"') {
+                return Fail("expected a key string");
+            }
+            value->object.emplace_back();
+            auto& [key, member] = value->object.back();
+            if (!ParseString(&key)) {
+                return false;
+            }
+            if (!Consume(':')) {
+                return Fail("expected ':' after \"" + key + "\"");
+            }
+            if (!ParseValue(&member, depth + 1)) {
+                return false;
+            }
+        } while (Consume(','));
+        return Consume('}') || Fail("expected ',' or '}'");
+    }
+
+    const std::string& text_;
+    size_t pos_ = 0;
+    int line_ = 1;
+    std::string error_;
+};
+}
+
+const JsonValue* JsonValue::Find(const std::string& key) const {
+    for (const auto& [name, member] : object) {
+        if (name == key) {
+            return &member;
+        }
+    }
+    return nullptr;
+}
+
+const char* JsonValue::TypeName(Type type) {
+    static const char* kNames[] = {"null", "boolean", "number", "string", "array", "object"};
+    return kNames[type];
+}
+
+bool ParseJson(const std::string& text, JsonValue* value, std::string* error) {
+    JsonParser parser(text);
+    *value = JsonValue{};
+    if (!parser.Parse(value)) {
+        if (error) {
+            *error = parser.GetError();
+        }
+        return false;
+    }
+    return true;
+}
+
+std::string EscapeJson(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped.push_back('\\');
+            escaped.push_back(c);
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else if (static_cast<unsigned char>(c) >= 0x20) {
+            escaped.push_back(c);
+        }
+    }
+    return escaped;
+}
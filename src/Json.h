@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+
+// Parsed JSON value (scene files, benchmark reports)
+struct JsonValue {
+    enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+    Type type = NUL;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;  // Keeps file order
+    int line = 0;  // Source line, for error messages
+
+    // Member of an object by key (nullptr if absent or not an object)
+    const JsonValue* Find(const std::string& key) const;
+
+    const char* TypeName() const { return TypeName(type); }
+    static const char* TypeName(Type type);
+};
+
+// Parse a whole document; on failure error holds the line and reason
+bool ParseJson(const std::string& text, JsonValue* value, std::string* error);
+
+// Escape quotes, backslashes and newlines for a JSON string literal
+std::string EscapeJson(const std::string& text);
@@ -0,0 +1,71 @@
+#include "LightBVH.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <numeric>
+
+namespace {
+float LightPower(const PointLight& light) {
+    return std::max(0.0f, 0.2126f * light.color.r + 0.7152f * light.color.g + 0.0722f * light.color.b);
+}
+}
+
+LightBVH::LightBVH(grassland::graphics::Core* core) : core_(core) {
+}
+
+void LightBVH::Build(const std::vector<PointLight>& lights) {
+    TRACE_SCOPE("LightBVH::Build");
+    nodes_.clear();
+    if (lights.empty()) {
+        nodes_.push_back(LightBVHNodeGPU{glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), kLeafBit});
+    } else {
+        order_.resize(lights.size());
+        std::iota(order_.begin(), order_.end(), 0u);
+        nodes_.reserve(2 * lights.size() - 1);
+        nodes_.emplace_back();
+        BuildNode(0, 0, lights.size(), lights);
+    }
+
+    size_t buffer_size = nodes_.size() * sizeof(LightBVHNodeGPU);
+    core_->CreateBuffer(buffer_size, grassland::graphics::BUFFER_TYPE_STATIC, &node_buffer_);
+    node_buffer_->UploadData(nodes_.data(), buffer_size);
+    grassland::LogInfo("Built light BVH with {} nodes over {} point lights", nodes_.size(), lights.size());
+}
+
+void LightBVH::AccumulateMemory(MemoryReport* report) const {
+    report->AddCpu(MEMORY_CATEGORY_BVH, MemoryReport::GetVectorBytes(nodes_) + MemoryReport::GetVectorBytes(order_));
+    report->AddGpu(MEMORY_CATEGORY_BVH, MemoryReport::GetBufferBytes(node_buffer_.get()));
+}
+
+void LightBVH::BuildNode(uint32_t node, size_t begin, size_t end, const std::vector<PointLight>& lights) {
+    glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+    float power = 0.0f;
+    for (size_t i = begin; i < end; ++i) {
+        const PointLight& light = lights[order_[i]];
+        lo = glm::min(lo, light.position);
+        hi = glm::max(hi, light.position);
+        power += LightPower(light);
+    }
+    nodes_[node].bounds_min = lo;
+    nodes_[node].bounds_max = hi;
+    nodes_[node].power = power;
+
+    if (end - begin == 1) {
+        nodes_[node].child_or_light = order_[begin] | kLeafBit;
+        return;
+    }
+
+    // Median split along the longest axis of the bounds
+    glm::vec3 extent = hi - lo;
+    int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+    size_t mid = (begin + end) / 2;
+    std::nth_element(order_.begin() + begin, order_.begin() + mid, order_.begin() + end,
+                     [&lights, axis](uint32_t a, uint32_t b) { return lights[a].position[axis] < lights[b].position[axis]; });
+
+    uint32_t left = static_cast<uint32_t>(nodes_.size());
+    nodes_.resize(nodes_.size() + 2);
+    nodes_[node].child_or_light = left;
+    BuildNode(left, begin, mid, lights);
+    BuildNode(left + 1, mid, end, lights);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "long_march.h"
+#include "Scene.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// GPU node of the light hierarchy (matches HLSL LightBVHNode)
+struct LightBVHNodeGPU {
+    glm::vec3 bounds_min;
+    float power;              // Summed luminance of the lights below
+    glm::vec3 bounds_max;
+    uint32_t child_or_light;  // Internal: first of two adjacent children; leaf: light index | kLeafBit
+};
+
+// Binary hierarchy over the point lights, with bounds and power per node.
+// The shader walks it from the root choosing a child in proportion to an
+// importance estimate (power over squared distance, zero when the node lies
+// below the shading point's tangent plane), so each shading point traces a
+// fixed number of shadow rays however many lights the scene has.
+class LightBVH {
+public:
+    static constexpr uint32_t kLeafBit = 0x80000000u;
+
+    explicit LightBVH(grassland::graphics::Core* core);
+
+    // Rebuild from the scene's lights (an empty list yields a single zero-power leaf)
+    void Build(const std::vector<PointLight>& lights);
+
+    size_t GetNodeCount() const { return nodes_.size(); }
+    grassland::graphics::Buffer* GetNodeBuffer() const { return node_buffer_.get(); }
+
+    void AccumulateMemory(MemoryReport* report) const;
+
+private:
+    // Fill nodes_[node] from lights order_[begin, end)
+    void BuildNode(uint32_t node, size_t begin, size_t end, const std::vector<PointLight>& lights);
+
+    grassland::graphics::Core* core_;
+    std::vector<LightBVHNodeGPU> nodes_;
+    std::vector<uint32_t> order_;  // Light indices, partitioned during the build
+    std::unique_ptr<grassland::graphics::Buffer> node_buffer_;
+};
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only memory-mapped file (mmap on POSIX, MapViewOfFile on Windows)
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool Open(const std::string& path);
+    void Close();
+
+    bool IsOpen() const { return data_ != nullptr; }
+    const uint8_t* Data() const { return data_; }
+    size_t Size() const { return size_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_handle_ = nullptr;
+    void* mapping_handle_ = nullptr;
+#endif
+};
+
+// FNV-1a over 64-bit words (bytes for the tail). Pass a previous result as h to
+// hash several ranges as one.
+constexpr uint64_t kHashSeed = 0xcbf29ce484222325ull;
+uint64_t HashBytes(const void* data, size_t size, uint64_t h = kHashSeed);
+
+// One contiguous part of a file being written
+struct FileSpan {
+    const void* data;
+    size_t size;
+};
+
+// Write the spans to a temporary file next to path and rename it over path, so
+// readers never see a partial file. Every call gets its own temporary file, so
+// several threads or processes may store the same path at once. Creates the
+// parent directory; on failure error (if given) says why.
+bool WriteFileAtomically(const std::string& path, const std::vector<FileSpan>& spans, std::string* error = nullptr);
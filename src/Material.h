@@ -2,6 +2,7 @@
 #include "long_march.h"
 #include <string>
 #include <cstring>
+#include <functional>
 
 // GPU-side material data (POD type, can be uploaded to GPU)
 // This must match the HLSL Material structure exactly
@@ -86,4 +87,29 @@ struct Material {
     }
 };
 
+// Hash/equality over every field that ends up on the GPU, used to share one
+// material slot between identical materials (paths stand in for texture indices)
+struct MaterialHash {
+    size_t operator()(const Material& m) const {
+        size_t h = 0;
+        auto combine = [&h](size_t v) { h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2); };
+        std::hash<float> float_hash;
+        for (int i = 0; i < 3; ++i) {
+            combine(float_hash(m.base_color[i]));
+            combine(float_hash(m.emission[i]));
+        }
+        combine(float_hash(m.roughness));
+        combine(float_hash(m.metallic));
+        combine(std::hash<std::string>()(m.texture_path));
+        combine(std::hash<std::string>()(m.normal_path));
+        return h;
+    }
+};
 
+struct MaterialEqual {
+    bool operator()(const Material& a, const Material& b) const {
+        return a.base_color == b.base_color && a.emission == b.emission &&
+               a.roughness == b.roughness && a.metallic == b.metallic &&
+               a.texture_path == b.texture_path && a.normal_path == b.normal_path;
+    }
+};
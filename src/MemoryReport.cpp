@@ -0,0 +1,115 @@
+#include "MemoryReport.h"
+
+#include <cstdio>
+#include <sstream>
+
+namespace {
+std::string FormatBytes(size_t bytes) {
+    char buffer[32];
+    if (bytes >= (size_t(1) << 20)) {
+        std::snprintf(buffer, sizeof(buffer), "%.2f MB", bytes / (1024.0 * 1024.0));
+    } else {
+        std::snprintf(buffer, sizeof(buffer), "%.1f KB", bytes / 1024.0);
+    }
+    return buffer;
+}
+
+void WriteUsage(std::ostringstream& json, const MemoryUsage& usage) {
+    json << "{ \"cpu\": " << usage.cpu_bytes << ", \"gpu\": " << usage.gpu_bytes
+         << ", \"mapped\": " << usage.mapped_bytes << " }";
+}
+}
+
+void MemoryReport::AddEntity(const EntityMemoryUsage& entity) {
+    Add(MEMORY_CATEGORY_ENTITY_MESH, entity.mesh);
+    Add(MEMORY_CATEGORY_ENTITY_BUFFERS, entity.buffers);
+    entities_.push_back(entity);
+}
+
+MemoryUsage MemoryReport::GetTotal() const {
+    MemoryUsage total;
+    for (const MemoryUsage& usage : categories_) {
+        total += usage;
+    }
+    return total;
+}
+
+void MemoryReport::Log() const {
+    MemoryUsage total = GetTotal();
+    grassland::LogInfo("Memory: {} CPU, {} GPU, {} mapped", FormatBytes(total.cpu_bytes),
+                       FormatBytes(total.gpu_bytes), FormatBytes(total.mapped_bytes));
+    for (int i = 0; i < MEMORY_CATEGORY_COUNT; ++i) {
+        const MemoryUsage& usage = categories_[i];
+        grassland::LogInfo("  {:<15} {:>11} CPU {:>11} GPU {:>11} mapped",
+                           GetCategoryName(static_cast<MemoryCategory>(i)), FormatBytes(usage.cpu_bytes),
+                           FormatBytes(usage.gpu_bytes), FormatBytes(usage.mapped_bytes));
+    }
+
+    // The same triangles live in the entity's mesh, its own buffers and the global streams
+    size_t geometry_copies = 0;
+    for (const EntityMemoryUsage& entity : entities_) {
+        grassland::LogInfo("  entity {} ({}): mesh {}, buffers {}, global streams {}", entity.entity_index,
+                           entity.mesh_path, FormatBytes(entity.mesh.Total()), FormatBytes(entity.buffers.Total()),
+                           FormatBytes(entity.scene_streams.Total()));
+        geometry_copies += entity.mesh.Total() + entity.buffers.Total() + entity.scene_streams.Total();
+    }
+    if (!entities_.empty()) {
+        grassland::LogInfo("  geometry across all copies: {}", FormatBytes(geometry_copies));
+    }
+}
+
+std::string MemoryReport::ToJson() const {
+    std::ostringstream json;
+    json << "{ ";
+    for (int i = 0; i < MEMORY_CATEGORY_COUNT; ++i) {
+        json << "\"" << GetCategoryName(static_cast<MemoryCategory>(i)) << "\": ";
+        WriteUsage(json, categories_[i]);
+        json << ", ";
+    }
+    json << "\"total\": ";
+    WriteUsage(json, GetTotal());
+    json << " }";
+    return json.str();
+}
+
+const char* MemoryReport::GetCategoryName(MemoryCategory category) {
+    switch (category) {
+        case MEMORY_CATEGORY_ENTITY_MESH:
+            return "entity_mesh";
+        case MEMORY_CATEGORY_ENTITY_BUFFERS:
+            return "entity_buffers";
+        case MEMORY_CATEGORY_SCENE_BUFFERS:
+            return "scene_buffers";
+        case MEMORY_CATEGORY_TEXTURES:
+            return "textures";
+        case MEMORY_CATEGORY_NORMAL_MAPS:
+            return "normal_maps";
+        case MEMORY_CATEGORY_SKYBOX:
+            return "skybox";
+        case MEMORY_CATEGORY_FILM:
+            return "film";
+        case MEMORY_CATEGORY_BVH:
+            return "bvh";
+        default:
+            return "unknown";
+    }
+}
+
+size_t MemoryReport::GetBufferBytes(const grassland::graphics::Buffer* buffer) {
+    return buffer ? buffer->Size() : 0;
+}
+
+size_t MemoryReport::GetImageBytes(int width, int height, grassland::graphics::ImageFormat format) {
+    size_t texel_bytes = 4;
+    switch (format) {
+        case grassland::graphics::IMAGE_FORMAT_R32G32B32A32_SFLOAT:
+            texel_bytes = 16;
+            break;
+        case grassland::graphics::IMAGE_FORMAT_R16G16B16A16_SFLOAT:
+            texel_bytes = 8;
+            break;
+        default:
+            break;
+    }
+    return static_cast<size_t>(width) * height * texel_bytes;
+}
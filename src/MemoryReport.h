@@ -0,0 +1,81 @@
+#pragma once
+#include "long_march.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Accounting tags: each allocation of the renderer is reported under one of these
+enum MemoryCategory {
+    MEMORY_CATEGORY_ENTITY_MESH,     // CPU mesh data kept by entities after loading
+    MEMORY_CATEGORY_ENTITY_BUFFERS,  // Per-entity GPU vertex/index/UV/material ID buffers (BLAS inputs)
+    MEMORY_CATEGORY_SCENE_BUFFERS,   // Global geometry streams, instance metadata, materials, emitters, point lights
+    MEMORY_CATEGORY_TEXTURES,        // Virtual texture pages and sources of color textures, shared page tables
+    MEMORY_CATEGORY_NORMAL_MAPS,     // Virtual texture pages and sources of normal maps
+    MEMORY_CATEGORY_SKYBOX,          // HDR skybox image and its importance sampling tables
+    MEMORY_CATEGORY_FILM,            // Accumulation, AOV and output images, per-frame render targets
+    MEMORY_CATEGORY_BVH,             // CPU light BVH and its node buffer
+    MEMORY_CATEGORY_COUNT
+};
+
+struct MemoryUsage {
+    size_t cpu_bytes = 0;     // Heap allocations
+    size_t gpu_bytes = 0;     // Buffers and images at their requested size (drivers may pad)
+    size_t mapped_bytes = 0;  // Memory-mapped files, paged in on demand
+
+    size_t Total() const { return cpu_bytes + gpu_bytes + mapped_bytes; }
+    MemoryUsage& operator+=(const MemoryUsage& other) {
+        cpu_bytes += other.cpu_bytes;
+        gpu_bytes += other.gpu_bytes;
+        mapped_bytes += other.mapped_bytes;
+        return *this;
+    }
+};
+
+// One entity's copies of its geometry
+struct EntityMemoryUsage {
+    size_t entity_index = 0;
+    std::string mesh_path;
+    MemoryUsage mesh;           // MEMORY_CATEGORY_ENTITY_MESH
+    MemoryUsage buffers;        // MEMORY_CATEGORY_ENTITY_BUFFERS
+    MemoryUsage scene_streams;  // Its words of the global streams (already counted in MEMORY_CATEGORY_SCENE_BUFFERS)
+};
+
+// Snapshot of the bytes held per category. Owners add what they hold from
+// their containers and GPU resources (AccumulateMemory), so nothing has to be
+// tracked at allocation time. Acceleration structures are not included: the
+// graphics backend does not report their sizes.
+class MemoryReport {
+public:
+    void Add(MemoryCategory category, const MemoryUsage& usage) { categories_[category] += usage; }
+    void AddCpu(MemoryCategory category, size_t bytes) { categories_[category].cpu_bytes += bytes; }
+    void AddGpu(MemoryCategory category, size_t bytes) { categories_[category].gpu_bytes += bytes; }
+    void AddMapped(MemoryCategory category, size_t bytes) { categories_[category].mapped_bytes += bytes; }
+
+    // Adds the entity's mesh and buffers to their categories and keeps the per-entity row
+    void AddEntity(const EntityMemoryUsage& entity);
+
+    const MemoryUsage& Get(MemoryCategory category) const { return categories_[category]; }
+    MemoryUsage GetTotal() const;
+    const std::vector<EntityMemoryUsage>& GetEntities() const { return entities_; }
+
+    // Log bytes per category, then per entity with each copy of its geometry
+    void Log() const;
+
+    // {"<category>": {"cpu": .., "gpu": .., "mapped": ..}, ..., "total": {...}}
+    std::string ToJson() const;
+
+    static const char* GetCategoryName(MemoryCategory category);
+
+    // Sizes of GPU resources (0 for null)
+    static size_t GetBufferBytes(const grassland::graphics::Buffer* buffer);
+    static size_t GetImageBytes(int width, int height, grassland::graphics::ImageFormat format);
+
+    template <class T>
+    static size_t GetVectorBytes(const std::vector<T>& values) {
+        return values.capacity() * sizeof(T);
+    }
+
+private:
+    MemoryUsage categories_[MEMORY_CATEGORY_COUNT];
+    std::vector<EntityMemoryUsage> entities_;
+};
@@ -0,0 +1,319 @@
+#include "MeshCache.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+
+constexpr uint32_t kCacheVersion = 1;
+constexpr uint64_t kStreamAlignment = 16;
+
+static_assert(sizeof(grassland::Vector3<float>) == 3 * sizeof(float), "positions are read in place");
+static_assert(sizeof(grassland::Vector2<float>) == 2 * sizeof(float), "UVs are read in place");
+
+std::string g_cache_directory = "mesh_cache";
+bool g_cache_enabled = false;
+
+// Mappings held by entities, keyed by cache path
+std::mutex g_open_mutex;
+std::unordered_map<std::string, std::weak_ptr<const MeshCacheFile>> g_open_files;
+
+uint64_t AlignUp(uint64_t offset) {
+    return (offset + kStreamAlignment - 1) & ~(kStreamAlignment - 1);
+}
+
+void AppendString(std::vector<uint8_t>* out, const std::string& s) {
+    uint32_t size = static_cast<uint32_t>(s.size());
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&size);
+    out->insert(out->end(), bytes, bytes + sizeof(size));
+    out->insert(out->end(), s.begin(), s.end());
+}
+
+// Indices must address existing vertices and material IDs existing materials
+// (-1 for faces without one), or readers would go out of bounds
+bool StreamsInRange(const uint32_t* indices, size_t index_count, size_t vertex_count, const int* material_ids,
+                    size_t triangle_count, size_t material_count) {
+    for (size_t i = 0; i < index_count; ++i) {
+        if (indices[i] >= vertex_count) {
+            return false;
+        }
+    }
+    for (size_t t = 0; material_ids && t < triangle_count; ++t) {
+        if (material_ids[t] < -1 || material_ids[t] >= static_cast<int64_t>(material_count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Bounds-checked reader over the material table
+struct TableReader {
+    const uint8_t* data;
+    size_t size;
+    size_t offset = 0;
+
+    bool Read(void* value, size_t bytes) {
+        if (bytes > size - offset) {
+            return false;
+        }
+        std::memcpy(value, data + offset, bytes);
+        offset += bytes;
+        return true;
+    }
+    bool ReadString(std::string* s) {
+        uint32_t length = 0;
+        if (!Read(&length, sizeof(length)) || length > size - offset) {
+            return false;
+        }
+        s->assign(reinterpret_cast<const char*>(data + offset), length);
+        offset += length;
+        return true;
+    }
+};
+
+}  // namespace
+
+// ---- MeshCacheFile ---------------------------------------------------------
+
+bool MeshCacheFile::Open(const std::string& cache_path) {
+    if (!file_.Open(cache_path) || file_.Size() < sizeof(MeshCacheHeader)) {
+        return false;
+    }
+    header_ = reinterpret_cast<const MeshCacheHeader*>(file_.Data());
+    auto fits = [this](uint64_t offset, uint64_t bytes) {
+        return offset <= file_.Size() && bytes <= file_.Size() - offset;
+    };
+    const MeshCacheHeader& h = *header_;
+    uint64_t vertices = h.vertex_count, triangles = h.triangle_count;
+    bool valid = std::memcmp(h.magic, "SMMC", 4) == 0 && h.version == kCacheVersion &&
+                 vertices > 0 && triangles > 0 &&
+                 fits(h.positions_offset, vertices * 3 * sizeof(float)) &&
+                 fits(h.indices_offset, triangles * 3 * sizeof(uint32_t)) &&
+                 (!HasUVs() || fits(h.uvs_offset, vertices * 2 * sizeof(float))) &&
+                 (!HasMaterialIDs() || fits(h.material_ids_offset, triangles * sizeof(int))) &&
+                 fits(h.materials_offset, h.materials_size);
+    if (!valid) {
+        file_.Close();
+        header_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool MeshCacheFile::CheckStreams() const {
+    std::call_once(streams_checked_, [this] {
+        TRACE_SCOPE("MeshCacheFile::CheckStreams");
+        streams_valid_ = StreamsInRange(GetIndices(), GetTriangleCount() * 3, GetVertexCount(), GetMaterialIDs(),
+                                        GetTriangleCount(), header_->material_count);
+    });
+    return streams_valid_;
+}
+
+glm::vec3 MeshCacheFile::GetBoundsMin() const {
+    return glm::vec3(header_->bounds_min[0], header_->bounds_min[1], header_->bounds_min[2]);
+}
+
+glm::vec3 MeshCacheFile::GetBoundsMax() const {
+    return glm::vec3(header_->bounds_max[0], header_->bounds_max[1], header_->bounds_max[2]);
+}
+
+const grassland::Vector3<float>* MeshCacheFile::GetPositions() const {
+    return reinterpret_cast<const grassland::Vector3<float>*>(file_.Data() + header_->positions_offset);
+}
+
+const grassland::Vector2<float>* MeshCacheFile::GetUVs() const {
+    return HasUVs() ? reinterpret_cast<const grassland::Vector2<float>*>(file_.Data() + header_->uvs_offset) : nullptr;
+}
+
+const uint32_t* MeshCacheFile::GetIndices() const {
+    return reinterpret_cast<const uint32_t*>(file_.Data() + header_->indices_offset);
+}
+
+const int* MeshCacheFile::GetMaterialIDs() const {
+    return HasMaterialIDs() ? reinterpret_cast<const int*>(file_.Data() + header_->material_ids_offset) : nullptr;
+}
+
+bool MeshCacheFile::ReadMaterials(std::vector<Material>* materials, std::vector<std::string>* names) const {
+    materials->clear();
+    names->clear();
+    TableReader reader{file_.Data() + header_->materials_offset, header_->materials_size};
+    for (uint32_t i = 0; i < header_->material_count; ++i) {
+        Material mat;
+        std::string name;
+        float values[8];
+        if (!reader.ReadString(&name) || !reader.Read(values, sizeof(values)) ||
+            !reader.ReadString(&mat.texture_path) || !reader.ReadString(&mat.normal_path)) {
+            return false;
+        }
+        mat.base_color = glm::vec3(values[0], values[1], values[2]);
+        mat.roughness = values[3];
+        mat.metallic = values[4];
+        mat.emission = glm::vec3(values[5], values[6], values[7]);
+        materials->push_back(std::move(mat));
+        names->push_back(std::move(name));
+    }
+    return true;
+}
+
+// ---- MeshCache -------------------------------------------------------------
+
+void MeshCache::SetDirectory(const std::string& directory) {
+    g_cache_directory = directory;
+}
+
+const std::string& MeshCache::GetDirectory() {
+    return g_cache_directory;
+}
+
+void MeshCache::SetEnabled(bool enabled) {
+    g_cache_enabled = enabled;
+}
+
+bool MeshCache::IsEnabled() {
+    return g_cache_enabled;
+}
+
+std::string MeshCache::GetCachePath(const std::string& source_path) {
+    std::error_code ec;
+    std::filesystem::path source(source_path);
+    auto size = std::filesystem::file_size(source, ec);
+    if (ec) return {};
+    auto mtime = std::filesystem::last_write_time(source, ec);
+    if (ec) return {};
+
+    // Welding changes the stored mesh, so its settings are part of the key
+    const WeldSettings& weld = MeshOptimizer::GetWeldSettings();
+    char weld_key[64];
+    std::snprintf(weld_key, sizeof(weld_key), "%d|%.9g|%.9g", weld.enabled ? 1 : 0, weld.position_epsilon,
+                  weld.uv_epsilon);
+    std::string key = std::filesystem::absolute(source, ec).string() + "|" + std::to_string(size) + "|" +
+                      std::to_string(mtime.time_since_epoch().count()) + "|" + weld_key;
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.smmc", static_cast<unsigned long long>(HashBytes(key.data(), key.size())));
+    return (std::filesystem::path(g_cache_directory) / name).string();
+}
+
+std::shared_ptr<const MeshCacheFile> MeshCache::Open(const std::string& source_path) {
+    if (!g_cache_enabled) {
+        return nullptr;
+    }
+    std::string cache_path = GetCachePath(source_path);
+    if (cache_path.empty()) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(g_open_mutex);
+    auto it = g_open_files.find(cache_path);
+    if (it != g_open_files.end()) {
+        if (auto shared = it->second.lock()) {
+            return shared;
+        }
+    }
+    auto file = std::make_shared<MeshCacheFile>();
+    if (!file->Open(cache_path)) {
+        return nullptr;
+    }
+    g_open_files[cache_path] = file;
+    return file;
+}
+
+bool MeshCache::Store(const std::string& source_path, const MeshData& mesh,
+                      const std::vector<Material>& materials, const std::vector<std::string>& material_names) {
+    TRACE_SCOPE("MeshCache::Store");
+    if (!g_cache_enabled || mesh.positions.empty() || mesh.indices.empty()) {
+        return false;
+    }
+    std::string cache_path = GetCachePath(source_path);
+    if (cache_path.empty()) {
+        return false;
+    }
+    // CheckStreams() rejects out-of-range streams, so such meshes are not cached at all
+    if (!StreamsInRange(mesh.indices.data(), mesh.indices.size(), mesh.positions.size(),
+                        mesh.material_ids.empty() ? nullptr : mesh.material_ids.data(), mesh.NumTriangles(),
+                        materials.size())) {
+        grassland::LogWarning("Not caching mesh {}: indices or material IDs out of range", source_path);
+        return false;
+    }
+
+    MeshCacheHeader header{};
+    std::memcpy(header.magic, "SMMC", 4);
+    header.version = kCacheVersion;
+    header.vertex_count = static_cast<uint32_t>(mesh.NumVertices());
+    header.triangle_count = static_cast<uint32_t>(mesh.NumTriangles());
+    header.material_count = static_cast<uint32_t>(materials.size());
+    if (!mesh.uvs.empty()) {
+        header.flags |= MESH_CACHE_HAS_UV;
+    }
+    if (!mesh.material_ids.empty()) {
+        header.flags |= MESH_CACHE_HAS_MATERIAL_IDS;
+    }
+    glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+    for (const auto& p : mesh.positions) {
+        lo = glm::min(lo, glm::vec3(p[0], p[1], p[2]));
+        hi = glm::max(hi, glm::vec3(p[0], p[1], p[2]));
+    }
+    for (int c = 0; c < 3; ++c) {
+        header.bounds_min[c] = lo[c];
+        header.bounds_max[c] = hi[c];
+    }
+
+    std::vector<uint8_t> material_table;
+    for (size_t i = 0; i < materials.size(); ++i) {
+        const Material& mat = materials[i];
+        AppendString(&material_table, i < material_names.size() ? material_names[i] : std::string());
+        float values[8] = {mat.base_color.r, mat.base_color.g, mat.base_color.b, mat.roughness, mat.metallic,
+                           mat.emission.r, mat.emission.g, mat.emission.b};
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values);
+        material_table.insert(material_table.end(), bytes, bytes + sizeof(values));
+        AppendString(&material_table, mat.texture_path);
+        AppendString(&material_table, mat.normal_path);
+    }
+
+    // Sections in file order
+    struct Section {
+        uint64_t* offset;
+        const void* data;
+        size_t size;
+    };
+    Section sections[] = {
+        {&header.positions_offset, mesh.positions.data(), mesh.positions.size() * sizeof(mesh.positions[0])},
+        {&header.uvs_offset, mesh.uvs.data(), mesh.uvs.size() * sizeof(grassland::Vector2<float>)},
+        {&header.indices_offset, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t)},
+        {&header.material_ids_offset, mesh.material_ids.data(), mesh.material_ids.size() * sizeof(int)},
+        {&header.materials_offset, material_table.data(), material_table.size()},
+    };
+    uint64_t offset = AlignUp(sizeof(MeshCacheHeader));
+    for (Section& section : sections) {
+        *section.offset = section.size > 0 ? offset : 0;
+        offset = AlignUp(offset + section.size);
+    }
+    header.materials_size = material_table.size();
+
+    // Entities (or worker processes) loading the same mesh may store it concurrently
+    static const char kPadding[kStreamAlignment] = {};
+    std::vector<FileSpan> spans = {{&header, sizeof(header)}};
+    uint64_t written = sizeof(header);
+    for (const Section& section : sections) {
+        if (section.size == 0) {
+            continue;
+        }
+        spans.push_back({kPadding, static_cast<size_t>(*section.offset - written)});
+        spans.push_back({section.data, section.size});
+        written = *section.offset + section.size;
+    }
+    std::string error;
+    if (!WriteFileAtomically(cache_path, spans, &error)) {
+        grassland::LogWarning("Cannot write mesh cache file {}: {}", cache_path, error);
+        return false;
+    }
+
+    grassland::LogInfo("Cached mesh {} ({} vertices, {} triangles, {} KB)", source_path, header.vertex_count,
+                       header.triangle_count, offset / 1024);
+    return true;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "long_march.h"
+#include "MappedFile.h"
+#include "Material.h"
+#include "MeshOptimizer.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum MeshCacheFlags : uint32_t {
+    MESH_CACHE_HAS_UV = 1 << 0,
+    MESH_CACHE_HAS_MATERIAL_IDS = 1 << 1,
+};
+
+// On-disk layout of a mesh cache file: header, then the welded and reordered
+// streams (16-byte aligned), then the MTL material table
+struct MeshCacheHeader {
+    char magic[4];                 // "SMMC"
+    uint32_t version;
+    uint32_t vertex_count;
+    uint32_t triangle_count;
+    uint32_t flags;                // MeshCacheFlags
+    uint32_t material_count;
+    float bounds_min[3];           // Object-space bounds of the positions
+    float bounds_max[3];
+    uint64_t positions_offset;     // 3 floats per vertex
+    uint64_t uvs_offset;           // 2 floats per vertex (with MESH_CACHE_HAS_UV)
+    uint64_t indices_offset;       // 3 uint32 per triangle
+    uint64_t material_ids_offset;  // 1 int32 per triangle (with MESH_CACHE_HAS_MATERIAL_IDS)
+    uint64_t materials_offset;     // Per material: name, 8 floats, texture path, normal path
+    uint64_t materials_size;
+};
+
+// A mesh cache file mapped into memory. The streams are read in place, so
+// only the pages actually touched (BLAS and stream uploads, emitters) are
+// brought into RAM, and the OS can drop them again under memory pressure.
+class MeshCacheFile {
+public:
+    bool Open(const std::string& cache_path);
+
+    size_t GetVertexCount() const { return header_->vertex_count; }
+    size_t GetTriangleCount() const { return header_->triangle_count; }
+    bool HasUVs() const { return (header_->flags & MESH_CACHE_HAS_UV) != 0; }
+    bool HasMaterialIDs() const { return (header_->flags & MESH_CACHE_HAS_MATERIAL_IDS) != 0; }
+    glm::vec3 GetBoundsMin() const;
+    glm::vec3 GetBoundsMax() const;
+
+    const grassland::Vector3<float>* GetPositions() const;
+    const grassland::Vector2<float>* GetUVs() const;  // nullptr without UVs
+    const uint32_t* GetIndices() const;
+    const int* GetMaterialIDs() const;                 // nullptr without material IDs
+
+    // MTL materials in material ID order, with their names
+    bool ReadMaterials(std::vector<Material>* materials, std::vector<std::string>* names) const;
+
+    // Whether the indices address existing vertices and the material IDs existing
+    // materials. Open() only checks the header, so this scans the streams on the
+    // first call (when an entity first uploads them) and remembers the result.
+    bool CheckStreams() const;
+
+    size_t GetFileSize() const { return file_.Size(); }
+
+private:
+    MappedFile file_;
+    const MeshCacheHeader* header_ = nullptr;
+    mutable std::once_flag streams_checked_;
+    mutable bool streams_valid_ = false;
+};
+
+// Optimized mesh cache for out-of-core scenes: stores each OBJ after welding
+// and reordering, keyed by source path, size, modification time and weld
+// settings. Entities map the cache file instead of keeping a heap copy of
+// their mesh, and entities of the same source share one mapping. Disabled by
+// default; later launches skip OBJ/MTL parsing for cached meshes.
+class MeshCache {
+public:
+    static void SetDirectory(const std::string& directory);
+    static const std::string& GetDirectory();
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled();
+
+    // Cache file path for a source mesh (empty if the source does not exist)
+    static std::string GetCachePath(const std::string& source_path);
+
+    // Map the cache file of a source, or share the mapping another entity
+    // already holds. Returns nullptr on a cache miss.
+    static std::shared_ptr<const MeshCacheFile> Open(const std::string& source_path);
+
+    // Write an optimized mesh and its materials to the cache (written atomically)
+    static bool Store(const std::string& source_path, const MeshData& mesh,
+                      const std::vector<Material>& materials, const std::vector<std::string>& material_names);
+};
@@ -0,0 +1,322 @@
+#include "MeshOptimizer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+WeldSettings g_weld_settings;
+
+struct CellHash {
+    size_t operator()(const std::array<int64_t, 3>& cell) const {
+        uint64_t h = 1469598103934665603ull;
+        for (int64_t c : cell) {
+            h = (h ^ static_cast<uint64_t>(c)) * 1099511628211ull;
+        }
+        return static_cast<size_t>(h);
+    }
+};
+
+struct TriangleHash {
+    size_t operator()(const std::array<uint32_t, 3>& tri) const {
+        return CellHash()({tri[0], tri[1], tri[2]});
+    }
+};
+
+// Exact welding hashes the bit pattern (with -0 folded into 0)
+int64_t ExactKey(float value) {
+    if (value == 0.0f) {
+        return 0;
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+float BoundsDiagonal(const MeshData& mesh) {
+    float lo[3] = {FLT_MAX, FLT_MAX, FLT_MAX}, hi[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (const auto& p : mesh.positions) {
+        for (int c = 0; c < 3; ++c) {
+            lo[c] = std::min(lo[c], p[c]);
+            hi[c] = std::max(hi[c], p[c]);
+        }
+    }
+    if (mesh.positions.empty()) {
+        return 0.0f;
+    }
+    float d[3] = {hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2]};
+    return std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+}
+
+// Spread the low 21 bits of v so that two zero bits follow each of them
+uint64_t SpreadBits(uint64_t v) {
+    v &= 0x1FFFFF;
+    v = (v | v << 32) & 0x1F00000000FFFFull;
+    v = (v | v << 16) & 0x1F0000FF0000FFull;
+    v = (v | v << 8) & 0x100F00F00F00F00Full;
+    v = (v | v << 4) & 0x10C30C30C30C30C3ull;
+    v = (v | v << 2) & 0x1249249249249249ull;
+    return v;
+}
+
+uint64_t MortonCode(uint32_t x, uint32_t y, uint32_t z) {
+    return SpreadBits(x) | (SpreadBits(y) << 1) | (SpreadBits(z) << 2);
+}
+
+}  // namespace
+
+void MeshOptimizer::SetWeldSettings(const WeldSettings& settings) {
+    g_weld_settings = settings;
+}
+
+const WeldSettings& MeshOptimizer::GetWeldSettings() {
+    return g_weld_settings;
+}
+
+size_t MeshOptimizer::WeldVertices(MeshData* mesh, const WeldSettings& settings) {
+    size_t vertex_count = mesh->NumVertices();
+    if (vertex_count == 0) {
+        return 0;
+    }
+
+    float epsilon = settings.position_epsilon * BoundsDiagonal(*mesh);
+    bool has_uvs = !mesh->uvs.empty();
+    auto cell_of = [epsilon](const grassland::Vector3<float>& p) {
+        std::array<int64_t, 3> cell;
+        for (int c = 0; c < 3; ++c) {
+            cell[c] = epsilon > 0.0f ? static_cast<int64_t>(std::floor(p[c] / epsilon)) : ExactKey(p[c]);
+        }
+        return cell;
+    };
+    auto matches = [&](uint32_t a, uint32_t b) {
+        for (int c = 0; c < 3; ++c) {
+            if (std::abs(mesh->positions[a][c] - mesh->positions[b][c]) > epsilon) return false;
+        }
+        if (has_uvs) {
+            for (int c = 0; c < 2; ++c) {
+                if (std::abs(mesh->uvs[a][c] - mesh->uvs[b][c]) > settings.uv_epsilon) return false;
+            }
+        }
+        return true;
+    };
+
+    // Each cell lists the kept vertices inside it; a vertex within epsilon of
+    // a kept one can only lie in the same or an adjacent cell
+    std::unordered_map<std::array<int64_t, 3>, std::vector<uint32_t>, CellHash> cells;
+    cells.reserve(vertex_count);
+    std::vector<uint32_t> remap(vertex_count);
+    std::vector<uint32_t> kept;
+    kept.reserve(vertex_count);
+    int reach = epsilon > 0.0f ? 1 : 0;
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        std::array<int64_t, 3> cell = cell_of(mesh->positions[v]);
+        uint32_t found = UINT32_MAX;
+        for (int dx = -reach; dx <= reach && found == UINT32_MAX; ++dx) {
+            for (int dy = -reach; dy <= reach && found == UINT32_MAX; ++dy) {
+                for (int dz = -reach; dz <= reach && found == UINT32_MAX; ++dz) {
+                    auto it = cells.find({cell[0] + dx, cell[1] + dy, cell[2] + dz});
+                    if (it == cells.end()) continue;
+                    for (uint32_t k : it->second) {
+                        if (matches(kept[k], v)) {
+                            found = k;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        if (found == UINT32_MAX) {
+            found = static_cast<uint32_t>(kept.size());
+            kept.push_back(v);
+            cells[cell].push_back(found);
+        }
+        remap[v] = found;
+    }
+
+    size_t removed = vertex_count - kept.size();
+    if (removed == 0) {
+        return 0;
+    }
+    for (uint32_t& index : mesh->indices) {
+        index = remap[index];
+    }
+    std::vector<grassland::Vector3<float>> positions(kept.size());
+    std::vector<grassland::Vector2<float>> uvs(has_uvs ? kept.size() : 0);
+    for (size_t k = 0; k < kept.size(); ++k) {
+        positions[k] = mesh->positions[kept[k]];
+        if (has_uvs) uvs[k] = mesh->uvs[kept[k]];
+    }
+    mesh->positions = std::move(positions);
+    mesh->uvs = std::move(uvs);
+    return removed;
+}
+
+size_t MeshOptimizer::RemoveDegenerateTriangles(MeshData* mesh, float epsilon) {
+    size_t triangle_count = mesh->NumTriangles();
+    float extent = epsilon * BoundsDiagonal(*mesh);
+    float area_epsilon = extent * extent;
+    bool has_ids = !mesh->material_ids.empty();
+    std::unordered_set<std::array<uint32_t, 3>, TriangleHash> seen;
+    seen.reserve(triangle_count);
+
+    size_t out = 0;
+    for (size_t t = 0; t < triangle_count; ++t) {
+        uint32_t a = mesh->indices[3 * t], b = mesh->indices[3 * t + 1], c = mesh->indices[3 * t + 2];
+        if (a == b || b == c || a == c) {
+            continue;
+        }
+        const auto& p0 = mesh->positions[a];
+        const auto& p1 = mesh->positions[b];
+        const auto& p2 = mesh->positions[c];
+        if ((p1 - p0).cross(p2 - p0).norm() <= area_epsilon) {
+            continue;
+        }
+        // Rotate the smallest index first so the same winding hashes equally
+        std::array<uint32_t, 3> key = {a, b, c};
+        std::rotate(key.begin(), std::min_element(key.begin(), key.end()), key.end());
+        if (!seen.insert(key).second) {
+            continue;
+        }
+        mesh->indices[3 * out] = a;
+        mesh->indices[3 * out + 1] = b;
+        mesh->indices[3 * out + 2] = c;
+        if (has_ids) mesh->material_ids[out] = mesh->material_ids[t];
+        ++out;
+    }
+    mesh->indices.resize(3 * out);
+    if (has_ids) mesh->material_ids.resize(out);
+    return triangle_count - out;
+}
+
+size_t MeshOptimizer::RemoveUnusedVertices(MeshData* mesh) {
+    size_t vertex_count = mesh->NumVertices();
+    std::vector<uint32_t> remap(vertex_count, UINT32_MAX);
+    for (uint32_t index : mesh->indices) {
+        remap[index] = 0;
+    }
+    uint32_t next = 0;
+    for (size_t v = 0; v < vertex_count; ++v) {
+        if (remap[v] != UINT32_MAX) {
+            remap[v] = next;
+            mesh->positions[next] = mesh->positions[v];
+            if (!mesh->uvs.empty()) mesh->uvs[next] = mesh->uvs[v];
+            ++next;
+        }
+    }
+    if (next == vertex_count) {
+        return 0;
+    }
+    for (uint32_t& index : mesh->indices) {
+        index = remap[index];
+    }
+    mesh->positions.resize(next);
+    if (!mesh->uvs.empty()) mesh->uvs.resize(next);
+    return vertex_count - next;
+}
+
+void MeshOptimizer::OptimizeLocality(MeshData* mesh) {
+    size_t triangle_count = mesh->NumTriangles();
+    size_t vertex_count = mesh->NumVertices();
+    if (triangle_count < 2) {
+        return;
+    }
+
+    // 1. Morton code of each triangle centroid in the mesh bounds (21 bits per axis)
+    float lo[3] = {FLT_MAX, FLT_MAX, FLT_MAX}, hi[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (const auto& p : mesh->positions) {
+        for (int c = 0; c < 3; ++c) {
+            lo[c] = std::min(lo[c], p[c]);
+            hi[c] = std::max(hi[c], p[c]);
+        }
+    }
+    const float kGridMax = static_cast<float>((1 << 21) - 1);
+    float scale[3];
+    for (int c = 0; c < 3; ++c) {
+        scale[c] = hi[c] > lo[c] ? kGridMax / (hi[c] - lo[c]) : 0.0f;
+    }
+
+    const uint32_t* indices = mesh->indices.data();
+    std::vector<uint64_t> codes(triangle_count);
+    ThreadPool::Global().ParallelFor((triangle_count + 4095) / 4096, [&](size_t chunk) {
+        size_t end = std::min(triangle_count, (chunk + 1) * 4096);
+        for (size_t t = chunk * 4096; t < end; ++t) {
+            uint32_t q[3];
+            for (int c = 0; c < 3; ++c) {
+                float centroid = (mesh->positions[indices[3 * t]][c] + mesh->positions[indices[3 * t + 1]][c] +
+                                  mesh->positions[indices[3 * t + 2]][c]) / 3.0f;
+                q[c] = static_cast<uint32_t>(std::clamp((centroid - lo[c]) * scale[c], 0.0f, kGridMax));
+            }
+            codes[t] = MortonCode(q[0], q[1], q[2]);
+        }
+    });
+
+    // 2. Sort triangles by code (stable, so coplanar fans keep their order)
+    std::vector<uint32_t> order(triangle_count);
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&codes](uint32_t a, uint32_t b) { return codes[a] < codes[b]; });
+
+    std::vector<uint32_t> sorted_indices(mesh->indices.size());
+    for (size_t t = 0; t < triangle_count; ++t) {
+        std::copy_n(&mesh->indices[3 * order[t]], 3, &sorted_indices[3 * t]);
+    }
+    if (!mesh->material_ids.empty()) {
+        std::vector<int> sorted_ids(triangle_count);
+        for (size_t t = 0; t < triangle_count; ++t) {
+            sorted_ids[t] = mesh->material_ids[order[t]];
+        }
+        mesh->material_ids = std::move(sorted_ids);
+    }
+
+    // 3. Renumber vertices in the order the sorted triangles first use them
+    std::vector<uint32_t> remap(vertex_count, UINT32_MAX);
+    uint32_t next = 0;
+    for (uint32_t& index : sorted_indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = next++;
+        }
+        index = remap[index];
+    }
+    for (uint32_t& new_index : remap) {
+        if (new_index == UINT32_MAX) {
+            new_index = next++;
+        }
+    }
+    mesh->indices = std::move(sorted_indices);
+
+    std::vector<grassland::Vector3<float>> positions(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v) {
+        positions[remap[v]] = mesh->positions[v];
+    }
+    mesh->positions = std::move(positions);
+    if (!mesh->uvs.empty()) {
+        std::vector<grassland::Vector2<float>> uvs(vertex_count);
+        for (size_t v = 0; v < vertex_count; ++v) {
+            uvs[remap[v]] = mesh->uvs[v];
+        }
+        mesh->uvs = std::move(uvs);
+    }
+}
+
+double MeshOptimizer::ComputeACMR(const MeshData& mesh, size_t cache_size) {
+    size_t triangle_count = mesh.NumTriangles();
+    if (triangle_count == 0 || cache_size == 0) {
+        return 0.0;
+    }
+
+    // FIFO cache: a vertex is cached while fewer than cache_size misses happened since it was loaded
+    std::vector<size_t> loaded_at(mesh.NumVertices(), SIZE_MAX);
+    size_t misses = 0;
+    for (uint32_t index : mesh.indices) {
+        if (loaded_at[index] == SIZE_MAX || misses - loaded_at[index] >= cache_size) {
+            loaded_at[index] = misses++;
+        }
+    }
+    return static_cast<double>(misses) / triangle_count;
+}
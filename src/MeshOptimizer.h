@@ -0,0 +1,59 @@
+#pragma once
+#include "long_march.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Editable copy of a loaded mesh. The optimizer passes work on this and the
+// entity rebuilds its grassland::Mesh from the result.
+struct MeshData {
+    std::vector<grassland::Vector3<float>> positions;
+    std::vector<grassland::Vector2<float>> uvs;  // One per vertex, empty if the mesh has no UVs
+    std::vector<uint32_t> indices;
+    std::vector<int> material_ids;               // One per triangle, empty if the mesh has none
+
+    size_t NumVertices() const { return positions.size(); }
+    size_t NumTriangles() const { return indices.size() / 3; }
+};
+
+// Vertex welding and degenerate triangle removal options
+struct WeldSettings {
+    bool enabled = true;
+    // Vertices closer than this (per axis, relative to the mesh bounds
+    // diagonal) merge when their UVs also match within uv_epsilon
+    float position_epsilon = 1e-6f;
+    float uv_epsilon = 1e-6f;
+};
+
+// CPU mesh passes run by Entity::LoadMesh before the BLAS is built
+class MeshOptimizer {
+public:
+    // Applied to every mesh loaded afterwards
+    static void SetWeldSettings(const WeldSettings& settings);
+    static const WeldSettings& GetWeldSettings();
+
+    // Merge vertices with matching position and UV (hashed on a grid of
+    // epsilon-sized cells, so near-duplicates in neighbouring cells are found
+    // too). Returns the number of vertices removed.
+    static size_t WeldVertices(MeshData* mesh, const WeldSettings& settings);
+
+    // Drop triangles that repeat a vertex, have (near) zero area, or repeat
+    // another triangle with the same winding, along with their material IDs.
+    // Zero area means twice the area is below (epsilon * bounds diagonal)^2.
+    // Opposite-facing copies are kept as they may be intended two-sided
+    // surfaces. Returns the number of triangles removed.
+    static size_t RemoveDegenerateTriangles(MeshData* mesh, float epsilon);
+
+    // Drop vertices no triangle references; returns the number removed
+    static size_t RemoveUnusedVertices(MeshData* mesh);
+
+    // Sort triangles along a Morton curve of their centroids, so triangles that
+    // end up in neighbouring BVH leaves are also close in the index buffer, then
+    // renumber vertices in first-use order (unreferenced vertices go last).
+    // Material IDs and UVs move with their triangles and vertices.
+    static void OptimizeLocality(MeshData* mesh);
+
+    // Average cache miss ratio: vertex fetches per triangle that miss a FIFO
+    // cache of cache_size vertices (between 0.5 and 3, lower is better)
+    static double ComputeACMR(const MeshData& mesh, size_t cache_size = 32);
+};
@@ -0,0 +1,124 @@
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SHORTMARCH_MIP_SSE2 1
+#endif
+
+namespace {
+
+void DownsampleColorRow(const uint8_t* row0, const uint8_t* row1, int width, int out_width, uint8_t* dst) {
+    int x = 0;
+#ifdef SHORTMARCH_MIP_SSE2
+    // 4 output pixels per iteration from 8 source pixels of each row
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(2);
+    for (; x + 4 <= out_width && 2 * x + 8 <= width; x += 4) {
+        __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8 * x));
+        __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8 * x + 16));
+        __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8 * x));
+        __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8 * x + 16));
+
+        // Vertical sums in 16 bits, two source pixels per register
+        __m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+        __m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+        __m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+        __m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+        // Horizontal pair sums land in the low 4 lanes
+        s0 = _mm_add_epi16(s0, _mm_srli_si128(s0, 8));
+        s1 = _mm_add_epi16(s1, _mm_srli_si128(s1, 8));
+        s2 = _mm_add_epi16(s2, _mm_srli_si128(s2, 8));
+        s3 = _mm_add_epi16(s3, _mm_srli_si128(s3, 8));
+
+        __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s0, s1), round), 2);
+        __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s2, s3), round), 2);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * x), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; x < out_width; ++x) {
+        int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+        for (int c = 0; c < 4; ++c) {
+            int sum = row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] + row1[x1 * 4 + c];
+            dst[x * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+        }
+    }
+}
+
+}  // namespace
+
+int MipGenerator::GetLevelCount(int width, int height) {
+    int levels = 1;
+    while ((width >> levels) > 0 || (height >> levels) > 0) {
+        ++levels;
+    }
+    return levels;
+}
+
+void MipGenerator::DownsampleColor(const uint8_t* src, int width, int height, uint8_t* dst) {
+    int w = std::max(1, width / 2), h = std::max(1, height / 2);
+    size_t src_pitch = static_cast<size_t>(width) * 4;
+    ThreadPool::Global().ParallelFor(h, [&](size_t y) {
+        const uint8_t* row0 = src + std::min<size_t>(2 * y, height - 1) * src_pitch;
+        const uint8_t* row1 = src + std::min<size_t>(2 * y + 1, height - 1) * src_pitch;
+        DownsampleColorRow(row0, row1, width, w, dst + y * w * 4);
+    });
+}
+
+void MipGenerator::DownsampleNormal(const uint8_t* src, int width, int height, uint8_t* dst) {
+    int w = std::max(1, width / 2), h = std::max(1, height / 2);
+    ThreadPool::Global().ParallelFor(h, [&](size_t y) {
+        int y0 = std::min(static_cast<int>(2 * y), height - 1);
+        int y1 = std::min(static_cast<int>(2 * y + 1), height - 1);
+        for (int x = 0; x < w; ++x) {
+            int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            const uint8_t* taps[4] = {
+                src + (static_cast<size_t>(y0) * width + x0) * 4, src + (static_cast<size_t>(y0) * width + x1) * 4,
+                src + (static_cast<size_t>(y1) * width + x0) * 4, src + (static_cast<size_t>(y1) * width + x1) * 4,
+            };
+            float n[3] = {0.0f, 0.0f, 0.0f};
+            int alpha = 0;
+            for (const uint8_t* t : taps) {
+                for (int c = 0; c < 3; ++c) n[c] += t[c] / 255.0f * 2.0f - 1.0f;
+                alpha += t[3];
+            }
+            float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (len < 1e-6f) {
+                n[0] = 0.0f; n[1] = 0.0f; n[2] = 1.0f;
+                len = 1.0f;
+            }
+            uint8_t* out = dst + (y * w + x) * 4;
+            for (int c = 0; c < 3; ++c) {
+                out[c] = static_cast<uint8_t>(std::lround((n[c] / len * 0.5f + 0.5f) * 255.0f));
+            }
+            out[3] = static_cast<uint8_t>((alpha + 2) / 4);
+        }
+    });
+}
+
+void MipGenerator::Generate(DecodedImage* image, TextureKind kind) {
+    TRACE_SCOPE("MipGenerator::Generate");
+    image->mips.clear();
+    if (!image->IsValid()) {
+        return;
+    }
+    int level_count = GetLevelCount(image->width, image->height);
+    image->mips.resize(level_count - 1);
+    for (int level = 1; level < level_count; ++level) {
+        const uint8_t* src = image->GetLevelPixels(level - 1);
+        int src_w = image->GetLevelWidth(level - 1), src_h = image->GetLevelHeight(level - 1);
+        auto& dst = image->mips[level - 1];
+        dst.resize(static_cast<size_t>(image->GetLevelWidth(level)) * image->GetLevelHeight(level) * 4);
+        if (kind == TEXTURE_KIND_NORMAL) {
+            DownsampleNormal(src, src_w, src_h, dst.data());
+        } else {
+            DownsampleColor(src, src_w, src_h, dst.data());
+        }
+    }
+}
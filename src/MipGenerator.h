@@ -0,0 +1,21 @@
+#pragma once
+#include "TextureLoader.h"
+#include <cstdint>
+#include <vector>
+
+// Mip chain generation for decoded RGBA8 images. Each level is a 2x2 box
+// filter of the previous one (odd trailing rows/columns are dropped, as in
+// the GPU convention max(1, size >> level)); rows are split over the global
+// thread pool and the color path uses SSE2 when available.
+class MipGenerator {
+public:
+    // Fill image->mips down to 1x1. Normal maps are filtered as unit vectors
+    // and renormalized so the shortened average does not flatten the shading.
+    static void Generate(DecodedImage* image, TextureKind kind);
+
+    // Box-filter one level into the next (dst holds max(1, w/2) * max(1, h/2) pixels)
+    static void DownsampleColor(const uint8_t* src, int width, int height, uint8_t* dst);
+    static void DownsampleNormal(const uint8_t* src, int width, int height, uint8_t* dst);
+
+    static int GetLevelCount(int width, int height);
+};
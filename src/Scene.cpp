@@ -1,10 +1,96 @@
 #include "Scene.h"
+#include "Trace.h"
 
-// Include stb_image for texture loading
-#include "stb_image.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+namespace {
+// Global buffers are allocated with headroom so that entities added after the
+// initial build can be appended without reallocating on every addition
+constexpr double kBufferGrowthFactor = 1.5;
+constexpr size_t kMinBufferCapacity = 256;  // bytes
+
+// 16-bit positions are used when the rounding error stays below this fraction
+// of the mesh's shortest edge, so shading normals do not change visibly
+constexpr float kPositionErrorTolerance = 0.01f;
+// 16-bit UVs are used when the rounding error stays below this many texels of
+// the entity's largest texture, assumed to be at least 4K since materials may
+// get larger textures later (a UV range of up to 4 at 4K)
+constexpr float kUVErrorTolerance = 0.25f;
+constexpr int kMinUVErrorResolution = 4096;
+constexpr uint32_t kMaxHalfWord = 0xFFFF;
+
+uint32_t FloatBits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+uint32_t QuantizeUnorm16(float value, float min, float scale) {
+    if (scale <= 0.0f) {
+        return 0;
+    }
+    long q = std::lround((value - min) / scale);
+    return static_cast<uint32_t>(std::clamp(q, 0L, static_cast<long>(kMaxHalfWord)));
+}
+
+// Pack count 16-bit values two per word, low half first
+template <typename Fn>
+void PackHalfWords(size_t count, Fn value, std::vector<uint32_t>* words) {
+    words->assign((count + 1) / 2, 0u);
+    for (size_t i = 0; i < count; ++i) {
+        (*words)[i / 2] |= (value(i) & kMaxHalfWord) << (16 * (i & 1));
+    }
+}
+
+// Words taken by each stream of an instance
+size_t PositionWords(const InstanceMetadata& m) {
+    return static_cast<size_t>(m.vertex_count) * ((m.stream_flags & STREAM_POSITION_16) ? 2 : 3);
+}
+size_t UVWords(const InstanceMetadata& m) {
+    return m.has_uv ? static_cast<size_t>(m.vertex_count) * ((m.stream_flags & STREAM_UV_16) ? 1 : 2) : 0;
+}
+size_t MaterialIDWords(const InstanceMetadata& m) {
+    size_t count = m.has_material_ids ? m.triangle_count : 0;
+    return (m.stream_flags & STREAM_MATERIAL_ID_16) ? (count + 1) / 2 : count;
+}
+size_t IndexWords(const InstanceMetadata& m) {
+    size_t count = static_cast<size_t>(m.triangle_count) * 3;
+    return (m.stream_flags & STREAM_INDEX_16) ? (count + 1) / 2 : count;
+}
+
+// Metadata of an entity that is not resident; no TLAS instance refers to it
+InstanceMetadata NonResidentMetadata(const Entity& entity) {
+    InstanceMetadata m{};
+    m.uv_offset = -1;
+    m.material_id_offset = entity.GetMaterialSlot(0);
+    return m;
+}
+
+// GPU bytes an entity takes while resident: BLAS inputs and its stream words at full precision
+size_t EstimateGeometryBytes(const Entity& entity) {
+    size_t vertex_bytes = sizeof(glm::vec3) + (entity.HasUVCoordinates() ? sizeof(glm::vec2) : 0);
+    size_t triangle_bytes = 3 * sizeof(uint32_t) + (entity.HasMaterialIDs() ? sizeof(int) : 0);
+    return 2 * (entity.GetNumVertices() * vertex_bytes + entity.GetNumTriangles() * triangle_bytes);
+}
+
+bool HasEmission(const Entity& entity) {
+    auto emissive = [](const Material& mat) {
+        return std::max({mat.emission.r, mat.emission.g, mat.emission.b}) > 0.0f;
+    };
+    if (!entity.HasMTLMaterials()) {
+        return emissive(entity.GetDefaultMaterial());
+    }
+    return std::any_of(entity.GetMaterials().begin(), entity.GetMaterials().end(), emissive);
+}
+}
 
 Scene::Scene(grassland::graphics::Core* core)
-    : core_(core) {
+    : core_(core)
+    , virtual_textures_(std::make_unique<VirtualTextureSystem>(core)) {
 }
 
 Scene::~Scene() {
@@ -17,57 +103,137 @@ void Scene::AddEntity(std::shared_ptr<Entity> entity) {
         return;
     }
 
-    // Build BLAS for the entity
-    entity->BuildBLAS(core_);
+    // Build BLAS for the entity (out-of-core scenes leave it to UpdateGeometryResidency())
+    if (geometry_budget_ == 0 && entity->BuildBLAS(core_)) {
+        residency_stats_.resident_bytes += EstimateGeometryBytes(*entity);
+        residency_stats_.resident_entities++;
+    }
     
     entities_.push_back(entity);
+    residency_.push_back({});
+    entity_emitters_.push_back({});
+    residency_dirty_ = true;
     grassland::LogInfo("Added entity to scene (total: {})", entities_.size());
+
+    // After the initial build, append only this entity's data instead of rebuilding everything
+    if (built_) {
+        LoadEntityTextures({ entity.get() });
+        AppendEntityData(*entity);
+        pending_updates_ |= SCENE_UPDATE_TLAS | SCENE_UPDATE_GEOMETRY | SCENE_UPDATE_MATERIALS;
+        MarkEmittersDirty(entities_.size() - 1);
+    }
+}
+
+void Scene::RemoveEntity(size_t index) {
+    if (index >= entities_.size()) {
+        grassland::LogError("Cannot remove entity {}: only {} entities in scene", index, entities_.size());
+        return;
+    }
+    if (!built_) {
+        EraseEntity(index);
+        return;
+    }
+    // The frame being recorded still binds its BLAS and metadata slot
+    pending_removals_.push_back(entities_[index].get());
+    pending_updates_ |= SCENE_UPDATE_TLAS | SCENE_UPDATE_GEOMETRY;
+}
+
+void Scene::EraseEntity(size_t index) {
+    size_t last = entities_.size() - 1;
+    if (entities_[index]->IsResident()) {
+        residency_stats_.resident_bytes -= EstimateGeometryBytes(*entities_[index]);
+        residency_stats_.resident_entities--;
+    }
+
+    if (built_) {
+        // The removed entity's ranges become holes in the global buffers
+        const auto& entity = entities_[index];
+        const InstanceMetadata& metadata = instance_metadata_[index];
+        position_garbage_ += PositionWords(metadata);
+        uv_garbage_ += UVWords(metadata);
+        material_id_garbage_ += MaterialIDWords(metadata);
+        index_garbage_ += IndexWords(metadata);
+        ReleaseMaterialSlots(*entity);
+
+        // Swap-remove the metadata entry and upload only the moved one
+        instance_metadata_[index] = instance_metadata_[last];
+        instance_metadata_.pop_back();
+        if (index != last) {
+            instance_metadata_buffer_->UploadData(&instance_metadata_[index], sizeof(InstanceMetadata),
+                                                  index * sizeof(InstanceMetadata));
+        }
+        pending_updates_ |= SCENE_UPDATE_TLAS | SCENE_UPDATE_GEOMETRY;
+        if (!entity_emitters_[index].triangles.empty() || !entity_emitters_[last].triangles.empty()) {
+            pending_updates_ |= SCENE_UPDATE_EMITTERS;
+        }
+    }
+
+    // Frames in flight may still trace against its BLAS
+    retired_.Retire(entities_[index]);
+    entities_[index] = entities_[last];
+    entities_.pop_back();
+    residency_[index] = residency_[last];
+    residency_.pop_back();
+    if (index != last) {
+        // The moved entity's triangles refer to it by index
+        entity_emitters_[index] = std::move(entity_emitters_[last]);
+        for (auto& tri : entity_emitters_[index].triangles) {
+            tri.entity = static_cast<uint32_t>(index);
+        }
+    }
+    entity_emitters_.pop_back();
+    grassland::LogInfo("Removed entity {} from scene (total: {})", index, entities_.size());
 }
 
 void Scene::AddPointLight(const PointLight & light) {
     point_lights_. push_back(light);
+    if (built_) {
+        pending_updates_ |= SCENE_UPDATE_LIGHTS;
+    }
 }
 
 void Scene::Clear() {
     entities_.clear();
+    residency_.clear();
+    residency_stats_ = GeometryResidencyStats{};
+    residency_stats_.budget_bytes = geometry_budget_;
+    residency_dirty_ = true;
     tlas_.reset();
     materials_buffer_.reset();
-    textures_.clear();
-    texture_path_to_index_.clear();
+    virtual_textures_->Clear();
+
+    gpu_materials_.clear();
+    material_slot_lookup_.clear();
+    material_slot_refs_.clear();
+    material_slot_edited_.clear();
+    position_count_ = uv_count_ = material_id_count_ = index_count_ = 0;
+    position_garbage_ = uv_garbage_ = material_id_garbage_ = index_garbage_ = material_garbage_ = 0;
+    restream_pending_ = false;
+    built_ = false;
+    pending_updates_ = SCENE_UPDATE_NONE;
+    dirty_material_slots_.clear();
+    material_id_dirty_entities_.clear();
+    pending_removals_.clear();
+    entity_emitters_.clear();
+    emissive_triangles_.clear();
+    emitters_.clear();
+    emissive_power_ = 0.0f;
 }
 
 void Scene::BuildAccelerationStructures() {
+    TRACE_SCOPE("Scene::BuildAccelerationStructures");
     if (entities_.empty()) {
         grassland::LogWarning("No entities to build acceleration structures");
         return;
     }
 
-    // Create TLAS instances from all entities
-    std::vector<grassland::graphics::RayTracingInstance> instances;
-    instances.reserve(entities_.size());
-
-    for (size_t i = 0; i < entities_.size(); ++i) {
-        auto& entity = entities_[i];
-        if (entity->GetBLAS()) {
-            // Create instance with entity's transform
-            // instanceCustomIndex is used to index into materials buffer
-            // Convert mat4 to mat4x3 (drop the last row which is always [0,0,0,1] for affine transforms)
-            glm::mat4x3 transform_3x4 = glm::mat4x3(entity->GetTransform());
-            
-            auto instance = entity->GetBLAS()->MakeInstance(
-                transform_3x4,
-                static_cast<uint32_t>(i),  // instanceCustomIndex for material lookup
-                0xFF,                       // instanceMask
-                0,                          // instanceShaderBindingTableRecordOffset
-                grassland::graphics::RAYTRACING_INSTANCE_FLAG_NONE
-            );
-            instances.push_back(instance);
-        }
+    // Out-of-core scenes start with the entities requested from the last viewpoint
+    if (geometry_budget_ > 0 && residency_dirty_) {
+        UpdateGeometryResidency(residency_viewpoint_);
     }
 
     // Build TLAS
-    core_->CreateTopLevelAccelerationStructure(instances, &tlas_);
-    grassland::LogInfo("Built TLAS with {} instances", instances.size());
+    RebuildTLAS();
 
     // Assign material offsets to entities
     AssignMaterialOffsets();
@@ -75,427 +241,1063 @@ void Scene::BuildAccelerationStructures() {
     // Load textures and assign indices to materials
     AssignTextureIndices();
 
-    // Build global UV and material ID buffers
-    ConstructUVBuffer();
-    ConstructMaterialIDBuffer();
-    ConstructIndexBuffer();
-    
-    // Build instance metadata buffer
-    ConstructInstanceMetadataBuffer();
+    // Build global position, UV, material ID and index streams and the instance metadata
+    ConstructGlobalBuffers();
 
     // Update materials buffer
     UpdateMaterialsBuffer();
+
+    position_garbage_ = uv_garbage_ = material_id_garbage_ = index_garbage_ = material_garbage_ = 0;
+
+    // Collect emissive triangles for next-event estimation
+    BuildEmitters();
+
+    built_ = true;
+    pending_updates_ = SCENE_UPDATE_NONE;
+    dirty_material_slots_.clear();
+}
+
+std::vector<grassland::graphics::RayTracingInstance> Scene::MakeInstances() const {
+    std::vector<grassland::graphics::RayTracingInstance> instances;
+    instances.reserve(entities_.size());
+
+    for (size_t i = 0; i < entities_.size(); ++i) {
+        auto& entity = entities_[i];
+        grassland::graphics::AccelerationStructure* blas = entity->GetBLAS();
+        uint8_t mask = 0xFF;
+        if (!blas) {
+            if (!placeholder_blas_) {
+                continue;
+            }
+            // Non-resident: keep the instance slot, but no ray can hit it
+            blas = placeholder_blas_.get();
+            mask = 0;
+        }
+        // Create instance with entity's transform
+        // instanceCustomIndex is used to index into materials buffer
+        // Convert mat4 to mat4x3 (drop the last row which is always [0,0,0,1] for affine transforms)
+        glm::mat4x3 transform_3x4 = glm::mat4x3(entity->GetTransform());
+
+        auto instance = blas->MakeInstance(
+            transform_3x4,
+            static_cast<uint32_t>(i),  // instanceCustomIndex for material lookup
+            mask,                       // instanceMask
+            0,                          // instanceShaderBindingTableRecordOffset
+            grassland::graphics::RAYTRACING_INSTANCE_FLAG_NONE
+        );
+        instances.push_back(instance);
+    }
+    return instances;
+}
+
+void Scene::RebuildTLAS() {
+    TRACE_SCOPE("Scene::RebuildTLAS");
+    if (entities_.empty()) {
+        retired_.Retire(std::move(tlas_));
+        return;
+    }
+    if (geometry_budget_ > 0 && !placeholder_blas_) {
+        CreatePlaceholderBLAS();
+    }
+    auto instances = MakeInstances();
+    retired_.Retire(std::move(tlas_));
+    core_->CreateTopLevelAccelerationStructure(instances, &tlas_);
+    grassland::LogInfo("Built TLAS with {} instances", instances.size());
+}
+
+void Scene::CreatePlaceholderBLAS() {
+    const glm::vec3 positions[3] = {glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f)};
+    const uint32_t indices[3] = {0, 1, 2};
+    core_->CreateBuffer(sizeof(positions), grassland::graphics::BUFFER_TYPE_DYNAMIC, &placeholder_vertex_buffer_);
+    placeholder_vertex_buffer_->UploadData(positions, sizeof(positions));
+    core_->CreateBuffer(sizeof(indices), grassland::graphics::BUFFER_TYPE_DYNAMIC, &placeholder_index_buffer_);
+    placeholder_index_buffer_->UploadData(indices, sizeof(indices));
+    core_->CreateBottomLevelAccelerationStructure(placeholder_vertex_buffer_.get(), placeholder_index_buffer_.get(),
+                                                  sizeof(glm::vec3), &placeholder_blas_);
 }
 
 void Scene::UpdateInstances() {
+    TRACE_SCOPE("Scene::UpdateInstances");
     if (!tlas_ || entities_.empty()) {
         return;
     }
 
-    // Recreate instances with updated transforms
-    std::vector<grassland::graphics::RayTracingInstance> instances;
-    instances.reserve(entities_.size());
+    // Update TLAS with updated transforms
+    tlas_->UpdateInstances(MakeInstances());
 
+    // Emissive triangles are stored in world space
     for (size_t i = 0; i < entities_.size(); ++i) {
-        auto& entity = entities_[i];
-        if (entity->GetBLAS()) {
-            // Convert mat4 to mat4x3
-            glm::mat4x3 transform_3x4 = glm::mat4x3(entity->GetTransform());
-            
-            auto instance = entity->GetBLAS()->MakeInstance(
-                transform_3x4,
-                static_cast<uint32_t>(i),
-                0xFF,
-                0,
-                grassland::graphics::RAYTRACING_INSTANCE_FLAG_NONE
-            );
-            instances.push_back(instance);
+        if (!entity_emitters_[i].triangles.empty()) {
+            MarkEmittersDirty(i);
         }
     }
+}
 
-    // Update TLAS
-    tlas_->UpdateInstances(instances);
+void Scene::MarkMaterialDirty(size_t entity_index, int material_index) {
+    if (!built_ || entity_index >= entities_.size()) {
+        return;
+    }
+
+    const auto& entity = entities_[entity_index];
+    const Material* mat = &entity->GetDefaultMaterial();
+    if (entity->HasMTLMaterials()) {
+        mat = entity->GetMaterial(material_index);
+        if (!mat) {
+            grassland::LogError("Entity {} has no material {}", entity_index, material_index);
+            return;
+        }
+    } else {
+        material_index = 0;
+    }
+
+    int slot = entity->GetMaterialSlot(material_index);
+    MaterialGPUData data = mat->ToGPUData();
+    if (std::memcmp(&gpu_materials_[slot], &data, sizeof(MaterialGPUData)) == 0) {
+        return;  // e.g. a UI widget reported an edit without changing the value
+    }
+    // Only emission edits change the entity's emissive triangles
+    if (gpu_materials_[slot].emission != mat->emission) {
+        MarkEmittersDirty(entity_index);
+    }
+    if (material_slot_refs_[slot] > 1) {
+        // The slot is shared with other materials: give the edited one its own slot
+        material_slot_refs_[slot]--;
+        slot = static_cast<int>(gpu_materials_.size());
+        gpu_materials_.push_back(data);
+        material_slot_refs_.push_back(1);
+        material_slot_edited_.push_back(true);
+
+        std::vector<int> slots = entity->GetMaterialSlots();
+        slots[material_index] = slot;
+        entity->SetMaterialSlots(std::move(slots));
+        // The material table grows and the IDs move in ApplyPendingUpdates(), not under the frame being recorded
+        material_id_dirty_entities_.push_back(entity_index);
+        pending_updates_ |= SCENE_UPDATE_GEOMETRY;
+    } else {
+        gpu_materials_[slot] = data;
+        material_slot_edited_[slot] = true;
+    }
+
+    dirty_material_slots_.push_back(slot);
+    pending_updates_ |= SCENE_UPDATE_MATERIALS;
+}
+
+uint32_t Scene::ApplyPendingUpdates() {
+    TRACE_SCOPE("Scene::ApplyPendingUpdates");
+    retired_.NextFrame();
+    if (!built_ || pending_updates_ == SCENE_UPDATE_NONE) {
+        return SCENE_UPDATE_NONE;
+    }
+
+    uint32_t updates = pending_updates_;
+
+    // Material slots split off by MarkMaterialDirty(): grow the table and point the entities at them
+    if (!material_id_dirty_entities_.empty()) {
+        size_t material_bytes = gpu_materials_.size() * sizeof(MaterialGPUData);
+        ReserveBuffer(materials_buffer_, material_bytes, material_bytes);
+        std::sort(material_id_dirty_entities_.begin(), material_id_dirty_entities_.end());
+        material_id_dirty_entities_.erase(
+            std::unique(material_id_dirty_entities_.begin(), material_id_dirty_entities_.end()),
+            material_id_dirty_entities_.end());
+        for (size_t entity_index : material_id_dirty_entities_) {
+            UploadEntityMaterialIDs(entity_index);
+        }
+        material_id_dirty_entities_.clear();
+    }
+
+    // Removals queued by RemoveEntity() (indices shift with each swap-remove)
+    for (const Entity* removed : pending_removals_) {
+        auto it = std::find_if(entities_.begin(), entities_.end(),
+                               [removed](const std::shared_ptr<Entity>& entity) { return entity.get() == removed; });
+        if (it != entities_.end()) {
+            EraseEntity(static_cast<size_t>(it - entities_.begin()));
+        }
+    }
+    pending_removals_.clear();
+    updates |= pending_updates_;  // Removals may add emitter updates
+
+    if (NeedsCompaction()) {
+        // Slots are renumbered but keep their values, so this is a geometry update only
+        CompactGlobalBuffers();
+        updates |= SCENE_UPDATE_GEOMETRY;
+    } else if (!dirty_material_slots_.empty()) {
+        // Upload each run of consecutive dirty slots with a single call
+        std::sort(dirty_material_slots_.begin(), dirty_material_slots_.end());
+        dirty_material_slots_.erase(std::unique(dirty_material_slots_.begin(), dirty_material_slots_.end()),
+                                    dirty_material_slots_.end());
+        size_t run_begin = 0;
+        for (size_t i = 1; i <= dirty_material_slots_.size(); ++i) {
+            if (i < dirty_material_slots_.size() && dirty_material_slots_[i] == dirty_material_slots_[i - 1] + 1) {
+                continue;
+            }
+            int first = dirty_material_slots_[run_begin];
+            size_t count = i - run_begin;
+            materials_buffer_->UploadData(&gpu_materials_[first], count * sizeof(MaterialGPUData),
+                                          first * sizeof(MaterialGPUData));
+            run_begin = i;
+        }
+    }
+    dirty_material_slots_.clear();
+
+    if (updates & SCENE_UPDATE_TLAS) {
+        RebuildTLAS();
+    } else if (updates & SCENE_UPDATE_RESIDENCY) {
+        // Paging swaps BLAS references but keeps one instance per entity
+        if (tlas_ && placeholder_blas_) {
+            tlas_->UpdateInstances(MakeInstances());
+        } else {
+            RebuildTLAS();  // The budget was set after the TLAS was built without placeholders
+        }
+    }
+
+    if (updates & SCENE_UPDATE_EMITTERS) {
+        UpdateEmitters();
+    }
+
+    pending_updates_ = SCENE_UPDATE_NONE;
+    return updates;
+}
+
+void Scene::BuildEmitters() {
+    TRACE_SCOPE("Scene::BuildEmitters");
+    entity_emitters_.assign(entities_.size(), EntityEmitters{});
+    UpdateEmitters();
+
+    if (!emitters_.empty()) {
+        grassland::LogInfo("Found {} emissive triangles in {} entities (total power {:.3f})",
+                           emissive_triangles_.size(), emitters_.size(), emissive_power_);
+    }
+}
+
+void Scene::MarkEmittersDirty(size_t entity_index) {
+    entity_emitters_[entity_index].dirty = true;
+    pending_updates_ |= SCENE_UPDATE_EMITTERS;
+}
+
+void Scene::CollectEntityEmitters(size_t entity_index) {
+    EntityEmitters& result = entity_emitters_[entity_index];
+    result = EntityEmitters{};
+    result.dirty = false;
+
+    const Entity& entity = *entities_[entity_index];
+    if (!entity.IsResident()) {
+        return;  // Not in the TLAS, so it cannot be hit by shadow rays either
+    }
+    auto luminance = [](const glm::vec3& c) { return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b; };
+    auto emission_of = [&entity](int local_index) {
+        const Material* mat = entity.HasMTLMaterials() ? entity.GetMaterial(local_index) : &entity.GetDefaultMaterial();
+        return mat ? mat->emission : glm::vec3(0.0f);
+    };
+
+    // Skip entities without any emissive material
+    bool emissive = false;
+    for (int i = 0; i < static_cast<int>(entity.GetNumMaterialSlots()); ++i) {
+        emissive |= luminance(emission_of(i)) > 0.0f;
+    }
+    if (!emissive) {
+        return;
+    }
+
+    const auto* positions = entity.GetPositions();
+    const uint32_t* indices = entity.GetIndices();
+    const int* material_ids = entity.GetMaterialIDs();
+    const glm::mat4& transform = entity.GetTransform();
+    auto world = [&](uint32_t v) {
+        return glm::vec3(transform * glm::vec4(positions[v][0], positions[v][1], positions[v][2], 1.0f));
+    };
+
+    std::vector<float> powers;
+    for (size_t t = 0; t < entity.GetNumTriangles(); ++t) {
+        glm::vec3 emission = emission_of(material_ids ? material_ids[t] : 0);
+        float lum = luminance(emission);
+        if (lum <= 0.0f) {
+            continue;
+        }
+        EmissiveTriangleGPU tri;
+        tri.p0 = world(indices[3 * t]);
+        tri.p1 = world(indices[3 * t + 1]);
+        tri.p2 = world(indices[3 * t + 2]);
+        tri.area = 0.5f * glm::length(glm::cross(tri.p1 - tri.p0, tri.p2 - tri.p0));
+        if (tri.area <= 0.0f) {
+            continue;
+        }
+        tri.entity = static_cast<uint32_t>(entity_index);
+        tri.primitive = static_cast<uint32_t>(t);
+        tri.emission = emission;
+        tri.power = lum * tri.area;
+        result.triangles.push_back(tri);
+        powers.push_back(tri.power);
+        result.power += tri.power;
+    }
+    if (!powers.empty()) {
+        result.alias = BuildAliasTable(powers);
+    }
+}
+
+void Scene::UpdateEmitters() {
+    TRACE_SCOPE("Scene::UpdateEmitters");
+    for (size_t e = 0; e < entities_.size(); ++e) {
+        if (entity_emitters_[e].dirty) {
+            CollectEntityEmitters(e);
+        }
+    }
+
+    // Concatenate the per-entity ranges; only the entity alias table is built here
+    emissive_triangles_.clear();
+    emitters_.clear();
+    std::vector<AliasEntry> triangle_alias;
+    std::vector<float> emitter_powers;
+    for (const EntityEmitters& source : entity_emitters_) {
+        if (source.triangles.empty()) {
+            continue;
+        }
+        emitters_.push_back({static_cast<uint32_t>(emissive_triangles_.size()),
+                             static_cast<uint32_t>(source.triangles.size()), source.power, 0});
+        emissive_triangles_.insert(emissive_triangles_.end(), source.triangles.begin(), source.triangles.end());
+        triangle_alias.insert(triangle_alias.end(), source.alias.begin(), source.alias.end());
+        emitter_powers.push_back(source.power);
+    }
+
+    emissive_power_ = 0.0f;
+    for (float power : emitter_powers) {
+        emissive_power_ += power;
+    }
+    std::vector<AliasEntry> emitter_alias = BuildAliasTable(emitter_powers);
+
+    // Buffers keep their capacity, so edits usually upload into the existing ones
+    auto upload = [this](std::unique_ptr<grassland::graphics::Buffer>& buffer, const void* data, size_t size) {
+        if (size > 0) {
+            ReserveBuffer(buffer, 0, size);
+            buffer->UploadData(data, size);
+        }
+    };
+    upload(emissive_triangle_buffer_, emissive_triangles_.data(), emissive_triangles_.size() * sizeof(EmissiveTriangleGPU));
+    upload(emissive_triangle_alias_buffer_, triangle_alias.data(), triangle_alias.size() * sizeof(AliasEntry));
+    upload(emitter_buffer_, emitters_.data(), emitters_.size() * sizeof(EmitterGPU));
+    upload(emitter_alias_buffer_, emitter_alias.data(), emitter_alias.size() * sizeof(AliasEntry));
 }
 
 void Scene::AssignMaterialOffsets() {
-    int global_material_offset = 0;
-    
+    TRACE_SCOPE("Scene::AssignMaterialOffsets");
+    material_slot_lookup_.clear();
+    material_slot_refs_.clear();
+    material_slot_edited_.clear();
+
+    size_t total_materials = 0;
     for (auto& entity : entities_) {
-        entity->SetMaterialOffset(global_material_offset);
-        
+        std::vector<int> slots;
         if (entity->HasMTLMaterials()) {
-            global_material_offset += entity->GetMaterials().size();
+            for (const auto& mat : entity->GetMaterials()) {
+                slots.push_back(AcquireMaterialSlot(mat));
+            }
         } else {
-            global_material_offset += 1;  // Default material
+            slots.push_back(AcquireMaterialSlot(entity->GetDefaultMaterial()));  // Default material
         }
+        total_materials += slots.size();
+        entity->SetMaterialSlots(std::move(slots));
     }
     
-    grassland::LogInfo("Assigned material offsets to {} entities, total {} materials", 
-                     entities_.size(), global_material_offset);
+    size_t unique_materials = material_slot_refs_.size();
+    grassland::LogInfo("Assigned material slots to {} entities: {} materials -> {} unique (dedup ratio {:.2f}x)", 
+                     entities_.size(), total_materials, unique_materials,
+                     unique_materials ? static_cast<double>(total_materials) / unique_materials : 1.0);
+}
+
+int Scene::AcquireMaterialSlot(const Material& material) {
+    auto it = material_slot_lookup_.find(material);
+    if (it != material_slot_lookup_.end() && !material_slot_edited_[it->second]) {
+        int slot = it->second;
+        if (material_slot_refs_[slot] == 0) {
+            material_garbage_--;  // Reviving a slot released by a removed entity
+        }
+        material_slot_refs_[slot]++;
+        return slot;
+    }
+
+    int slot = static_cast<int>(material_slot_refs_.size());
+    material_slot_refs_.push_back(1);
+    material_slot_edited_.push_back(false);
+    material_slot_lookup_[material] = slot;
+    return slot;
+}
+
+void Scene::ReleaseMaterialSlots(const Entity& entity) {
+    for (int slot : entity.GetMaterialSlots()) {
+        if (--material_slot_refs_[slot] == 0) {
+            material_garbage_++;
+        }
+    }
 }
 
 void Scene::UpdateMaterialsBuffer() {
+    TRACE_SCOPE("Scene::UpdateMaterialsBuffer");
     if (entities_.empty()) {
         return;
     }
 
     // Collect all materials in GPU format
-    // Each entity's materials are appended to create a global material array
-    std::vector<MaterialGPUData> materials;
+    // Each entity writes its materials into the slots assigned by AssignMaterialOffsets()
+    gpu_materials_.assign(material_slot_refs_.size(), MaterialGPUData{});
 
     for (const auto& entity : entities_) {
         if (entity->HasMTLMaterials()) {
             // Add all materials from MTL
             auto& mtl_materials = entity->GetMaterials();
-            for (const auto& mat : mtl_materials) {
-                materials.push_back(mat.ToGPUData());
+            for (size_t i = 0; i < mtl_materials.size(); ++i) {
+                gpu_materials_[entity->GetMaterialSlot(static_cast<int>(i))] = mtl_materials[i].ToGPUData();
             }
         } else {
             // Add default material
-            materials.push_back(entity->GetDefaultMaterial().ToGPUData());
+            gpu_materials_[entity->GetMaterialSlot(0)] = entity->GetDefaultMaterial().ToGPUData();
         }
     }
 
     // Create/update materials buffer
-    size_t buffer_size = materials.size() * sizeof(MaterialGPUData);
-    
-    if (!materials_buffer_) {
-        core_->CreateBuffer(buffer_size, 
-                          grassland::graphics::BUFFER_TYPE_DYNAMIC, 
-                          &materials_buffer_);
-    }
+    size_t buffer_size = gpu_materials_.size() * sizeof(MaterialGPUData);
+    ReserveBuffer(materials_buffer_, 0, buffer_size);
     
-    materials_buffer_->UploadData(materials.data(), buffer_size);
-    grassland::LogInfo("Updated materials buffer with {} materials", materials.size());
+    materials_buffer_->UploadData(gpu_materials_.data(), buffer_size);
+    grassland::LogInfo("Updated materials buffer with {} materials", gpu_materials_.size());
 }
 
 void Scene::AssignTextureIndices() {
+    TRACE_SCOPE("Scene::AssignTextureIndices");
     // Load all unique textures and assign indices to materials (assign texture and normal maps together)
-    int cnt = 0;
-    grassland::LogInfo("AAAAA Assigning Texture index to entity {}", cnt);
+    std::vector<Entity*> entities;
+    entities.reserve(entities_.size());
     for (auto& entity : entities_) {
-        if (entity->HasMTLMaterials()) {
-            // Process all materials from MTL
-            auto& mtl_materials = entity->GetMutableMaterials();
-            for (size_t i = 0; i < mtl_materials.size(); ++i) {
-                Material& mat = mtl_materials[i];
-                if (mat.HasTexture()) {
-                    int tex_index = LoadTexture(mat.GetTexturePath());
-                    mat.texture_index = tex_index;
-                    grassland::LogInfo("Assigned texture index {} to material {} with texture: {}", 
-                                     tex_index, i, mat.GetTexturePath());
-                }
-                if(mat.HasNormal()) {
-                    int norm_index = LoadNormal(mat.GetNormalPath());
-                    mat.normal_index = norm_index; 
-                    grassland::LogInfo("Assigned texture index {} to material {} with texture: {}", 
-                                     norm_index, i, mat.GetNormalPath());
+        entities.push_back(entity.get());
+    }
+    LoadEntityTextures(entities);
+}
+
+void Scene::LoadEntityTextures(const std::vector<Entity*>& entities) {
+    TRACE_SCOPE("Scene::LoadEntityTextures");
+    auto for_each_material = [&entities](const std::function<void(Material&)>& fn) {
+        for (Entity* entity : entities) {
+            if (entity->HasMTLMaterials()) {
+                for (auto& mat : entity->GetMutableMaterials()) {
+                    fn(mat);
                 }
+            } else {
+                fn(entity->GetMutableDefaultMaterial());
             }
-            grassland::LogInfo("Entity {} has texture index {}", cnt, mtl_materials[0].texture_index);
+        }
+    };
 
-        } else {
-            // Process default material
-            Material& mat = entity->GetMutableDefaultMaterial();
-            if (mat.HasTexture()) {
-                int tex_index = LoadTexture(mat.GetTexturePath());
-                mat.texture_index = tex_index;
-                grassland::LogInfo("Assigned texture index {} to default material with texture: {}", 
-                                 tex_index, mat.GetTexturePath());
-            }
-            if(mat.HasNormal()) {
-                int norm_index = LoadNormal(mat.GetNormalPath());
-                mat.normal_index = norm_index; 
-                grassland::LogInfo("Assigned texture index {} to material {} with texture: {}", 
-                                    norm_index, mat.GetNormalPath());
-            }
-            grassland::LogInfo("Entity {} has texture index {}", cnt, mat.texture_index);
+    // 1. Collect paths in material order so IDs are deterministic
+    std::vector<std::pair<std::string, TextureKind>> requests;
+    for_each_material([&requests](Material& mat) {
+        if (mat.HasTexture()) {
+            requests.emplace_back(mat.GetTexturePath(), TEXTURE_KIND_COLOR);
         }
-        
-        cnt++;
+        if (mat.HasNormal()) {
+            requests.emplace_back(mat.GetNormalPath(), TEXTURE_KIND_NORMAL);
+        }
+    });
+    if (requests.empty()) {
+        return;
     }
+
+    // 2. Register with the virtual texture system (known paths resolve immediately,
+    //    new ones are cached in parallel and only their mip tails are uploaded)
+    std::vector<int> ids = virtual_textures_->AddTextures(requests);
+
+    // 3. Assign IDs
+    size_t next = 0;
+    for_each_material([&ids, &next](Material& mat) {
+        if (mat.HasTexture()) {
+            mat.texture_index = ids[next++];
+        }
+        if (mat.HasNormal()) {
+            mat.normal_index = ids[next++];
+        }
+    });
 }
 
 int Scene::LoadTexture(const std::string& filepath) {
-    // Check if already loaded
-    grassland::LogInfo("Entering Texture Loading");
-    auto it = texture_path_to_index_.find(filepath);
-    if (it != texture_path_to_index_.end()) {
-        return it->second;
-    }
+    return virtual_textures_->AddTexture(filepath, TEXTURE_KIND_COLOR);
+}
 
-    // Load image using stb_image
-    int width, height, channels;
-    unsigned char* data = stbi_load(filepath.c_str(), &width, &height, &channels, 4);  // Force RGBA
-    
-    if (!data) {
-        grassland::LogInfo("Failed to load texture: {} - {}", filepath, stbi_failure_reason());
-        return -1;
-    }
-    grassland::LogInfo("Successfully Loaded Texture");
-    // Create GPU image
-    std::unique_ptr<grassland::graphics::Image> texture;
-    core_->CreateImage(
-        width,
-        height,
-        grassland::graphics::IMAGE_FORMAT_R8G8B8A8_UNORM,
-        &texture
-    );
-
-    // Upload data
-    texture->UploadData(data);
-    
-    // Free image data
-    stbi_image_free(data);
+int Scene::LoadNormal(const std::string& filepath){
+    return virtual_textures_->AddTexture(filepath, TEXTURE_KIND_NORMAL);
+}
 
-    // Store texture
-    int index = static_cast<int>(textures_.size());
-    textures_.push_back(std::move(texture));
-    texture_path_to_index_[filepath] = index;
+size_t Scene::UpdateVirtualTextures() {
+    TRACE_SCOPE("Scene::UpdateVirtualTextures");
+    return virtual_textures_->Update();
+}
 
-    grassland::LogInfo("Loaded texture: {} ({}x{}, {} channels) -> index {}", 
-                      filepath, width, height, channels, index);
 
-    return index;
+void Scene::SetCompactStreams(bool enabled) {
+    if (compact_streams_ == enabled) {
+        return;
+    }
+    compact_streams_ = enabled;
+    if (built_) {
+        restream_pending_ = true;
+        pending_updates_ |= SCENE_UPDATE_GEOMETRY;
+    }
 }
 
-int Scene::LoadNormal(const std::string& filepath){
-    grassland::LogInfo("Enter Normal Loading");
-    int width, height, channels;
-    unsigned char* data = stbi_load(filepath.c_str(), &width, &height, &channels, 4);  // Force RGBA
-    
-    if (!data) {
-        grassland::LogInfo("Failed to load normal: {} - {}", filepath, stbi_failure_reason());
-        return -1;
-    }
-    grassland::LogInfo("Successfully Loaded normal");
-    // Create GPU image
-    std::unique_ptr<grassland::graphics::Image> normal;
-    core_->CreateImage(
-        width,
-        height,
-        grassland::graphics::IMAGE_FORMAT_R8G8B8A8_UNORM,
-        &normal
-    );
-
-    // Upload data
-    normal->UploadData(data);
-    
-    // Free image data
-    stbi_image_free(data);
+GeometryStreamStats Scene::GetGeometryStreamStats() const {
+    GeometryStreamStats stats;
+    for (const auto& m : instance_metadata_) {
+        size_t words = PositionWords(m) + UVWords(m) + MaterialIDWords(m) + IndexWords(m);
+        size_t full_words = static_cast<size_t>(m.vertex_count) * (m.has_uv ? 5 : 3) +
+                            static_cast<size_t>(m.triangle_count) * (m.has_material_ids ? 4 : 3);
+        stats.bytes += words * sizeof(uint32_t);
+        stats.full_precision_bytes += full_words * sizeof(uint32_t);
+        if (m.stream_flags != 0) {
+            stats.compact_entities++;
+        }
+    }
+    return stats;
+}
 
-    // Store texture
-    int index = static_cast<int>(normals_.size());
-    normals_.push_back(std::move(normal));
+void Scene::AccumulateMemory(MemoryReport* report) const {
+    for (size_t i = 0; i < entities_.size(); ++i) {
+        EntityMemoryUsage usage = entities_[i]->GetMemoryUsage();
+        usage.entity_index = i;
+        if (i < instance_metadata_.size()) {
+            const InstanceMetadata& m = instance_metadata_[i];
+            usage.scene_streams.gpu_bytes =
+                (PositionWords(m) + UVWords(m) + MaterialIDWords(m) + IndexWords(m)) * sizeof(uint32_t);
+        }
+        report->AddEntity(usage);
+    }
 
-    grassland::LogInfo("Loaded normal: {} ({}x{}, {} channels) -> index {}", 
-                      filepath, width, height, channels, index);
+    // Buffers are counted at capacity: growth headroom and holes of removed entities included
+    MemoryUsage buffers;
+    buffers.gpu_bytes = MemoryReport::GetBufferBytes(global_position_buffer_.get()) +
+                        MemoryReport::GetBufferBytes(global_uv_buffer_.get()) +
+                        MemoryReport::GetBufferBytes(global_material_id_buffer_.get()) +
+                        MemoryReport::GetBufferBytes(global_index_buffer_.get()) +
+                        MemoryReport::GetBufferBytes(instance_metadata_buffer_.get()) +
+                        MemoryReport::GetBufferBytes(materials_buffer_.get()) +
+                        MemoryReport::GetBufferBytes(emissive_triangle_buffer_.get()) +
+                        MemoryReport::GetBufferBytes(emissive_triangle_alias_buffer_.get()) +
+                        MemoryReport::GetBufferBytes(emitter_buffer_.get()) +
+                        MemoryReport::GetBufferBytes(emitter_alias_buffer_.get());
+    buffers.cpu_bytes = MemoryReport::GetVectorBytes(instance_metadata_) + MemoryReport::GetVectorBytes(gpu_materials_) +
+                        MemoryReport::GetVectorBytes(emissive_triangles_) + MemoryReport::GetVectorBytes(emitters_) +
+                        MemoryReport::GetVectorBytes(point_lights_);
+    report->Add(MEMORY_CATEGORY_SCENE_BUFFERS, buffers);
 
-    return index;
+    virtual_textures_->AccumulateMemory(report);
 }
 
+void Scene::EncodeEntityStreams(const Entity& entity, InstanceMetadata* metadata, EntityStreams* streams) const {
+    InstanceMetadata& m = *metadata;
+    m = InstanceMetadata{};
+    size_t vertex_count = entity.GetNumVertices();
+    size_t num_indices = entity.GetNumIndices();
+    const uint32_t* indices = entity.GetIndices();
+    m.vertex_count = static_cast<int>(vertex_count);
+    m.triangle_count = static_cast<int>(num_indices / 3);
 
-void Scene::ConstructUVBuffer(){
-    if(entities_.empty()){
-        return;
+    // Positions, object space
+    const auto* positions = entity.GetPositions();
+    glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+    for (size_t i = 0; i < vertex_count; ++i) {
+        glm::vec3 p(positions[i][0], positions[i][1], positions[i][2]);
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
     }
-    
-    std::vector<glm::vec2> global_uv;
-    
-    // Calculate total vertices (only for entities with UV)
-    size_t total_vertices = 0;
-    for(const auto& entity : entities_){
-        if(entity->HasUVCoordinates()){
-            total_vertices += entity->GetNumVertices();
+    bool quantize_positions = compact_streams_ && vertex_count > 0;
+    glm::vec3 scale = quantize_positions ? (hi - lo) / static_cast<float>(kMaxHalfWord) : glm::vec3(0.0f);
+    if (quantize_positions) {
+        float min_edge_sq = FLT_MAX;
+        for (size_t t = 0; t + 2 < num_indices; t += 3) {
+            for (int e = 0; e < 3; ++e) {
+                const auto& a = positions[indices[t + e]];
+                const auto& b = positions[indices[t + (e + 1) % 3]];
+                float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+                float len_sq = dx * dx + dy * dy + dz * dz;
+                if (len_sq > 0.0f) {
+                    min_edge_sq = std::min(min_edge_sq, len_sq);
+                }
+            }
         }
+        float max_error = 0.5f * std::sqrt(glm::dot(scale, scale));
+        quantize_positions = max_error <= kPositionErrorTolerance * std::sqrt(min_edge_sq);
     }
-    
-    // Reserve space to avoid reallocation
-    global_uv.reserve(total_vertices);
-    
-    // Collect UV data from entities that have UV coordinates
-    for(const auto& entity : entities_){
-        if(entity->HasUVCoordinates()){
-            auto* uv_data = entity->GetUVCoordinates();
-            size_t count = entity->GetNumVertices();
-            
-            // Convert from Eigen::Vector2<float> to glm::vec2
-            for(size_t i = 0; i < count; i++) {
-                global_uv.push_back(glm::vec2(uv_data[i][0], uv_data[i][1]));
+    streams->positions.clear();
+    if (quantize_positions) {
+        m.stream_flags |= STREAM_POSITION_16;
+        m.position_min = lo;
+        m.position_scale = scale;
+        streams->positions.reserve(vertex_count * 2);
+        for (size_t i = 0; i < vertex_count; ++i) {
+            uint32_t qx = QuantizeUnorm16(positions[i][0], lo.x, scale.x);
+            uint32_t qy = QuantizeUnorm16(positions[i][1], lo.y, scale.y);
+            uint32_t qz = QuantizeUnorm16(positions[i][2], lo.z, scale.z);
+            streams->positions.push_back(qx | (qy << 16));
+            streams->positions.push_back(qz);
+        }
+    } else {
+        streams->positions.reserve(vertex_count * 3);
+        for (size_t i = 0; i < vertex_count; ++i) {
+            for (int c = 0; c < 3; ++c) {
+                streams->positions.push_back(FloatBits(positions[i][c]));
             }
         }
-        // No padding for entities without UV - metadata will handle this
-    }
-    
-    // Create GPU buffer if we have UV data
-    if(!global_uv.empty()){
-        size_t buffer_size = global_uv.size() * sizeof(glm::vec2);
-        core_->CreateBuffer(buffer_size,
-                           grassland::graphics::BUFFER_TYPE_DYNAMIC,
-                           &global_uv_buffer_);
-        global_uv_buffer_->UploadData(global_uv.data(), buffer_size);
-        
-        grassland::LogInfo("Created global UV buffer with {} UV coordinates (no padding)", 
-                          global_uv.size());
     }
-}
 
-void Scene::ConstructMaterialIDBuffer(){
-    if(entities_.empty()){
-        return;
-    }
-    
-    std::vector<int> global_material_ids;
-    
-    // Calculate total triangles (only for entities with material IDs)
-    size_t total_triangles = 0;
-    for(const auto& entity : entities_){
-        if(entity->HasMaterialIDs()){
-            total_triangles += entity->GetNumTriangles();
+    // UVs
+    streams->uvs.clear();
+    m.uv_offset = -1;
+    if (entity.HasUVCoordinates()) {
+        const auto* uv_data = entity.GetUVCoordinates();
+        glm::vec2 uv_lo(FLT_MAX), uv_hi(-FLT_MAX);
+        for (size_t i = 0; i < vertex_count; ++i) {
+            glm::vec2 uv(uv_data[i][0], uv_data[i][1]);
+            uv_lo = glm::min(uv_lo, uv);
+            uv_hi = glm::max(uv_hi, uv);
         }
-    }
-    
-    // Reserve space to avoid reallocation
-    global_material_ids.reserve(total_triangles);
-    
-    // Collect material ID data from entities that have material IDs
-    for(const auto& entity : entities_){
-        if(entity->HasMaterialIDs()){
-            const int* material_ids = entity->GetMaterialIDs();
-            size_t num_triangles = entity->GetNumTriangles();
-            int material_offset = entity->GetMaterialOffset();
-            
-            // Add material offset to convert local IDs to global IDs
-            for(size_t i = 0; i < num_triangles; i++) {
-                global_material_ids.push_back(material_ids[i] + material_offset);
+        m.has_uv = 1;
+        glm::vec2 range = uv_hi - uv_lo;
+        bool quantize_uvs = compact_streams_ && vertex_count > 0;
+        if (quantize_uvs) {
+            int resolution = kMinUVErrorResolution;
+            auto add_textures = [this, &resolution](const Material& mat) {
+                resolution = std::max({resolution, virtual_textures_->GetTextureResolution(mat.texture_index),
+                                       virtual_textures_->GetTextureResolution(mat.normal_index)});
+            };
+            if (entity.HasMTLMaterials()) {
+                for (const auto& mat : entity.GetMaterials()) {
+                    add_textures(mat);
+                }
+            } else {
+                add_textures(entity.GetDefaultMaterial());
+            }
+            float max_error = 0.5f * std::max(range.x, range.y) / static_cast<float>(kMaxHalfWord);
+            quantize_uvs = max_error * resolution <= kUVErrorTolerance;
+        }
+        if (quantize_uvs) {
+            m.stream_flags |= STREAM_UV_16;
+            m.uv_min = uv_lo;
+            m.uv_scale = range / static_cast<float>(kMaxHalfWord);
+            streams->uvs.reserve(vertex_count);
+            for (size_t i = 0; i < vertex_count; ++i) {
+                streams->uvs.push_back(QuantizeUnorm16(uv_data[i][0], m.uv_min.x, m.uv_scale.x) |
+                                       (QuantizeUnorm16(uv_data[i][1], m.uv_min.y, m.uv_scale.y) << 16));
+            }
+        } else {
+            streams->uvs.reserve(vertex_count * 2);
+            for (size_t i = 0; i < vertex_count; ++i) {
+                streams->uvs.push_back(FloatBits(uv_data[i][0]));
+                streams->uvs.push_back(FloatBits(uv_data[i][1]));
             }
-            grassland::LogInfo("This entity has material IDs {} and offset {}", entity->HasMaterialIDs(), material_offset);
         }
-        else grassland::LogInfo("This entity does not have material ID");
-        // No padding for entities without material IDs - metadata will handle this
     }
-    
-    // Create GPU buffer if we have material ID data
-    if(!global_material_ids.empty()){
-        size_t buffer_size = global_material_ids.size() * sizeof(int);
-        core_->CreateBuffer(buffer_size,
-                           grassland::graphics::BUFFER_TYPE_DYNAMIC,
-                           &global_material_id_buffer_);
-        global_material_id_buffer_->UploadData(global_material_ids.data(), buffer_size);
-        
-        grassland::LogInfo("Created global Material ID buffer with {} material IDs (no padding)", 
-                          global_material_ids.size());
+
+    // Material IDs (global slots)
+    streams->material_ids.clear();
+    if (entity.HasMaterialIDs()) {
+        m.has_material_ids = 1;
+        const auto& slots = entity.GetMaterialSlots();
+        if (compact_streams_ && std::all_of(slots.begin(), slots.end(),
+                                            [](int slot) { return static_cast<uint32_t>(slot) <= kMaxHalfWord; })) {
+            m.stream_flags |= STREAM_MATERIAL_ID_16;
+        }
+        EncodeMaterialIDs(entity, m, &streams->material_ids);
+    } else {
+        // No material IDs - use the entity's material slot directly as the material index
+        m.material_id_offset = entity.GetMaterialSlot(0);
     }
-}
 
-void Scene::ConstructIndexBuffer(){
-    if(entities_.empty()){
-        return;
+    // Indices (local to the entity's vertices)
+    if (compact_streams_ && vertex_count <= kMaxHalfWord + 1) {
+        m.stream_flags |= STREAM_INDEX_16;
+        PackHalfWords(num_indices, [indices](size_t i) { return indices[i]; }, &streams->indices);
+    } else {
+        streams->indices.assign(indices, indices + num_indices);
     }
-    
-    std::vector<uint32_t> global_indices;
-    
-    // Calculate total indices
-    size_t total_indices = 0;
-    for(const auto& entity : entities_){
-        total_indices += entity->GetNumIndices();
+}
+
+bool Scene::EncodeMaterialIDs(const Entity& entity, const InstanceMetadata& metadata,
+                              std::vector<uint32_t>* words) const {
+    const int* material_ids = entity.GetMaterialIDs();
+    size_t count = metadata.triangle_count;
+    if (metadata.stream_flags & STREAM_MATERIAL_ID_16) {
+        for (size_t i = 0; i < count; ++i) {
+            if (static_cast<uint32_t>(entity.GetMaterialSlot(material_ids[i])) > kMaxHalfWord) {
+                return false;
+            }
+        }
+        PackHalfWords(count, [&](size_t i) { return static_cast<uint32_t>(entity.GetMaterialSlot(material_ids[i])); },
+                      words);
+    } else {
+        words->resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            (*words)[i] = static_cast<uint32_t>(entity.GetMaterialSlot(material_ids[i]));
+        }
     }
-    
-    // Reserve space to avoid reallocation
-    global_indices.reserve(total_indices);
-    
-    // Collect index data from all entities
-    for(const auto& entity : entities_){
-        const uint32_t* indices = entity->GetIndices();
-        size_t num_indices = entity->GetNumIndices();
-        
-        // Copy indices directly (no offset adjustment needed - UV buffer already handles vertex offsets)
-        for(size_t i = 0; i < num_indices; i++) {
-            global_indices.push_back(indices[i]);
-        }
-    }
-    grassland::LogInfo("Pending global index buffer creating with {} indices", global_indices.size());
-    // Create GPU buffer if we have index data
-    if(!global_indices.empty()){
-        size_t buffer_size = global_indices.size() * sizeof(uint32_t);
-        core_->CreateBuffer(buffer_size,
-                           grassland::graphics::BUFFER_TYPE_DYNAMIC,
-                           &global_index_buffer_);
-        global_index_buffer_->UploadData(global_indices.data(), buffer_size);
-        
-        grassland::LogInfo("Created global index buffer with {} indices", 
-                          global_indices.size());
-    }
-}
-
-void Scene::ConstructInstanceMetadataBuffer(){
-    if(entities_.empty()){
+    return true;
+}
+
+void Scene::ConstructGlobalBuffers() {
+    TRACE_SCOPE("Scene::ConstructGlobalBuffers");
+    if (entities_.empty()) {
         return;
     }
-    
+
+    std::vector<uint32_t> global_positions, global_uvs, global_material_ids, global_indices;
     instance_metadata_.clear();
     instance_metadata_.reserve(entities_.size());
-    
-    int uv_offset = 0;
-    int mat_id_offset = 0;
-    int index_offset = 0;  // Track index buffer offset
-    
-    for(const auto& entity : entities_){
+
+    EntityStreams streams;
+    for (const auto& entity : entities_) {
+        if (!entity->IsResident()) {
+            instance_metadata_.push_back(NonResidentMetadata(*entity));
+            continue;
+        }
         InstanceMetadata metadata;
-        metadata.padding[0] = 0;
-        
-        // UV information
-        if(entity->HasUVCoordinates()){
-            metadata.uv_offset = uv_offset;
-            metadata.has_uv = 1;
-            metadata.vertex_count = static_cast<int>(entity->GetNumVertices());
-            uv_offset += metadata.vertex_count;
-        } else {
-            metadata.uv_offset = -1;  // Mark as no UV
-            metadata.has_uv = 0;
-            metadata.vertex_count = 0;
-        }
-        
-        // Material ID information
-        if(entity->HasMaterialIDs()){
-            metadata.material_id_offset = mat_id_offset;
-            metadata.has_material_ids = 1;
-            metadata.triangle_count = static_cast<int>(entity->GetNumTriangles());
-            mat_id_offset += metadata.triangle_count;
-        } else {
-            // No material IDs - use material offset directly as the material index
-            metadata.material_id_offset = entity->GetMaterialOffset();
-            metadata.has_material_ids = 0;
-            metadata.triangle_count = 0;
-        }
-        
-        // Index buffer offset
-        metadata.index_offset = index_offset;
-        index_offset += static_cast<int>(entity->GetNumIndices());
-        
+        EncodeEntityStreams(*entity, &metadata, &streams);
+
+        metadata.position_offset = static_cast<int>(global_positions.size());
+        global_positions.insert(global_positions.end(), streams.positions.begin(), streams.positions.end());
+        if (metadata.has_uv) {
+            metadata.uv_offset = static_cast<int>(global_uvs.size());
+            global_uvs.insert(global_uvs.end(), streams.uvs.begin(), streams.uvs.end());
+        }
+        if (metadata.has_material_ids) {
+            metadata.material_id_offset = static_cast<int>(global_material_ids.size());
+            global_material_ids.insert(global_material_ids.end(), streams.material_ids.begin(), streams.material_ids.end());
+        }
+        metadata.index_offset = static_cast<int>(global_indices.size());
+        global_indices.insert(global_indices.end(), streams.indices.begin(), streams.indices.end());
+
         instance_metadata_.push_back(metadata);
     }
-    
-    // Create GPU buffer
+
+    // Create GPU buffers (only actual data, no padding)
+    auto upload = [this](std::unique_ptr<grassland::graphics::Buffer>& buffer, const std::vector<uint32_t>& words) {
+        buffer.reset();
+        if (!words.empty()) {
+            ReserveBuffer(buffer, 0, words.size() * sizeof(uint32_t));
+            buffer->UploadData(words.data(), words.size() * sizeof(uint32_t));
+        }
+    };
+    upload(global_position_buffer_, global_positions);
+    upload(global_uv_buffer_, global_uvs);
+    upload(global_material_id_buffer_, global_material_ids);
+    upload(global_index_buffer_, global_indices);
+    position_count_ = global_positions.size();
+    uv_count_ = global_uvs.size();
+    material_id_count_ = global_material_ids.size();
+    index_count_ = global_indices.size();
+
     size_t buffer_size = instance_metadata_.size() * sizeof(InstanceMetadata);
-    core_->CreateBuffer(buffer_size,
-                       grassland::graphics::BUFFER_TYPE_DYNAMIC,
-                       &instance_metadata_buffer_);
+    instance_metadata_buffer_.reset();
+    ReserveBuffer(instance_metadata_buffer_, 0, buffer_size);
     instance_metadata_buffer_->UploadData(instance_metadata_.data(), buffer_size);
-    
-    grassland::LogInfo("Created instance metadata buffer with {} entries", instance_metadata_.size());
+    restream_pending_ = false;
+
+    GeometryStreamStats stats = GetGeometryStreamStats();
+    grassland::LogInfo("Built global geometry streams for {} entities: {:.1f} KB ({:.1f} KB at full precision, "
+                       "{:.1f} KB saved, {} entities compact)",
+                       instance_metadata_.size(), stats.bytes / 1024.0, stats.full_precision_bytes / 1024.0,
+                       (stats.full_precision_bytes - stats.bytes) / 1024.0, stats.compact_entities);
 }
 
-grassland::graphics::Image* Scene::GetTexture(int index) const {
-    if (index < 0 || index >= static_cast<int>(textures_.size())) {
-        return nullptr;
+void Scene::AppendEntityData(Entity& entity) {
+    TRACE_SCOPE("Scene::AppendEntityData");
+    // Materials reuse existing identical slots; new ones go to the end of the material table
+    size_t first_new_slot = gpu_materials_.size();
+    std::vector<const Material*> entity_materials;
+    if (entity.HasMTLMaterials()) {
+        for (const auto& mat : entity.GetMaterials()) {
+            entity_materials.push_back(&mat);
+        }
+    } else {
+        entity_materials.push_back(&entity.GetDefaultMaterial());
     }
-    return textures_[index].get();
+    std::vector<int> slots;
+    for (const Material* mat : entity_materials) {
+        int slot = AcquireMaterialSlot(*mat);
+        if (slot >= static_cast<int>(gpu_materials_.size())) {
+            gpu_materials_.push_back(mat->ToGPUData());
+        }
+        slots.push_back(slot);
+    }
+    entity.SetMaterialSlots(std::move(slots));
+    if (gpu_materials_.size() > first_new_slot) {
+        size_t material_bytes = (gpu_materials_.size() - first_new_slot) * sizeof(MaterialGPUData);
+        ReserveBuffer(materials_buffer_, first_new_slot * sizeof(MaterialGPUData),
+                      gpu_materials_.size() * sizeof(MaterialGPUData));
+        materials_buffer_->UploadData(&gpu_materials_[first_new_slot], material_bytes,
+                                      first_new_slot * sizeof(MaterialGPUData));
+    }
+
+    // Streams, encoded with the slots assigned above
+    InstanceMetadata metadata = NonResidentMetadata(entity);
+    if (entity.IsResident()) {
+        AppendEntityStreams(entity, &metadata);
+    }
+
+    // Metadata entry
+    size_t metadata_index = instance_metadata_.size();
+    instance_metadata_.push_back(metadata);
+    ReserveBuffer(instance_metadata_buffer_, metadata_index * sizeof(InstanceMetadata),
+                  instance_metadata_.size() * sizeof(InstanceMetadata));
+    instance_metadata_buffer_->UploadData(&metadata, sizeof(InstanceMetadata),
+                                          metadata_index * sizeof(InstanceMetadata));
+
+    grassland::LogInfo("Appended entity {} to global buffers ({} vertices, {} indices, {} new materials)",
+                       metadata_index, metadata.vertex_count, entity.GetNumIndices(),
+                       gpu_materials_.size() - first_new_slot);
+}
+
+void Scene::AppendEntityStreams(const Entity& entity, InstanceMetadata* metadata) {
+    EntityStreams streams;
+    EncodeEntityStreams(entity, metadata, &streams);
+
+    auto append = [this](std::unique_ptr<grassland::graphics::Buffer>& buffer, size_t& count,
+                         const std::vector<uint32_t>& words) {
+        int offset = static_cast<int>(count);
+        if (!words.empty()) {
+            ReserveBuffer(buffer, count * sizeof(uint32_t), (count + words.size()) * sizeof(uint32_t));
+            buffer->UploadData(words.data(), words.size() * sizeof(uint32_t), count * sizeof(uint32_t));
+            count += words.size();
+        }
+        return offset;
+    };
+    metadata->position_offset = append(global_position_buffer_, position_count_, streams.positions);
+    if (metadata->has_uv) {
+        metadata->uv_offset = append(global_uv_buffer_, uv_count_, streams.uvs);
+    }
+    if (metadata->has_material_ids) {
+        metadata->material_id_offset = append(global_material_id_buffer_, material_id_count_, streams.material_ids);
+    }
+    metadata->index_offset = append(global_index_buffer_, index_count_, streams.indices);
 }
 
-grassland::graphics::Image* Scene::GetNormal(int index) const {
-    if(index < 0 || index >= static_cast<int>(normals_.size())) {
-        return nullptr;
+void Scene::UploadEntityMaterialIDs(size_t entity_index) {
+    const auto& entity = entities_[entity_index];
+    InstanceMetadata& metadata = instance_metadata_[entity_index];
+
+    if (!metadata.has_material_ids) {
+        metadata.material_id_offset = entity->GetMaterialSlot(0);
+        instance_metadata_buffer_->UploadData(&metadata, sizeof(InstanceMetadata),
+                                              entity_index * sizeof(InstanceMetadata));
+        return;
+    }
+
+    std::vector<uint32_t> words;
+    if (!EncodeMaterialIDs(*entity, metadata, &words)) {
+        // A new slot does not fit the entity's 16-bit IDs: pick the encodings again
+        restream_pending_ = true;
+        return;
     }
-    return normals_[index].get();
+    global_material_id_buffer_->UploadData(words.data(), words.size() * sizeof(uint32_t),
+                                           metadata.material_id_offset * sizeof(uint32_t));
+}
+
+bool Scene::NeedsCompaction() const {
+    // Compact once removed entities account for more than half of a buffer
+    auto wasteful = [](size_t garbage, size_t used) { return garbage > 0 && garbage * 2 > used; };
+    return restream_pending_ ||
+           wasteful(position_garbage_, position_count_) ||
+           wasteful(uv_garbage_, uv_count_) ||
+           wasteful(material_id_garbage_, material_id_count_) ||
+           wasteful(index_garbage_, index_count_) ||
+           wasteful(material_garbage_, gpu_materials_.size());
 }
+
+void Scene::CompactGlobalBuffers() {
+    TRACE_SCOPE("Scene::CompactGlobalBuffers");
+    grassland::LogInfo("Compacting global buffers ({} position, {} UV, {} material ID, {} index words and {} materials unused)",
+                       position_garbage_, uv_garbage_, material_id_garbage_, index_garbage_, material_garbage_);
+
+    // Textures are already loaded, only the packed buffers are rebuilt
+    AssignMaterialOffsets();
+    ConstructGlobalBuffers();
+    UpdateMaterialsBuffer();
+
+    position_garbage_ = uv_garbage_ = material_id_garbage_ = index_garbage_ = material_garbage_ = 0;
+}
+
+void Scene::SetGeometryBudget(size_t bytes) {
+    geometry_budget_ = bytes;
+    residency_stats_.budget_bytes = bytes;
+    residency_dirty_ = true;
+}
+
+size_t Scene::UpdateGeometryResidency(const glm::vec3& viewpoint) {
+    TRACE_SCOPE("Scene::UpdateGeometryResidency");
+    if (!residency_dirty_ && viewpoint == residency_viewpoint_) {
+        return 0;
+    }
+    residency_viewpoint_ = viewpoint;
+    residency_dirty_ = false;
+    size_t max_page_ins = built_ ? kMaxPageInsPerUpdate : SIZE_MAX;
+    size_t paged_in = 0;
+
+    if (geometry_budget_ == 0) {
+        // No budget (any more): everything becomes resident
+        for (size_t i = 0; i < entities_.size(); ++i) {
+            if (entities_[i]->IsResident()) {
+                continue;
+            }
+            if (paged_in == max_page_ins) {
+                residency_dirty_ = true;
+                break;
+            }
+            PageIn(i);
+            paged_in++;
+        }
+        return paged_in;
+    }
+
+    uint64_t update = ++residency_stats_.updates;
+
+    // Rank by bounding sphere radius over distance to the sphere (a proxy for
+    // the solid angle it covers from anywhere near the viewpoint, so geometry
+    // behind the camera that shows up in reflections and bounces still counts)
+    std::vector<std::pair<float, uint32_t>> ranking(entities_.size());
+    for (size_t i = 0; i < entities_.size(); ++i) {
+        const Entity& entity = *entities_[i];
+        const glm::mat4& transform = entity.GetTransform();
+        glm::vec3 center = glm::vec3(transform * glm::vec4(0.5f * (entity.GetBoundsMin() + entity.GetBoundsMax()), 1.0f));
+        float scale = std::max({glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+                                glm::length(glm::vec3(transform[2]))});
+        float radius = 0.5f * scale * glm::length(entity.GetBoundsMax() - entity.GetBoundsMin());
+        float distance = std::max(glm::length(center - viewpoint) - radius, 1e-4f);
+        float priority = HasEmission(entity) ? FLT_MAX : radius / distance;
+        ranking[i] = {priority, static_cast<uint32_t>(i)};
+    }
+    std::sort(ranking.begin(), ranking.end(), [](const auto& a, const auto& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    // Request the highest ranked entities that fit the budget together
+    size_t requested_bytes = 0;
+    std::vector<uint32_t> missing;
+    residency_stats_.requested_entities = 0;
+    for (const auto& [priority, i] : ranking) {
+        size_t bytes = EstimateGeometryBytes(*entities_[i]);
+        if (requested_bytes + bytes > geometry_budget_) {
+            continue;
+        }
+        requested_bytes += bytes;
+        residency_stats_.requested_entities++;
+        residency_[i].last_requested = update;
+        if (entities_[i]->IsResident()) {
+            residency_stats_.hits++;
+        } else {
+            missing.push_back(i);
+        }
+    }
+    if (missing.empty()) {
+        return 0;
+    }
+
+    // Entities not requested this time stay resident until their room is needed, least recently requested first
+    std::vector<uint32_t> candidates;
+    for (size_t i = 0; i < entities_.size(); ++i) {
+        if (entities_[i]->IsResident() && residency_[i].last_requested != update) {
+            candidates.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+        return residency_[a].last_requested < residency_[b].last_requested;
+    });
+
+    size_t next_candidate = 0;
+    for (uint32_t i : missing) {
+        if (paged_in == max_page_ins) {
+            residency_dirty_ = true;  // Continue on the next update
+            break;
+        }
+        size_t bytes = EstimateGeometryBytes(*entities_[i]);
+        while (residency_stats_.resident_bytes + bytes > geometry_budget_ && next_candidate < candidates.size()) {
+            Evict(candidates[next_candidate++]);
+        }
+        PageIn(i);
+        paged_in++;
+    }
+    return paged_in;
+}
+
+void Scene::PageIn(size_t index) {
+    TRACE_SCOPE("Scene::PageIn");
+    Entity& entity = *entities_[index];
+    if (!entity.BuildBLAS(core_)) {
+        return;  // Stays out of the TLAS
+    }
+
+    size_t bytes = EstimateGeometryBytes(entity);
+    residency_stats_.resident_bytes += bytes;
+    residency_stats_.resident_entities++;
+    residency_stats_.page_ins++;
+    residency_stats_.bytes_paged_in += bytes;
+    if (residency_[index].evicted) {
+        residency_stats_.reloads++;
+    }
+
+    if (built_) {
+        InstanceMetadata& metadata = instance_metadata_[index];
+        metadata = NonResidentMetadata(entity);
+        AppendEntityStreams(entity, &metadata);
+        instance_metadata_buffer_->UploadData(&metadata, sizeof(InstanceMetadata), index * sizeof(InstanceMetadata));
+        pending_updates_ |= SCENE_UPDATE_RESIDENCY | SCENE_UPDATE_GEOMETRY;
+        if (HasEmission(entity)) {
+            MarkEmittersDirty(index);
+        }
+    }
+}
+
+void Scene::Evict(size_t index) {
+    TRACE_SCOPE("Scene::Evict");
+    Entity& entity = *entities_[index];
+    if (built_) {
+        // Its ranges become holes in the global buffers, reclaimed by compaction
+        InstanceMetadata& metadata = instance_metadata_[index];
+        position_garbage_ += PositionWords(metadata);
+        uv_garbage_ += UVWords(metadata);
+        material_id_garbage_ += MaterialIDWords(metadata);
+        index_garbage_ += IndexWords(metadata);
+        metadata = NonResidentMetadata(entity);
+        instance_metadata_buffer_->UploadData(&metadata, sizeof(InstanceMetadata), index * sizeof(InstanceMetadata));
+        pending_updates_ |= SCENE_UPDATE_RESIDENCY | SCENE_UPDATE_GEOMETRY;
+        if (!entity_emitters_[index].triangles.empty()) {
+            MarkEmittersDirty(index);
+        }
+    }
+    entity.ReleaseGPUResources(&retired_);
+
+    residency_stats_.resident_bytes -= EstimateGeometryBytes(entity);
+    residency_stats_.resident_entities--;
+    residency_stats_.evictions++;
+    residency_[index].evicted = true;
+}
+
+void Scene::ReserveBuffer(std::unique_ptr<grassland::graphics::Buffer>& buffer,
+                          size_t used_bytes, size_t required_bytes) {
+    if (buffer && buffer->Size() >= required_bytes) {
+        return;
+    }
+
+    size_t capacity = std::max(kMinBufferCapacity, static_cast<size_t>(required_bytes * kBufferGrowthFactor));
+
+    // Carry over the data already in use (GPU buffers cannot be resized in place)
+    std::vector<uint8_t> old_data;
+    if (buffer) {
+        used_bytes = std::min(used_bytes, buffer->Size());
+    }
+    if (buffer && used_bytes > 0) {
+        old_data.resize(used_bytes);
+        buffer->DownloadData(old_data.data(), used_bytes, 0);
+    }
+
+    std::unique_ptr<grassland::graphics::Buffer> new_buffer;
+    core_->CreateBuffer(capacity, grassland::graphics::BUFFER_TYPE_DYNAMIC, &new_buffer);
+    if (!old_data.empty()) {
+        new_buffer->UploadData(old_data.data(), used_bytes, 0);
+    }
+    retired_.Retire(std::move(buffer));
+    buffer = std::move(new_buffer);
+}
+
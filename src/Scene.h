@@ -1,22 +1,96 @@
 #pragma once
 #include "long_march.h"
+#include "AliasTable.h"
 #include "Entity.h"
+#include "GpuRetireQueue.h"
 #include "Material.h"
+#include "MemoryReport.h"
+#include "VirtualTexture.h"
 #include <vector>
 #include <memory>
 #include <string>
 #include <unordered_map>
 
+// Encoding of an instance's ranges in the global streams (keep in sync with STREAM_* in shader.hlsl)
+enum StreamFlags : uint32_t {
+    STREAM_POSITION_16 = 1 << 0,     // 3 x 16-bit UNORM in the mesh AABB, 2 words per vertex (else 3 floats)
+    STREAM_UV_16 = 1 << 1,           // 2 x 16-bit UNORM in the mesh UV bounds, 1 word per vertex (else 2 floats)
+    STREAM_INDEX_16 = 1 << 2,        // Two indices per word (else one)
+    STREAM_MATERIAL_ID_16 = 1 << 3,  // Two material IDs per word (else one)
+};
+
 // Per-instance metadata for shader access (GPU-aligned)
+// All global streams are arrays of 32-bit words; offsets are in words.
 struct InstanceMetadata {
-    int uv_offset;              // Offset in global UV buffer (-1 if no UV)
-    int material_id_offset;     // Offset in global material ID buffer (or direct material index if no IDs)
+    int uv_offset;              // Offset in global UV stream (-1 if no UV)
+    int material_id_offset;     // Offset in global material ID stream (or direct material index if no IDs)
     int has_uv;                 // Boolean flag (0 or 1)
     int has_material_ids;       // Boolean flag (0 or 1)
-    int vertex_count;           // Number of vertices (0 if no UV)
-    int triangle_count;         // Number of triangles (0 if no material IDs)
-    int index_offset;           // Offset in global index buffer
-    int padding[1];             // Align to 32 bytes for GPU (reduced from 2 to 1)
+    int vertex_count;           // Number of vertices
+    int triangle_count;         // Number of triangles
+    int index_offset;           // Offset in global index stream
+    uint32_t stream_flags;      // StreamFlags
+    glm::vec3 position_min;     // Dequantization of 16-bit positions: min + q * scale
+    int position_offset;        // Offset in global position stream (object space)
+    glm::vec3 position_scale;
+    int padding;
+    glm::vec2 uv_min;           // Dequantization of 16-bit UVs
+    glm::vec2 uv_scale;
+};
+
+// Size of the global geometry streams, and what they would take at full precision
+struct GeometryStreamStats {
+    size_t bytes = 0;
+    size_t full_precision_bytes = 0;
+    size_t compact_entities = 0;  // Entities using at least one 16-bit stream
+};
+
+// Out-of-core geometry residency (see Scene::SetGeometryBudget). Bytes are
+// estimated per entity: BLAS inputs plus its global stream words at full
+// precision (acceleration structures themselves are not reported by the backend).
+struct GeometryResidencyStats {
+    size_t budget_bytes = 0;
+    size_t resident_bytes = 0;
+    size_t resident_entities = 0;
+    size_t requested_entities = 0;  // Entities the last update wanted resident
+    uint64_t updates = 0;
+    uint64_t hits = 0;              // Requests that found the entity resident
+    uint64_t page_ins = 0;
+    uint64_t reloads = 0;           // Page-ins of entities evicted earlier (the budget is too small to keep them)
+    uint64_t evictions = 0;
+    uint64_t bytes_paged_in = 0;
+};
+
+// World-space emissive triangle for next-event estimation (matches HLSL EmissiveTriangle)
+struct EmissiveTriangleGPU {
+    glm::vec3 p0;
+    float area;
+    glm::vec3 p1;
+    uint32_t entity;
+    glm::vec3 p2;
+    uint32_t primitive;
+    glm::vec3 emission;
+    float power;  // Luminance of the emission times area
+};
+
+// Emissive triangles of one entity: a range of the emissive triangle buffer
+// and of its alias table (alias indices are local to the range)
+struct EmitterGPU {
+    uint32_t first_triangle;
+    uint32_t triangle_count;
+    float power;
+    uint32_t padding;
+};
+
+// Bits returned by Scene::ApplyPendingUpdates() describing what changed on the GPU
+enum SceneUpdateFlags : uint32_t {
+    SCENE_UPDATE_NONE = 0,
+    SCENE_UPDATE_TLAS = 1 << 0,       // TLAS was rebuilt (entities added/removed)
+    SCENE_UPDATE_GEOMETRY = 1 << 1,   // Global position/UV/index/material ID buffers or metadata changed
+    SCENE_UPDATE_MATERIALS = 1 << 2,  // Material slots were added or edited
+    SCENE_UPDATE_LIGHTS = 1 << 3,     // Point lights were added after build
+    SCENE_UPDATE_EMITTERS = 1 << 4,   // Emissive triangle tables were updated
+    SCENE_UPDATE_RESIDENCY = 1 << 5,  // Entities were paged in or out (TLAS instances refit)
 };
 
 struct PointLight {
@@ -33,8 +107,14 @@ public:
     ~Scene();
 
     // Add an entity to the scene
+    // After BuildAccelerationStructures() the entity's data is appended to the global buffers
     void AddEntity(std::shared_ptr<Entity> entity);
 
+    // Remove an entity (swap-remove: the last entity takes over its index). After the
+    // build this is applied by the next ApplyPendingUpdates(), so it is safe to call
+    // while a frame is being recorded.
+    void RemoveEntity(size_t index);
+
     // Add a point light
     void AddPointLight(const PointLight &);
 
@@ -47,12 +127,56 @@ public:
     // Update TLAS instances (e.g., for animation)
     void UpdateInstances();
 
+    // Mark one material of an entity as edited; only its slot is re-uploaded
+    // (material_index is ignored for entities using their default material).
+    // Edits that leave the material's GPU data unchanged are ignored. GPU buffers
+    // change only in ApplyPendingUpdates(), so this is safe while a frame is recorded.
+    void MarkMaterialDirty(size_t entity_index, int material_index);
+
+    // Apply changes made since the last call (TLAS rebuild, material slot uploads,
+    // compaction of the global buffers). Returns a mask of SceneUpdateFlags.
+    // Call once per frame before recording it: GPU objects the scene dropped are
+    // released here once no frame in flight can reference them.
+    uint32_t ApplyPendingUpdates();
+
+    // Whether BuildAccelerationStructures() has been called
+    bool IsBuilt() const { return built_; }
+
+    // Store positions, UVs, indices and material IDs in 16 bits where the mesh
+    // allows it without visible error (on by default). Changing it after the
+    // build re-encodes the global streams on the next ApplyPendingUpdates().
+    void SetCompactStreams(bool enabled);
+    bool GetCompactStreams() const { return compact_streams_; }
+    GeometryStreamStats GetGeometryStreamStats() const;
+
+    // Out-of-core geometry: with a budget, an entity only has its GPU buffers,
+    // BLAS and global stream ranges while it ranks among the entities that
+    // matter most from the viewpoint given to UpdateGeometryResidency()
+    // (emissive entities first, then by bounding sphere radius over distance).
+    // The TLAS always covers the resident set and is refit, not rebuilt, when it changes.
+    // 0 keeps everything resident (default).
+    void SetGeometryBudget(size_t bytes);
+    size_t GetGeometryBudget() const { return geometry_budget_; }
+
+    // Request the entities that fit the budget for a viewpoint, page in the
+    // missing ones (at most kMaxPageInsPerUpdate once built) and evict the least
+    // recently requested ones to make room. Before BuildAccelerationStructures()
+    // it picks the initial set. Returns the number of entities paged in.
+    size_t UpdateGeometryResidency(const glm::vec3& viewpoint);
+    const GeometryResidencyStats& GetGeometryResidencyStats() const { return residency_stats_; }
+
+    // Entities (with their share of the global streams), global buffers and virtual textures
+    void AccumulateMemory(MemoryReport* report) const;
+
     // Get the TLAS for rendering
     grassland::graphics::AccelerationStructure* GetTLAS() const { return tlas_.get(); }
 
     // Get materials buffer for all entities
     grassland::graphics::Buffer* GetMaterialsBuffer() const { return materials_buffer_.get(); }
 
+    // Get global position buffer (object space, indexed through the global index buffer)
+    grassland::graphics::Buffer* GetGlobalPositionBuffer() const { return global_position_buffer_.get(); }
+
     // Get global UV buffer
     grassland::graphics::Buffer* GetGlobalUVBuffer() const { return global_uv_buffer_.get(); }
     
@@ -71,34 +195,87 @@ public:
     // Get number of entities
     size_t GetEntityCount() const { return entities_.size(); }
 
-    // Texture management
-    int LoadTexture(const std::string& filepath);  // Returns texture index
+    // Texture management (textures and normal maps share one virtual texture ID space)
+    int LoadTexture(const std::string& filepath);  // Returns virtual texture ID
     int LoadNormal(const std::string& filepath);
-    grassland::graphics::Image* GetTexture(int index) const;
-    grassland::graphics::Image* GetNormal(int index) const;
-    size_t GetTextureCount() const { return textures_.size(); }
-    size_t GetNormalCount() const { return normals_.size(); }
+    VirtualTextureSystem* GetVirtualTextures() const { return virtual_textures_.get(); }
+    // Stream in the texture pages requested by the last frame; returns the number loaded
+    size_t UpdateVirtualTextures();
 
     // Get all point lights
     const std :: vector<PointLight> & GetPointLights() const { return point_lights_; }
 
+    // Emissive triangles (updated for the entities whose emission, transform or
+    // residency changed, or that were added or removed). An entity is picked through the emitter alias table by power, then one of
+    // its triangles through the triangle alias table by area x luminance; the
+    // shader samples a uniform point on it.
+    size_t GetEmitterCount() const { return emitters_.size(); }
+    size_t GetEmissiveTriangleCount() const { return emissive_triangles_.size(); }
+    float GetEmissivePower() const { return emissive_power_; }
+    grassland::graphics::Buffer* GetEmissiveTriangleBuffer() const { return emissive_triangle_buffer_.get(); }
+    grassland::graphics::Buffer* GetEmissiveTriangleAliasBuffer() const { return emissive_triangle_alias_buffer_.get(); }
+    grassland::graphics::Buffer* GetEmitterBuffer() const { return emitter_buffer_.get(); }
+    grassland::graphics::Buffer* GetEmitterAliasBuffer() const { return emitter_alias_buffer_.get(); }
+
 
 private:
     void UpdateMaterialsBuffer();
     void AssignTextureIndices();  // Assign texture indices to materials
-    void AssignMaterialOffsets();  // Assign global material offset to each entity
-    void ConstructUVBuffer();
-    void ConstructMaterialIDBuffer();
-    void ConstructIndexBuffer();  // Build global index buffer
-    void ConstructInstanceMetadataBuffer();  // Build instance metadata buffer
+    void LoadEntityTextures(const std::vector<Entity*>& entities);  // Batch-load and assign texture indices
+    void AssignMaterialOffsets();  // Assign deduplicated global material slots to each entity
+    int AcquireMaterialSlot(const Material& material);  // Find or create the slot for a material
+    void ReleaseMaterialSlots(const Entity& entity);
+    void UploadEntityMaterialIDs(size_t entity_index);  // Re-upload one entity's material ID range
+    void EraseEntity(size_t index);  // Swap-remove an entity with its metadata, emitters and residency
+    void RebuildTLAS();
+    std::vector<grassland::graphics::RayTracingInstance> MakeInstances() const;
+    void CreatePlaceholderBLAS();  // Degenerate triangle standing in for non-resident entities
+
+    // Word streams of one entity, before placement in the global buffers
+    struct EntityStreams {
+        std::vector<uint32_t> positions;
+        std::vector<uint32_t> uvs;
+        std::vector<uint32_t> material_ids;
+        std::vector<uint32_t> indices;
+    };
+    // Pick the encodings for an entity and fill its metadata (except offsets) and streams
+    void EncodeEntityStreams(const Entity& entity, InstanceMetadata* metadata, EntityStreams* streams) const;
+    // Encode per-triangle material slots; false if they no longer fit the entity's encoding
+    bool EncodeMaterialIDs(const Entity& entity, const InstanceMetadata& metadata, std::vector<uint32_t>* words) const;
+    void ConstructGlobalBuffers();  // Build the global streams and instance metadata buffer
+    void BuildEmitters();           // Collect the emissive triangles of every entity
+    void UpdateEmitters();          // Redo the emitters of changed entities and upload the tables
+    void CollectEntityEmitters(size_t entity_index);
+    void MarkEmittersDirty(size_t entity_index);
+
+    // Incremental updates after build
+    void AppendEntityData(Entity& entity);  // Append one entity to the global buffers
+    // Append a resident entity's streams and fill the offsets of its metadata
+    void AppendEntityStreams(const Entity& entity, InstanceMetadata* metadata);
+    void CompactGlobalBuffers();            // Drop holes left by removed entities
+    bool NeedsCompaction() const;
+    // Residency changes of one entity (BLAS, buffers, metadata and stream ranges)
+    void PageIn(size_t index);
+    void Evict(size_t index);
+    // Grow buffer to hold at least required_bytes, keeping the first used_bytes (at most its size)
+    void ReserveBuffer(std::unique_ptr<grassland::graphics::Buffer>& buffer,
+                       size_t used_bytes, size_t required_bytes);
 
     grassland::graphics::Core* core_;
     std::vector<std::shared_ptr<Entity>> entities_;
     std::unique_ptr<grassland::graphics::AccelerationStructure> tlas_;
+    // Out-of-core scenes instance it (masked out) for every non-resident entity, so the
+    // TLAS keeps one instance per entity and paging only refits it
+    std::unique_ptr<grassland::graphics::AccelerationStructure> placeholder_blas_;
+    std::unique_ptr<grassland::graphics::Buffer> placeholder_vertex_buffer_;
+    std::unique_ptr<grassland::graphics::Buffer> placeholder_index_buffer_;
     std::unique_ptr<grassland::graphics::Buffer> materials_buffer_;
+    // Replaced buffers and TLASes and evicted entity resources, kept while frames in flight use them
+    GpuRetireQueue retired_;
     std::vector <PointLight> point_lights_;
     
     // Global buffers for all entities combined (only actual data, no padding)
+    std::unique_ptr<grassland::graphics::Buffer> global_position_buffer_;
     std::unique_ptr<grassland::graphics::Buffer> global_uv_buffer_;
     std::unique_ptr<grassland::graphics::Buffer> global_material_id_buffer_;
     std::unique_ptr<grassland::graphics::Buffer> global_index_buffer_;  // Global index buffer
@@ -106,11 +283,70 @@ private:
     
     // CPU-side instance metadata
     std::vector<InstanceMetadata> instance_metadata_;
+
+    // CPU-side copy of the materials buffer (one slot per unique material)
+    std::vector<MaterialGPUData> gpu_materials_;
+
+    // Material deduplication: identical materials share one slot
+    std::unordered_map<Material, int, MaterialHash, MaterialEqual> material_slot_lookup_;
+    std::vector<int> material_slot_refs_;     // Number of entity materials using each slot
+    std::vector<bool> material_slot_edited_;  // Edited in place, no longer matches its lookup key
+
+    // Used words of the global streams (buffers carry extra capacity)
+    size_t position_count_ = 0;
+    size_t uv_count_ = 0;
+    size_t material_id_count_ = 0;
+    size_t index_count_ = 0;
+
+    // Words left behind by removed entities, reclaimed by CompactGlobalBuffers()
+    size_t position_garbage_ = 0;
+    size_t uv_garbage_ = 0;
+    size_t material_id_garbage_ = 0;
+    size_t index_garbage_ = 0;
+    size_t material_garbage_ = 0;
+
+    bool compact_streams_ = true;
+    bool restream_pending_ = false;  // Encodings must be chosen again (toggle, material ID overflow)
+
+    // Dirty tracking
+    bool built_ = false;
+    uint32_t pending_updates_ = SCENE_UPDATE_NONE;
+    std::vector<int> dirty_material_slots_;
+    std::vector<size_t> material_id_dirty_entities_;  // Entities whose material IDs moved to split-off slots
+    std::vector<const Entity*> pending_removals_;     // Entities RemoveEntity() queued for the next update
     
-    // Texture management
-    std::vector<std::unique_ptr<grassland::graphics::Image>> textures_;
-    std::unordered_map<std::string, int> texture_path_to_index_;
-    //Normal management
-    std::vector<std::unique_ptr<grassland::graphics::Image>> normals_;
+    // Emissive triangles of one entity and their alias table, kept so that an
+    // update only redoes the entities that changed
+    struct EntityEmitters {
+        std::vector<EmissiveTriangleGPU> triangles;
+        std::vector<AliasEntry> alias;
+        float power = 0.0f;
+        bool dirty = true;
+    };
+    std::vector<EntityEmitters> entity_emitters_;  // Parallel to entities_
+
+    // Emissive triangles, grouped by entity
+    std::vector<EmissiveTriangleGPU> emissive_triangles_;
+    std::vector<EmitterGPU> emitters_;
+    float emissive_power_ = 0.0f;
+    std::unique_ptr<grassland::graphics::Buffer> emissive_triangle_buffer_;
+    std::unique_ptr<grassland::graphics::Buffer> emissive_triangle_alias_buffer_;
+    std::unique_ptr<grassland::graphics::Buffer> emitter_buffer_;
+    std::unique_ptr<grassland::graphics::Buffer> emitter_alias_buffer_;
+
+    // Texture and normal map pages, streamed on demand
+    std::unique_ptr<VirtualTextureSystem> virtual_textures_;
+
+    // Geometry residency
+    static constexpr size_t kMaxPageInsPerUpdate = 32;
+    struct EntityResidency {
+        uint64_t last_requested = 0;  // Update that last requested the entity
+        bool evicted = false;         // Paged out at least once
+    };
+    size_t geometry_budget_ = 0;
+    std::vector<EntityResidency> residency_;  // Parallel to entities_
+    glm::vec3 residency_viewpoint_{0.0f};
+    bool residency_dirty_ = true;             // Entities changed or page-ins were deferred
+    GeometryResidencyStats residency_stats_;
 };
 
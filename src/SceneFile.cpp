@@ -0,0 +1,391 @@
+#include "SceneFile.h"
+#include "Entity.h"
+#include "Json.h"
+#include "MappedFile.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+// Typed reads of JSON values into scene fields; the first mismatch is kept as the error
+class SceneReader {
+public:
+    explicit SceneReader(const std::string& source_name) : source_name_(source_name) {}
+
+    bool Ok() const { return error_.empty(); }
+    const std::string& GetError() const { return error_; }
+
+    void Fail(const JsonValue& value, const std::string& message) {
+        if (error_.empty()) {
+            error_ = "line " + std::to_string(value.line) + ": " + message;
+        }
+    }
+
+    bool Expect(const JsonValue& value, JsonValue::Type type, const std::string& what) {
+        if (value.type != type) {
+            Fail(value, what + " must be " + JsonValue::TypeName(type) + ", not " + value.TypeName());
+            return false;
+        }
+        return true;
+    }
+
+    float ReadFloat(const JsonValue& value, const std::string& what) {
+        return Expect(value, JsonValue::NUMBER, what) ? static_cast<float>(value.number) : 0.0f;
+    }
+
+    std::string ReadString(const JsonValue& value, const std::string& what) {
+        return Expect(value, JsonValue::STRING, what) ? value.string : std::string();
+    }
+
+    glm::vec3 ReadVec3(const JsonValue& value, const std::string& what) {
+        glm::vec3 v(0.0f);
+        if (Expect(value, JsonValue::ARRAY, what)) {
+            if (value.array.size() != 3) {
+                Fail(value, what + " must have 3 components");
+            } else {
+                for (int i = 0; i < 3; ++i) {
+                    v[i] = ReadFloat(value.array[i], what);
+                }
+            }
+        }
+        return v;
+    }
+
+    void WarnUnknown(const std::string& key, const JsonValue& value, const std::string& where) {
+        grassland::LogWarning("{}:{}: ignoring unknown key \"{}\" in {}", source_name_, value.line, key, where);
+    }
+
+    MaterialDescription ReadMaterial(const JsonValue& value) {
+        MaterialDescription material;
+        if (!Expect(value, JsonValue::OBJECT, "material")) {
+            return material;
+        }
+        for (const auto& [key, member] : value.object) {
+            if (key == "base_color") {
+                material.base_color = ReadVec3(member, key);
+            } else if (key == "roughness") {
+                material.roughness = ReadFloat(member, key);
+            } else if (key == "metallic") {
+                material.metallic = ReadFloat(member, key);
+            } else if (key == "emission") {
+                material.emission = ReadVec3(member, key);
+            } else if (key == "texture") {
+                material.texture = ReadString(member, key);
+            } else if (key == "normal_map") {
+                material.normal_map = ReadString(member, key);
+            } else {
+                WarnUnknown(key, member, "material");
+            }
+        }
+        return material;
+    }
+
+    EntityDescription ReadEntity(const JsonValue& value) {
+        EntityDescription entity;
+        if (!Expect(value, JsonValue::OBJECT, "entity")) {
+            return entity;
+        }
+        glm::vec3 position(0.0f), rotation(0.0f), scale(1.0f);
+        const JsonValue* matrix = nullptr;
+        for (const auto& [key, member] : value.object) {
+            if (key == "mesh") {
+                entity.mesh = ReadString(member, key);
+            } else if (key == "position") {
+                position = ReadVec3(member, key);
+            } else if (key == "rotation") {
+                rotation = ReadVec3(member, key);
+            } else if (key == "scale") {
+                scale = member.type == JsonValue::NUMBER ? glm::vec3(ReadFloat(member, key)) : ReadVec3(member, key);
+            } else if (key == "matrix") {
+                matrix = &member;
+            } else if (key == "material") {
+                entity.material = ReadMaterial(member);
+            } else if (key == "material_overrides") {
+                if (Expect(member, JsonValue::OBJECT, key)) {
+                    for (const auto& [name, fields] : member.object) {
+                        entity.material_overrides.emplace_back(name, ReadMaterial(fields));
+                    }
+                }
+            } else {
+                WarnUnknown(key, member, "entity");
+            }
+        }
+        if (entity.mesh.empty()) {
+            Fail(value, "entity has no \"mesh\"");
+        }
+
+        if (matrix) {
+            if (Expect(*matrix, JsonValue::ARRAY, "matrix") && matrix->array.size() != 16) {
+                Fail(*matrix, "matrix must have 16 components");
+            } else if (Ok()) {
+                for (int i = 0; i < 16; ++i) {
+                    entity.transform[i / 4][i % 4] = ReadFloat(matrix->array[i], "matrix");
+                }
+            }
+        } else {
+            glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+            transform = glm::rotate(transform, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+            transform = glm::rotate(transform, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+            transform = glm::rotate(transform, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+            entity.transform = glm::scale(transform, scale);
+        }
+        return entity;
+    }
+
+    PointLight ReadPointLight(const JsonValue& value) {
+        PointLight light;
+        if (!Expect(value, JsonValue::OBJECT, "point light")) {
+            return light;
+        }
+        for (const auto& [key, member] : value.object) {
+            if (key == "position") {
+                light.position = ReadVec3(member, key);
+            } else if (key == "color") {
+                light.color = ReadVec3(member, key);
+            } else {
+                WarnUnknown(key, member, "point light");
+            }
+        }
+        return light;
+    }
+
+    CameraDescription ReadCamera(const JsonValue& value) {
+        CameraDescription camera;
+        if (!Expect(value, JsonValue::OBJECT, "camera")) {
+            return camera;
+        }
+        for (const auto& [key, member] : value.object) {
+            if (key == "position") {
+                camera.position = ReadVec3(member, key);
+            } else if (key == "yaw") {
+                camera.yaw = ReadFloat(member, key);
+            } else if (key == "pitch") {
+                camera.pitch = ReadFloat(member, key);
+            } else if (key == "aperture") {
+                camera.aperture_size = ReadFloat(member, key);
+            } else if (key == "focal_distance") {
+                camera.focal_distance = ReadFloat(member, key);
+            } else {
+                WarnUnknown(key, member, "camera");
+            }
+        }
+        return camera;
+    }
+
+    void ReadScene(const JsonValue& root, SceneDescription* description) {
+        if (!Expect(root, JsonValue::OBJECT, "scene")) {
+            return;
+        }
+        for (const auto& [key, member] : root.object) {
+            if (key == "entities") {
+                if (Expect(member, JsonValue::ARRAY, key)) {
+                    for (const auto& entity : member.array) {
+                        description->entities.push_back(ReadEntity(entity));
+                    }
+                }
+            } else if (key == "point_lights") {
+                if (Expect(member, JsonValue::ARRAY, key)) {
+                    for (const auto& light : member.array) {
+                        description->point_lights.push_back(ReadPointLight(light));
+                    }
+                }
+            } else if (key == "skybox") {
+                description->skybox = ReadString(member, key);
+            } else if (key == "camera") {
+                description->camera = ReadCamera(member);
+            } else {
+                WarnUnknown(key, member, "scene");
+            }
+        }
+    }
+
+private:
+    std::string source_name_;
+    std::string error_;
+};
+
+// Texture sources of an entity's materials after overrides were applied
+std::vector<std::pair<std::string, TextureKind>> CollectTextures(const Entity& entity) {
+    std::vector<std::pair<std::string, TextureKind>> sources;
+    auto add = [&sources](const Material& mat) {
+        if (mat.HasTexture()) {
+            sources.emplace_back(mat.GetTexturePath(), TEXTURE_KIND_COLOR);
+        }
+        if (mat.HasNormal()) {
+            sources.emplace_back(mat.GetNormalPath(), TEXTURE_KIND_NORMAL);
+        }
+    };
+    if (entity.HasMTLMaterials()) {
+        for (const auto& mat : entity.GetMaterials()) {
+            add(mat);
+        }
+    } else {
+        add(entity.GetDefaultMaterial());
+    }
+    return sources;
+}
+}
+
+void MaterialDescription::ApplyTo(Material* material) const {
+    if (base_color) {
+        material->base_color = *base_color;
+    }
+    if (roughness) {
+        material->roughness = *roughness;
+    }
+    if (metallic) {
+        material->metallic = *metallic;
+    }
+    if (emission) {
+        material->emission = *emission;
+    }
+    if (texture) {
+        material->SetTexturePath(texture->empty() ? std::string() : grassland::FindAssetFile(*texture));
+    }
+    if (normal_map) {
+        material->SetNormalPath(normal_map->empty() ? std::string() : grassland::FindAssetFile(*normal_map));
+    }
+}
+
+bool SceneFile::Load(const std::string& path, SceneDescription* description) {
+    MappedFile file;
+    if (!file.Open(path)) {
+        grassland::LogError("Failed to open scene file {}", path);
+        return false;
+    }
+    std::string text(reinterpret_cast<const char*>(file.Data()), file.Size());
+    return Parse(text, path, description);
+}
+
+bool SceneFile::Parse(const std::string& text, const std::string& source_name, SceneDescription* description) {
+    JsonValue root;
+    std::string error;
+    if (!ParseJson(text, &root, &error)) {
+        grassland::LogError("{}: {}", source_name, error);
+        return false;
+    }
+
+    SceneDescription parsed;
+    SceneReader reader(source_name);
+    reader.ReadScene(root, &parsed);
+    if (!reader.Ok()) {
+        grassland::LogError("{}: {}", source_name, reader.GetError());
+        return false;
+    }
+    *description = std::move(parsed);
+    grassland::LogInfo("Parsed scene {}: {} entities, {} point lights", source_name,
+                       description->entities.size(), description->point_lights.size());
+    return true;
+}
+
+size_t SceneFile::Populate(const SceneDescription& description, Scene* scene, SceneLoadStats* stats) {
+    TRACE_SCOPE("SceneFile::Populate");
+    auto start = std::chrono::steady_clock::now();
+
+    // Texture cache entries shared by several entities are only encoded once
+    std::mutex claimed_mutex;
+    std::unordered_set<std::string> claimed_textures;
+    auto prebuild_textures = [&](const Entity& entity) {
+        if (!TextureCache::IsEnabled()) {
+            return;
+        }
+        std::vector<std::pair<std::string, TextureKind>> sources;
+        {
+            std::lock_guard<std::mutex> lock(claimed_mutex);
+            for (auto& source : CollectTextures(entity)) {
+                if (claimed_textures.insert(std::to_string(source.second) + ":" + source.first).second) {
+                    sources.push_back(std::move(source));
+                }
+            }
+        }
+        if (!sources.empty()) {
+            TextureCache::Prebuild(sources);
+        }
+    };
+
+    // Every mesh is parsed once, however many entities instance it
+    std::vector<std::string> mesh_paths;
+    std::unordered_map<std::string, size_t> mesh_index;
+    std::vector<size_t> instance_counts;
+    std::vector<size_t> entity_mesh(description.entities.size());
+    for (size_t i = 0; i < description.entities.size(); ++i) {
+        auto [it, inserted] = mesh_index.emplace(description.entities[i].mesh, mesh_paths.size());
+        if (inserted) {
+            mesh_paths.push_back(description.entities[i].mesh);
+            instance_counts.push_back(0);
+        }
+        entity_mesh[i] = it->second;
+        instance_counts[it->second]++;
+    }
+    std::vector<std::shared_ptr<Entity>> meshes(mesh_paths.size());
+    ThreadPool::Global().ParallelFor(meshes.size(), [&](size_t m) {
+        auto mesh = std::make_shared<Entity>(mesh_paths[m]);
+        if (!mesh->IsValid()) {
+            return;
+        }
+        // Encode its textures now rather than after every mesh has loaded
+        prebuild_textures(*mesh);
+        meshes[m] = std::move(mesh);
+    });
+
+    std::vector<std::shared_ptr<Entity>> entities(description.entities.size());
+    ThreadPool::Global().ParallelFor(entities.size(), [&](size_t i) {
+        const EntityDescription& desc = description.entities[i];
+        const std::shared_ptr<Entity>& mesh = meshes[entity_mesh[i]];
+        if (!mesh) {
+            return;
+        }
+        Material default_material;
+        desc.material.ApplyTo(&default_material);
+        // The only instance of a mesh takes the loaded entity itself, the others copy it untouched
+        std::shared_ptr<Entity> entity;
+        if (instance_counts[entity_mesh[i]] == 1) {
+            entity = mesh;
+            entity->SetDefaultMaterial(default_material);
+            entity->SetTransform(desc.transform);
+        } else {
+            entity = std::make_shared<Entity>(*mesh, default_material, desc.transform);
+        }
+
+        for (const auto& [name, overrides] : desc.material_overrides) {
+            auto it = entity->GetMaterialNameMap().find(name);
+            if (it == entity->GetMaterialNameMap().end()) {
+                grassland::LogWarning("Mesh {} has no material named \"{}\"", desc.mesh, name);
+                continue;
+            }
+            overrides.ApplyTo(&entity->GetMutableMaterials()[it->second]);
+        }
+
+        // Textures set by material overrides (the mesh's own are claimed already)
+        prebuild_textures(*entity);
+        entities[i] = std::move(entity);
+    });
+
+    auto loaded = std::chrono::steady_clock::now();
+
+    // BLAS creation and registration stay on this thread, in file order
+    size_t added = 0;
+    for (size_t i = 0; i < entities.size(); ++i) {
+        if (!entities[i]) {
+            grassland::LogError("Skipping entity {} ({}): mesh failed to load", i, description.entities[i].mesh);
+            continue;
+        }
+        scene->AddEntity(entities[i]);
+        added++;
+    }
+    for (const auto& light : description.point_lights) {
+        scene->AddPointLight(light);
+    }
+
+    if (stats) {
+        auto end = std::chrono::steady_clock::now();
+        stats->mesh_load_seconds = std::chrono::duration<double>(loaded - start).count();
+        stats->blas_build_seconds = std::chrono::duration<double>(end - loaded).count();
+    }
+    return added;
+}
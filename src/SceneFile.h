@@ -0,0 +1,78 @@
+#pragma once
+#include "Scene.h"
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Material fields set by a scene file; unset fields keep the mesh's own values
+struct MaterialDescription {
+    std::optional<glm::vec3> base_color;
+    std::optional<float> roughness;
+    std::optional<float> metallic;
+    std::optional<glm::vec3> emission;
+    std::optional<std::string> texture;
+    std::optional<std::string> normal_map;
+
+    void ApplyTo(Material* material) const;
+};
+
+struct EntityDescription {
+    std::string mesh;                 // OBJ path, relative to the asset directory
+    glm::mat4 transform{1.0f};
+    MaterialDescription material;     // Applied to the default material (used when the mesh has no MTL)
+    std::vector<std::pair<std::string, MaterialDescription>> material_overrides;  // MTL material name -> fields
+};
+
+struct CameraDescription {
+    glm::vec3 position{0.0f, 1.0f, 5.0f};
+    float yaw = -90.0f;  // Degrees, -90 looks down -Z
+    float pitch = 0.0f;
+    float aperture_size = 0.0f;
+    float focal_distance = 3.0f;
+};
+
+struct SceneDescription {
+    std::vector<EntityDescription> entities;
+    std::vector<PointLight> point_lights;
+    std::string skybox;                    // Empty keeps the application's skybox
+    std::optional<CameraDescription> camera;
+};
+
+// Wall-clock time of the loading stages of Populate()
+struct SceneLoadStats {
+    double mesh_load_seconds = 0.0;   // Parallel mesh loading and texture cache encoding
+    double blas_build_seconds = 0.0;  // Per-entity BLAS builds while adding to the scene
+};
+
+// JSON scene description:
+//
+//   {
+//     "skybox": "meshes/background1.hdr",
+//     "camera": { "position": [0, 1, 5], "yaw": -90, "pitch": 0, "aperture": 0, "focal_distance": 3 },
+//     "entities": [
+//       { "mesh": "meshes/cube.obj", "position": [0, -2, 0], "rotation": [0, 45, 0], "scale": [10, 0.1, 10],
+//         "material": { "base_color": [0.5, 0.5, 0.5], "roughness": 0, "metallic": 0, "emission": [0, 0, 0] },
+//         "material_overrides": { "Glass": { "roughness": 0.05 } } }
+//     ],
+//     "point_lights": [ { "position": [0, 0.7, 0], "color": [3, 2, 1] } ]
+//   }
+//
+// Rotations are XYZ Euler angles in degrees; "matrix" (16 numbers, column
+// major) may replace position/rotation/scale. Unknown keys are reported so
+// typos do not silently change a benchmark scene.
+class SceneFile {
+public:
+    // Parse a scene file; logs the line and column of the first error
+    static bool Load(const std::string& path, SceneDescription* description);
+    static bool Parse(const std::string& text, const std::string& source_name, SceneDescription* description);
+
+    // Load every entity of the description and add them to the scene in file
+    // order. Meshes (OBJ/MTL parsing, welding, reordering) load in parallel on
+    // the global thread pool, once per distinct path however many entities
+    // instance them, and each one starts encoding the texture cache entries of
+    // its materials as soon as it is parsed, so disk and decode work overlap
+    // instead of running one asset after another. Returns the number of
+    // entities added; failed meshes are skipped.
+    static size_t Populate(const SceneDescription& description, Scene* scene, SceneLoadStats* stats = nullptr);
+};
@@ -0,0 +1,178 @@
+#include "ShaderCache.h"
+#include "MappedFile.h"
+#include "Trace.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach-o/dyld.h>
+#endif
+
+namespace {
+// Bump when the file layout changes
+constexpr uint32_t kCacheVersion = 2;
+
+std::string g_cache_directory = "shader_cache";
+bool g_cache_enabled = true;
+
+std::filesystem::path GetExecutablePath() {
+#ifdef _WIN32
+    wchar_t buffer[MAX_PATH];
+    DWORD length = GetModuleFileNameW(nullptr, buffer, MAX_PATH);
+    return length > 0 && length < MAX_PATH ? std::filesystem::path(std::wstring(buffer, length))
+                                           : std::filesystem::path();
+#elif defined(__APPLE__)
+    char buffer[4096];
+    uint32_t size = sizeof(buffer);
+    return _NSGetExecutablePath(buffer, &size) == 0 ? std::filesystem::path(buffer) : std::filesystem::path();
+#else
+    std::error_code ec;
+    std::filesystem::path path = std::filesystem::read_symlink("/proc/self/exe", ec);
+    return ec ? std::filesystem::path() : path;
+#endif
+}
+
+// "<size>:<mtime>" of a file, empty if it does not exist
+std::string FileStamp(const std::filesystem::path& path) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    if (ec) return {};
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec) return {};
+    return std::to_string(size) + ":" + std::to_string(mtime.time_since_epoch().count());
+}
+
+std::string GetCachePath(uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.smsc", static_cast<unsigned long long>(key));
+    return (std::filesystem::path(g_cache_directory) / name).string();
+}
+
+bool ReadCachedLibrary(const std::string& path, uint64_t key, std::vector<uint8_t>* data) {
+    MappedFile file;
+    if (!file.Open(path) || file.Size() < sizeof(ShaderCacheHeader)) {
+        return false;
+    }
+    ShaderCacheHeader header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+    if (std::memcmp(header.magic, "SMSC", 4) != 0 || header.version != kCacheVersion || header.key != key ||
+        header.data_size != file.Size() - sizeof(header)) {
+        return false;
+    }
+    const uint8_t* begin = file.Data() + sizeof(header);
+    if (HashBytes(begin, header.data_size) != header.data_hash) {
+        grassland::LogWarning("Ignoring corrupted shader cache file {}", path);
+        return false;
+    }
+    data->assign(begin, begin + header.data_size);
+    return true;
+}
+
+bool WriteCachedLibrary(const std::string& path, uint64_t key, const std::vector<uint8_t>& data) {
+    ShaderCacheHeader header{};
+    std::memcpy(header.magic, "SMSC", 4);
+    header.version = kCacheVersion;
+    header.key = key;
+    header.data_size = data.size();
+    header.data_hash = HashBytes(data.data(), data.size());
+
+    // Worker processes started together compile concurrently and may store the same library
+    std::string error;
+    if (!WriteFileAtomically(path, {{&header, sizeof(header)}, {data.data(), data.size()}}, &error)) {
+        grassland::LogWarning("Cannot write shader cache file {}: {}", path, error);
+        return false;
+    }
+    return true;
+}
+}  // namespace
+
+void ShaderCache::SetDirectory(const std::string& directory) {
+    g_cache_directory = directory;
+}
+
+const std::string& ShaderCache::GetDirectory() {
+    return g_cache_directory;
+}
+
+void ShaderCache::SetEnabled(bool enabled) {
+    g_cache_enabled = enabled;
+}
+
+bool ShaderCache::IsEnabled() {
+    return g_cache_enabled;
+}
+
+const std::string& ShaderCache::GetCompilerIdentity() {
+    static const std::string identity = []() {
+        std::filesystem::path executable = GetExecutablePath();
+        if (executable.empty()) {
+            return std::string();
+        }
+        std::string stamp = "exe=" + FileStamp(executable);
+        for (const char* library : {"dxcompiler.dll", "libdxcompiler.so", "libdxcompiler.dylib"}) {
+            std::string library_stamp = FileStamp(executable.parent_path() / library);
+            if (!library_stamp.empty()) {
+                stamp += std::string("|") + library + "=" + library_stamp;
+            }
+        }
+        return stamp;
+    }();
+    return identity;
+}
+
+bool ShaderCache::CompileLibrary(grassland::graphics::BackendAPI api, const std::string& source,
+                                 const std::string& target, const std::vector<std::string>& entry_points,
+                                 std::vector<grassland::graphics::CompiledShaderBlob>* blobs, bool* cache_hit) {
+    TRACE_SCOPE("ShaderCache::CompileLibrary");
+    if (cache_hit) {
+        *cache_hit = false;
+    }
+    if (entry_points.empty()) {
+        return false;
+    }
+
+    // Without a compiler identity a stale library could never be told apart, so don't cache
+    const std::string& compiler = GetCompilerIdentity();
+    bool use_cache = g_cache_enabled && !compiler.empty();
+    std::string key_text = target + "|" + std::to_string(api) + "|" + compiler + "|" +
+                           std::to_string(HashBytes(source.data(), source.size())) + "|" +
+                           std::to_string(source.size());
+    uint64_t key = HashBytes(key_text.data(), key_text.size());
+    std::string cache_path = GetCachePath(key);
+
+    std::vector<uint8_t> library;
+    if (use_cache && ReadCachedLibrary(cache_path, key, &library)) {
+        grassland::LogInfo("Loaded {} shader library from {} ({} KB)", target, cache_path, library.size() / 1024);
+        if (cache_hit) {
+            *cache_hit = true;
+        }
+    } else {
+        grassland::graphics::CompiledShaderBlob blob;
+        if (grassland::graphics::CompileShader(source, entry_points.front(), target, &blob) != 0 ||
+            blob.data.empty()) {
+            grassland::LogError("Failed to compile {} shader library", target);
+            return false;
+        }
+        library = std::move(blob.data);
+        if (use_cache && WriteCachedLibrary(cache_path, key, library)) {
+            grassland::LogInfo("Cached {} shader library as {} ({} KB)", target, cache_path, library.size() / 1024);
+        }
+    }
+
+    blobs->resize(entry_points.size());
+    for (size_t i = 0; i < entry_points.size(); ++i) {
+        (*blobs)[i].data = library;
+        (*blobs)[i].entry_point = entry_points[i];
+    }
+    return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "long_march.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk layout of a cache file: header followed by the compiled library
+struct ShaderCacheHeader {
+    char magic[4];       // "SMSC"
+    uint32_t version;
+    uint64_t key;        // Full key hash (the file name is derived from it too)
+    uint64_t data_size;
+    uint64_t data_hash;  // Rejects truncated or corrupted files
+};
+
+// Compiled shader libraries cached on disk. A ray tracing library (lib_*
+// target) exports all of its entry points, so the source is compiled once
+// and every entry point gets a blob sharing that bytecode. Cache files are
+// keyed by a hash of the source, the target profile, the backend and the
+// compiler identity; any change to them is a miss and recompiles.
+class ShaderCache {
+public:
+    static void SetDirectory(const std::string& directory);
+    static const std::string& GetDirectory();
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled();
+
+    // Compile source once for target (or load it from the cache) and return one
+    // blob per entry point, in order. cache_hit is set when nothing was compiled.
+    static bool CompileLibrary(grassland::graphics::BackendAPI api, const std::string& source,
+                               const std::string& target, const std::vector<std::string>& entry_points,
+                               std::vector<grassland::graphics::CompiledShaderBlob>* blobs,
+                               bool* cache_hit = nullptr);
+
+    // Stands in for the compiler version, which the graphics library does not
+    // expose: size and modification time of the executable (the compiler is
+    // linked into it) and of a DXC shared library next to it, if any
+    static const std::string& GetCompilerIdentity();
+};
@@ -0,0 +1,300 @@
+#include "ShardedRender.h"
+#include "app.h"
+#include "FilmCheckpoint.h"
+#include "MeshCache.h"
+#include "Trace.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// Lines a worker writes to its stdout for the coordinator; anything else
+// there (e.g. log output) is ignored
+constexpr const char* kProgressMessage = "@shard-progress";
+constexpr const char* kDoneMessage = "@shard-done";
+
+#ifdef _WIN32
+FILE* OpenPipe(const std::string& command) {
+    // cmd.exe strips the outer quotes of the whole command line
+    return _popen(("\"" + command + "\"").c_str(), "r");
+}
+int ClosePipe(FILE* pipe) {
+    return _pclose(pipe);
+}
+#else
+FILE* OpenPipe(const std::string& command) {
+    return popen(command.c_str(), "r");
+}
+int ClosePipe(FILE* pipe) {
+    return pclose(pipe);
+}
+#endif
+
+std::string Quote(const std::string& argument) {
+    return "\"" + argument + "\"";
+}
+
+const char* ApiFlag(grassland::graphics::BackendAPI api) {
+    if (api == grassland::graphics::BACKEND_API_VULKAN) {
+        return " --vulkan";
+    }
+    if (api == grassland::graphics::BACKEND_API_D3D12) {
+        return " --d3d12";
+    }
+    return "";
+}
+
+struct WorkerState {
+    SampleRange range;
+    std::string partial_path;
+    FILE* pipe = nullptr;
+    std::thread reader;
+    int samples_done = 0;
+    bool finished = false;  // Pipe closed
+    bool succeeded = false; // Reported done and exited cleanly
+};
+
+// Sum of the partial films written so far (missing ones are skipped unless all are required)
+bool MergePartials(const std::vector<std::unique_ptr<WorkerState>>& workers, bool require_all, FilmData* merged) {
+    std::vector<std::string> paths;
+    for (const auto& worker : workers) {
+        if (require_all || std::filesystem::exists(worker->partial_path)) {
+            paths.push_back(worker->partial_path);
+        }
+    }
+    FilmCheckpointInfo info;
+    return !paths.empty() && FilmCheckpoint::Merge(paths, merged, &info);
+}
+
+std::shared_ptr<grassland::graphics::Core> CreateFilmCore(grassland::graphics::BackendAPI api) {
+    std::shared_ptr<grassland::graphics::Core> core;
+    grassland::graphics::CreateCore(api, grassland::graphics::Core::Settings{}, &core);
+    core->InitializeLogicalDeviceAutoSelect(true);
+    return core;
+}
+}  // namespace
+
+std::vector<SampleRange> ShardedRender::SplitSamples(int spp, int count) {
+    std::vector<SampleRange> ranges;
+    int first = 0;
+    for (int i = 0; i < count; ++i) {
+        int size = spp / count + (i < spp % count ? 1 : 0);
+        if (size > 0) {
+            ranges.push_back({first, size});
+        }
+        first += size;
+    }
+    return ranges;
+}
+
+int ShardedRender::RunCoordinator(const ShardSettings& settings) {
+    if (settings.width <= 0 || settings.height <= 0 || settings.spp <= 0 || settings.workers <= 0 ||
+        settings.update_interval <= 0 || settings.executable.empty()) {
+        grassland::LogError("Invalid sharded render settings: {}x{}, {} spp, {} workers",
+                            settings.width, settings.height, settings.spp, settings.workers);
+        return 1;
+    }
+    TRACE_THREAD_NAME("coordinator");
+    auto start = Clock::now();
+    std::error_code ec;
+    std::filesystem::create_directories(settings.work_directory, ec);
+
+    // The merged film is developed on this process's device; no scene is loaded here
+    std::shared_ptr<grassland::graphics::Core> core = CreateFilmCore(settings.api);
+    Film film(core.get(), settings.width, settings.height);
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::unique_ptr<WorkerState>> workers;
+    for (const SampleRange& range : SplitSamples(settings.spp, settings.workers)) {
+        auto worker = std::make_unique<WorkerState>();
+        worker->range = range;
+        worker->partial_path = (std::filesystem::path(settings.work_directory) /
+                                ("shard_" + std::to_string(workers.size()) + ".ckpt")).string();
+        std::filesystem::remove(worker->partial_path, ec);
+
+        std::ostringstream command;
+        command << Quote(settings.executable) << " --shard-worker" << ApiFlag(settings.api)
+                << " --width " << settings.width << " --height " << settings.height
+                << " --first-sample " << range.first << " --spp " << range.count
+                << " --update " << settings.update_interval << " --partial " << Quote(worker->partial_path);
+        if (!settings.scene_path.empty()) {
+            command << " --scene " << Quote(settings.scene_path);
+        }
+        if (settings.geometry_budget_mb > 0) {
+            command << " --geometry-budget " << settings.geometry_budget_mb;
+        }
+        worker->pipe = OpenPipe(command.str());
+        if (!worker->pipe) {
+            grassland::LogError("Failed to start worker: {}", command.str());
+            worker->finished = true;
+            workers.push_back(std::move(worker));
+            continue;
+        }
+        grassland::LogInfo("Started worker {} for samples [{}, {})", workers.size(), range.first,
+                           range.first + range.count);
+
+        // Blocking reads, one thread per pipe
+        WorkerState* state = worker.get();
+        worker->reader = std::thread([state, &mutex, &changed] {
+            TRACE_THREAD_NAME("shard reader");
+            char line[512];
+            bool done = false;
+            while (std::fgets(line, sizeof(line), state->pipe)) {
+                std::istringstream message(line);
+                std::string tag;
+                int samples = 0;
+                if (!(message >> tag >> samples) || (tag != kProgressMessage && tag != kDoneMessage)) {
+                    continue;
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                state->samples_done = samples;
+                done |= tag == kDoneMessage;
+                changed.notify_all();
+            }
+            int status = ClosePipe(state->pipe);
+            std::lock_guard<std::mutex> lock(mutex);
+            state->finished = true;
+            state->succeeded = done && status == 0;
+            changed.notify_all();
+        });
+        workers.push_back(std::move(worker));
+    }
+
+    // Report progress (and refresh the preview) while the workers render
+    auto last_preview = Clock::now();
+    int last_total = -1;
+    while (true) {
+        int total = 0;
+        bool all_finished = true;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait_for(lock, std::chrono::seconds(1));
+            for (const auto& worker : workers) {
+                total += worker->samples_done;
+                all_finished &= worker->finished;
+            }
+        }
+        if (all_finished) {
+            break;
+        }
+        if (total == last_total) {
+            continue;
+        }
+        last_total = total;
+        grassland::LogInfo("Sharded render: {} / {} spp ({:.1f} s)", total, settings.spp,
+                           std::chrono::duration<double>(Clock::now() - start).count());
+        if (!settings.preview_path.empty() && Clock::now() - last_preview > std::chrono::seconds(2)) {
+            FilmData merged;
+            if (MergePartials(workers, false, &merged) && film.Upload(merged)) {
+                film.SavePng(settings.preview_path);
+            }
+            last_preview = Clock::now();
+        }
+    }
+
+    bool succeeded = true;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        if (workers[i]->reader.joinable()) {
+            workers[i]->reader.join();
+        }
+        if (!workers[i]->succeeded) {
+            grassland::LogError("Worker {} failed after {} of {} samples", i, workers[i]->samples_done,
+                                workers[i]->range.count);
+            succeeded = false;
+        }
+    }
+    if (!succeeded) {
+        return 1;
+    }
+
+    FilmData merged;
+    if (!MergePartials(workers, true, &merged) || !film.Upload(merged) || !film.SavePng(settings.image_path)) {
+        return 1;
+    }
+    for (const auto& worker : workers) {
+        std::filesystem::remove(worker->partial_path, ec);
+    }
+    grassland::LogInfo("Sharded render: {} spp at {}x{} with {} workers in {:.3f} s, written to {}",
+                       merged.sample_count, settings.width, settings.height, workers.size(),
+                       std::chrono::duration<double>(Clock::now() - start).count(), settings.image_path);
+    return 0;
+}
+
+int ShardedRender::RunWorker(const ShardWorkerSettings& settings) {
+    if (settings.width <= 0 || settings.height <= 0 || settings.samples <= 0 || settings.first_sample < 0 ||
+        settings.update_interval <= 0 || settings.partial_path.empty()) {
+        grassland::LogError("Invalid shard worker settings: {}x{}, samples [{}, +{})",
+                            settings.width, settings.height, settings.first_sample, settings.samples);
+        return 1;
+    }
+    TRACE_THREAD_NAME("main");
+
+    Application app{settings.api};
+    app.SetHeadless(settings.width, settings.height);
+    if (!settings.scene_path.empty()) {
+        app.SetScenePath(settings.scene_path);
+    }
+    app.SetFirstSample(static_cast<uint32_t>(settings.first_sample));
+    if (settings.geometry_budget_mb > 0) {
+        MeshCache::SetEnabled(true);
+        app.SetGeometryBudget(static_cast<size_t>(settings.geometry_budget_mb) << 20);
+    }
+    app.OnInit();
+    while (app.IsLoadingAssets()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        app.OnUpdate();
+    }
+
+    app.GetFilm()->Reset();
+    FilmData data;
+    for (int i = 1; i <= settings.samples; ++i) {
+        app.OnUpdate();
+        app.OnRender();
+        if (i % settings.update_interval != 0 && i != settings.samples) {
+            continue;
+        }
+        app.GetFilm()->Download(&data);  // Waits for the frame
+        if (!FilmCheckpoint::Write(settings.partial_path, data, app.GetCheckpointInfo(), false)) {
+            app.OnClose();
+            return 1;
+        }
+        std::cout << kProgressMessage << " " << i << std::endl;
+    }
+    std::cout << kDoneMessage << " " << settings.samples << std::endl;
+
+    app.OnClose();
+    return 0;
+}
+
+int ShardedRender::RunMerge(const MergeSettings& settings) {
+    FilmData merged;
+    FilmCheckpointInfo info;
+    if (settings.inputs.empty() || !FilmCheckpoint::Merge(settings.inputs, &merged, &info)) {
+        grassland::LogError("Nothing merged");
+        return 1;
+    }
+    grassland::LogInfo("Merged {} checkpoints: {} samples at {}x{}", settings.inputs.size(), merged.sample_count,
+                       merged.width, merged.height);
+    if (!settings.checkpoint_path.empty() &&
+        !FilmCheckpoint::Write(settings.checkpoint_path, merged, info, settings.compress)) {
+        return 1;
+    }
+    if (!settings.image_path.empty()) {
+        std::shared_ptr<grassland::graphics::Core> core = CreateFilmCore(settings.api);
+        Film film(core.get(), merged.width, merged.height);
+        if (!film.Upload(merged) || !film.SavePng(settings.image_path)) {
+            return 1;
+        }
+    }
+    return 0;
+}
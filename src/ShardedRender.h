@@ -0,0 +1,65 @@
+#pragma once
+#include "long_march.h"
+#include <string>
+#include <vector>
+
+struct ShardSettings {
+    grassland::graphics::BackendAPI api = grassland::graphics::BACKEND_API_DEFAULT;
+    std::string scene_path;              // Empty renders the built-in scene
+    int width = 1920;
+    int height = 1080;
+    int spp = 256;                       // Samples per pixel of the whole render
+    int workers = 2;                     // Local worker processes, each renders a sample range
+    int update_interval = 16;            // Samples between partial results of a worker
+    std::string image_path = "render.png";
+    std::string preview_path;            // Optional PNG rewritten from the partials as they arrive
+    std::string work_directory = "shards";  // Partial films (checkpoints) of the workers
+    int geometry_budget_mb = 0;          // Out-of-core geometry in the workers (0: everything resident)
+    std::string executable;              // Program to start the workers with (argv[0])
+};
+
+struct ShardWorkerSettings {
+    grassland::graphics::BackendAPI api = grassland::graphics::BACKEND_API_DEFAULT;
+    std::string scene_path;
+    int width = 0;
+    int height = 0;
+    int first_sample = 0;                // Sample index of the worker's first sample
+    int samples = 0;
+    int update_interval = 16;
+    std::string partial_path;            // Film written here after every update_interval samples
+    int geometry_budget_mb = 0;
+};
+
+// Sum checkpoint files of one view into a checkpoint and/or an image
+struct MergeSettings {
+    grassland::graphics::BackendAPI api = grassland::graphics::BACKEND_API_DEFAULT;
+    std::vector<std::string> inputs;
+    std::string checkpoint_path;         // Optional merged checkpoint
+    bool compress = true;
+    std::string image_path;              // Optional PNG of the merged film
+};
+
+struct SampleRange {
+    int first = 0;
+    int count = 0;
+};
+
+// Sharded offline render on one machine. The coordinator splits the samples
+// per pixel into contiguous ranges and starts one worker process per range
+// (the same program with --shard-worker). Each worker renders the whole frame
+// for its range of the pixel sample sequence and periodically writes its film
+// to a partial file (an uncompressed FilmCheckpoint), then reports on its
+// stdout, which the coordinator reads through a pipe. Accumulated color, AOVs
+// and sample counts are sums, so the coordinator merges the partials into one
+// Film by adding them up and develops that (denoised when enabled) into the
+// final image.
+class ShardedRender {
+public:
+    // All return the process exit code
+    static int RunCoordinator(const ShardSettings& settings);
+    static int RunWorker(const ShardWorkerSettings& settings);
+    static int RunMerge(const MergeSettings& settings);
+
+    // spp split into count ranges whose sizes differ by at most one
+    static std::vector<SampleRange> SplitSamples(int spp, int count);
+};
@@ -0,0 +1,235 @@
+#include "SkyboxLoader.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include "glm/gtc/packing.hpp"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+constexpr int kPlaceholderWidth = 64;
+constexpr int kPlaceholderHeight = 32;
+constexpr float kMaxHalf = 65504.0f;
+
+// Radiance above the largest half would become +inf, which the environment map
+// gives zero sampling weight and the shader would add to the film
+uint16_t PackHalf(float value) {
+    return glm::packHalf1x16(std::min(value, kMaxHalf));
+}
+
+void StoreHalfPixel(uint16_t* out, float r, float g, float b) {
+    out[0] = PackHalf(r);
+    out[1] = PackHalf(g);
+    out[2] = PackHalf(b);
+    out[3] = PackHalf(1.0f);
+}
+
+// Read one header line starting at *pos, advancing past its newline
+bool ReadLine(const uint8_t* data, size_t size, size_t* pos, std::string* line) {
+    if (*pos >= size) {
+        return false;
+    }
+    const uint8_t* begin = data + *pos;
+    const uint8_t* end = static_cast<const uint8_t*>(std::memchr(begin, '\n', size - *pos));
+    size_t length = end ? static_cast<size_t>(end - begin) : size - *pos;
+    line->assign(reinterpret_cast<const char*>(begin), length);
+    *pos += length + (end ? 1 : 0);
+    return true;
+}
+
+// Scanline uses the adaptive RLE encoding (2, 2, width hi, width lo)
+bool IsRLEScanline(const uint8_t* p, int width) {
+    return p[0] == 2 && p[1] == 2 && !(p[2] & 0x80) && ((p[2] << 8) | p[3]) == width;
+}
+
+// Skip one RLE scanline at pos, returning false if it runs past the end
+bool SkipRLEScanline(const uint8_t* data, size_t size, int width, size_t* pos) {
+    *pos += 4;
+    for (int channel = 0; channel < 4; ++channel) {
+        for (int x = 0; x < width;) {
+            if (*pos >= size) {
+                return false;
+            }
+            int count = data[(*pos)++];
+            if (count > 128) {
+                count -= 128;
+                *pos += 1;
+            } else {
+                *pos += count;
+            }
+            if (count == 0 || x + count > width) {
+                return false;
+            }
+            x += count;
+        }
+    }
+    return *pos <= size;
+}
+
+// Expand one RLE scanline into interleaved RGBE
+void DecodeRLEScanline(const uint8_t* p, int width, uint8_t* rgbe) {
+    p += 4;
+    for (int channel = 0; channel < 4; ++channel) {
+        for (int x = 0; x < width;) {
+            int count = *p++;
+            if (count > 128) {
+                count -= 128;
+                uint8_t value = *p++;
+                for (int i = 0; i < count; ++i) {
+                    rgbe[(x + i) * 4 + channel] = value;
+                }
+            } else {
+                for (int i = 0; i < count; ++i) {
+                    rgbe[(x + i) * 4 + channel] = *p++;
+                }
+            }
+            x += count;
+        }
+    }
+}
+
+void RGBEToHalf(const uint8_t* rgbe, int width, uint16_t* out) {
+    for (int x = 0; x < width; ++x, rgbe += 4, out += 4) {
+        float scale = rgbe[3] ? std::ldexp(1.0f, rgbe[3] - (128 + 8)) : 0.0f;
+        StoreHalfPixel(out, rgbe[0] * scale, rgbe[1] * scale, rgbe[2] * scale);
+    }
+}
+
+// Radiance .hdr in the standard -Y +X orientation; returns an invalid image
+// for anything else so the caller can fall back to stb_image
+HdrImage DecodeRadiance(const std::string& path) {
+    HdrImage image;
+    MappedFile file;
+    if (!file.Open(path)) {
+        return image;
+    }
+    const uint8_t* data = file.Data();
+    size_t size = file.Size();
+
+    size_t pos = 0;
+    std::string line;
+    if (!ReadLine(data, size, &pos, &line) || (line != "#?RADIANCE" && line != "#?RGBE")) {
+        return image;
+    }
+    bool rgbe_format = true;
+    while (ReadLine(data, size, &pos, &line) && !line.empty()) {
+        if (line.rfind("FORMAT=", 0) == 0) {
+            rgbe_format = line == "FORMAT=32-bit_rle_rgbe";
+        }
+    }
+    int width = 0, height = 0;
+    if (!rgbe_format || !ReadLine(data, size, &pos, &line) ||
+        std::sscanf(line.c_str(), "-Y %d +X %d", &height, &width) != 2 ||
+        width <= 0 || height <= 0) {
+        return image;
+    }
+
+    // Find where each scanline starts (RLE scanlines vary in length)
+    std::vector<size_t> offsets(height);
+    bool rle = width >= 8 && width < 0x8000 && pos + 4 <= size && IsRLEScanline(data + pos, width);
+    for (int y = 0; y < height; ++y) {
+        offsets[y] = pos;
+        if (rle) {
+            if (pos + 4 > size || !IsRLEScanline(data + pos, width) || !SkipRLEScanline(data, size, width, &pos)) {
+                grassland::LogWarning("Corrupt RLE scanline {} in {}", y, path);
+                return image;
+            }
+        } else {
+            pos += static_cast<size_t>(width) * 4;
+        }
+    }
+    if (pos > size) {
+        grassland::LogWarning("Truncated HDR file {}", path);
+        return image;
+    }
+
+    // Expand and convert the scanlines in parallel
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(static_cast<size_t>(width) * height * 4);
+    ThreadPool::Global().ParallelFor(height, [&](size_t y) {
+        uint16_t* out = &image.pixels[y * width * 4];
+        if (rle) {
+            std::vector<uint8_t> rgbe(static_cast<size_t>(width) * 4);
+            DecodeRLEScanline(data + offsets[y], width, rgbe.data());
+            RGBEToHalf(rgbe.data(), width, out);
+        } else {
+            RGBEToHalf(data + offsets[y], width, out);
+        }
+    });
+    return image;
+}
+}
+
+void SkyboxLoader::LoadAsync(const std::string& path) {
+    // A superseded load finishes into its own state and is dropped
+    auto state = std::make_shared<State>();
+    state_ = state;
+    ThreadPool::Global().Enqueue([state, path]() {
+        state->image = Decode(path);
+        if (state->image.IsValid()) {
+            state->tables = EnvironmentMap::ComputeTables(state->image.pixels.data(), state->image.width,
+                                                          state->image.height);
+        }
+        state->ready.store(true, std::memory_order_release);
+    });
+}
+
+bool SkyboxLoader::Poll(HdrImage* image, EnvironmentTables* tables) {
+    if (!state_ || !state_->ready.load(std::memory_order_acquire)) {
+        return false;
+    }
+    *image = std::move(state_->image);
+    *tables = std::move(state_->tables);
+    state_.reset();
+    return true;
+}
+
+HdrImage SkyboxLoader::Decode(const std::string& path) {
+    TRACE_SCOPE("SkyboxLoader::Decode");
+    HdrImage image = DecodeRadiance(path);
+    if (image.IsValid()) {
+        return image;
+    }
+
+    int width = 0, height = 0, channels = 0;
+    float* data = stbi_loadf(path.c_str(), &width, &height, &channels, 4);
+    if (!data) {
+        grassland::LogWarning("Failed to load skybox {}: {}", path, stbi_failure_reason());
+        return image;
+    }
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(static_cast<size_t>(width) * height * 4);
+    ThreadPool::Global().ParallelFor(height, [&](size_t y) {
+        for (size_t i = y * width * 4; i < (y + 1) * width * 4; ++i) {
+            image.pixels[i] = PackHalf(data[i]);
+        }
+    });
+    stbi_image_free(data);
+    return image;
+}
+
+HdrImage SkyboxLoader::MakePlaceholder() {
+    HdrImage image;
+    image.width = kPlaceholderWidth;
+    image.height = kPlaceholderHeight;
+    image.pixels.resize(kPlaceholderWidth * kPlaceholderHeight * 4);
+    for (int y = 0; y < kPlaceholderHeight; ++y) {
+        // Zenith blue fading to a pale horizon, dim grey below it
+        float v = (y + 0.5f) / kPlaceholderHeight;
+        float t = std::min(v * 2.0f, 1.0f);
+        float r = v < 0.5f ? 0.3f + 0.5f * t : 0.3f;
+        float g = v < 0.5f ? 0.5f + 0.35f * t : 0.3f;
+        float b = v < 0.5f ? 1.0f - 0.05f * t : 0.3f;
+        for (int x = 0; x < kPlaceholderWidth; ++x) {
+            StoreHalfPixel(&image.pixels[(y * kPlaceholderWidth + x) * 4], r, g, b);
+        }
+    }
+    return image;
+}
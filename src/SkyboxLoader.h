@@ -0,0 +1,48 @@
+#pragma once
+#include "EnvironmentMap.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// HDR image as half-float RGBA (8 bytes per pixel), ready for upload
+struct HdrImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint16_t> pixels;  // width * height * 4 halfs
+
+    bool IsValid() const { return !pixels.empty(); }
+};
+
+// Loads the equirectangular skybox on the global thread pool. Radiance .hdr
+// files are decoded directly: scanline offsets are found in one pass over the
+// run lengths, then the RLE scanlines are expanded and converted to half
+// floats in parallel. Other formats go through stb_image. The environment
+// sampling tables are computed on the worker as well, so the main thread only
+// uploads when the map is ready.
+class SkyboxLoader {
+public:
+    // Start loading path, replacing any pending request
+    void LoadAsync(const std::string& path);
+
+    bool IsLoading() const { return state_ != nullptr; }
+
+    // Take the finished image and its sampling tables; returns false while the
+    // load is still running, and true with an invalid image if it failed
+    bool Poll(HdrImage* image, EnvironmentTables* tables);
+
+    // Decode an image file on the calling thread
+    static HdrImage Decode(const std::string& path);
+
+    // Low-resolution sky gradient shown until the full map arrives
+    static HdrImage MakePlaceholder();
+
+private:
+    struct State {
+        std::atomic<bool> ready{false};
+        HdrImage image;
+        EnvironmentTables tables;
+    };
+    std::shared_ptr<State> state_;
+};
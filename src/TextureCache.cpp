@@ -0,0 +1,470 @@
+#include "TextureCache.h"
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "long_march.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+
+constexpr uint32_t kCacheVersion = 2;
+
+std::string g_cache_directory = "texture_cache";
+bool g_cache_enabled = true;
+
+size_t BlockBytes(BlockFormat format) {
+    return format == BLOCK_FORMAT_BC1 ? 8 : 16;
+}
+
+// ---- BC1 -------------------------------------------------------------------
+
+uint16_t PackRGB565(const float c[3]) {
+    int r = std::clamp(static_cast<int>(std::lround(c[0] * 31.0f / 255.0f)), 0, 31);
+    int g = std::clamp(static_cast<int>(std::lround(c[1] * 63.0f / 255.0f)), 0, 63);
+    int b = std::clamp(static_cast<int>(std::lround(c[2] * 31.0f / 255.0f)), 0, 31);
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void UnpackRGB565(uint16_t c, int out[3]) {
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+void EncodeBC1Block(const uint8_t block[16][4], uint8_t* out) {
+    // Principal axis of the block colors via a few power iterations
+    float mean[3] = {0, 0, 0};
+    for (int i = 0; i < 16; ++i)
+        for (int c = 0; c < 3; ++c) mean[c] += block[i][c] / 16.0f;
+    float cov[6] = {0, 0, 0, 0, 0, 0};  // xx xy xz yy yz zz
+    for (int i = 0; i < 16; ++i) {
+        float d[3] = {block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2]};
+        cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+        cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+    }
+    float axis[3] = {1, 1, 1};
+    for (int iter = 0; iter < 4; ++iter) {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float len = std::sqrt(x * x + y * y + z * z);
+        if (len < 1e-6f) break;
+        axis[0] = x / len; axis[1] = y / len; axis[2] = z / len;
+    }
+
+    float t_min = 1e30f, t_max = -1e30f;
+    for (int i = 0; i < 16; ++i) {
+        float t = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] +
+                  (block[i][2] - mean[2]) * axis[2];
+        t_min = std::min(t_min, t);
+        t_max = std::max(t_max, t);
+    }
+    // Inset the endpoints slightly to reduce quantization error at the extremes
+    float inset = (t_max - t_min) / 16.0f;
+    t_min += inset;
+    t_max -= inset;
+
+    float e0[3], e1[3];
+    for (int c = 0; c < 3; ++c) {
+        e0[c] = std::clamp(mean[c] + axis[c] * t_max, 0.0f, 255.0f);
+        e1[c] = std::clamp(mean[c] + axis[c] * t_min, 0.0f, 255.0f);
+    }
+    uint16_t c0 = PackRGB565(e0), c1 = PackRGB565(e1);
+    if (c0 < c1) std::swap(c0, c1);  // c0 > c1 selects the opaque 4-color mode
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        int p[4][3];
+        UnpackRGB565(c0, p[0]);
+        UnpackRGB565(c1, p[1]);
+        for (int c = 0; c < 3; ++c) {
+            p[2][c] = (2 * p[0][c] + p[1][c]) / 3;
+            p[3][c] = (p[0][c] + 2 * p[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; ++i) {
+            int best = 0, best_dist = 1 << 30;
+            for (int k = 0; k < 4; ++k) {
+                int dr = block[i][0] - p[k][0], dg = block[i][1] - p[k][1], db = block[i][2] - p[k][2];
+                int dist = dr * dr + dg * dg + db * db;
+                if (dist < best_dist) { best_dist = dist; best = k; }
+            }
+            indices |= static_cast<uint32_t>(best) << (2 * i);
+        }
+    }
+
+    out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+    std::memcpy(out + 4, &indices, 4);
+}
+
+void DecodeBC1Block(const uint8_t* in, uint8_t block[16][4]) {
+    uint16_t c0 = in[0] | (in[1] << 8), c1 = in[2] | (in[3] << 8);
+    uint32_t indices;
+    std::memcpy(&indices, in + 4, 4);
+    int p[4][4];
+    UnpackRGB565(c0, p[0]);
+    UnpackRGB565(c1, p[1]);
+    p[0][3] = p[1][3] = p[2][3] = 255;
+    if (c0 > c1) {
+        for (int c = 0; c < 3; ++c) {
+            p[2][c] = (2 * p[0][c] + p[1][c]) / 3;
+            p[3][c] = (p[0][c] + 2 * p[1][c]) / 3;
+        }
+        p[3][3] = 255;
+    } else {
+        for (int c = 0; c < 3; ++c) {
+            p[2][c] = (p[0][c] + p[1][c]) / 2;
+            p[3][c] = 0;
+        }
+        p[3][3] = 0;
+    }
+    for (int i = 0; i < 16; ++i) {
+        int k = (indices >> (2 * i)) & 3;
+        for (int c = 0; c < 4; ++c) block[i][c] = static_cast<uint8_t>(p[k][c]);
+    }
+}
+
+// ---- BC4 (one channel, two of them make BC5) ------------------------------
+
+void BC4Palette(int r0, int r1, int palette[8]) {
+    palette[0] = r0;
+    palette[1] = r1;
+    if (r0 > r1) {
+        for (int k = 2; k < 8; ++k) palette[k] = ((8 - k) * r0 + (k - 1) * r1) / 7;
+    } else {
+        for (int k = 2; k < 6; ++k) palette[k] = ((6 - k) * r0 + (k - 1) * r1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+void EncodeBC4Block(const uint8_t values[16], uint8_t* out) {
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; ++i) {
+        lo = std::min(lo, static_cast<int>(values[i]));
+        hi = std::max(hi, static_cast<int>(values[i]));
+    }
+    out[0] = static_cast<uint8_t>(hi);
+    out[1] = static_cast<uint8_t>(lo);
+
+    uint64_t indices = 0;
+    if (hi != lo) {
+        int palette[8];
+        BC4Palette(hi, lo, palette);
+        for (int i = 0; i < 16; ++i) {
+            int best = 0, best_dist = 1 << 30;
+            for (int k = 0; k < 8; ++k) {
+                int dist = std::abs(values[i] - palette[k]);
+                if (dist < best_dist) { best_dist = dist; best = k; }
+            }
+            indices |= static_cast<uint64_t>(best) << (3 * i);
+        }
+    }
+    for (int b = 0; b < 6; ++b) out[2 + b] = static_cast<uint8_t>(indices >> (8 * b));
+}
+
+void DecodeBC4Block(const uint8_t* in, uint8_t values[16]) {
+    int palette[8];
+    BC4Palette(in[0], in[1], palette);
+    uint64_t indices = 0;
+    for (int b = 0; b < 6; ++b) indices |= static_cast<uint64_t>(in[2 + b]) << (8 * b);
+    for (int i = 0; i < 16; ++i) values[i] = static_cast<uint8_t>(palette[(indices >> (3 * i)) & 7]);
+}
+
+void EncodeBC5Block(const uint8_t block[16][4], uint8_t* out) {
+    uint8_t r[16], g[16];
+    for (int i = 0; i < 16; ++i) { r[i] = block[i][0]; g[i] = block[i][1]; }
+    EncodeBC4Block(r, out);
+    EncodeBC4Block(g, out + 8);
+}
+
+void DecodeBC5Block(const uint8_t* in, uint8_t block[16][4]) {
+    uint8_t r[16], g[16];
+    DecodeBC4Block(in, r);
+    DecodeBC4Block(in + 8, g);
+    for (int i = 0; i < 16; ++i) {
+        // Reconstruct Z of the unit tangent-space normal
+        float x = r[i] / 255.0f * 2.0f - 1.0f;
+        float y = g[i] / 255.0f * 2.0f - 1.0f;
+        float z = std::sqrt(std::max(0.0f, 1.0f - x * x - y * y));
+        block[i][0] = r[i];
+        block[i][1] = g[i];
+        block[i][2] = static_cast<uint8_t>(std::lround((z * 0.5f + 0.5f) * 255.0f));
+        block[i][3] = 255;
+    }
+}
+
+}  // namespace
+
+// ---- TextureCacheFile ------------------------------------------------------
+
+bool TextureCacheFile::Open(const std::string& cache_path) {
+    if (!file_.Open(cache_path) || file_.Size() < sizeof(TextureCacheHeader)) {
+        return false;
+    }
+    header_ = reinterpret_cast<const TextureCacheHeader*>(file_.Data());
+    if (std::memcmp(header_->magic, "SMTC", 4) != 0 || header_->version != kCacheVersion ||
+        header_->level_count == 0 || header_->level_count > TextureCacheHeader::kMaxLevels) {
+        file_.Close();
+        header_ = nullptr;
+        return false;
+    }
+    // Reject truncated files
+    int last = GetLevelCount() - 1;
+    size_t end = header_->level_offsets[last] +
+                 TextureCache::GetLevelSize(GetLevelWidth(last), GetLevelHeight(last), GetFormat());
+    if (end > file_.Size()) {
+        file_.Close();
+        header_ = nullptr;
+        return false;
+    }
+    // Reject files whose blocks do not match the hash written with them
+    uint64_t begin = header_->level_offsets[0];
+    if (begin > end || HashBytes(file_.Data() + begin, end - begin) != header_->data_hash) {
+        grassland::LogWarning("Ignoring corrupted texture cache file {}", cache_path);
+        file_.Close();
+        header_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+int TextureCacheFile::GetLevelWidth(int level) const {
+    return std::max(1, GetWidth() >> level);
+}
+
+int TextureCacheFile::GetLevelHeight(int level) const {
+    return std::max(1, GetHeight() >> level);
+}
+
+void TextureCacheFile::DecodeLevel(int level, uint8_t* rgba) const {
+    int w = GetLevelWidth(level), h = GetLevelHeight(level);
+    int blocks_y = (h + 3) / 4;
+    // Decode block rows in parallel
+    ThreadPool::Global().ParallelFor(blocks_y, [&](size_t by) {
+        int y = static_cast<int>(by) * 4;
+        DecodeRegion(level, 0, y, w, std::min(4, h - y), rgba + static_cast<size_t>(y) * w * 4);
+    });
+}
+
+void TextureCacheFile::DecodeRegion(int level, int x, int y, int w, int h, uint8_t* rgba) const {
+    int level_width = GetLevelWidth(level);
+    int blocks_x = (level_width + 3) / 4;
+    size_t block_bytes = BlockBytes(GetFormat());
+    const uint8_t* data = GetLevelData(level);
+
+    uint8_t block[16][4];
+    for (int by = y / 4; by <= (y + h - 1) / 4; ++by) {
+        for (int bx = x / 4; bx <= (x + w - 1) / 4; ++bx) {
+            const uint8_t* in = data + (static_cast<size_t>(by) * blocks_x + bx) * block_bytes;
+            if (GetFormat() == BLOCK_FORMAT_BC1) {
+                DecodeBC1Block(in, block);
+            } else {
+                DecodeBC5Block(in, block);
+            }
+            for (int py = 0; py < 4; ++py) {
+                int ty = by * 4 + py - y;
+                if (ty < 0 || ty >= h) continue;
+                for (int px = 0; px < 4; ++px) {
+                    int tx = bx * 4 + px - x;
+                    if (tx < 0 || tx >= w) continue;
+                    std::memcpy(rgba + (static_cast<size_t>(ty) * w + tx) * 4, block[py * 4 + px], 4);
+                }
+            }
+        }
+    }
+}
+
+uint64_t TextureCacheFile::ComputeContentHash() const {
+    uint64_t h = kHashSeed;
+    const uint64_t prime = 0x100000001b3ull;
+    h = (h ^ header_->width) * prime;
+    h = (h ^ header_->height) * prime;
+    h = (h ^ header_->format) * prime;
+    h = HashBytes(GetLevelData(0), TextureCache::GetLevelSize(GetWidth(), GetHeight(), GetFormat()), h);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+// ---- TextureCache ----------------------------------------------------------
+
+void TextureCache::SetDirectory(const std::string& directory) {
+    g_cache_directory = directory;
+}
+
+const std::string& TextureCache::GetDirectory() {
+    return g_cache_directory;
+}
+
+void TextureCache::SetEnabled(bool enabled) {
+    g_cache_enabled = enabled;
+}
+
+bool TextureCache::IsEnabled() {
+    return g_cache_enabled;
+}
+
+std::string TextureCache::GetCachePath(const std::string& source_path, TextureKind kind) {
+    std::error_code ec;
+    std::filesystem::path source(source_path);
+    auto size = std::filesystem::file_size(source, ec);
+    if (ec) return {};
+    auto mtime = std::filesystem::last_write_time(source, ec);
+    if (ec) return {};
+
+    std::string key = std::filesystem::absolute(source, ec).string() + "|" + std::to_string(size) + "|" +
+                      std::to_string(mtime.time_since_epoch().count()) + "|" + std::to_string(kind);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.smtc", static_cast<unsigned long long>(HashBytes(key.data(), key.size())));
+    return (std::filesystem::path(g_cache_directory) / name).string();
+}
+
+size_t TextureCache::GetLevelSize(int width, int height, BlockFormat format) {
+    size_t blocks = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+    return blocks * BlockBytes(format);
+}
+
+std::vector<uint8_t> TextureCache::EncodeLevel(const uint8_t* rgba, int width, int height, BlockFormat format) {
+    int blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+    size_t block_bytes = BlockBytes(format);
+    std::vector<uint8_t> out(GetLevelSize(width, height, format));
+
+    ThreadPool::Global().ParallelFor(blocks_y, [&](size_t by) {
+        uint8_t block[16][4];
+        for (int bx = 0; bx < blocks_x; ++bx) {
+            // Gather the 4x4 block, clamping at the image border
+            for (int py = 0; py < 4; ++py) {
+                int y = std::min(static_cast<int>(by) * 4 + py, height - 1);
+                for (int px = 0; px < 4; ++px) {
+                    int x = std::min(bx * 4 + px, width - 1);
+                    std::memcpy(block[py * 4 + px], rgba + (static_cast<size_t>(y) * width + x) * 4, 4);
+                }
+            }
+            uint8_t* dst = out.data() + (by * blocks_x + bx) * block_bytes;
+            if (format == BLOCK_FORMAT_BC1) {
+                EncodeBC1Block(block, dst);
+            } else {
+                EncodeBC5Block(block, dst);
+            }
+        }
+    });
+    return out;
+}
+
+bool TextureCache::Open(const std::string& source_path, TextureKind kind, TextureCacheFile* file) {
+    if (!g_cache_enabled) {
+        return false;
+    }
+    std::string cache_path = GetCachePath(source_path, kind);
+    return !cache_path.empty() && file->Open(cache_path);
+}
+
+bool TextureCache::Load(const std::string& source_path, TextureKind kind, DecodedImage* image) {
+    if (!g_cache_enabled) {
+        return false;
+    }
+    std::string cache_path = GetCachePath(source_path, kind);
+    TextureCacheFile file;
+    if (cache_path.empty() || !file.Open(cache_path)) {
+        return false;
+    }
+
+    image->width = file.GetWidth();
+    image->height = file.GetHeight();
+    image->channels = file.GetSourceChannels();
+    image->pixels.resize(static_cast<size_t>(image->width) * image->height * 4);
+    file.DecodeLevel(0, image->pixels.data());
+    image->mips.resize(file.GetLevelCount() - 1);
+    for (int level = 1; level < file.GetLevelCount(); ++level) {
+        image->mips[level - 1].resize(static_cast<size_t>(file.GetLevelWidth(level)) * file.GetLevelHeight(level) * 4);
+        file.DecodeLevel(level, image->mips[level - 1].data());
+    }
+    return true;
+}
+
+bool TextureCache::Store(const std::string& source_path, TextureKind kind, const DecodedImage& image) {
+    TRACE_SCOPE("TextureCache::Store");
+    if (!g_cache_enabled || !image.IsValid()) {
+        return false;
+    }
+    std::string cache_path = GetCachePath(source_path, kind);
+    if (cache_path.empty()) {
+        return false;
+    }
+
+    BlockFormat format = (kind == TEXTURE_KIND_NORMAL) ? BLOCK_FORMAT_BC5 : BLOCK_FORMAT_BC1;
+
+    TextureCacheHeader header{};
+    std::memcpy(header.magic, "SMTC", 4);
+    header.version = kCacheVersion;
+    header.format = format;
+    header.width = image.width;
+    header.height = image.height;
+    header.source_channels = image.channels;
+
+    // Encode the full mip chain, generating it first if the caller did not
+    const DecodedImage* source = &image;
+    DecodedImage with_mips;
+    if (image.mips.empty() && MipGenerator::GetLevelCount(image.width, image.height) > 1) {
+        with_mips = image;
+        MipGenerator::Generate(&with_mips, kind);
+        source = &with_mips;
+    }
+    int level_count = std::min<int>(source->GetLevelCount(), TextureCacheHeader::kMaxLevels);
+    std::vector<std::vector<uint8_t>> levels;
+    uint64_t offset = sizeof(TextureCacheHeader);
+    for (int level = 0; level < level_count; ++level) {
+        header.level_offsets[level] = offset;
+        levels.push_back(EncodeLevel(source->GetLevelPixels(level), source->GetLevelWidth(level),
+                                     source->GetLevelHeight(level), format));
+        offset += levels.back().size();
+    }
+    header.level_count = static_cast<uint32_t>(level_count);
+    header.data_hash = kHashSeed;
+    for (const auto& level : levels) {
+        header.data_hash = HashBytes(level.data(), level.size(), header.data_hash);
+    }
+
+    // Meshes sharing a texture (or worker processes) may store it concurrently
+    std::vector<FileSpan> spans = {{&header, sizeof(header)}};
+    for (const auto& level : levels) {
+        spans.push_back({level.data(), level.size()});
+    }
+    std::string error;
+    if (!WriteFileAtomically(cache_path, spans, &error)) {
+        grassland::LogWarning("Cannot write texture cache file {}: {}", cache_path, error);
+        return false;
+    }
+
+    grassland::LogInfo("Cached {} as {} ({} levels, {} KB -> {} KB)", source_path,
+                       format == BLOCK_FORMAT_BC1 ? "BC1" : "BC5", levels.size(),
+                       image.pixels.size() / 1024, (offset - sizeof(TextureCacheHeader)) / 1024);
+    return true;
+}
+
+size_t TextureCache::Prebuild(const std::vector<std::pair<std::string, TextureKind>>& sources) {
+    std::atomic<size_t> built{0};
+    ThreadPool::Global().ParallelFor(sources.size(), [&](size_t i) {
+        const auto& [path, kind] = sources[i];
+        TextureCacheFile existing;
+        std::string cache_path = GetCachePath(path, kind);
+        if (cache_path.empty() || existing.Open(cache_path)) {
+            return;
+        }
+        DecodedImage image = TextureLoader::DecodeFile(path);
+        if (Store(path, kind, image)) {
+            built++;
+        }
+    });
+    grassland::LogInfo("Texture cache prebuild: {} of {} textures encoded", built.load(), sources.size());
+    return built.load();
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "MappedFile.h"
+#include "TextureLoader.h"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Block-compressed formats stored in the texture cache
+enum BlockFormat : uint32_t {
+    BLOCK_FORMAT_BC1 = 1,  // RGB, 8 bytes per 4x4 block (albedo)
+    BLOCK_FORMAT_BC5 = 5,  // RG, 16 bytes per 4x4 block (tangent-space normals, Z reconstructed)
+};
+
+// On-disk layout of a cache file: header followed by the block data of every mip level
+struct TextureCacheHeader {
+    static constexpr uint32_t kMaxLevels = 16;
+
+    char magic[4];              // "SMTC"
+    uint32_t version;
+    uint32_t format;            // BlockFormat
+    uint32_t width;
+    uint32_t height;
+    uint32_t level_count;
+    uint32_t source_channels;
+    uint32_t reserved;
+    uint64_t data_hash;                  // Hash of the block data of all levels
+    uint64_t level_offsets[kMaxLevels];  // Byte offset of each level from the start of the file
+};
+
+// A cache file mapped into memory
+class TextureCacheFile {
+public:
+    bool Open(const std::string& cache_path);
+
+    BlockFormat GetFormat() const { return static_cast<BlockFormat>(header_->format); }
+    int GetWidth() const { return static_cast<int>(header_->width); }
+    int GetHeight() const { return static_cast<int>(header_->height); }
+    int GetLevelCount() const { return static_cast<int>(header_->level_count); }
+    int GetSourceChannels() const { return static_cast<int>(header_->source_channels); }
+    int GetLevelWidth(int level) const;
+    int GetLevelHeight(int level) const;
+    const uint8_t* GetLevelData(int level) const { return file_.Data() + header_->level_offsets[level]; }
+    size_t GetFileSize() const { return file_.Size(); }
+
+    // Decode a whole level into RGBA8
+    void DecodeLevel(int level, uint8_t* rgba) const;
+    // Decode a w x h region of a level starting at (x, y) into RGBA8 (row pitch w * 4)
+    void DecodeRegion(int level, int x, int y, int w, int h, uint8_t* rgba) const;
+
+    // Hash of the dimensions and level 0 blocks, used to share identical textures
+    uint64_t ComputeContentHash() const;
+
+private:
+    MappedFile file_;
+    const TextureCacheHeader* header_ = nullptr;
+};
+
+// Pre-decoded texture cache: stores the mip chain of each source image in
+// block-compressed form keyed by source path, size and modification time, so
+// later launches skip PNG/JPEG decoding and just map the blocks. Enabled by
+// default: virtual texture pages are BC1/BC5 in GPU memory either way, and
+// cached levels whose size is a multiple of 4 are paged in by copying blocks.
+class TextureCache {
+public:
+    static void SetDirectory(const std::string& directory);
+    static const std::string& GetDirectory();
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled();
+
+    // Cache file path for a source image (empty if the source does not exist)
+    static std::string GetCachePath(const std::string& source_path, TextureKind kind);
+
+    // Map the cache file of a source without decoding it. Returns false on a cache miss.
+    static bool Open(const std::string& source_path, TextureKind kind, TextureCacheFile* file);
+
+    // Load every level from the cache into RGBA8. Returns false on a cache miss.
+    static bool Load(const std::string& source_path, TextureKind kind, DecodedImage* image);
+
+    // Encode an image with its mip chain and write it to the cache (written atomically)
+    static bool Store(const std::string& source_path, TextureKind kind, const DecodedImage& image);
+
+    // Offline build: encode every source that is not cached yet, in parallel. Returns the number built.
+    static size_t Prebuild(const std::vector<std::pair<std::string, TextureKind>>& sources);
+
+    // Encode RGBA8 pixels (multi-threaded over block rows)
+    static std::vector<uint8_t> EncodeLevel(const uint8_t* rgba, int width, int height, BlockFormat format);
+    static size_t GetLevelSize(int width, int height, BlockFormat format);
+};
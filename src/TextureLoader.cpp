@@ -0,0 +1,93 @@
+#include "TextureLoader.h"
+#include "MappedFile.h"
+#include "MipGenerator.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "long_march.h"
+#include "stb_image.h"
+
+#include <chrono>
+
+size_t TextureLoader::Request(const std::string& path, TextureKind kind) {
+    std::string key = std::to_string(kind) + ":" + path;
+    auto it = path_to_slot_.find(key);
+    if (it != path_to_slot_.end()) {
+        return it->second;
+    }
+    size_t slot = paths_.size();
+    paths_.push_back(path);
+    kinds_.push_back(kind);
+    path_to_slot_[key] = slot;
+    return slot;
+}
+
+void TextureLoader::LoadAll() {
+    TRACE_SCOPE("TextureLoader::LoadAll");
+    auto start = std::chrono::steady_clock::now();
+
+    images_.clear();
+    images_.resize(paths_.size());
+    ThreadPool::Global().ParallelFor(paths_.size(), [this](size_t i) {
+        images_[i] = Decode(paths_[i], kinds_[i]);
+    });
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    grassland::LogInfo("Decoded {} textures in {:.1f} ms on {} threads",
+                       paths_.size(), ms, ThreadPool::Global().GetThreadCount());
+}
+
+void TextureLoader::Clear() {
+    paths_.clear();
+    kinds_.clear();
+    path_to_slot_.clear();
+    images_.clear();
+}
+
+DecodedImage TextureLoader::Decode(const std::string& path, TextureKind kind) {
+    TRACE_SCOPE("TextureLoader::Decode");
+    DecodedImage image;
+    if (TextureCache::Load(path, kind, &image)) {
+        image.content_hash = HashImage(image);
+        return image;
+    }
+
+    // On a miss keep the decoded source; only later launches see the lossy cached copy
+    image = DecodeFile(path);
+    MipGenerator::Generate(&image, kind);
+    if (image.IsValid()) {
+        TextureCache::Store(path, kind, image);
+    }
+    return image;
+}
+
+DecodedImage TextureLoader::DecodeFile(const std::string& path) {
+    DecodedImage image;
+    unsigned char* data = stbi_load(path.c_str(), &image.width, &image.height, &image.channels, 4);  // Force RGBA
+    if (!data) {
+        grassland::LogInfo("Failed to load texture: {} - {}", path, stbi_failure_reason());
+        return image;
+    }
+
+    size_t size = static_cast<size_t>(image.width) * image.height * 4;
+    image.pixels.assign(data, data + size);
+    stbi_image_free(data);
+
+    image.content_hash = HashImage(image);
+    return image;
+}
+
+uint64_t TextureLoader::HashImage(const DecodedImage& image) {
+    // Seeded with the dimensions
+    const uint64_t prime = 0x100000001b3ull;
+    uint64_t h = kHashSeed;
+    h = (h ^ static_cast<uint64_t>(image.width)) * prime;
+    h = (h ^ static_cast<uint64_t>(image.height)) * prime;
+    h = HashBytes(image.pixels.data(), image.pixels.size(), h);
+
+    // Final avalanche so nearby images do not cluster
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
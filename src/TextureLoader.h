@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// RGBA8 image decoded on the CPU, ready for upload
+struct DecodedImage {
+    int width = 0;
+    int height = 0;
+    int channels = 0;               // Channels in the source file (pixels are always RGBA)
+    std::vector<uint8_t> pixels;    // width * height * 4 bytes
+    std::vector<std::vector<uint8_t>> mips;  // Mip levels 1..n-1 (level 0 is pixels), may be empty
+    uint64_t content_hash = 0;      // Hash of dimensions and pixels, used for dedup
+
+    bool IsValid() const { return !pixels.empty(); }
+    int GetLevelCount() const { return 1 + static_cast<int>(mips.size()); }
+    int GetLevelWidth(int level) const { return width >> level > 0 ? width >> level : 1; }
+    int GetLevelHeight(int level) const { return height >> level > 0 ? height >> level : 1; }
+    const uint8_t* GetLevelPixels(int level) const { return level == 0 ? pixels.data() : mips[level - 1].data(); }
+};
+
+// How a texture is used, which selects its compressed cache format
+enum TextureKind : uint32_t {
+    TEXTURE_KIND_COLOR = 0,
+    TEXTURE_KIND_NORMAL = 1,
+};
+
+// Batch texture loader: collects unique paths, decodes them in parallel on the
+// global thread pool and hashes the decoded content so identical images stored
+// under different paths can share one GPU texture
+class TextureLoader {
+public:
+    // Queue a path and return its slot (duplicates of the same kind share the slot of the first request)
+    size_t Request(const std::string& path, TextureKind kind = TEXTURE_KIND_COLOR);
+
+    // Decode every queued path in parallel
+    void LoadAll();
+
+    // Queued paths in request order and their decoded images (same order)
+    const std::vector<std::string>& GetPaths() const { return paths_; }
+    const std::vector<DecodedImage>& GetImages() const { return images_; }
+
+    // Release decoded pixel data once uploaded
+    void Clear();
+
+    // Decode through the texture cache: on a miss the source is decoded, stored
+    // and reloaded so every launch sees the same block-compressed pixels
+    static DecodedImage Decode(const std::string& path, TextureKind kind = TEXTURE_KIND_COLOR);
+    // Decode the source file directly, bypassing the cache
+    static DecodedImage DecodeFile(const std::string& path);
+    static uint64_t HashImage(const DecodedImage& image);
+
+private:
+    std::vector<std::string> paths_;
+    std::vector<TextureKind> kinds_;
+    std::unordered_map<std::string, size_t> path_to_slot_;  // Keyed by kind + path
+    std::vector<DecodedImage> images_;
+};
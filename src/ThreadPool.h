@@ -0,0 +1,39 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads shared by the CPU-side loaders and filters
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t num_threads = 0);  // 0 = hardware concurrency
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Process-wide pool
+    static ThreadPool& Global();
+
+    size_t GetThreadCount() const { return workers_.size(); }
+
+    // Queue a task to run on a worker thread
+    void Enqueue(std::function<void()> task);
+
+    // Run fn(i) for every i in [0, count) and block until all calls have finished.
+    // The calling thread processes items too, so nested calls cannot deadlock.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+private:
+    void WorkerLoop();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+};
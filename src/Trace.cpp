@@ -0,0 +1,144 @@
+#include "Trace.h"
+#include "long_march.h"
+
+#ifdef SHORTMARCH_ENABLE_TRACING
+#include "Json.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+struct TraceEvent {
+    const char* name;
+    uint64_t start;
+    uint64_t duration;
+};
+
+// Events per thread before the oldest are overwritten (24 bytes each)
+constexpr size_t kBufferCapacity = size_t(1) << 15;
+
+struct TraceBuffer {
+    std::vector<TraceEvent> events = std::vector<TraceEvent>(kBufferCapacity);
+    std::atomic<uint64_t> count{0};  // Events ever recorded; the ring holds the last kBufferCapacity
+    std::atomic<const char*> thread_name{nullptr};
+    uint32_t thread_id = 0;
+};
+
+// Buffers outlive their threads so events of finished threads still get exported
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<TraceBuffer>> buffers;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+TraceRegistry& GetRegistry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+TraceBuffer& GetThreadBuffer() {
+    thread_local std::shared_ptr<TraceBuffer> buffer = []() {
+        auto created = std::make_shared<TraceBuffer>();
+        TraceRegistry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        created->thread_id = static_cast<uint32_t>(registry.buffers.size());
+        registry.buffers.push_back(created);
+        return created;
+    }();
+    return *buffer;
+}
+}
+
+uint64_t Trace::Now() {
+    auto elapsed = std::chrono::steady_clock::now() - GetRegistry().epoch;
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+void Trace::Record(const char* name, uint64_t start, uint64_t end) {
+    TraceBuffer& buffer = GetThreadBuffer();
+    uint64_t index = buffer.count.load(std::memory_order_relaxed);
+    buffer.events[index % kBufferCapacity] = {name, start, end - start};
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+void Trace::SetThreadName(const char* name) {
+    GetThreadBuffer().thread_name.store(name, std::memory_order_relaxed);
+}
+
+bool Trace::WriteChromeTrace(const std::string& path) {
+    std::vector<std::shared_ptr<TraceBuffer>> buffers;
+    {
+        TraceRegistry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        buffers = registry.buffers;
+    }
+
+    std::ofstream file(path);
+    if (!file) {
+        grassland::LogError("Failed to open trace file {}", path);
+        return false;
+    }
+
+    // Complete ("X") events with microsecond timestamps, plus thread names
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    size_t written = 0;
+    uint64_t dropped = 0;
+    char line[512];
+    for (const auto& buffer : buffers) {
+        const char* thread_name = buffer->thread_name.load(std::memory_order_relaxed);
+        std::string label = thread_name ? thread_name : "thread";
+        if (!thread_name || label != "main") {
+            label += " " + std::to_string(buffer->thread_id);
+        }
+        std::snprintf(line, sizeof(line),
+                      "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                      first ? "" : ",\n", buffer->thread_id, EscapeJson(label).c_str());
+        file << line;
+        first = false;
+
+        uint64_t count = buffer->count.load(std::memory_order_acquire);
+        uint64_t begin = count > kBufferCapacity ? count - kBufferCapacity : 0;
+        dropped += begin;
+        for (uint64_t i = begin; i < count; ++i) {
+            const TraceEvent& event = buffer->events[i % kBufferCapacity];
+            std::snprintf(line, sizeof(line),
+                          ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                          EscapeJson(event.name).c_str(), buffer->thread_id, event.start * 1e-3,
+                          event.duration * 1e-3);
+            file << line;
+        }
+        written += static_cast<size_t>(count - begin);
+    }
+    file << "\n]}\n";
+
+    if (!file) {
+        grassland::LogError("Failed to write trace file {}", path);
+        return false;
+    }
+    if (dropped > 0) {
+        grassland::LogWarning("Trace buffers wrapped: the oldest {} events were overwritten", dropped);
+    }
+    grassland::LogInfo("Wrote {} trace events from {} threads to {}", written, buffers.size(), path);
+    return true;
+}
+#else
+uint64_t Trace::Now() {
+    return 0;
+}
+
+void Trace::Record(const char*, uint64_t, uint64_t) {}
+
+void Trace::SetThreadName(const char*) {}
+
+bool Trace::WriteChromeTrace(const std::string& path) {
+    grassland::LogWarning("Not writing {}: tracing was compiled out (configure with -DSHORTMARCH_ENABLE_TRACING=ON)",
+                          path);
+    return false;
+}
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Scoped CPU timers exported as Chrome trace-event JSON (open the file in
+// chrome://tracing or ui.perfetto.dev). Everything here compiles to nothing
+// unless SHORTMARCH_ENABLE_TRACING is defined (CMake option of the same name).
+// Each thread appends to its own fixed-size ring buffer, so a scope costs two
+// clock reads and one store with no locking; when a buffer wraps the oldest
+// events are overwritten.
+class Trace {
+public:
+    static constexpr bool IsEnabled() {
+#ifdef SHORTMARCH_ENABLE_TRACING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Nanoseconds since the trace epoch (first use)
+    static uint64_t Now();
+
+    // Append a complete event to the calling thread's buffer. The name is
+    // stored by pointer, so it must be a string literal.
+    static void Record(const char* name, uint64_t start, uint64_t end);
+
+    // Label the calling thread in the exported trace (string literal)
+    static void SetThreadName(const char* name);
+
+    // Write the events of all threads. Call while the workers are idle
+    // (e.g. on exit): buffers are read without synchronizing with writers.
+    static bool WriteChromeTrace(const std::string& path);
+};
+
+#ifdef SHORTMARCH_ENABLE_TRACING
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : name_(name), start_(Trace::Now()) {}
+    ~TraceScope() { Trace::Record(name_, start_, Trace::Now()); }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name_;
+    uint64_t start_;
+};
+
+#define SHORTMARCH_TRACE_CONCAT_(a, b) a##b
+#define SHORTMARCH_TRACE_CONCAT(a, b) SHORTMARCH_TRACE_CONCAT_(a, b)
+// Time the rest of the enclosing block under `name` (a string literal)
+#define TRACE_SCOPE(name) TraceScope SHORTMARCH_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) Trace::SetThreadName(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
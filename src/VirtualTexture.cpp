@@ -0,0 +1,565 @@
+#include "VirtualTexture.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+std::string MakeKey(TextureKind kind, const std::string& value) {
+    return std::to_string(kind) + ":" + value;
+}
+
+// Contiguous source ranges covering one page axis, wrapping at the level edge
+struct PageRun {
+    int src;
+    int dst;
+    int len;
+};
+
+std::vector<PageRun> MakePageRuns(int start, int size) {
+    std::vector<PageRun> runs;
+    for (int i = 0; i < VirtualTextureSystem::kPageStride; ++i) {
+        int src = ((start + i) % size + size) % size;
+        if (!runs.empty() && runs.back().src + runs.back().len == src) {
+            runs.back().len++;
+        } else {
+            runs.push_back({src, i, 1});
+        }
+    }
+    return runs;
+}
+
+}  // namespace
+
+int VirtualTextureSystem::VirtualTexture::GetLevelWidth(int level) const {
+    return std::max(1, static_cast<int>(gpu.width) >> level);
+}
+
+int VirtualTextureSystem::VirtualTexture::GetLevelHeight(int level) const {
+    return std::max(1, static_cast<int>(gpu.height) >> level);
+}
+
+void VirtualTextureSystem::VirtualTexture::ReadRegion(int level, int x, int y, int w, int h, uint8_t* rgba) const {
+    if (file) {
+        file->DecodeRegion(level, x, y, w, h, rgba);
+        return;
+    }
+    const uint8_t* src = image.GetLevelPixels(level);
+    int pitch = image.GetLevelWidth(level);
+    for (int row = 0; row < h; ++row) {
+        std::memcpy(rgba + static_cast<size_t>(row) * w * 4,
+                    src + (static_cast<size_t>(y + row) * pitch + x) * 4, static_cast<size_t>(w) * 4);
+    }
+}
+
+BlockFormat VirtualTextureSystem::VirtualTexture::GetFormat() const {
+    if (file) {
+        return file->GetFormat();
+    }
+    return kind == TEXTURE_KIND_NORMAL ? BLOCK_FORMAT_BC5 : BLOCK_FORMAT_BC1;
+}
+
+bool VirtualTextureSystem::VirtualTexture::HasSameContent(const VirtualTexture& other) const {
+    if (file && other.file) {
+        int w = file->GetWidth(), h = file->GetHeight();
+        return file->GetFormat() == other.file->GetFormat() && w == other.file->GetWidth() &&
+               h == other.file->GetHeight() && file->GetLevelCount() == other.file->GetLevelCount() &&
+               std::memcmp(file->GetLevelData(0), other.file->GetLevelData(0),
+                           TextureCache::GetLevelSize(w, h, file->GetFormat())) == 0;
+    }
+    if (!file && !other.file) {
+        return image.width == other.image.width && image.height == other.image.height &&
+               image.GetLevelCount() == other.image.GetLevelCount() && image.pixels == other.image.pixels;
+    }
+    // Cached blocks and decoded pixels are hashed differently, never share them
+    return false;
+}
+
+VirtualTextureSystem::VirtualTextureSystem(grassland::graphics::Core* core, size_t budget_bytes)
+    : core_(core), budget_bytes_(budget_bytes) {
+    feedback_.assign(kFeedbackSize, 0);
+    for (auto& buffer : feedback_buffers_) {
+        core_->CreateBuffer(kFeedbackSize * sizeof(uint32_t), grassland::graphics::BUFFER_TYPE_DYNAMIC, &buffer);
+        buffer->UploadData(feedback_.data(), kFeedbackSize * sizeof(uint32_t));
+    }
+
+    // Placeholders keep the bindings valid until the first texture arrives
+    uint32_t zero[4] = {0, 0, 0, 0};
+    core_->CreateBuffer(sizeof(zero), grassland::graphics::BUFFER_TYPE_DYNAMIC, &pool_buffer_);
+    pool_buffer_->UploadData(zero, sizeof(zero));
+    UploadTables();
+}
+
+std::vector<int> VirtualTextureSystem::AddTextures(const std::vector<std::pair<std::string, TextureKind>>& requests) {
+    // Open (or build) the cache files of new paths in parallel
+    std::vector<size_t> pending;
+    std::unordered_map<std::string, size_t> pending_lookup;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        std::string key = MakeKey(requests[i].second, requests[i].first);
+        if (!path_to_id_.count(key) && !pending_lookup.count(key)) {
+            pending_lookup[key] = pending.size();
+            pending.push_back(i);
+        }
+    }
+
+    std::vector<std::unique_ptr<VirtualTexture>> loaded(pending.size());
+    ThreadPool::Global().ParallelFor(pending.size(), [&](size_t i) {
+        const auto& [path, kind] = requests[pending[i]];
+        auto texture = std::make_unique<VirtualTexture>();
+        texture->path = path;
+        texture->kind = kind;
+        texture->file = std::make_unique<TextureCacheFile>();
+        if (!TextureCache::Open(path, kind, texture->file.get())) {
+            // On a miss page from the decoded source (decoding stores the cache entry
+            // for later launches) rather than from its lossy cached copy
+            texture->file.reset();
+            texture->image = TextureLoader::Decode(path, kind);
+        }
+        texture->content_hash = texture->file ? texture->file->ComputeContentHash() : texture->image.content_hash;
+        loaded[i] = std::move(texture);
+    });
+
+    // Register in request order so IDs are deterministic
+    size_t pages_before = resident_page_count_;
+    size_t textures_before = textures_.size();
+    for (size_t i = 0; i < pending.size(); ++i) {
+        const auto& [path, kind] = requests[pending[i]];
+        RegisterTexture(path, kind, std::move(loaded[i]));
+    }
+    UploadTables();
+
+    std::vector<int> ids;
+    ids.reserve(requests.size());
+    for (const auto& [path, kind] : requests) {
+        ids.push_back(path_to_id_[MakeKey(kind, path)]);
+    }
+
+    if (!pending.empty()) {
+        grassland::LogInfo("Virtual textures: {} new paths -> {} textures, {} mip tail pages ({:.1f} MB resident)",
+                           pending.size(), textures_.size() - textures_before,
+                           resident_page_count_ - pages_before, GetResidentBytes() / (1024.0 * 1024.0));
+    }
+    return ids;
+}
+
+int VirtualTextureSystem::AddTexture(const std::string& path, TextureKind kind) {
+    return AddTextures({ {path, kind} }).front();
+}
+
+int VirtualTextureSystem::GetTextureResolution(int id) const {
+    if (id < 0 || static_cast<size_t>(id) >= textures_.size()) {
+        return 0;
+    }
+    const VirtualTextureGPUData& gpu = textures_[id]->gpu;
+    return static_cast<int>(std::max(gpu.width, gpu.height));
+}
+
+int VirtualTextureSystem::RegisterTexture(const std::string& path, TextureKind kind,
+                                          std::unique_ptr<VirtualTexture> texture) {
+    std::string path_key = MakeKey(kind, path);
+    if (!texture->file && !texture->image.IsValid()) {
+        path_to_id_[path_key] = -1;
+        return -1;
+    }
+
+    // Identical content under another path: share the existing virtual texture
+    std::string hash_key = MakeKey(kind, std::to_string(texture->content_hash));
+    auto same = hash_to_id_.find(hash_key);
+    if (same != hash_to_id_.end()) {
+        if (textures_[same->second]->HasSameContent(*texture)) {
+            path_to_id_[path_key] = same->second;
+            grassland::LogInfo("Texture {} has the same content as virtual texture {}", path, same->second);
+            return same->second;
+        }
+        grassland::LogWarning("Texture {} collides with the content hash of virtual texture {}", path, same->second);
+    }
+
+    VirtualTexture& tex = *texture;
+    int available_levels;
+    if (tex.file) {
+        tex.gpu.width = tex.file->GetWidth();
+        tex.gpu.height = tex.file->GetHeight();
+        available_levels = tex.file->GetLevelCount();
+    } else {
+        tex.gpu.width = tex.image.width;
+        tex.gpu.height = tex.image.height;
+        available_levels = tex.image.GetLevelCount();
+    }
+    tex.gpu.format = tex.GetFormat();
+
+    // Levels below the first single-page level are never paged
+    int tail = 0;
+    while (tail + 1 < available_levels &&
+           (tex.GetLevelWidth(tail) > kPageSize || tex.GetLevelHeight(tail) > kPageSize)) {
+        ++tail;
+    }
+    tex.gpu.level_count = tail + 1;
+    tex.gpu.page_table_offset = static_cast<uint32_t>(page_table_.size());
+    uint32_t offset = tex.gpu.page_table_offset;
+    for (int level = 0; level <= tail; ++level) {
+        tex.level_offsets.push_back(offset);
+        offset += tex.GetPagesX(level) * tex.GetPagesY(level);
+    }
+    page_table_.resize(offset, 0);
+
+    int id = static_cast<int>(textures_.size());
+    textures_.push_back(std::move(texture));
+    path_to_id_[path_key] = id;
+    hash_to_id_.emplace(hash_key, id);
+
+    // Pin the mip tail so sampling always has a fallback
+    const VirtualTexture& registered = *textures_.back();
+    std::vector<uint8_t> blocks;
+    FillPage({id, tail, 0, 0}, blocks);
+    MapPage(registered.level_offsets[tail], blocks, true);
+
+    grassland::LogInfo("Virtual texture {}: {} ({}x{}, {} paged levels) -> {} pages",
+                       id, path, registered.gpu.width, registered.gpu.height, tail + 1,
+                       offset - registered.gpu.page_table_offset);
+    return id;
+}
+
+VirtualTextureSystem::PageKey VirtualTextureSystem::ResolvePageTableIndex(uint32_t index) const {
+    auto it = std::upper_bound(textures_.begin(), textures_.end(), index,
+                               [](uint32_t value, const std::unique_ptr<VirtualTexture>& tex) {
+                                   return value < tex->gpu.page_table_offset;
+                               });
+    int texture = static_cast<int>(it - textures_.begin()) - 1;
+    const VirtualTexture& tex = *textures_[texture];
+    int level = static_cast<int>(tex.gpu.level_count) - 1;
+    while (level > 0 && tex.level_offsets[level] > index) {
+        --level;
+    }
+    int local = static_cast<int>(index - tex.level_offsets[level]);
+    int pages_x = tex.GetPagesX(level);
+    return {texture, level, local % pages_x, local / pages_x};
+}
+
+void VirtualTextureSystem::FillPage(const PageKey& key, std::vector<uint8_t>& blocks) const {
+    const VirtualTexture& tex = *textures_[key.texture];
+    int w = tex.GetLevelWidth(key.level), h = tex.GetLevelHeight(key.level);
+    BlockFormat format = tex.GetFormat();
+    size_t block_bytes = format == BLOCK_FORMAT_BC1 ? 8 : 16;
+
+    // Cached levels made of whole blocks are copied block by block. Others (odd
+    // sizes, where wrapping splits blocks, and decoded sources) are encoded per page.
+    const uint8_t* source;
+    int source_x, source_y, source_blocks_x, source_blocks_y;
+    std::vector<uint8_t> encoded;
+    if (tex.file && w % 4 == 0 && h % 4 == 0) {
+        source = tex.file->GetLevelData(key.level);
+        source_x = (key.page_x * kPageSize - kPageBorder) / 4;
+        source_y = (key.page_y * kPageSize - kPageBorder) / 4;
+        source_blocks_x = w / 4;
+        source_blocks_y = h / 4;
+    } else {
+        std::vector<uint8_t> texels;
+        ReadPageTexels(key, texels);
+        encoded = TextureCache::EncodeLevel(texels.data(), kPageStride, kPageStride, format);
+        source = encoded.data();
+        source_x = source_y = 0;
+        source_blocks_x = source_blocks_y = kPageBlocks;
+    }
+
+    // BC1 blocks fill one physical page; BC5 blocks are split into their red and green halves
+    blocks.resize(kPhysicalPageBytes * (block_bytes / 8));
+    for (int by = 0; by < kPageBlocks; ++by) {
+        int sy = ((source_y + by) % source_blocks_y + source_blocks_y) % source_blocks_y;
+        for (int bx = 0; bx < kPageBlocks; ++bx) {
+            int sx = ((source_x + bx) % source_blocks_x + source_blocks_x) % source_blocks_x;
+            const uint8_t* in = source + (static_cast<size_t>(sy) * source_blocks_x + sx) * block_bytes;
+            size_t index = static_cast<size_t>(by) * kPageBlocks + bx;
+            for (size_t half = 0; half < block_bytes / 8; ++half) {
+                std::memcpy(&blocks[half * kPhysicalPageBytes + index * 8], in + half * 8, 8);
+            }
+        }
+    }
+}
+
+void VirtualTextureSystem::ReadPageTexels(const PageKey& key, std::vector<uint8_t>& texels) const {
+    const VirtualTexture& tex = *textures_[key.texture];
+    int w = tex.GetLevelWidth(key.level), h = tex.GetLevelHeight(key.level);
+    int x0 = key.page_x * kPageSize - kPageBorder, y0 = key.page_y * kPageSize - kPageBorder;
+    texels.resize(static_cast<size_t>(kPageStride) * kPageStride * 4);
+
+    if (w <= kPageSize && h <= kPageSize) {
+        // Single-page level: decode it whole and tile it into the page
+        std::vector<uint8_t> level(static_cast<size_t>(w) * h * 4);
+        tex.ReadRegion(key.level, 0, 0, w, h, level.data());
+        for (int y = 0; y < kPageStride; ++y) {
+            int sy = ((y0 + y) % h + h) % h;
+            for (int x = 0; x < kPageStride; ++x) {
+                int sx = ((x0 + x) % w + w) % w;
+                std::memcpy(&texels[(static_cast<size_t>(y) * kPageStride + x) * 4],
+                            &level[(static_cast<size_t>(sy) * w + sx) * 4], 4);
+            }
+        }
+        return;
+    }
+
+    std::vector<uint8_t> region;
+    for (const PageRun& ry : MakePageRuns(y0, h)) {
+        for (const PageRun& rx : MakePageRuns(x0, w)) {
+            region.resize(static_cast<size_t>(rx.len) * ry.len * 4);
+            tex.ReadRegion(key.level, rx.src, ry.src, rx.len, ry.len, region.data());
+            for (int row = 0; row < ry.len; ++row) {
+                std::memcpy(&texels[(static_cast<size_t>(ry.dst + row) * kPageStride + rx.dst) * 4],
+                            &region[static_cast<size_t>(row) * rx.len * 4], static_cast<size_t>(rx.len) * 4);
+            }
+        }
+    }
+}
+
+uint32_t VirtualTextureSystem::AllocatePhysicalPage(bool pinned) {
+    size_t budget_pages = std::clamp<size_t>(budget_bytes_ / kPhysicalPageBytes, 1, kMaxPhysicalPages);
+    if (free_pages_.empty() && physical_pages_.size() < budget_pages) {
+        GrowPool(std::min(budget_pages, std::max<size_t>(64, physical_pages_.size() * 2)));
+    }
+    if (free_pages_.empty()) {
+        // Evict the least recently used page that was not requested this frame
+        uint32_t victim = UINT32_MAX;
+        for (uint32_t i = 0; i < physical_pages_.size(); ++i) {
+            const PhysicalPage& page = physical_pages_[i];
+            if (page.pinned || page.last_used >= frame_) continue;
+            if (victim == UINT32_MAX || page.last_used < physical_pages_[victim].last_used) {
+                victim = i;
+            }
+        }
+        if (victim != UINT32_MAX) {
+            UnmapPage(physical_pages_[victim].page_table_index);
+        } else if (!pinned) {
+            return UINT32_MAX;
+        } else if (physical_pages_.size() < kMaxPhysicalPages) {
+            // Mip tails must stay resident even past the budget
+            grassland::LogWarning("Virtual texture mip tails exceed the {} MB budget, growing the page pool",
+                                  budget_bytes_ >> 20);
+            GrowPool(std::min(physical_pages_.size() + 64, kMaxPhysicalPages));
+        } else {
+            grassland::LogError("Virtual texture pool is full ({} physical pages)", kMaxPhysicalPages);
+            return UINT32_MAX;
+        }
+    }
+    uint32_t page = free_pages_.back();
+    free_pages_.pop_back();
+    return page;
+}
+
+bool VirtualTextureSystem::MapPage(uint32_t page_table_index, const std::vector<uint8_t>& blocks, bool pinned) {
+    // Claim every physical page first: claimed ones are used this frame, so
+    // allocating the next cannot evict them
+    size_t count = blocks.size() / kPhysicalPageBytes;
+    uint32_t physical[2] = {UINT32_MAX, UINT32_MAX};
+    for (size_t i = 0; i < count; ++i) {
+        physical[i] = AllocatePhysicalPage(pinned);
+        if (physical[i] == UINT32_MAX) {
+            for (size_t j = 0; j < i; ++j) {
+                physical_pages_[physical[j]] = PhysicalPage();
+                free_pages_.push_back(physical[j]);
+            }
+            return false;
+        }
+        PhysicalPage& page = physical_pages_[physical[i]];
+        page.page_table_index = page_table_index;
+        page.last_used = frame_;
+        page.pinned = pinned;
+    }
+
+    uint32_t entry = 0;
+    for (size_t i = 0; i < count; ++i) {
+        pool_buffer_->UploadData(blocks.data() + i * kPhysicalPageBytes, kPhysicalPageBytes,
+                                 physical[i] * kPhysicalPageBytes);
+        entry |= (physical[i] + 1) << (16 * i);
+    }
+    page_table_[page_table_index] = entry;
+    if (page_table_buffer_->Size() >= (page_table_index + 1) * sizeof(uint32_t)) {
+        page_table_buffer_->UploadData(&page_table_[page_table_index], sizeof(uint32_t),
+                                       page_table_index * sizeof(uint32_t));
+    }
+    resident_page_count_++;
+    return true;
+}
+
+void VirtualTextureSystem::UnmapPage(uint32_t page_table_index) {
+    uint32_t entry = page_table_[page_table_index];
+    for (uint32_t slot : {entry & 0xFFFF, entry >> 16}) {
+        if (slot != 0) {
+            physical_pages_[slot - 1] = PhysicalPage();
+            free_pages_.push_back(slot - 1);
+        }
+    }
+    page_table_[page_table_index] = 0;
+    page_table_buffer_->UploadData(&page_table_[page_table_index], sizeof(uint32_t),
+                                   page_table_index * sizeof(uint32_t));
+    resident_page_count_--;
+}
+
+void VirtualTextureSystem::GrowPool(size_t page_count) {
+    size_t old_count = physical_pages_.size();
+    if (page_count <= old_count) {
+        return;
+    }
+
+    std::unique_ptr<grassland::graphics::Buffer> buffer;
+    core_->CreateBuffer(page_count * kPhysicalPageBytes, grassland::graphics::BUFFER_TYPE_DYNAMIC, &buffer);
+    if (old_count > 0) {
+        std::vector<uint8_t> contents(old_count * kPhysicalPageBytes);
+        pool_buffer_->DownloadData(contents.data(), contents.size());
+        buffer->UploadData(contents.data(), contents.size());
+    }
+    retired_.Retire(std::move(pool_buffer_));
+    pool_buffer_ = std::move(buffer);
+
+    physical_pages_.resize(page_count);
+    for (size_t i = page_count; i > old_count; --i) {
+        free_pages_.push_back(static_cast<uint32_t>(i - 1));
+    }
+    grassland::LogInfo("Virtual texture pool: {} pages ({:.1f} MB)", page_count,
+                       page_count * kPhysicalPageBytes / (1024.0 * 1024.0));
+}
+
+void VirtualTextureSystem::AccumulateMemory(MemoryReport* report) const {
+    auto category = [](TextureKind kind) {
+        return kind == TEXTURE_KIND_NORMAL ? MEMORY_CATEGORY_NORMAL_MAPS : MEMORY_CATEGORY_TEXTURES;
+    };
+    for (const auto& texture : textures_) {
+        MemoryCategory target = category(texture->kind);
+        if (texture->file) {
+            report->AddMapped(target, texture->file->GetFileSize());
+        }
+        size_t image_bytes = MemoryReport::GetVectorBytes(texture->image.pixels);
+        for (const auto& mip : texture->image.mips) {
+            image_bytes += MemoryReport::GetVectorBytes(mip);
+        }
+        report->AddCpu(target, image_bytes + MemoryReport::GetVectorBytes(texture->level_offsets));
+    }
+
+    size_t free_bytes = MemoryReport::GetBufferBytes(pool_buffer_.get());
+    for (const PhysicalPage& page : physical_pages_) {
+        if (page.page_table_index != UINT32_MAX) {
+            const VirtualTexture& owner = *textures_[ResolvePageTableIndex(page.page_table_index).texture];
+            report->AddGpu(category(owner.kind), kPhysicalPageBytes);
+            free_bytes -= std::min(free_bytes, kPhysicalPageBytes);
+        }
+    }
+    size_t feedback_bytes = 0;
+    for (const auto& buffer : feedback_buffers_) {
+        feedback_bytes += MemoryReport::GetBufferBytes(buffer.get());
+    }
+    report->AddGpu(MEMORY_CATEGORY_TEXTURES, free_bytes + MemoryReport::GetBufferBytes(page_table_buffer_.get()) +
+                                                 MemoryReport::GetBufferBytes(texture_info_buffer_.get()) +
+                                                 feedback_bytes);
+    report->AddCpu(MEMORY_CATEGORY_TEXTURES,
+                   MemoryReport::GetVectorBytes(page_table_) + MemoryReport::GetVectorBytes(physical_pages_) +
+                       MemoryReport::GetVectorBytes(free_pages_) + MemoryReport::GetVectorBytes(feedback_));
+}
+
+void VirtualTextureSystem::UploadTables() {
+    // One zeroed entry keeps each binding valid while empty
+    size_t table_size = std::max<size_t>(1, page_table_.size()) * sizeof(uint32_t);
+    if (!page_table_buffer_ || page_table_buffer_->Size() != table_size) {
+        retired_.Retire(std::move(page_table_buffer_));
+        core_->CreateBuffer(table_size, grassland::graphics::BUFFER_TYPE_DYNAMIC, &page_table_buffer_);
+    }
+    if (page_table_.empty()) {
+        uint32_t zero = 0;
+        page_table_buffer_->UploadData(&zero, sizeof(zero));
+    } else {
+        page_table_buffer_->UploadData(page_table_.data(), table_size);
+    }
+
+    std::vector<VirtualTextureGPUData> infos;
+    infos.reserve(textures_.size());
+    for (const auto& tex : textures_) {
+        infos.push_back(tex->gpu);
+    }
+    if (infos.empty()) {
+        infos.push_back(VirtualTextureGPUData{});
+    }
+    size_t info_size = infos.size() * sizeof(VirtualTextureGPUData);
+    if (!texture_info_buffer_ || texture_info_buffer_->Size() != info_size) {
+        retired_.Retire(std::move(texture_info_buffer_));
+        core_->CreateBuffer(info_size, grassland::graphics::BUFFER_TYPE_DYNAMIC, &texture_info_buffer_);
+    }
+    texture_info_buffer_->UploadData(infos.data(), info_size);
+}
+
+size_t VirtualTextureSystem::Update() {
+    TRACE_SCOPE("VirtualTextureSystem::Update");
+    frame_++;
+    retired_.NextFrame();
+    if (textures_.empty()) {
+        return 0;
+    }
+
+    // Gather the pages sampled two frames ago, whose buffer the GPU is done with, and
+    // clear it for reuse. This frame writes the next buffer in the ring, and the last
+    // frame's buffer is left alone while it may still be in flight.
+    grassland::graphics::Buffer* feedback = feedback_buffers_[(frame_ + 1) % kFeedbackRingSize].get();
+    feedback->DownloadData(feedback_.data(), kFeedbackSize * sizeof(uint32_t));
+    std::vector<uint32_t> requests;
+    for (uint32_t value : feedback_) {
+        if (value != 0 && value - 1 < page_table_.size()) {
+            requests.push_back(value - 1);
+        }
+    }
+    std::fill(feedback_.begin(), feedback_.end(), 0);
+    feedback->UploadData(feedback_.data(), kFeedbackSize * sizeof(uint32_t));
+
+    std::sort(requests.begin(), requests.end());
+    requests.erase(std::unique(requests.begin(), requests.end()), requests.end());
+
+    std::vector<uint32_t> missing_indices;
+    for (uint32_t index : requests) {
+        if (uint32_t entry = page_table_[index]) {
+            for (uint32_t slot : {entry & 0xFFFF, entry >> 16}) {
+                if (slot != 0) {
+                    physical_pages_[slot - 1].last_used = frame_;
+                }
+            }
+        } else {
+            missing_indices.push_back(index);
+        }
+    }
+    if (missing_indices.empty()) {
+        return 0;
+    }
+
+    // Coarse levels first so detail refines progressively
+    std::vector<std::pair<PageKey, uint32_t>> loads;
+    for (uint32_t index : missing_indices) {
+        loads.emplace_back(ResolvePageTableIndex(index), index);
+    }
+    std::stable_sort(loads.begin(), loads.end(), [](const auto& a, const auto& b) {
+        return a.first.level > b.first.level;
+    });
+    if (loads.size() > kMaxPagesPerUpdate) {
+        loads.resize(kMaxPagesPerUpdate);
+    }
+
+    std::vector<std::vector<uint8_t>> staging(loads.size());
+    ThreadPool::Global().ParallelFor(loads.size(), [&](size_t i) {
+        FillPage(loads[i].first, staging[i]);
+    });
+
+    size_t loaded = 0;
+    for (size_t i = 0; i < loads.size(); ++i) {
+        if (!MapPage(loads[i].second, staging[i], false)) {
+            break;  // Every page is in use this frame
+        }
+        loaded++;
+    }
+    return loaded;
+}
+
+void VirtualTextureSystem::Clear() {
+    textures_.clear();
+    path_to_id_.clear();
+    hash_to_id_.clear();
+    page_table_.clear();
+    physical_pages_.clear();
+    free_pages_.clear();
+    resident_page_count_ = 0;
+    UploadTables();
+}
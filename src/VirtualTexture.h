@@ -0,0 +1,157 @@
+#pragma once
+#include "long_march.h"
+#include "GpuRetireQueue.h"
+#include "MemoryReport.h"
+#include "TextureCache.h"
+#include "TextureLoader.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// GPU-side description of a virtual texture (matches HLSL VirtualTextureInfo)
+struct VirtualTextureGPUData {
+    uint32_t width;              // Level 0 size
+    uint32_t height;
+    uint32_t level_count;        // Levels down to the mip tail (first level that fits in one page)
+    uint32_t page_table_offset;  // First page table entry of level 0
+    uint32_t format;             // BlockFormat of its pages
+    uint32_t padding[3];
+};
+
+// Virtual texturing: every texture and normal map is split into fixed-size
+// pages per mip level. Pages live in one physical pool buffer; each texture
+// owns a range of the page table mapping its pages to pool slots. The shader
+// writes the pages it wants into a feedback buffer and Update() streams the
+// missing ones in from the texture cache, evicting the least recently used
+// pages once the pool reaches the memory budget. The mip tail of every
+// texture stays resident so a coarser fallback always exists.
+//
+// Pages stay block-compressed in the pool and the shader decodes the texels
+// it filters. A physical page holds one 8-byte block per 4x4 texels, so a BC1
+// page takes one physical page and a BC5 page two (its red and green BC4
+// halves); its page table entry packs both slots into 16 bits each.
+class VirtualTextureSystem {
+public:
+    // Keep in sync with VT_* in shader.hlsl
+    static constexpr int kPageSize = 128;                    // Texels per page side
+    static constexpr int kPageBorder = 4;                    // One block of border texels for bilinear filtering
+    static constexpr int kPageStride = kPageSize + 2 * kPageBorder;
+    static constexpr int kPageBlocks = kPageStride / 4;      // 4x4 blocks per page side
+    static constexpr size_t kPhysicalPageBytes = static_cast<size_t>(kPageBlocks) * kPageBlocks * 8;
+    static constexpr size_t kMaxPhysicalPages = 0xFFFF;      // Slots are 16 bits in a page table entry
+    static constexpr size_t kFeedbackSize = 1 << 16;         // Feedback slots (power of two)
+    static constexpr size_t kFeedbackRingSize = 3;           // Feedback buffers, read back two frames late
+    static constexpr size_t kMaxPagesPerUpdate = 64;
+    static constexpr size_t kDefaultBudget = 256ull << 20;
+
+    explicit VirtualTextureSystem(grassland::graphics::Core* core, size_t budget_bytes = kDefaultBudget);
+
+    // Register textures (cache lookup and encoding run in parallel). Returns one
+    // virtual texture ID per request, -1 for files that failed to load. Paths
+    // and identical contents of the same kind share one ID.
+    std::vector<int> AddTextures(const std::vector<std::pair<std::string, TextureKind>>& requests);
+    int AddTexture(const std::string& path, TextureKind kind);
+
+    // Read back the feedback of the frame before last (the last one may still be
+    // running on the GPU) and stream in missing pages. Returns the number of pages loaded.
+    // Call once per frame, before binding GetFeedbackBuffer().
+    size_t Update();
+
+    void Clear();
+
+    // Pool growth stops at the budget; beyond it pages are evicted
+    void SetMemoryBudget(size_t bytes) { budget_bytes_ = bytes; }
+    size_t GetMemoryBudget() const { return budget_bytes_; }
+
+    size_t GetTextureCount() const { return textures_.size(); }
+    // Larger side of a texture's level 0 in texels (0 for invalid IDs)
+    int GetTextureResolution(int id) const;
+    size_t GetResidentPageCount() const { return resident_page_count_; }
+    size_t GetPhysicalPageCount() const { return physical_pages_.size(); }
+    size_t GetResidentBytes() const { return (physical_pages_.size() - free_pages_.size()) * kPhysicalPageBytes; }
+
+    // Resident pages and sources go to textures or normal maps by kind; free
+    // pool slots, page tables and feedback count as textures
+    void AccumulateMemory(MemoryReport* report) const;
+
+    grassland::graphics::Buffer* GetPoolBuffer() const { return pool_buffer_.get(); }
+    grassland::graphics::Buffer* GetPageTableBuffer() const { return page_table_buffer_.get(); }
+    grassland::graphics::Buffer* GetTextureInfoBuffer() const { return texture_info_buffer_.get(); }
+    // Feedback buffer the shader writes this frame
+    grassland::graphics::Buffer* GetFeedbackBuffer() const {
+        return feedback_buffers_[frame_ % kFeedbackRingSize].get();
+    }
+
+private:
+    struct VirtualTexture {
+        std::string path;
+        TextureKind kind = TEXTURE_KIND_COLOR;
+        std::unique_ptr<TextureCacheFile> file;  // Block-compressed pages are decoded from here
+        DecodedImage image;                      // Fallback when the cache is unavailable
+        uint64_t content_hash = 0;
+        VirtualTextureGPUData gpu{};
+        std::vector<uint32_t> level_offsets;     // Page table offset of each level
+
+        int GetLevelWidth(int level) const;
+        int GetLevelHeight(int level) const;
+        int GetPagesX(int level) const { return (GetLevelWidth(level) + kPageSize - 1) / kPageSize; }
+        int GetPagesY(int level) const { return (GetLevelHeight(level) + kPageSize - 1) / kPageSize; }
+        // BC1 for textures, BC5 for normal maps (as stored in the texture cache)
+        BlockFormat GetFormat() const;
+        // Decode an in-bounds region of a level into RGBA8
+        void ReadRegion(int level, int x, int y, int w, int h, uint8_t* rgba) const;
+        // Same dimensions and level 0 data (the content hash alone may collide)
+        bool HasSameContent(const VirtualTexture& other) const;
+    };
+
+    struct PhysicalPage {
+        uint32_t page_table_index = UINT32_MAX;  // Owner, UINT32_MAX when free
+        uint64_t last_used = 0;
+        bool pinned = false;
+    };
+
+    // Location of a page table entry
+    struct PageKey {
+        int texture;
+        int level;
+        int page_x;
+        int page_y;
+    };
+
+    int RegisterTexture(const std::string& path, TextureKind kind, std::unique_ptr<VirtualTexture> texture);
+    PageKey ResolvePageTableIndex(uint32_t index) const;
+    // Blocks of a page in physical page order (the BC5 red halves, then the green halves)
+    void FillPage(const PageKey& key, std::vector<uint8_t>& blocks) const;
+    // RGBA8 texels of a page with its border, wrapping at the level edge
+    void ReadPageTexels(const PageKey& key, std::vector<uint8_t>& texels) const;
+    // Free or LRU physical page; pinned requests may grow the pool past the budget (UINT32_MAX if none)
+    uint32_t AllocatePhysicalPage(bool pinned);
+    bool MapPage(uint32_t page_table_index, const std::vector<uint8_t>& blocks, bool pinned);
+    // Drop a page from the page table and free its physical pages
+    void UnmapPage(uint32_t page_table_index);
+    void GrowPool(size_t page_count);
+    void UploadTables();
+
+    grassland::graphics::Core* core_;
+    size_t budget_bytes_;
+    uint64_t frame_ = 0;
+
+    std::vector<std::unique_ptr<VirtualTexture>> textures_;
+    std::unordered_map<std::string, int> path_to_id_;  // Keyed by kind + path
+    std::unordered_map<std::string, int> hash_to_id_;  // Keyed by kind + content hash
+
+    std::vector<uint32_t> page_table_;  // 0 = not resident, otherwise physical page + 1 (second one << 16 for BC5)
+    std::vector<PhysicalPage> physical_pages_;
+    std::vector<uint32_t> free_pages_;
+    size_t resident_page_count_ = 0;
+
+    std::unique_ptr<grassland::graphics::Buffer> pool_buffer_;
+    std::unique_ptr<grassland::graphics::Buffer> page_table_buffer_;
+    std::unique_ptr<grassland::graphics::Buffer> texture_info_buffer_;
+    std::unique_ptr<grassland::graphics::Buffer> feedback_buffers_[kFeedbackRingSize];
+    std::vector<uint32_t> feedback_;
+    GpuRetireQueue retired_;  // Replaced pools and tables, kept while frames in flight may bind them
+};
@@ -1,7 +1,10 @@
 #include "app.h"
 #include "Material.h"
 #include "Entity.h"
+#include "MappedFile.h"
 #include "Scene.h"
+#include "ShaderCache.h"
+#include "Trace.h"
 
 #include "glm/gtc/matrix_transform.hpp"
 #include "imgui.h"
@@ -21,8 +24,11 @@
 namespace {
 #include "built_in_shaders.inl"
 }
-const int MAX_TEXTURE_COUNT = 64;
 const float fov = 90.0f;
+// Effective samples kept when history is reprojected into a new view
+const float kReprojectionHistoryLimit = 64.0f;
+// Skybox used when neither the command line nor the scene file names one
+const char* const kDefaultSkyboxPath = "meshes/background1.hdr";
 Application::Application(grassland::graphics::BackendAPI api) {
     grassland::graphics::CreateCore(api, grassland::graphics::Core::Settings{}, &core_);
     core_->InitializeLogicalDeviceAutoSelect(true);
@@ -188,43 +194,7 @@ void Application::OnMouseButton(int button, int action, int mods, double xpos, d
 
 
 
-void Application::OnInit() {
-    alive_ = true;
-    core_->CreateWindowObject(1280, 720,
-        ((core_->API() == grassland::graphics::BACKEND_API_VULKAN) ? "[Vulkan]" : "[D3D12]") +
-        std::string(" Ray Tracing Scene Demo"),
-        &window_);
-
-    // Initialize ImGui for this window
-    window_->InitImGui();
-
-    // Register the mouse move event handler
-    window_->MouseMoveEvent().RegisterCallback(
-        [this](double xpos, double ypos) {
-            this->OnMouseMove(xpos, ypos);
-        }
-    );
-    // Register the mouse button event handler
-    window_->MouseButtonEvent().RegisterCallback(
-        [this](int button, int action, int mods, double xpos, double ypos) {
-            this->OnMouseButton(button, action, mods, xpos, ypos);
-        }
-    );
-
-    // Initialize camera as DISABLED to avoid cursor conflicts with multiple windows
-    camera_enabled_ = false;
-    last_camera_enabled_ = false;
-    ui_hidden_ = false;
-    hovered_entity_id_ = -1; // No entity hovered initially
-    hovered_pixel_color_ = glm::vec4(0.0f); // No pixel color initially
-    selected_entity_id_ = -1; // No entity selected initially
-    mouse_x_ = 0.0;
-    mouse_y_ = 0.0;
-    // Don't grab cursor initially - user can right-click to enable camera mode
-
-    // Create scene
-    scene_ = std::make_unique<Scene>(core_.get());
-
+void Application::BuildDefaultScene() {
     // Add entities to the scene
     // Ground plane - a cube scaled to be flat
     {
@@ -332,12 +302,230 @@ void Application::OnInit() {
         );
         scene_->AddEntity(Eyeball);
     }
+}
+
+void Application::SetHeadless(int width, int height) {
+    headless_ = true;
+    width_ = width;
+    height_ = height;
+}
+
+void Application::SetRayCounting(bool enabled) {
+    ray_counting_ = enabled;
+    if (misc_buffer_) {
+        uint32_t count_rays = enabled ? 1 : 0;
+        misc_buffer_->UploadData(&count_rays, sizeof(uint32_t), 6 * sizeof(uint32_t));
+    }
+}
+
+void Application::SetLowDiscrepancySampling(bool enabled) {
+    low_discrepancy_ = enabled;
+    if (misc_buffer_) {
+        uint32_t sampler_type = enabled ? 1 : 0;  // SAMPLER_SOBOL / SAMPLER_INDEPENDENT in shader.hlsl
+        misc_buffer_->UploadData(&sampler_type, sizeof(uint32_t), 7 * sizeof(uint32_t));
+    }
+}
+
+void Application::SetFirstSample(uint32_t first_sample) {
+    first_sample_ = first_sample;
+    fixed_sequence_ = true;
+    sequence_seed_ = 0;
+}
+
+void Application::SetCheckpoint(const std::string& path, int interval_samples, bool compress) {
+    checkpoint_path_ = path;
+    checkpoint_interval_ = std::max(interval_samples, 1);
+    checkpoint_compress_ = compress;
+}
+
+uint64_t Application::GetViewHash() const {
+    uint64_t h = kHashSeed;
+    auto mix = [&h](const void* data, size_t size) { h = HashBytes(data, size, h); };
+    auto mix_string = [&mix](const std::string& s) { mix(s.c_str(), s.size() + 1); };
+    auto mix_material = [&](const Material& m) {
+        mix(&m.base_color, sizeof(m.base_color));
+        mix(&m.roughness, sizeof(m.roughness));
+        mix(&m.metallic, sizeof(m.metallic));
+        mix(&m.emission, sizeof(m.emission));
+        mix_string(m.texture_path);
+        mix_string(m.normal_path);
+    };
+
+    int size[2] = { width_, height_ };
+    mix(size, sizeof(size));
+    mix(&camera_pos_, sizeof(camera_pos_));
+    mix(&camera_front_, sizeof(camera_front_));
+    mix(&camera_up_, sizeof(camera_up_));
+    float lens[3] = { fov, aperture_size_, focal_distance_ };
+    mix(lens, sizeof(lens));
+    mix(&low_discrepancy_, sizeof(low_discrepancy_));
+    mix(&geometry_budget_, sizeof(geometry_budget_));  // Decides which entities are resident
+    mix_string(skybox_path_);
+    if (scene_) {
+        for (const auto& entity : scene_->GetEntities()) {
+            mix_string(entity->GetMeshPath());
+            mix(&entity->GetTransform(), sizeof(glm::mat4));
+            mix_material(entity->GetDefaultMaterial());
+            for (const Material& material : entity->GetMaterials()) {
+                mix_material(material);
+            }
+        }
+        for (const PointLight& light : scene_->GetPointLights()) {
+            mix(&light.position, sizeof(light.position));
+            mix(&light.color, sizeof(light.color));
+        }
+    }
+    return h;
+}
+
+FilmCheckpointInfo Application::GetCheckpointInfo() const {
+    FilmCheckpointInfo info;
+    info.view_hash = GetViewHash();
+    info.first_sample = first_sample_;
+    info.sequence_seed = sequence_seed_;
+    info.frame_index = frame_index_;
+    return info;
+}
+
+void Application::WriteCheckpoint(bool wait) {
+    TRACE_SCOPE("Application::WriteCheckpoint");
+    if (wait) {
+        checkpoint_writer_.Wait();
+    }
+    FilmData data;
+    film_->Download(&data);
+    checkpoint_samples_ = data.sample_count;
+    if (wait) {
+        if (FilmCheckpoint::Write(checkpoint_path_, data, GetCheckpointInfo(), checkpoint_compress_)) {
+            grassland::LogInfo("Film checkpoint written: {} ({} samples)", checkpoint_path_, data.sample_count);
+        }
+    } else {
+        checkpoint_writer_.WriteAsync(checkpoint_path_, std::move(data), GetCheckpointInfo(), checkpoint_compress_);
+    }
+}
+
+bool Application::ResumeFromCheckpoint(const std::string& path) {
+    TRACE_SCOPE("Application::ResumeFromCheckpoint");
+    FilmData data;
+    FilmCheckpointInfo info;
+    if (!FilmCheckpoint::Read(path, &data, &info)) {
+        return false;
+    }
+    if (info.view_hash != GetViewHash()) {
+        grassland::LogWarning("Not resuming {}: it was rendered from a different camera, scene or resolution", path);
+        return false;
+    }
+    if (!film_->Upload(data)) {
+        return false;
+    }
+    // The next sample continues the checkpoint's sequence where it stopped
+    first_sample_ = info.first_sample;
+    sequence_seed_ = info.sequence_seed;
+    frame_index_ = info.frame_index;
+    checkpoint_samples_ = data.sample_count;
+    grassland::LogInfo("Resumed {} samples from {}", data.sample_count, path);
+    return true;
+}
+
+void Application::OnInit() {
+    TRACE_SCOPE("Application::OnInit");
+    alive_ = true;
+    startup_phases_.clear();
+    auto phase_start = std::chrono::steady_clock::now();
+    uint64_t trace_phase_start = Trace::Now();
+    auto end_phase = [this, &phase_start, &trace_phase_start](const char* name) {
+        auto now = std::chrono::steady_clock::now();
+        startup_phases_.push_back({name, std::chrono::duration<double>(now - phase_start).count()});
+        phase_start = now;
+        if (Trace::IsEnabled()) {
+            uint64_t trace_now = Trace::Now();
+            Trace::Record(name, trace_phase_start, trace_now);
+            trace_phase_start = trace_now;
+        }
+    };
+
+    if (!headless_) {
+        core_->CreateWindowObject(1280, 720,
+            ((core_->API() == grassland::graphics::BACKEND_API_VULKAN) ? "[Vulkan]" : "[D3D12]") +
+            std::string(" Ray Tracing Scene Demo"),
+            &window_);
+        width_ = window_->GetWidth();
+        height_ = window_->GetHeight();
+
+        // Initialize ImGui for this window
+        window_->InitImGui();
+
+        // Register the mouse move event handler
+        window_->MouseMoveEvent().RegisterCallback(
+            [this](double xpos, double ypos) {
+                this->OnMouseMove(xpos, ypos);
+            }
+        );
+        // Register the mouse button event handler
+        window_->MouseButtonEvent().RegisterCallback(
+            [this](int button, int action, int mods, double xpos, double ypos) {
+                this->OnMouseButton(button, action, mods, xpos, ypos);
+            }
+        );
+        end_phase("window");
+    }
+
+    // Initialize camera as DISABLED to avoid cursor conflicts with multiple windows
+    camera_enabled_ = false;
+    last_camera_enabled_ = false;
+    ui_hidden_ = false;
+    hovered_entity_id_ = -1; // No entity hovered initially
+    hovered_pixel_color_ = glm::vec4(0.0f); // No pixel color initially
+    selected_entity_id_ = -1; // No entity selected initially
+    mouse_x_ = 0.0;
+    mouse_y_ = 0.0;
+    // Don't grab cursor initially - user can right-click to enable camera mode
+
+    // Read the scene file first so the skybox decodes while the meshes load
+    SceneDescription scene_description;
+    bool has_scene_file = false;
+    if (!scene_path_.empty()) {
+        std::string scene_path = std::filesystem::exists(scene_path_) ? scene_path_ : grassland::FindAssetFile(scene_path_);
+        has_scene_file = SceneFile::Load(scene_path, &scene_description);
+        if (!has_scene_file) {
+            grassland::LogWarning("Falling back to the built-in scene");
+        }
+        end_phase("scene_parse");
+    }
+    if (skybox_path_.empty()) {
+        skybox_path_ = scene_description.skybox.empty() ? kDefaultSkyboxPath : scene_description.skybox;
+    }
+    std::string skybox_path = std::filesystem::exists(skybox_path_) ? skybox_path_ : grassland::FindAssetFile(skybox_path_);
+    skybox_loader_.LoadAsync(skybox_path);
+
+    // Create scene
+    scene_ = std::make_unique<Scene>(core_.get());
+    scene_->SetGeometryBudget(geometry_budget_);
+    if (has_scene_file) {
+        SceneLoadStats load_stats;
+        SceneFile::Populate(scene_description, scene_.get(), &load_stats);
+        startup_phases_.push_back({"mesh_load", load_stats.mesh_load_seconds});
+        startup_phases_.push_back({"blas_build", load_stats.blas_build_seconds});
+        phase_start = std::chrono::steady_clock::now();
+    } else {
+        BuildDefaultScene();
+        end_phase("default_scene");
+    }
+
+    // Out-of-core scenes page in what the initial camera needs first
+    if (geometry_budget_ > 0) {
+        CameraDescription camera = scene_description.camera.value_or(CameraDescription{});
+        size_t paged_in = scene_->UpdateGeometryResidency(camera.position);
+        grassland::LogInfo("Geometry budget {:.1f} MB: {} of {} entities resident", geometry_budget_ / (1024.0 * 1024.0),
+                           paged_in, scene_->GetEntityCount());
+    }
 
     // Build acceleration structures
     scene_->BuildAccelerationStructures();
+    end_phase("tlas_build");
 
     // Create film for accumulation
-    film_ = std::make_unique<Film>(core_.get(), window_->GetWidth(), window_->GetHeight());
+    film_ = std::make_unique<Film>(core_.get(), width_, height_);
 
     core_->CreateBuffer(sizeof(CameraObject), grassland::graphics::BUFFER_TYPE_DYNAMIC, &camera_object_buffer_);
     
@@ -355,10 +543,18 @@ void Application::OnInit() {
     // Initialize new mouse/view variables
     yaw_ = -90.0f; // Point down -Z
     pitch_ = 0.0f;
-    last_x_ = (float)window_->GetWidth() / 2.0f;
-    last_y_ = (float)window_->GetHeight() / 2.0f;
+    last_x_ = (float)width_ / 2.0f;
+    last_y_ = (float)height_ / 2.0f;
     mouse_sensitivity_ = 0.1f;
     first_mouse_ = true;
+    if (scene_description.camera) {
+        const CameraDescription& camera = *scene_description.camera;
+        camera_pos_ = camera.position;
+        yaw_ = camera.yaw;
+        pitch_ = camera.pitch;
+        aperture_size_ = camera.aperture_size;
+        focal_distance_ = camera.focal_distance;
+    }
 
     // Calculate initial camera_front_ based on yaw and pitch
     glm::vec3 front;
@@ -368,28 +564,48 @@ void Application::OnInit() {
     camera_front_ = glm::normalize(front);
 
     // Set initial camera buffer data
+    glm::mat4 projection = glm::perspective(glm::radians(fov), (float)width_ / (float)height_, 0.1f, 10.0f);
+    glm::mat4 view = glm::lookAt(camera_pos_, camera_pos_ + camera_front_, camera_up_);
     CameraObject camera_object{};
-    camera_object.screen_to_camera = glm::inverse(
-        glm::perspective(glm::radians(fov), (float)window_->GetWidth() / (float)window_->GetHeight(), 0.1f, 10.0f));
-    camera_object.camera_to_world =
-        glm::inverse(glm::lookAt(camera_pos_, camera_pos_ + camera_front_, camera_up_));
+    camera_object.screen_to_camera = glm::inverse(projection);
+    camera_object.camera_to_world = glm::inverse(view);
     camera_object.aperture_size = aperture_size_;
     std::cerr<<aperture_size_<<std::endl;
     camera_object.focal_distance = focal_distance_;
+    history_world_to_screen_ = projection * view;
+    history_camera_pos_ = camera_pos_;
+    camera_object.prev_world_to_screen = history_world_to_screen_;
+    camera_object.prev_position = history_camera_pos_;
+    camera_object.reproject = 0;
+    camera_object.history_limit = kReprojectionHistoryLimit;
+    camera_object.invalidated_entity = -1;
     camera_object_buffer_->UploadData(&camera_object, sizeof(CameraObject));
 
-    core_->CreateImage(window_->GetWidth(), window_->GetHeight(), grassland::graphics::IMAGE_FORMAT_R32G32B32A32_SFLOAT,
+    core_->CreateImage(width_, height_, grassland::graphics::IMAGE_FORMAT_R32G32B32A32_SFLOAT,
         &color_image_);
     
     // Create entity ID buffer for accurate picking (R32_SINT to store entity indices)
-    core_->CreateImage(window_->GetWidth(), window_->GetHeight(), grassland::graphics::IMAGE_FORMAT_R32_SINT,
+    core_->CreateImage(width_, height_, grassland::graphics::IMAGE_FORMAT_R32_SINT,
         &entity_id_image_);
 
-    core_->CreateShader(GetShaderCode("shaders/shader.hlsl"), "RayGenMain", "lib_6_3", &raygen_shader_);
-    core_->CreateShader(GetShaderCode("shaders/shader.hlsl"), "MissMain", "lib_6_3", &miss_shader_);
-    core_->CreateShader(GetShaderCode("shaders/shader.hlsl"), "ShadowMiss", "lib_6_3", &shadow_miss_shader_);
-    core_->CreateShader(GetShaderCode("shaders/shader.hlsl"), "ClosestHitMain", "lib_6_3", &closest_hit_shader_);
+    // One compile of the library serves all four entry points; later launches load it from the shader cache
+    std::string shader_source = GetShaderCode("shaders/brdf.hlsl") + GetShaderCode("shaders/shader.hlsl");
+    std::vector<grassland::graphics::CompiledShaderBlob> shader_blobs;
+    if (ShaderCache::CompileLibrary(core_->API(), shader_source, "lib_6_3",
+                                    {"RayGenMain", "MissMain", "ShadowMiss", "ClosestHitMain"}, &shader_blobs)) {
+        core_->CreateShader(shader_blobs[0], &raygen_shader_);
+        core_->CreateShader(shader_blobs[1], &miss_shader_);
+        core_->CreateShader(shader_blobs[2], &shadow_miss_shader_);
+        core_->CreateShader(shader_blobs[3], &closest_hit_shader_);
+    } else {
+        grassland::LogWarning("Compiling the shader entry points one by one");
+        core_->CreateShader(shader_source, "RayGenMain", "lib_6_3", &raygen_shader_);
+        core_->CreateShader(shader_source, "MissMain", "lib_6_3", &miss_shader_);
+        core_->CreateShader(shader_source, "ShadowMiss", "lib_6_3", &shadow_miss_shader_);
+        core_->CreateShader(shader_source, "ClosestHitMain", "lib_6_3", &closest_hit_shader_);
+    }
     grassland::LogInfo("Shader compiled successfully");
+    end_phase("shader_compile");
 
     core_->CreateRayTracingProgram(raygen_shader_.get(), miss_shader_.get(), closest_hit_shader_.get(), &program_);
     program_ -> AddMissShader(shadow_miss_shader_. get());
@@ -402,27 +618,29 @@ void Application::OnInit() {
     program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_WRITABLE_IMAGE, 1);          // space6 - accumulated color
     program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_WRITABLE_IMAGE, 1);          // space7 - accumulated samples
     program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_UNIFORM_BUFFER, 1);          // space8 - frame count
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER, 3);          // space9 - vertices, triangles
+    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER, 1);          // space9 - global positions
     program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER, 3);          // space10 - UV buffer, Material ID Buffer, index Buffer
     program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER, 1);          // space11 - Instance Metadata Buffer
     
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_IMAGE, MAX_TEXTURE_COUNT);   // space12 - Texture Buffer
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_SAMPLER, 1);                 // space13 - Sampler for textures
+    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER, 3);          // space12 - virtual texture page pool, page table, texture infos
+    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_WRITABLE_STORAGE_BUFFER, 1); // space13 - virtual texture feedback
     
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER, 1);          // space14 - point lights
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_IMAGE, MAX_TEXTURE_COUNT);   // space15 - Normal map Buffer
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_SAMPLER, 1);                 // space16 - Normal map sampler
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_IMAGE, 1);      // space17 - HDR skybox
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_SAMPLER, 1);    // space18 - skybox sampler
+    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER, 2);          // space14 - point lights, light BVH
+    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_IMAGE, 1);      // space15 - HDR skybox
+    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_SAMPLER, 1);    // space16 - skybox sampler
+    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER, 3);          // space17 - environment marginal CDF, conditional CDFs, pdf
+    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER, 4);          // space18 - emissive triangles, triangle alias tables, emitters, emitter alias table
+    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_WRITABLE_IMAGE, 2);          // space19 - accumulated albedo, accumulated normal
+    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_WRITABLE_IMAGE, 3);          // space20 - history color, albedo, normal
+    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_WRITABLE_IMAGE, 1);          // space21 - history samples
+    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_WRITABLE_STORAGE_BUFFER, 1); // space22 - ray counters
 
     program_->Finalize();
 
     // Create a small buffer to hold the sample count (space8 expects a uniform buffer)
-    core_->CreateBuffer(16, grassland::graphics::BUFFER_TYPE_DYNAMIC, &misc_buffer_);
+    core_->CreateBuffer(48, grassland::graphics::BUFFER_TYPE_DYNAMIC, &misc_buffer_);
     uint32_t initial_sample_count = static_cast<uint32_t>(film_->GetSampleCount());
     misc_buffer_->UploadData(&initial_sample_count, sizeof(uint32_t), 0);
-    uint32_t plcnt = static_cast <uint32_t> ((scene_ -> GetPointLights()). size());
-    misc_buffer_->UploadData(&plcnt, sizeof(uint32_t), sizeof(uint32_t));
 
     // Create persistent dummy resources (do once, reuse each frame)
     // Dummy buffer (used as fallback for missing storage buffers)
@@ -430,42 +648,10 @@ void Application::OnInit() {
     core_->CreateBuffer(sizeof(uint32_t), grassland::graphics::BUFFER_TYPE_STATIC, &dummy_buffer_);
     dummy_buffer_->UploadData(&placeholder, sizeof(uint32_t), 0);
 
-    // Dummy image (1x1) - use an 8-bit RGBA UNORM format to match typical textures
-    uint8_t clear_pixel_u8[4] = {0, 0, 0, 0};
-    core_->CreateImage(1, 1, grassland::graphics::IMAGE_FORMAT_R8G8B8A8_UNORM, &dummy_image_);
-    dummy_image_->UploadData(clear_pixel_u8);
 
-    int width, height, channels;
-    float* hdr_data = stbi_loadf("C:/Users/LRYP/Desktop/ACG/project/ShortMarch/external/LongMarch/assets/meshes/background1.hdr", &width, &height, &channels, 4);
-    
-    if (hdr_data) {
-        core_->CreateImage(width, height, 
-                            grassland::graphics::IMAGE_FORMAT_R32G32B32A32_SFLOAT,
-                            &hdr_skybox_);
-        
-        // 上传数据
-        hdr_skybox_->UploadData(hdr_data);
-        
-        stbi_image_free(hdr_data);
-        grassland::LogInfo("HDR skybox loaded: {}x{}", width, height);
-    } else {
-        grassland::LogWarning("Failed to load HDR skybox, using dummy image");
-        float fallback[4] = {0.5f, 0.7f, 1.0f, 1.0f}; // 天空蓝色
-        core_->CreateImage(1, 1, 
-                            grassland::graphics::IMAGE_FORMAT_R32G32B32A32_SFLOAT,
-                            &hdr_skybox_);
-        hdr_skybox_->UploadData(fallback);
-    }
-
-    // Create a default sampler
-    grassland::graphics::SamplerInfo sampler_info{};
-    sampler_info.min_filter = grassland::graphics::FILTER_MODE_LINEAR;
-    sampler_info.mag_filter = grassland::graphics::FILTER_MODE_LINEAR;
-    sampler_info.mip_filter = grassland::graphics::FILTER_MODE_LINEAR;
-    sampler_info.address_mode_u = grassland::graphics::ADDRESS_MODE_REPEAT;
-    sampler_info.address_mode_v = grassland::graphics::ADDRESS_MODE_REPEAT;
-    sampler_info.address_mode_w = grassland::graphics::ADDRESS_MODE_REPEAT;
-    core_->CreateSampler(sampler_info, &dummy_sampler_);
+    // Render with a low-resolution placeholder sky while the HDR skybox (started above) loads in the background
+    environment_map_ = std::make_unique<EnvironmentMap>(core_.get());
+    UploadSkybox(SkyboxLoader::MakePlaceholder(), EnvironmentTables{});
 
     // Create skybox sampler
     grassland::graphics::SamplerInfo skybox_sampler_info{};
@@ -476,86 +662,88 @@ void Application::OnInit() {
     skybox_sampler_info.address_mode_v = grassland::graphics::ADDRESS_MODE_CLAMP_TO_EDGE; // 防止极点拉伸
     skybox_sampler_info.address_mode_w = grassland::graphics::ADDRESS_MODE_REPEAT;
     core_->CreateSampler(skybox_sampler_info, &skybox_sampler_);
-    
-    // Create aggregated faces and triangle index buffers from scene entities
-    {
-        std::vector<uint32_t> index_begin;
-        std::vector<glm::vec3> aggregated_vertices;
-        std::vector<uint32_t> aggregated_triangles;
-
-        int vertex_offset = 0;
-        for (const auto &entity : scene_->GetEntities()) {
-            index_begin.push_back(aggregated_triangles.size() / 3);
-            if (!entity) continue;
-            // Download vertex positions from the entity's GPU vertex buffer (if present).
-            auto *vb = entity->GetVertexBuffer();
-            size_t vcount = 0;
-            if (vb && vb->Size() >= sizeof(glm::vec3)) {
-                vcount = vb->Size() / sizeof(glm::vec3);
-                std::vector<glm::vec3> tmp(vcount);
-                // Download entire buffer content
-                vb->DownloadData(tmp.data(), vb->Size(), 0);
-
-                // Transform vertices into world space using entity transform before aggregating
-                const glm::mat4 &xform = entity->GetTransform();
-                for (size_t i = 0; i < vcount; ++i) {
-                    glm::vec4 wp = xform * glm::vec4(tmp[i], 1.0f);
-                    aggregated_vertices.push_back(glm::vec3(wp));
-                }
-            }
 
-            // Download index buffer and append, applying vertex offset so indices refer to the aggregated vertex array.
-            auto *ib = entity->GetIndexBuffer();
-            if (ib && ib->Size() >= sizeof(uint32_t)) {
-                size_t icount = ib->Size() / sizeof(uint32_t);
-                std::vector<uint32_t> itmp(icount);
-                ib->DownloadData(itmp.data(), ib->Size(), 0);
-                for (size_t i = 0; i < icount; ++i) {
-                    aggregated_triangles.push_back(static_cast<uint32_t>(itmp[i] + vertex_offset));
-                }
-            }
+    // Ray counters (space22), only written while ray counting is enabled
+    uint32_t zero_counters[4] = {0, 0, 0, 0};
+    core_->CreateBuffer(sizeof(zero_counters), grassland::graphics::BUFFER_TYPE_DYNAMIC, &ray_counter_buffer_);
+    ray_counter_buffer_->UploadData(zero_counters, sizeof(zero_counters));
+    SetRayCounting(ray_counting_);
+    SetLowDiscrepancySampling(low_discrepancy_);
 
-            vertex_offset += static_cast<int>(vcount);
-        }
+    BuildPointLightBuffer();
+    UploadEmitterInfo();
+    end_phase("resources");
 
-        // Ensure non-zero buffers (create minimal buffers if scene empty to avoid zero-sized GPU resources)
-        if (index_begin.empty()) {
-            index_begin.push_back(0u);
-        }
-        if (aggregated_vertices.empty()) {
-            aggregated_vertices.push_back(glm::vec3(0.0f));
-        }
-        if (aggregated_triangles.empty()) {
-            aggregated_triangles.push_back(0u);
-            aggregated_triangles.push_back(0u);
-            aggregated_triangles.push_back(0u);
-        }
+    GetMemoryReport().Log();
+}
 
-        // Upload aggregated data to GPU buffers bound to the raytracing program (space9)
-        core_->CreateBuffer(index_begin.size() * sizeof(uint32_t),
-                            grassland::graphics::BUFFER_TYPE_STATIC, &offsets_buffer_);
-        offsets_buffer_->UploadData(index_begin.data(), index_begin.size() * sizeof(uint32_t));
+MemoryReport Application::GetMemoryReport() const {
+    MemoryReport report;
+    scene_->AccumulateMemory(&report);
+    report.AddGpu(MEMORY_CATEGORY_SCENE_BUFFERS, MemoryReport::GetBufferBytes(point_lights_buffer_.get()));
+    light_bvh_->AccumulateMemory(&report);
+
+    report.AddGpu(MEMORY_CATEGORY_SKYBOX, MemoryReport::GetImageBytes(skybox_width_, skybox_height_,
+                                                                      grassland::graphics::IMAGE_FORMAT_R16G16B16A16_SFLOAT));
+    environment_map_->AccumulateMemory(&report);
+
+    // The frame's color and entity ID targets next to the film's images
+    film_->AccumulateMemory(&report);
+    report.AddGpu(MEMORY_CATEGORY_FILM,
+                  MemoryReport::GetImageBytes(width_, height_, grassland::graphics::IMAGE_FORMAT_R32G32B32A32_SFLOAT) +
+                      MemoryReport::GetImageBytes(width_, height_, grassland::graphics::IMAGE_FORMAT_R32_SINT));
+    return report;
+}
 
-        core_->CreateBuffer(aggregated_vertices.size() * sizeof(glm::vec3),
-                            grassland::graphics::BUFFER_TYPE_STATIC, &vertices_buffer_);
-        vertices_buffer_->UploadData(aggregated_vertices.data(), aggregated_vertices.size() * sizeof(glm::vec3));
+void Application::UploadSkybox(const HdrImage& image, const EnvironmentTables& tables) {
+    // Half floats with bilinear filtering (half the footprint of RGBA32F)
+    core_->CreateImage(image.width, image.height, grassland::graphics::IMAGE_FORMAT_R16G16B16A16_SFLOAT, &hdr_skybox_);
+    skybox_width_ = image.width;
+    skybox_height_ = image.height;
+    hdr_skybox_->UploadData(image.pixels.data());
+    environment_map_->Upload(tables);
+
+    // Environment sampling table size (0 x 0 disables explicit environment sampling)
+    uint32_t environment_size[2] = {static_cast<uint32_t>(environment_map_->GetWidth()),
+                                    static_cast<uint32_t>(environment_map_->GetHeight())};
+    misc_buffer_->UploadData(environment_size, sizeof(environment_size), 2 * sizeof(uint32_t));
+}
 
-        core_->CreateBuffer(aggregated_triangles.size() * sizeof(uint32_t),
-                            grassland::graphics::BUFFER_TYPE_STATIC, &triangles_buffer_);
-        triangles_buffer_->UploadData(aggregated_triangles.data(), aggregated_triangles.size() * sizeof(uint32_t));
-    }
+void Application::UploadEmitterInfo() {
+    uint32_t emitter_count = static_cast<uint32_t>(scene_->GetEmitterCount());
+    float emissive_power = scene_->GetEmissivePower();
+    misc_buffer_->UploadData(&emitter_count, sizeof(uint32_t), 4 * sizeof(uint32_t));
+    misc_buffer_->UploadData(&emissive_power, sizeof(float), 5 * sizeof(uint32_t));
+}
 
-    {
-        std :: vector <PointLight> point_lights = scene_ -> GetPointLights();
-        if (point_lights. empty()) point_lights. push_back(PointLight ());
-        core_->CreateBuffer(point_lights.size() * sizeof(PointLight),
-                            grassland::graphics::BUFFER_TYPE_STATIC, &point_lights_buffer_);
-        point_lights_buffer_->UploadData(point_lights.data(), point_lights.size() * sizeof(PointLight));
-    }
+void Application::BuildPointLightBuffer() {
+    std :: vector <PointLight> point_lights = scene_ -> GetPointLights();
+    if (point_lights. empty()) point_lights. push_back(PointLight ());
+    core_->CreateBuffer(point_lights.size() * sizeof(PointLight),
+                        grassland::graphics::BUFFER_TYPE_STATIC, &point_lights_buffer_);
+    point_lights_buffer_->UploadData(point_lights.data(), point_lights.size() * sizeof(PointLight));
+    uint32_t plcnt = static_cast <uint32_t> ((scene_ -> GetPointLights()). size());
+    misc_buffer_->UploadData(&plcnt, sizeof(uint32_t), sizeof(uint32_t));
 
+    if (!light_bvh_) {
+        light_bvh_ = std::make_unique<LightBVH>(core_.get());
+    }
+    light_bvh_->Build(scene_->GetPointLights());
 }
 
 void Application::OnClose() {
+    if (!checkpoint_path_.empty() && film_ && film_->GetSampleCount() > checkpoint_samples_) {
+        WriteCheckpoint(true);
+    }
+    checkpoint_writer_.Wait();
+
+    if (scene_ && scene_->GetGeometryBudget() > 0) {
+        const GeometryResidencyStats& residency = scene_->GetGeometryResidencyStats();
+        grassland::LogInfo("Geometry residency: {} page-ins ({} reloads, {:.1f} MB), {} evictions, {} hits over {} updates",
+                           residency.page_ins, residency.reloads, residency.bytes_paged_in / (1024.0 * 1024.0),
+                           residency.evictions, residency.hits, residency.updates);
+    }
+
     // Clean up graphics resources first
     program_.reset();
     raygen_shader_.reset();
@@ -569,6 +757,7 @@ void Application::OnClose() {
     entity_id_image_.reset();
     camera_object_buffer_.reset();
     hover_info_buffer_.reset();
+    ray_counter_buffer_.reset();
     
     // Don't call TerminateImGui - let the window destructor handle it
     // Just reset window which will clean everything up properly
@@ -586,8 +775,8 @@ void Application::UpdateHoveredEntity() {
     // Get mouse position in pixel coordinates
     int x = static_cast<int>(mouse_x_);
     int y = static_cast<int>(mouse_y_);
-    int width = window_->GetWidth();
-    int height = window_->GetHeight();
+    int width = width_;
+    int height = height_;
     
     // Check bounds
     if (x < 0 || x >= width || y < 0 || y >= height) {
@@ -613,8 +802,9 @@ void Application::UpdateHoveredEntity() {
     float accumulated_rgba[4] = {0.0f, 0.0f, 0.0f, 0.0f};
     film_->GetAccumulatedColorImage()->DownloadData(accumulated_rgba, offset, extent);
     
-    // Average by sample count to get final color (before highlighting)
-    int sample_count = film_->GetSampleCount();
+    // Average by the pixel's sample count to get final color (before highlighting)
+    int32_t sample_count = 0;
+    film_->GetAccumulatedSamplesImage()->DownloadData(&sample_count, offset, extent);
     if (sample_count > 0) {
         hovered_pixel_color_ = glm::vec4(
             accumulated_rgba[0] / static_cast<float>(sample_count),
@@ -630,30 +820,83 @@ void Application::UpdateHoveredEntity() {
 }
 
 void Application::OnUpdate() {
-    if (window_->ShouldClose()) {
+    TRACE_SCOPE("Application::OnUpdate");
+    if (!headless_ && window_->ShouldClose()) {
         window_->CloseWindow();
         alive_ = false;
         return;  // Exit update immediately after closing
     }
     if (alive_) {
         // Process keyboard input to move camera
-        ProcessInput();
+        if (!headless_) {
+            ProcessInput();
+        }
         
-        // Detect camera state change and reset accumulation if camera started moving
+        // Camera moves no longer reset the accumulation: the raygen shader
+        // reprojects the history into the new view (see Film)
         if (camera_enabled_ != last_camera_enabled_) {
             if (camera_enabled_) {
-                // Camera just got enabled - will be moving, so prepare for reset when it stops
-                grassland::LogInfo("Camera enabled - accumulation will reset when camera stops");
+                grassland::LogInfo("Camera enabled - accumulation is reprojected while moving");
             } else {
-                // Camera just got disabled - reset accumulation for new stationary view
-                film_->Reset();
-                grassland::LogInfo("Camera disabled - starting accumulation");
+                grassland::LogInfo("Camera disabled - continuing accumulation");
             }
             last_camera_enabled_ = camera_enabled_;
         }
         
+        // Page out-of-core geometry in and out around the camera
+        scene_->UpdateGeometryResidency(camera_pos_);
+
+        // Apply entity additions/removals and material edits made since the last frame
+        uint32_t scene_updates = scene_->ApplyPendingUpdates();
+        if (scene_updates & SCENE_UPDATE_LIGHTS) {
+            BuildPointLightBuffer();
+        }
+        if (scene_updates & SCENE_UPDATE_EMITTERS) {
+            UploadEmitterInfo();
+        }
+        if (scene_updates & (SCENE_UPDATE_TLAS | SCENE_UPDATE_LIGHTS)) {
+            film_->Reset();
+        } else if (scene_updates & (SCENE_UPDATE_MATERIALS | SCENE_UPDATE_RESIDENCY)) {
+            // Pixels showing an edited entity or paged geometry fail the history checks and
+            // start over; elsewhere the history is capped like on a camera move, so the
+            // change in indirect light fades in
+            revalidate_history_ = true;
+        }
+
+        // Swap in the full skybox once the background load has finished
+        HdrImage skybox;
+        EnvironmentTables environment_tables;
+        if (skybox_loader_.Poll(&skybox, &environment_tables)) {
+            if (skybox.IsValid()) {
+                UploadSkybox(skybox, environment_tables);
+                film_->Reset();
+                grassland::LogInfo("HDR skybox loaded: {}x{}", skybox.width, skybox.height);
+            } else {
+                grassland::LogWarning("Failed to load HDR skybox, keeping the placeholder sky");
+            }
+        }
+
+        // Stream in texture pages sampled two frames ago (samples taken with the
+        // coarser fallback fade out of the accumulation as detail arrives)
+        scene_->UpdateVirtualTextures();
+
+        // Resume once nothing is left to reset the film, then checkpoint periodically
+        if (!resume_path_.empty() && !IsLoadingAssets()) {
+            ResumeFromCheckpoint(resume_path_);
+            resume_path_.clear();
+        }
+        if (film_->GetSampleCount() < checkpoint_samples_) {
+            checkpoint_samples_ = 0;  // The film was reset
+        }
+        if (!checkpoint_path_.empty() && resume_path_.empty() &&
+            film_->GetSampleCount() >= checkpoint_samples_ + checkpoint_interval_ && !checkpoint_writer_.IsWriting()) {
+            WriteCheckpoint(false);
+        }
+        
         // Update which entity is being hovered
-        UpdateHoveredEntity();
+        if (!headless_) {
+            UpdateHoveredEntity();
+        }
         
         // Update hover info buffer
         HoverInfo hover_info{};
@@ -661,14 +904,24 @@ void Application::OnUpdate() {
         hover_info_buffer_->UploadData(&hover_info, sizeof(HoverInfo));
 
         // Update the camera buffer with new position/orientation
+        glm::mat4 projection = glm::perspective(glm::radians(fov), (float)width_ / (float)height_, 0.1f, 10.0f);
+        glm::mat4 view = glm::lookAt(camera_pos_, camera_pos_ + camera_front_, camera_up_);
+        glm::mat4 world_to_screen = projection * view;
         CameraObject camera_object{};
-        camera_object.screen_to_camera = glm::inverse(
-            glm::perspective(glm::radians(fov), (float)window_->GetWidth() / (float)window_->GetHeight(), 0.1f, 10.0f));
-        camera_object.camera_to_world =
-            glm::inverse(glm::lookAt(camera_pos_, camera_pos_ + camera_front_, camera_up_));
+        camera_object.screen_to_camera = glm::inverse(projection);
+        camera_object.camera_to_world = glm::inverse(view);
         camera_object.focal_distance = focal_distance_;
         camera_object.aperture_size = aperture_size_;
+        camera_object.prev_world_to_screen = history_world_to_screen_;
+        camera_object.prev_position = history_camera_pos_;
+        camera_object.reproject = world_to_screen != history_world_to_screen_ || revalidate_history_ ? 1 : 0;
+        camera_object.history_limit = kReprojectionHistoryLimit;
+        camera_object.invalidated_entity = revalidate_history_ ? edited_entity_ : -1;
+        revalidate_history_ = false;
+        edited_entity_ = -1;
         camera_object_buffer_->UploadData(&camera_object, sizeof(CameraObject));
+        history_world_to_screen_ = world_to_screen;
+        history_camera_pos_ = camera_pos_;
 
 
         // Optional: Animate entities
@@ -678,11 +931,12 @@ void Application::OnUpdate() {
 }
 
 void Application::ApplyHoverHighlight(grassland::graphics::Image* image) {
+    TRACE_SCOPE("Application::ApplyHoverHighlight");
     // Apply hover highlighting by modifying pixels where entity ID matches hovered entity
     // This is done as a CPU-side post-process so it doesn't affect accumulation
     
-    int width = window_->GetWidth();
-    int height = window_->GetHeight();
+    int width = width_;
+    int height = height_;
     size_t pixel_count = width * height;
     
     // Download current image
@@ -710,46 +964,13 @@ void Application::ApplyHoverHighlight(grassland::graphics::Image* image) {
 }
 
 void Application::SaveAccumulatedOutput(const std::string& filename) {
-    // Save the accumulated output image to a PNG file (without hover highlighting)
-    int width = window_->GetWidth();
-    int height = window_->GetHeight();
-    int sample_count = film_->GetSampleCount();
-    
-    if (sample_count == 0) {
-        grassland::LogWarning("Cannot save screenshot: no samples accumulated yet");
-        return;
-    }
-    
-    // Download accumulated color directly from film buffers (not the output image which may have highlights)
-    std::vector<float> accumulated_colors(width * height * 4);
-    film_->GetAccumulatedColorImage()->DownloadData(accumulated_colors.data());
-    
-    // Convert from accumulated sum to averaged color, then to 8-bit
-    std::vector<uint8_t> byte_data(width * height * 4);
-    for (size_t i = 0; i < width * height; i++) {
-        // Average the accumulated color by dividing by sample count
-        float r = accumulated_colors[i * 4 + 0] / static_cast<float>(sample_count);
-        float g = accumulated_colors[i * 4 + 1] / static_cast<float>(sample_count);
-        float b = accumulated_colors[i * 4 + 2] / static_cast<float>(sample_count);
-        float a = 1; // accumulated_colors[i * 4 + 3] / static_cast<float>(sample_count);
-        
-        // Clamp to [0, 1] and convert to 8-bit
-        byte_data[i * 4 + 0] = static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, r)) * 255.0f);
-        byte_data[i * 4 + 1] = static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, g)) * 255.0f);
-        byte_data[i * 4 + 2] = static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, b)) * 255.0f);
-        byte_data[i * 4 + 3] = static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, a)) * 255.0f);
-    }
-    
-    // Write PNG file
-    int result = stbi_write_png(filename.c_str(), width, height, 4, byte_data.data(), width * 4);
-    
-    if (result) {
+    // Develop directly from film buffers (not the output image which may have highlights),
+    // denoised when the denoiser is enabled
+    if (film_->SavePng(filename)) {
         // Get absolute path for logging
         std::filesystem::path abs_path = std::filesystem::absolute(filename);
         grassland::LogInfo("Screenshot saved: {} ({}x{}, {} samples)", 
-                          abs_path.string(), width, height, sample_count);
-    } else {
-        grassland::LogError("Failed to save screenshot: {}", filename);
+                          abs_path.string(), width_, height_, film_->GetSampleCount());
     }
 }
 
@@ -761,7 +982,7 @@ void Application::RenderInfoOverlay() {
 
     // Create a window on the left side (matching entity panel style)
     ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f), ImGuiCond_Always);
-    ImGui::SetNextWindowSize(ImVec2(350.0f, (float)window_->GetHeight()), ImGuiCond_Always);
+    ImGui::SetNextWindowSize(ImVec2(350.0f, (float)height_), ImGuiCond_Always);
     
     ImGuiWindowFlags window_flags = ImGuiWindowFlags_NoMove | 
                                      ImGuiWindowFlags_NoResize | 
@@ -841,10 +1062,35 @@ void Application::RenderInfoOverlay() {
 
     // Render Information
     ImGui::SeparatorText("Render");
-    ImGui::Text("Resolution: %d x %d", window_->GetWidth(), window_->GetHeight());
+    ImGui::Text("Resolution: %d x %d", width_, height_);
     ImGui::Text("Backend: %s", 
                 core_->API() == grassland::graphics::BACKEND_API_VULKAN ? "Vulkan" : "D3D12");
     ImGui::Text("Device: %s", core_->DeviceName().c_str());
+    const VirtualTextureSystem* virtual_textures = scene_->GetVirtualTextures();
+    ImGui::Text("Textures: %zu (%zu / %zu pages, %.1f MB)",
+                virtual_textures->GetTextureCount(),
+                virtual_textures->GetResidentPageCount(),
+                virtual_textures->GetPhysicalPageCount(),
+                virtual_textures->GetResidentBytes() / (1024.0 * 1024.0));
+    GeometryStreamStats geometry_stats = scene_->GetGeometryStreamStats();
+    ImGui::Text("Geometry streams: %.1f MB (%.1f MB uncompressed)",
+                geometry_stats.bytes / (1024.0 * 1024.0),
+                geometry_stats.full_precision_bytes / (1024.0 * 1024.0));
+    if (scene_->GetGeometryBudget() > 0) {
+        const GeometryResidencyStats& residency = scene_->GetGeometryResidencyStats();
+        ImGui::Text("Resident geometry: %zu / %zu entities, %.1f / %.1f MB",
+                    residency.resident_entities, scene_->GetEntityCount(),
+                    residency.resident_bytes / (1024.0 * 1024.0), residency.budget_bytes / (1024.0 * 1024.0));
+        ImGui::Text("Page-ins: %llu (%llu reloads), evictions: %llu, hit rate %.1f%%",
+                    static_cast<unsigned long long>(residency.page_ins),
+                    static_cast<unsigned long long>(residency.reloads),
+                    static_cast<unsigned long long>(residency.evictions),
+                    residency.hits + residency.page_ins > 0
+                        ? 100.0 * residency.hits / (residency.hits + residency.page_ins) : 100.0);
+    }
+    if (ImGui::Button("Log Memory Report")) {
+        GetMemoryReport().Log();
+    }
     
     ImGui::Spacing();
     
@@ -853,6 +1099,21 @@ void Application::RenderInfoOverlay() {
     if (!camera_enabled_) {
         ImGui::TextColored(ImVec4(0.5f, 1.0f, 0.5f, 1.0f), "Status: Active");
         ImGui::Text("Samples: %d", film_->GetSampleCount());
+        DenoiserSettings& denoiser = film_->GetDenoiserSettings();
+        bool denoiser_changed = ImGui::Checkbox("Denoise", &denoiser.enabled);
+        if (denoiser.enabled) {
+            ImGui::SameLine();
+            denoiser_changed |= ImGui::Checkbox("Variance guided", &denoiser.variance_guided);
+            denoiser_changed |= ImGui::SliderInt("Passes", &denoiser.iterations, 1, 8);
+        }
+        if (denoiser_changed) {
+            film_->InvalidateOutput();
+        }
+        bool low_discrepancy = low_discrepancy_;
+        if (ImGui::Checkbox("Sobol sampler", &low_discrepancy)) {
+            SetLowDiscrepancySampling(low_discrepancy);
+            film_->Reset();  // Restart the sequence rather than mix two estimators
+        }
     } else {
         ImGui::TextColored(ImVec4(0.7f, 0.7f, 0.7f, 1.0f), "Status: Paused");
         ImGui::Text("(Disable camera to accumulate)");
@@ -880,8 +1141,8 @@ void Application::RenderEntityPanel() {
     }
 
     // Create a window on the right side
-    ImGui::SetNextWindowPos(ImVec2((float)window_->GetWidth() - 350.0f, 0.0f), ImGuiCond_Always);
-    ImGui::SetNextWindowSize(ImVec2(350.0f, (float)window_->GetHeight()), ImGuiCond_Always);
+    ImGui::SetNextWindowPos(ImVec2((float)width_ - 350.0f, 0.0f), ImGuiCond_Always);
+    ImGui::SetNextWindowSize(ImVec2(350.0f, (float)height_), ImGuiCond_Always);
     
     ImGuiWindowFlags window_flags = ImGuiWindowFlags_NoMove | 
                                      ImGuiWindowFlags_NoResize | 
@@ -957,15 +1218,15 @@ void Application::RenderEntityPanel() {
         
         ImGui::Spacing();
         
-        // Material information
+        // Material information (edits are uploaded per material slot)
         ImGui::SeparatorText("Material");
         if (entity->HasMTLMaterials()) {
             ImGui::Text("Materials from MTL: %zu", entity->GetMaterials().size());
             
             // Display first material
-            auto& materials = entity->GetMaterials();
+            auto& materials = entity->GetMutableMaterials();
             if (!materials.empty()) {
-                const Material& mat = materials[0];
+                Material& mat = materials[0];
                 auto& name_map = entity->GetMaterialNameMap();
                 std::string mat_name = "Material 0";
                 for (const auto& [name, idx] : name_map) {
@@ -975,34 +1236,18 @@ void Application::RenderEntityPanel() {
                     }
                 }
                 ImGui::Text("Material Name: %s", mat_name.c_str());
-                ImGui::Text("Base Color:");
-                ImGui::ColorEdit3("##base_color", (float*)&mat.base_color[0], ImGuiColorEditFlags_NoInputs);
-                ImGui::Text("  RGB: (%.2f, %.2f, %.2f)", mat.base_color.r, mat.base_color.g, mat.base_color.b);
-                ImGui::Text("Roughness: %.2f", mat.roughness);
-                ImGui::Text("Metallic: %.2f", mat.metallic);
-                
-                if (mat.HasTexture()) {
-                    ImGui::Text("Texture: %s", mat.GetTexturePath().c_str());
-                    ImGui::Text("Texture Index: %d", mat.texture_index);
-                } else {
-                    ImGui::Text("Texture: None");
+                if (RenderMaterialEditor(mat)) {
+                    scene_->MarkMaterialDirty(selected_entity_id_, 0);
+                    edited_entity_ = selected_entity_id_;
                 }
             }
         } else {
             // Display default material
-            const Material& mat = entity->GetDefaultMaterial();
+            Material& mat = entity->GetMutableDefaultMaterial();
             ImGui::Text("Using default material");
-            ImGui::Text("Base Color:");
-            ImGui::ColorEdit3("##base_color", (float*)&mat.base_color[0], ImGuiColorEditFlags_NoInputs);
-            ImGui::Text("  RGB: (%.2f, %.2f, %.2f)", mat.base_color.r, mat.base_color.g, mat.base_color.b);
-            ImGui::Text("Roughness: %.2f", mat.roughness);
-            ImGui::Text("Metallic: %.2f", mat.metallic);
-            
-            if (mat.HasTexture()) {
-                ImGui::Text("Texture: %s", mat.GetTexturePath().c_str());
-                ImGui::Text("Texture Index: %d", mat.texture_index);
-            } else {
-                ImGui::Text("Texture: None");
+            if (RenderMaterialEditor(mat)) {
+                scene_->MarkMaterialDirty(selected_entity_id_, 0);
+                edited_entity_ = selected_entity_id_;
             }
         }
         
@@ -1032,6 +1277,14 @@ void Application::RenderEntityPanel() {
         } else {
             ImGui::Text("BLAS: Not built");
         }
+
+        ImGui::Spacing();
+        if (ImGui::Button("Remove Entity")) {
+            // Applied by Scene::ApplyPendingUpdates() on the next update
+            scene_->RemoveEntity(selected_entity_id_);
+            selected_entity_id_ = -1;
+            hovered_entity_id_ = -1;
+        }
     } else {
         ImGui::TextDisabled("No entity selected");
         ImGui::Spacing();
@@ -1041,7 +1294,26 @@ void Application::RenderEntityPanel() {
     ImGui::End();
 }
 
+bool Application::RenderMaterialEditor(Material& mat) {
+    bool changed = false;
+    ImGui::Text("Base Color:");
+    changed |= ImGui::ColorEdit3("##base_color", &mat.base_color[0]);
+    ImGui::Text("  RGB: (%.2f, %.2f, %.2f)", mat.base_color.r, mat.base_color.g, mat.base_color.b);
+    changed |= ImGui::SliderFloat("Roughness", &mat.roughness, 0.0f, 1.0f);
+    changed |= ImGui::SliderFloat("Metallic", &mat.metallic, 0.0f, 1.0f);
+    changed |= ImGui::DragFloat3("Emission", &mat.emission[0], 0.01f, 0.0f, 100.0f);
+    
+    if (mat.HasTexture()) {
+        ImGui::Text("Texture: %s", mat.GetTexturePath().c_str());
+        ImGui::Text("Texture Index: %d", mat.texture_index);
+    } else {
+        ImGui::Text("Texture: None");
+    }
+    return changed;
+}
+
 void Application::OnRender() {
+    TRACE_SCOPE("Application::OnRender");
     // Don't render if window is closing
     if (!alive_) {
         return;
@@ -1061,17 +1333,20 @@ void Application::OnRender() {
     command_context->CmdBindResources(3, { scene_->GetMaterialsBuffer() }, grassland::graphics::BIND_POINT_RAYTRACING);
     command_context->CmdBindResources(4, { hover_info_buffer_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
     command_context->CmdBindResources(5, { entity_id_image_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdBindResources(6, { film_->GetAccumulatedColorImage() }, grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdBindResources(7, { film_->GetAccumulatedSamplesImage() }, grassland::graphics::BIND_POINT_RAYTRACING);
-    uint32_t sc = static_cast<uint32_t>(film_->GetSampleCount());
-    misc_buffer_->UploadData(&sc, sizeof(uint32_t), 0);
+    command_context->CmdBindResources(6, { film_->GetTargetColorImage() }, grassland::graphics::BIND_POINT_RAYTRACING);
+    command_context->CmdBindResources(7, { film_->GetTargetSamplesImage() }, grassland::graphics::BIND_POINT_RAYTRACING);
+    uint32_t frame_index = frame_index_++;
+    misc_buffer_->UploadData(&frame_index, sizeof(uint32_t), 0);
+    // A fresh accumulation gets a new scramble, and so does every frame while the camera
+    // moves (the film's sample count stands still then)
+    if ((film_->GetSampleCount() == 0 || camera_enabled_) && !fixed_sequence_) {
+        sequence_seed_ = frame_index;
+    }
+    uint32_t sequence[2] = { first_sample_ + static_cast<uint32_t>(film_->GetSampleCount()), sequence_seed_ };
+    misc_buffer_->UploadData(sequence, sizeof(sequence), 8 * sizeof(uint32_t));
     command_context->CmdBindResources(8, { misc_buffer_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
-    std::vector<grassland::graphics::Buffer*> buffers = {
-        offsets_buffer_.get(),
-        vertices_buffer_.get(), 
-        triangles_buffer_.get()
-    };
-    command_context->CmdBindResources(9, buffers, grassland::graphics::BIND_POINT_RAYTRACING);
+    command_context->CmdBindResources(9, { scene_->GetGlobalPositionBuffer() ? scene_->GetGlobalPositionBuffer() : dummy_buffer_.get() },
+                                      grassland::graphics::BIND_POINT_RAYTRACING);
     // use persistent dummy_buffer_
     std::vector<grassland::graphics::Buffer*> space10_Buffers = {
         scene_->GetGlobalUVBuffer() ? scene_->GetGlobalUVBuffer() : dummy_buffer_.get(),
@@ -1080,33 +1355,52 @@ void Application::OnRender() {
     };
     command_context->CmdBindResources(10, space10_Buffers, grassland::graphics::BIND_POINT_RAYTRACING);
     command_context->CmdBindResources(11, {scene_->GetInstanceMetadataBuffer()}, grassland::graphics::BIND_POINT_RAYTRACING);
-    // use persistent dummy_image_
-    std::vector<grassland::graphics::Image*> tex_list;
-    tex_list.reserve(MAX_TEXTURE_COUNT);
-    for (int i = 0; i < scene_->GetTextureCount(); ++i) {
-        tex_list.push_back(scene_->GetTexture(i));
-    }
-    for(int i = scene_->GetTextureCount(); i < MAX_TEXTURE_COUNT; ++i){
-        tex_list.push_back(dummy_image_.get());
-    }
-    // 最后填充占位图（或按你希望的位置插入）
-    command_context->CmdBindResources(12, tex_list, grassland::graphics::BIND_POINT_RAYTRACING);
-    // Bind sampler (space13)
-    command_context->CmdBindResources(13, { dummy_sampler_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context -> CmdBindResources(14, {point_lights_buffer_. get()}, grassland::graphics::BIND_POINT_RAYTRACING);
-    std::vector<grassland::graphics::Image*> norm_list;
-    norm_list.reserve(MAX_TEXTURE_COUNT);
-    for(int i = 0 ; i < scene_->GetNormalCount(); ++i) {
-        norm_list.push_back(scene_->GetNormal(i));
-    }
-    for(int i = scene_->GetNormalCount(); i < MAX_TEXTURE_COUNT; ++i) {
-        norm_list.push_back(dummy_image_.get());
+    VirtualTextureSystem* virtual_textures = scene_->GetVirtualTextures();
+    std::vector<grassland::graphics::Buffer*> virtual_texture_buffers = {
+        virtual_textures->GetPoolBuffer(),
+        virtual_textures->GetPageTableBuffer(),
+        virtual_textures->GetTextureInfoBuffer()
+    };
+    command_context->CmdBindResources(12, virtual_texture_buffers, grassland::graphics::BIND_POINT_RAYTRACING);
+    command_context->CmdBindResources(13, { virtual_textures->GetFeedbackBuffer() }, grassland::graphics::BIND_POINT_RAYTRACING);
+    std::vector<grassland::graphics::Buffer*> light_buffers = { point_lights_buffer_.get(), light_bvh_->GetNodeBuffer() };
+    command_context->CmdBindResources(14, light_buffers, grassland::graphics::BIND_POINT_RAYTRACING);
+    command_context->CmdBindResources(15, {hdr_skybox_.get()}, grassland::graphics::BIND_POINT_RAYTRACING);
+    command_context->CmdBindResources(16, {skybox_sampler_.get()}, grassland::graphics::BIND_POINT_RAYTRACING);
+    std::vector<grassland::graphics::Buffer*> environment_buffers = {
+        environment_map_->IsValid() ? environment_map_->GetMarginalCdfBuffer() : dummy_buffer_.get(),
+        environment_map_->IsValid() ? environment_map_->GetConditionalCdfBuffer() : dummy_buffer_.get(),
+        environment_map_->IsValid() ? environment_map_->GetPdfBuffer() : dummy_buffer_.get()
+    };
+    command_context->CmdBindResources(17, environment_buffers, grassland::graphics::BIND_POINT_RAYTRACING);
+    bool has_emitters = scene_->GetEmitterCount() > 0;
+    std::vector<grassland::graphics::Buffer*> emitter_buffers = {
+        has_emitters ? scene_->GetEmissiveTriangleBuffer() : dummy_buffer_.get(),
+        has_emitters ? scene_->GetEmissiveTriangleAliasBuffer() : dummy_buffer_.get(),
+        has_emitters ? scene_->GetEmitterBuffer() : dummy_buffer_.get(),
+        has_emitters ? scene_->GetEmitterAliasBuffer() : dummy_buffer_.get()
+    };
+    command_context->CmdBindResources(18, emitter_buffers, grassland::graphics::BIND_POINT_RAYTRACING);
+    std::vector<grassland::graphics::Image*> aov_images = { film_->GetTargetAlbedoImage(), film_->GetTargetNormalImage() };
+    command_context->CmdBindResources(19, aov_images, grassland::graphics::BIND_POINT_RAYTRACING);
+    std::vector<grassland::graphics::Image*> history_images = {
+        film_->GetAccumulatedColorImage(),
+        film_->GetAccumulatedAlbedoImage(),
+        film_->GetAccumulatedNormalImage()
+    };
+    command_context->CmdBindResources(20, history_images, grassland::graphics::BIND_POINT_RAYTRACING);
+    command_context->CmdBindResources(21, { film_->GetAccumulatedSamplesImage() }, grassland::graphics::BIND_POINT_RAYTRACING);
+    command_context->CmdBindResources(22, { ray_counter_buffer_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
+    command_context->CmdDispatchRays(width_, height_, 1);
+
+    if (headless_) {
+        // Nothing to display: leave developing to the caller (Film::Develop)
+        film_->IncrementSampleCount();
+        core_->SubmitCommandContext(command_context.get());
+        film_->Advance();
+        ReadRayCounters();
+        return;
     }
-    command_context->CmdBindResources(15, norm_list, grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdBindResources(16, { dummy_sampler_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdBindResources(17, {hdr_skybox_.get()}, grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdBindResources(18, {skybox_sampler_.get()}, grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdDispatchRays(window_->GetWidth(), window_->GetHeight(), 1);
     
     // When camera is disabled, increment sample count and use accumulated image
     grassland::graphics::Image* display_image = color_image_.get();
@@ -1129,4 +1423,22 @@ void Application::OnRender() {
     
     command_context->CmdPresent(window_.get(), display_image);
     core_->SubmitCommandContext(command_context.get());
+
+    // This frame's target images now hold the accumulation
+    film_->Advance();
+    ReadRayCounters();
+}
+
+void Application::ReadRayCounters() {
+    if (!ray_counting_) {
+        return;
+    }
+    // 32-bit GPU counters are drained every frame into the 64-bit totals
+    uint32_t counters[4] = {0, 0, 0, 0};
+    ray_counter_buffer_->DownloadData(counters, sizeof(counters));
+    ray_counts_.primary += counters[0];
+    ray_counts_.secondary += counters[1];
+    ray_counts_.shadow += counters[2];
+    uint32_t zero_counters[4] = {0, 0, 0, 0};
+    ray_counter_buffer_->UploadData(zero_counters, sizeof(zero_counters));
 }
@@ -2,13 +2,40 @@
 #include "long_march.h"
 #include "Scene.h"
 #include "Film.h"
+#include "FilmCheckpoint.h"
+#include "EnvironmentMap.h"
+#include "LightBVH.h"
+#include "MemoryReport.h"
+#include "SkyboxLoader.h"
+#include "SceneFile.h"
 #include <memory>
+#include <string>
+#include <vector>
 
 struct CameraObject {
     glm::mat4 screen_to_camera;
     glm::mat4 camera_to_world;
     float aperture_size;
     float focal_distance;
+    float padding[2];
+    glm::mat4 prev_world_to_screen;  // Camera of the accumulated history
+    glm::vec3 prev_position;
+    uint32_t reproject;              // 1 when the camera moved or a material changed since the last frame
+    float history_limit;             // Sample count reprojected history is scaled down to
+    int invalidated_entity;          // Entity whose pixels drop their history (-1 for none)
+};
+
+// Rays traced since the counters were last reset (see SetRayCounting)
+struct RayCounts {
+    uint64_t primary = 0;
+    uint64_t secondary = 0;  // BSDF-sampled bounces
+    uint64_t shadow = 0;     // Light visibility tests
+};
+
+// Wall-clock time of one OnInit() stage
+struct StartupPhase {
+    std::string name;
+    double seconds;
 };
 
 class Application {
@@ -23,11 +50,71 @@ public:
     void OnRender();
     void UpdateHoveredEntity(); // Update which entity the mouse is hovering over
     void RenderEntityPanel(); // Render entity inspector panel on the right
+    bool RenderMaterialEditor(Material& mat); // Editable material widgets, returns true if changed
 
     bool IsAlive() const {
         return alive_;
     }
 
+    // Skybox image (absolute, or relative to the asset directory); set before OnInit.
+    // Takes precedence over the skybox of the scene file.
+    void SetSkyboxPath(const std::string& path) { skybox_path_ = path; }
+
+    // JSON scene description to load instead of the built-in scene; set before OnInit
+    void SetScenePath(const std::string& path) { scene_path_ = path; }
+
+    // Render offscreen at a fixed resolution with no window, input or UI (the
+    // film is not developed each frame either); set before OnInit
+    void SetHeadless(int width, int height);
+    bool IsHeadless() const { return headless_; }
+
+    // Whether background loads (the HDR skybox) are still running; OnUpdate picks them up
+    bool IsLoadingAssets() const { return skybox_loader_.IsLoading(); }
+
+    // Count primary, secondary and shadow rays on the GPU. The counters are
+    // read back after every frame, which stalls, so this is meant for benchmarks.
+    void SetRayCounting(bool enabled);
+    const RayCounts& GetRayCounts() const { return ray_counts_; }
+    void ResetRayCounts() { ray_counts_ = RayCounts{}; }
+
+    // Owen-scrambled Sobol samples (default) or independent random numbers in the path tracer
+    void SetLowDiscrepancySampling(bool enabled);
+    bool IsLowDiscrepancySampling() const { return low_discrepancy_; }
+
+    // Number this process's samples from first_sample under a fixed sequence seed, so that
+    // processes rendering disjoint sample ranges of one view draw disjoint parts of the same
+    // sequence and their films can be merged (see ShardedRender)
+    void SetFirstSample(uint32_t first_sample);
+
+    // Write the film to path every interval_samples samples (downloaded here, compressed and
+    // written on the thread pool) and once more in OnClose; see FilmCheckpoint
+    void SetCheckpoint(const std::string& path, int interval_samples, bool compress = true);
+
+    // Continue the accumulation of a checkpoint once the scene and skybox have loaded; skipped
+    // with a warning if it was rendered from another view. Set before OnInit.
+    void SetResumePath(const std::string& path) { resume_path_ = path; }
+
+    // Out-of-core geometry: keep at most bytes of entity geometry on the GPU, paged in and out
+    // around the camera (see Scene::SetGeometryBudget); 0 keeps everything resident. Combine
+    // with MeshCache::SetEnabled so entities map their meshes instead of holding them. Set before OnInit.
+    void SetGeometryBudget(size_t bytes) { geometry_budget_ = bytes; }
+
+    // Hash of everything the image depends on: resolution, camera, entities with their
+    // transforms and materials, point lights, skybox and sampler
+    uint64_t GetViewHash() const;
+    FilmCheckpointInfo GetCheckpointInfo() const;
+
+    const std::vector<StartupPhase>& GetStartupPhases() const { return startup_phases_; }
+    Film* GetFilm() const { return film_.get(); }
+    Scene* GetScene() const { return scene_.get(); }
+    int GetWidth() const { return width_; }
+    int GetHeight() const { return height_; }
+
+    // Bytes held per memory category and per entity (MemoryReport::Log dumps it)
+    MemoryReport GetMemoryReport() const;
+
+    void SaveAccumulatedOutput(const std::string& filename); // Save accumulated output to PNG file
+
 private:
     // Core graphics objects
     std::shared_ptr<grassland::graphics::Core> core_;
@@ -59,18 +146,39 @@ private:
     std::unique_ptr<grassland::graphics::Image> entity_id_image_; // Entity ID buffer for accurate picking
     std::unique_ptr<grassland::graphics::RayTracingProgram> program_;
     // Persistent dummy resources to avoid null bindings
-    std::unique_ptr<grassland::graphics::Image> dummy_image_;
     std::unique_ptr<grassland::graphics::Buffer> dummy_buffer_;
-    std::unique_ptr<grassland::graphics::Sampler> dummy_sampler_;
     std::unique_ptr<grassland::graphics::Sampler>skybox_sampler_;
     std::unique_ptr<grassland::graphics::Image> hdr_skybox_;
+    int skybox_width_ = 0;
+    int skybox_height_ = 0;
+    std::unique_ptr<EnvironmentMap> environment_map_;  // Importance sampling tables of hdr_skybox_
+    std::string skybox_path_;  // Empty: the scene file's skybox, else the default one
+    std::string scene_path_;
+    SkyboxLoader skybox_loader_;
     
     std::unique_ptr<grassland::graphics::Buffer> misc_buffer_;
-    std::unique_ptr<grassland::graphics::Buffer> offsets_buffer_;
-    std::unique_ptr<grassland::graphics::Buffer> vertices_buffer_;
-    std::unique_ptr<grassland::graphics::Buffer> triangles_buffer_;
     std::unique_ptr<grassland::graphics::Buffer> point_lights_buffer_;
+    std::unique_ptr<LightBVH> light_bvh_;  // Hierarchy over the point lights for light selection
     bool alive_{ false };
+    bool headless_ = false;
+    int width_ = 0;   // Render resolution (the window's, or the headless size)
+    int height_ = 0;
+
+    std::unique_ptr<grassland::graphics::Buffer> ray_counter_buffer_;
+    bool ray_counting_ = false;
+    bool low_discrepancy_ = true;
+    uint32_t first_sample_ = 0;     // Sample index of the film's first sample
+    bool fixed_sequence_ = false;   // Keep sequence_seed_ instead of reseeding on every film reset
+    uint32_t sequence_seed_ = 0;
+    std::string checkpoint_path_;   // Empty: no checkpoints
+    int checkpoint_interval_ = 0;
+    bool checkpoint_compress_ = true;
+    int checkpoint_samples_ = 0;    // Film sample count of the last checkpoint
+    FilmCheckpointWriter checkpoint_writer_;
+    std::string resume_path_;       // Checkpoint to resume once assets are loaded
+    size_t geometry_budget_ = 0;    // Bytes of resident entity geometry, 0: unlimited
+    RayCounts ray_counts_;
+    std::vector<StartupPhase> startup_phases_;
 
     void ProcessInput(); // Helper function for keyboard input
 
@@ -80,12 +188,26 @@ private:
     glm::vec3 camera_up_;
     float camera_speed_;
 
+    // Camera the film's accumulation was rendered from, for reprojection
+    glm::mat4 history_world_to_screen_{1.0f};
+    glm::vec3 history_camera_pos_{0.0f};
+    // A material edit revalidates the history instead of resetting the film
+    bool revalidate_history_ = false;
+    int edited_entity_ = -1;  // Entity whose material the panel edited, -1 if unknown
+    uint32_t frame_index_ = 0;  // Frames rendered, reseeds the sampler on every film reset
+
 
     void OnMouseMove(double xpos, double ypos); // Mouse event handler
     void OnMouseButton(int button, int action, int mods, double xpos, double ypos); // Mouse button event handler
     void RenderInfoOverlay(); // Render the info overlay
     void ApplyHoverHighlight(grassland::graphics::Image* image); // Apply hover highlighting as post-process
-    void SaveAccumulatedOutput(const std::string& filename); // Save accumulated output to PNG file
+    void BuildPointLightBuffer(); // Upload point lights, their count and the light BVH
+    void UploadEmitterInfo();     // Upload the emissive triangle entity count and total power
+    void UploadSkybox(const HdrImage& image, const EnvironmentTables& tables); // Replace the skybox and its sampling tables
+    void BuildDefaultScene(); // Built-in scene used without a scene file
+    void ReadRayCounters();   // Add the GPU ray counters to ray_counts_ and clear them
+    void WriteCheckpoint(bool wait);  // Download the film and write it to checkpoint_path_
+    bool ResumeFromCheckpoint(const std::string& path);
 
     float yaw_;
     float pitch_;
@@ -0,0 +1,160 @@
+#include "MicroBenchmark.h"
+#include "Json.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double Median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+// Seconds for `iterations` back-to-back kernel calls
+double TimeIterations(const MicroBenchmarkKernel& kernel, uint64_t iterations) {
+    auto start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        kernel();
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// 1.4826 scales the MAD to a standard deviation for normally distributed noise
+constexpr double kMadToSigma = 1.4826;
+
+// Written by MicroBenchmarkKeep; the volatile store keeps kernel results alive
+const void* volatile g_sink = nullptr;
+}
+
+void MicroBenchmarkKeep(const void* data) {
+    g_sink = data;
+}
+
+void MicroBenchmark::Register(const std::string& name, bool needs_gpu, MicroBenchmarkSetup setup) {
+    MutableCases().push_back({name, needs_gpu, std::move(setup)});
+}
+
+const std::vector<MicroBenchmarkCase>& MicroBenchmark::GetCases() {
+    return MutableCases();
+}
+
+std::vector<MicroBenchmarkCase>& MicroBenchmark::MutableCases() {
+    static std::vector<MicroBenchmarkCase> cases;
+    return cases;
+}
+
+MicroBenchmarkResult MicroBenchmark::Run(const MicroBenchmarkCase& bench_case, const MicroBenchmarkKernel& kernel,
+                                         const MicroBenchmarkSettings& settings) {
+    MicroBenchmarkResult result;
+    result.name = bench_case.name;
+
+    // Warm up caches and lazily initialized state, then grow the iteration
+    // count until one sample lasts min_sample_seconds
+    double seconds = TimeIterations(kernel, 1);
+    uint64_t iterations = 1;
+    while (seconds < settings.min_sample_seconds) {
+        double scale = seconds > 0.0 ? std::min(10.0, 1.2 * settings.min_sample_seconds / seconds) : 10.0;
+        iterations = std::max<uint64_t>(iterations + 1, static_cast<uint64_t>(iterations * scale));
+        seconds = TimeIterations(kernel, iterations);
+    }
+
+    std::vector<double> per_iteration(std::max(settings.samples, 1));
+    for (double& sample : per_iteration) {
+        sample = TimeIterations(kernel, iterations) * 1e9 / static_cast<double>(iterations);
+    }
+
+    result.iterations = iterations;
+    result.samples = static_cast<int>(per_iteration.size());
+    result.min = *std::min_element(per_iteration.begin(), per_iteration.end());
+    result.median = Median(per_iteration);
+    double sum = 0.0;
+    for (double sample : per_iteration) {
+        sum += sample;
+    }
+    result.mean = sum / per_iteration.size();
+    double squares = 0.0;
+    std::vector<double> deviations;
+    for (double sample : per_iteration) {
+        squares += (sample - result.mean) * (sample - result.mean);
+        deviations.push_back(std::abs(sample - result.median));
+    }
+    result.stddev = per_iteration.size() > 1 ? std::sqrt(squares / (per_iteration.size() - 1)) : 0.0;
+    result.mad = Median(deviations);
+    return result;
+}
+
+std::string MicroBenchmark::ToJson(const std::vector<MicroBenchmarkResult>& results) {
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3);
+    json << "{\n  \"unit\": \"ns\",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const MicroBenchmarkResult& r = results[i];
+        json << "    { \"name\": \"" << EscapeJson(r.name) << "\", \"iterations\": " << r.iterations
+             << ", \"samples\": " << r.samples << ", \"min\": " << r.min << ", \"median\": " << r.median
+             << ", \"mean\": " << r.mean << ", \"stddev\": " << r.stddev << ", \"mad\": " << r.mad << " }"
+             << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    json << "  ]\n}\n";
+    return json.str();
+}
+
+bool MicroBenchmark::LoadBaseline(const std::string& path, std::vector<MicroBenchmarkResult>* results) {
+    MappedFile file;
+    if (!file.Open(path)) {
+        grassland::LogError("Failed to open baseline {}", path);
+        return false;
+    }
+    JsonValue root;
+    std::string error;
+    if (!ParseJson(std::string(reinterpret_cast<const char*>(file.Data()), file.Size()), &root, &error)) {
+        grassland::LogError("{}: {}", path, error);
+        return false;
+    }
+    const JsonValue* entries = root.Find("results");
+    if (!entries || entries->type != JsonValue::ARRAY) {
+        grassland::LogError("{}: no \"results\" array", path);
+        return false;
+    }
+
+    results->clear();
+    for (const JsonValue& entry : entries->array) {
+        const JsonValue* name = entry.Find("name");
+        const JsonValue* median = entry.Find("median");
+        const JsonValue* mad = entry.Find("mad");
+        if (!name || name->type != JsonValue::STRING || !median || median->type != JsonValue::NUMBER) {
+            grassland::LogWarning("{}:{}: skipping malformed result", path, entry.line);
+            continue;
+        }
+        MicroBenchmarkResult result;
+        result.name = name->string;
+        result.median = median->number;
+        result.mad = mad && mad->type == JsonValue::NUMBER ? mad->number : 0.0;
+        results->push_back(result);
+    }
+    return true;
+}
+
+MicroBenchmarkVerdict MicroBenchmark::Compare(const MicroBenchmarkResult& result,
+                                              const std::vector<MicroBenchmarkResult>& baseline, double threshold,
+                                              double* ratio) {
+    *ratio = 1.0;
+    auto it = std::find_if(baseline.begin(), baseline.end(),
+                           [&result](const MicroBenchmarkResult& b) { return b.name == result.name; });
+    if (it == baseline.end() || it->median <= 0.0) {
+        return MICRO_BENCHMARK_NEW;
+    }
+    *ratio = result.median / it->median;
+    double difference = result.median - it->median;
+    double noise = 3.0 * kMadToSigma * std::sqrt(result.mad * result.mad + it->mad * it->mad);
+    if (std::abs(difference) <= std::max(threshold * it->median, noise)) {
+        return MICRO_BENCHMARK_UNCHANGED;
+    }
+    return difference < 0.0 ? MICRO_BENCHMARK_FASTER : MICRO_BENCHMARK_SLOWER;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "long_march.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// What a case may use while preparing its inputs
+struct MicroBenchmarkContext {
+    grassland::graphics::Core* core = nullptr;  // Null unless GPU cases were requested
+    std::string temp_directory;                 // Scratch space for generated input files
+};
+
+// A case prepares its inputs once (untimed) and returns the kernel to time;
+// returning an empty function skips the case (e.g. missing input)
+using MicroBenchmarkKernel = std::function<void()>;
+using MicroBenchmarkSetup = std::function<MicroBenchmarkKernel(const MicroBenchmarkContext&)>;
+
+struct MicroBenchmarkCase {
+    std::string name;  // "group/case"
+    bool needs_gpu = false;
+    MicroBenchmarkSetup setup;
+};
+
+struct MicroBenchmarkSettings {
+    std::string filter;              // Substring of the case names to run (empty runs all)
+    int samples = 15;                // Timed samples per case
+    double min_sample_seconds = 0.05;  // Each sample repeats the kernel until it lasts this long
+    double threshold = 0.05;         // Relative median change reported against the baseline
+};
+
+// Per-iteration statistics of one case, in nanoseconds
+struct MicroBenchmarkResult {
+    std::string name;
+    uint64_t iterations = 0;  // Kernel calls per sample
+    int samples = 0;
+    double min = 0.0;
+    double median = 0.0;
+    double mean = 0.0;
+    double stddev = 0.0;
+    double mad = 0.0;  // Median absolute deviation, the noise estimate used for comparisons
+};
+
+// Outcome of comparing a result against the baseline entry of the same name
+enum MicroBenchmarkVerdict {
+    MICRO_BENCHMARK_NEW,        // Not in the baseline
+    MICRO_BENCHMARK_UNCHANGED,  // Within the threshold or the noise
+    MICRO_BENCHMARK_FASTER,
+    MICRO_BENCHMARK_SLOWER,
+};
+
+// Minimal harness for isolated kernel timings: each case is warmed up,
+// calibrated to a number of iterations per sample, then timed over several
+// samples. Reports are JSON so a saved run can serve as the baseline of the
+// next one; a change only counts when the medians differ by more than the
+// threshold and by more than three combined MADs.
+class MicroBenchmark {
+public:
+    static void Register(const std::string& name, bool needs_gpu, MicroBenchmarkSetup setup);
+    static const std::vector<MicroBenchmarkCase>& GetCases();
+
+    static MicroBenchmarkResult Run(const MicroBenchmarkCase& bench_case, const MicroBenchmarkKernel& kernel,
+                                    const MicroBenchmarkSettings& settings);
+
+    static std::string ToJson(const std::vector<MicroBenchmarkResult>& results);
+    static bool LoadBaseline(const std::string& path, std::vector<MicroBenchmarkResult>* results);
+
+    // Compare result with its baseline; ratio is result / baseline median (1 when new)
+    static MicroBenchmarkVerdict Compare(const MicroBenchmarkResult& result,
+                                         const std::vector<MicroBenchmarkResult>& baseline, double threshold,
+                                         double* ratio);
+
+private:
+    static std::vector<MicroBenchmarkCase>& MutableCases();
+};
+
+// Keep a value observable so the optimizer cannot drop the work producing it
+void MicroBenchmarkKeep(const void* data);
+
+// Registers the kernel cases (micro_cases.cpp)
+void RegisterMicroBenchmarks();
@@ -0,0 +1,44 @@
+#include "Benchmark.h"
+#include "ShaderCache.h"
+
+#include <cstdlib>
+#include <string>
+
+// ShortMarchBench: headless benchmark runner, see Benchmark.h
+//   --scene <file>  --width <px>  --height <px>  --spp <n>  --warmup <n>
+//   --output <report.json>  --image <out.png>  --trace <trace.json>  --vulkan | --d3d12 (default: the platform's backend)
+//   --no-shader-cache  compile the shaders even if a cached library exists (cold start timings)
+int main(int argc, char** argv) {
+  BenchmarkSettings settings;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--vulkan") {
+      settings.api = grassland::graphics::BACKEND_API_VULKAN;
+    } else if (arg == "--d3d12") {
+      settings.api = grassland::graphics::BACKEND_API_D3D12;
+    } else if (arg == "--no-shader-cache") {
+      ShaderCache::SetEnabled(false);
+    } else if (i + 1 < argc) {
+      if (arg == "--scene") {
+        settings.scene_path = argv[++i];
+      } else if (arg == "--width") {
+        settings.width = std::atoi(argv[++i]);
+      } else if (arg == "--height") {
+        settings.height = std::atoi(argv[++i]);
+      } else if (arg == "--spp") {
+        settings.spp = std::atoi(argv[++i]);
+      } else if (arg == "--warmup") {
+        settings.warmup_frames = std::atoi(argv[++i]);
+      } else if (arg == "--output") {
+        settings.output_path = argv[++i];
+      } else if (arg == "--image") {
+        settings.image_path = argv[++i];
+      } else if (arg == "--trace") {
+        settings.trace_path = argv[++i];
+      }
+    }
+  }
+
+  return Benchmark::Run(settings);
+}
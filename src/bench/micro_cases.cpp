@@ -0,0 +1,533 @@
+#include "MicroBenchmark.h"
+#include "AliasTable.h"
+#include "Denoiser.h"
+#include "Entity.h"
+#include "EnvironmentMap.h"
+#include "Film.h"
+#include "LightBVH.h"
+#include "MeshOptimizer.h"
+#include "MipGenerator.h"
+#include "Scene.h"
+#include "SceneFile.h"
+#include "SkyboxLoader.h"
+#include "TextureCache.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/packing.hpp"
+#include "stb_image.h"
+#include "stb_image_write.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+
+// Inputs are generated from fixed seeds so every run times the same work.
+// Kernels that modify their input work on a copy made inside the timed call;
+// the copy is small next to the kernel and identical between runs.
+
+namespace {
+#include "built_in_shaders.inl"
+
+constexpr int kGridSize = 256;  // Quads per side of the generated meshes
+
+// Height of the generated grids over their unit square
+float GridHeight(float u, float v) {
+    return 0.5f * std::sin(6.0f * u) * std::cos(6.0f * v);
+}
+
+// n x n quads over the unit square with three vertices per triangle (as an OBJ
+// loader produces them before welding), UVs equal to the XY position
+MeshData MakeGridSoup(int n) {
+    MeshData mesh;
+    for (int y = 0; y < n; ++y) {
+        for (int x = 0; x < n; ++x) {
+            float x0 = static_cast<float>(x) / n, x1 = static_cast<float>(x + 1) / n;
+            float y0 = static_cast<float>(y) / n, y1 = static_cast<float>(y + 1) / n;
+            float corners[6][2] = {{x0, y0}, {x1, y0}, {x1, y1}, {x0, y0}, {x1, y1}, {x0, y1}};
+            for (auto& c : corners) {
+                mesh.indices.push_back(static_cast<uint32_t>(mesh.positions.size()));
+                mesh.positions.emplace_back(c[0], c[1], GridHeight(c[0], c[1]));
+                mesh.uvs.emplace_back(c[0], c[1]);
+            }
+            mesh.material_ids.push_back((x + y) & 3);
+            mesh.material_ids.push_back((x + y) & 3);
+        }
+    }
+    return mesh;
+}
+
+// Welded grid with its triangles in random order
+MeshData MakeShuffledGrid(int n) {
+    MeshData mesh = MakeGridSoup(n);
+    MeshOptimizer::WeldVertices(&mesh, WeldSettings{});
+    std::vector<size_t> order(mesh.NumTriangles());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(7));
+    MeshData shuffled = mesh;
+    for (size_t i = 0; i < order.size(); ++i) {
+        for (int k = 0; k < 3; ++k) {
+            shuffled.indices[i * 3 + k] = mesh.indices[order[i] * 3 + k];
+        }
+        shuffled.material_ids[i] = mesh.material_ids[order[i]];
+    }
+    return shuffled;
+}
+
+// Welded grid written as an OBJ with UVs; returns its path
+std::string WriteGridObj(const MicroBenchmarkContext& context, int n) {
+    std::string path = context.temp_directory + "/grid_" + std::to_string(n) + ".obj";
+    std::ofstream file(path);
+    for (int y = 0; y <= n; ++y) {
+        for (int x = 0; x <= n; ++x) {
+            float u = static_cast<float>(x) / n, v = static_cast<float>(y) / n;
+            file << "v " << u << " " << v << " " << GridHeight(u, v) << "\n";
+            file << "vt " << u << " " << v << "\n";
+        }
+    }
+    for (int y = 0; y < n; ++y) {
+        for (int x = 0; x < n; ++x) {
+            int a = y * (n + 1) + x + 1, b = a + 1, c = a + n + 2, d = a + n + 1;
+            file << "f " << a << "/" << a << " " << b << "/" << b << " " << c << "/" << c << "\n";
+            file << "f " << a << "/" << a << " " << c << "/" << c << " " << d << "/" << d << "\n";
+        }
+    }
+    return file ? path : std::string();
+}
+
+// Smooth color pattern with noise (compresses like a photo, not like a flat fill)
+std::vector<uint8_t> MakeTexture(int width, int height) {
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<int> noise(-12, 12);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            uint8_t* p = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+            p[0] = static_cast<uint8_t>(std::clamp(128 + static_cast<int>(100 * std::sin(x * 0.02f)) + noise(rng), 0, 255));
+            p[1] = static_cast<uint8_t>(std::clamp(128 + static_cast<int>(100 * std::cos(y * 0.03f)) + noise(rng), 0, 255));
+            p[2] = static_cast<uint8_t>(std::clamp((x ^ y) & 255, 0, 255));
+            p[3] = 255;
+        }
+    }
+    return pixels;
+}
+
+// Equirectangular HDR sky with a small bright sun, as RGB floats
+std::vector<float> MakeSky(int width, int height) {
+    std::vector<float> pixels(static_cast<size_t>(width) * height * 3);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float* p = &pixels[(static_cast<size_t>(y) * width + x) * 3];
+            float v = (y + 0.5f) / height;
+            float sun = std::abs(x - width / 3) < width / 200 && std::abs(y - height / 4) < height / 100 ? 5000.0f : 0.0f;
+            p[0] = 0.3f + 0.5f * v + sun;
+            p[1] = 0.5f + 0.3f * v + sun;
+            p[2] = 1.0f - 0.4f * v + sun;
+        }
+    }
+    return pixels;
+}
+
+DenoiserFrame MakeNoisyFrame(int width, int height) {
+    DenoiserFrame frame;
+    frame.width = width;
+    frame.height = height;
+    size_t count = static_cast<size_t>(width) * height;
+    frame.color.resize(count * 4);
+    frame.albedo.resize(count * 4);
+    frame.normal.resize(count * 4);
+    frame.variance.resize(count);
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (size_t p = 0; p < count; ++p) {
+        int x = static_cast<int>(p % width), y = static_cast<int>(p / width);
+        bool left = x < width / 2;
+        for (int c = 0; c < 3; ++c) {
+            frame.color[p * 4 + c] = (left ? 0.6f : 0.3f) * (0.5f + unit(rng));
+            frame.albedo[p * 4 + c] = left ? 0.8f : 0.4f;
+        }
+        frame.color[p * 4 + 3] = 1.0f;
+        frame.albedo[p * 4 + 3] = 2.0f + y * 0.01f;
+        frame.normal[p * 4 + (left ? 1 : 2)] = 1.0f;
+        frame.variance[p] = 0.05f;
+    }
+    return frame;
+}
+
+std::string MakeSceneJson(int entity_count) {
+    std::ostringstream json;
+    json << "{\n  \"camera\": { \"position\": [0, 1, 5], \"yaw\": -90, \"pitch\": 0 },\n  \"entities\": [\n";
+    for (int i = 0; i < entity_count; ++i) {
+        json << "    { \"mesh\": \"meshes/cube.obj\", \"position\": [" << i % 32 << ", 0.5, " << i / 32
+             << "], \"rotation\": [0, " << i * 7 % 360 << ", 0], \"scale\": 0.4, \"material\": { \"base_color\": ["
+             << (i % 7) / 7.0 << ", 0.5, 0.5], \"roughness\": 0.3, \"metallic\": 0 } }"
+             << (i + 1 < entity_count ? ",\n" : "\n");
+    }
+    json << "  ],\n  \"point_lights\": [ { \"position\": [0, 3, 0], \"color\": [10, 10, 10] } ]\n}\n";
+    return json.str();
+}
+
+void RegisterMeshCases() {
+    MicroBenchmark::Register("mesh/weld_grid_256", false, [](const MicroBenchmarkContext&) {
+        auto soup = std::make_shared<MeshData>(MakeGridSoup(kGridSize));
+        return [soup]() {
+            MeshData mesh = *soup;
+            MeshOptimizer::WeldVertices(&mesh, WeldSettings{});
+            MicroBenchmarkKeep(mesh.indices.data());
+        };
+    });
+    MicroBenchmark::Register("mesh/remove_degenerates_grid_256", false, [](const MicroBenchmarkContext&) {
+        auto welded = std::make_shared<MeshData>(MakeShuffledGrid(kGridSize));
+        return [welded]() {
+            MeshData mesh = *welded;
+            MeshOptimizer::RemoveDegenerateTriangles(&mesh, WeldSettings{}.position_epsilon);
+            MicroBenchmarkKeep(mesh.indices.data());
+        };
+    });
+    MicroBenchmark::Register("mesh/optimize_locality_grid_256", false, [](const MicroBenchmarkContext&) {
+        auto shuffled = std::make_shared<MeshData>(MakeShuffledGrid(kGridSize));
+        return [shuffled]() {
+            MeshData mesh = *shuffled;
+            MeshOptimizer::OptimizeLocality(&mesh);
+            MicroBenchmarkKeep(mesh.indices.data());
+        };
+    });
+    MicroBenchmark::Register("mesh/acmr_grid_256", false, [](const MicroBenchmarkContext&) {
+        auto shuffled = std::make_shared<MeshData>(MakeShuffledGrid(kGridSize));
+        return [shuffled]() {
+            double acmr = MeshOptimizer::ComputeACMR(*shuffled);
+            MicroBenchmarkKeep(&acmr);
+        };
+    });
+    // Entity::LoadMesh end to end: OBJ parse, welding and reordering
+    MicroBenchmark::Register("mesh/entity_load_obj_grid_256", false, [](const MicroBenchmarkContext& context) {
+        std::string path = WriteGridObj(context, kGridSize);
+        return path.empty() ? MicroBenchmarkKernel() : MicroBenchmarkKernel([path]() {
+            Entity entity(path);
+            MicroBenchmarkKeep(&entity);
+        });
+    });
+}
+
+void RegisterTextureCases() {
+    constexpr int kSize = 1024;
+    MicroBenchmark::Register("texture/stbi_decode_png_1k", false, [](const MicroBenchmarkContext&) {
+        std::vector<uint8_t> pixels = MakeTexture(kSize, kSize);
+        auto png = std::make_shared<std::vector<uint8_t>>();
+        stbi_write_png_to_func(
+            [](void* context, void* data, int size) {
+                auto* out = static_cast<std::vector<uint8_t>*>(context);
+                out->insert(out->end(), static_cast<uint8_t*>(data), static_cast<uint8_t*>(data) + size);
+            },
+            png.get(), kSize, kSize, 4, pixels.data(), kSize * 4);
+        return [png]() {
+            int width = 0, height = 0, channels = 0;
+            unsigned char* decoded = stbi_load_from_memory(png->data(), static_cast<int>(png->size()), &width, &height, &channels, 4);
+            MicroBenchmarkKeep(decoded);
+            stbi_image_free(decoded);
+        };
+    });
+    MicroBenchmark::Register("texture/mips_color_1k", false, [](const MicroBenchmarkContext&) {
+        auto image = std::make_shared<DecodedImage>();
+        image->width = image->height = kSize;
+        image->channels = 4;
+        image->pixels = MakeTexture(kSize, kSize);
+        return [image]() {
+            image->mips.clear();
+            MipGenerator::Generate(image.get(), TEXTURE_KIND_COLOR);
+            MicroBenchmarkKeep(image->mips.back().data());
+        };
+    });
+    MicroBenchmark::Register("texture/bc1_encode_1k", false, [](const MicroBenchmarkContext&) {
+        auto pixels = std::make_shared<std::vector<uint8_t>>(MakeTexture(kSize, kSize));
+        return [pixels]() {
+            std::vector<uint8_t> blocks = TextureCache::EncodeLevel(pixels->data(), kSize, kSize, BLOCK_FORMAT_BC1);
+            MicroBenchmarkKeep(blocks.data());
+        };
+    });
+    MicroBenchmark::Register("texture/bc5_encode_1k", false, [](const MicroBenchmarkContext&) {
+        auto pixels = std::make_shared<std::vector<uint8_t>>(MakeTexture(kSize, kSize));
+        return [pixels]() {
+            std::vector<uint8_t> blocks = TextureCache::EncodeLevel(pixels->data(), kSize, kSize, BLOCK_FORMAT_BC5);
+            MicroBenchmarkKeep(blocks.data());
+        };
+    });
+}
+
+void RegisterLightingCases() {
+    constexpr int kSkyWidth = 2048, kSkyHeight = 1024;
+    MicroBenchmark::Register("skybox/decode_hdr_2k", false, [](const MicroBenchmarkContext& context) {
+        std::string path = context.temp_directory + "/sky_2k.hdr";
+        std::vector<float> sky = MakeSky(kSkyWidth, kSkyHeight);
+        if (!stbi_write_hdr(path.c_str(), kSkyWidth, kSkyHeight, 3, sky.data())) {
+            return MicroBenchmarkKernel();
+        }
+        return MicroBenchmarkKernel([path]() {
+            HdrImage image = SkyboxLoader::Decode(path);
+            MicroBenchmarkKeep(image.pixels.data());
+        });
+    });
+    MicroBenchmark::Register("skybox/environment_tables_2k", false, [](const MicroBenchmarkContext&) {
+        std::vector<float> sky = MakeSky(kSkyWidth, kSkyHeight);
+        auto halfs = std::make_shared<std::vector<uint16_t>>(static_cast<size_t>(kSkyWidth) * kSkyHeight * 4);
+        for (size_t p = 0; p < static_cast<size_t>(kSkyWidth) * kSkyHeight; ++p) {
+            for (int c = 0; c < 3; ++c) {
+                (*halfs)[p * 4 + c] = glm::packHalf1x16(sky[p * 3 + c]);
+            }
+            (*halfs)[p * 4 + 3] = glm::packHalf1x16(1.0f);
+        }
+        return [halfs]() {
+            EnvironmentTables tables = EnvironmentMap::ComputeTables(halfs->data(), kSkyWidth, kSkyHeight);
+            MicroBenchmarkKeep(&tables);
+        };
+    });
+    MicroBenchmark::Register("lights/alias_table_1m", false, [](const MicroBenchmarkContext&) {
+        auto weights = std::make_shared<std::vector<float>>(1 << 20);
+        std::mt19937 rng(3);
+        std::exponential_distribution<float> power(1.0f);
+        for (float& w : *weights) {
+            w = power(rng);
+        }
+        return [weights]() {
+            std::vector<AliasEntry> table = BuildAliasTable(*weights);
+            MicroBenchmarkKeep(table.data());
+        };
+    });
+}
+
+void RegisterFilmCases() {
+    MicroBenchmark::Register("film/denoise_640x360", false, [](const MicroBenchmarkContext&) {
+        auto frame = std::make_shared<DenoiserFrame>(MakeNoisyFrame(640, 360));
+        return [frame]() {
+            DenoiserFrame copy = *frame;
+            Denoiser::Denoise(DenoiserSettings{}, &copy);
+            MicroBenchmarkKeep(copy.color.data());
+        };
+    });
+    // Readback, per-pixel averaging, tonemapping and upload of the output image
+    MicroBenchmark::Register("film/develop_to_output_640x360", true, [](const MicroBenchmarkContext& context) {
+        auto film = std::make_shared<Film>(context.core, 640, 360);
+        DenoiserFrame frame = MakeNoisyFrame(640, 360);
+        std::vector<int32_t> samples(640 * 360, 16);
+        for (float& c : frame.color) {
+            c *= 16.0f;
+        }
+        film->GetAccumulatedColorImage()->UploadData(frame.color.data());
+        film->GetAccumulatedSamplesImage()->UploadData(samples.data());
+        film->IncrementSampleCount();
+        return [film]() { film->DevelopToOutput(); };
+    });
+}
+
+void RegisterSceneCases() {
+    MicroBenchmark::Register("scene/parse_json_1k_entities", false, [](const MicroBenchmarkContext&) {
+        auto text = std::make_shared<std::string>(MakeSceneJson(1024));
+        return [text]() {
+            SceneDescription description;
+            SceneFile::Parse(*text, "generated", &description);
+            MicroBenchmarkKeep(description.entities.data());
+        };
+    });
+    MicroBenchmark::Register("bvh/blas_grid_256", true, [](const MicroBenchmarkContext& context) {
+        std::string path = WriteGridObj(context, kGridSize);
+        auto entity = std::make_shared<Entity>(path);
+        if (!entity->IsValid()) {
+            return MicroBenchmarkKernel();
+        }
+        grassland::graphics::Core* core = context.core;
+        return MicroBenchmarkKernel([entity, core]() { entity->BuildBLAS(core); });
+    });
+    // TLAS plus the Scene::Construct* global buffers, with and without 16-bit streams
+    for (bool compact : {true, false}) {
+        std::string name = compact ? "bvh/scene_build_16_entities_compact" : "bvh/scene_build_16_entities_full";
+        MicroBenchmark::Register(name, true, [compact](const MicroBenchmarkContext& context) {
+            std::string path = WriteGridObj(context, kGridSize / 2);
+            auto scene = std::make_shared<Scene>(context.core);
+            scene->SetCompactStreams(compact);
+            for (int i = 0; i < 16; ++i) {
+                auto entity = std::make_shared<Entity>(path, Material(), glm::translate(glm::mat4(1.0f), glm::vec3(i % 4, 0.0f, i / 4)));
+                if (!entity->IsValid()) {
+                    return MicroBenchmarkKernel();
+                }
+                scene->AddEntity(entity);
+            }
+            return MicroBenchmarkKernel([scene]() { scene->BuildAccelerationStructures(); });
+        });
+    }
+    MicroBenchmark::Register("lights/light_bvh_64k", true, [](const MicroBenchmarkContext& context) {
+        auto lights = std::make_shared<std::vector<PointLight>>();
+        std::mt19937 rng(9);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        for (int i = 0; i < 1 << 16; ++i) {
+            lights->emplace_back(glm::vec3(unit(rng), unit(rng), unit(rng)) * 100.0f, glm::vec3(unit(rng), unit(rng), unit(rng)));
+        }
+        auto bvh = std::make_shared<LightBVH>(context.core);
+        return [bvh, lights]() { bvh->Build(*lights); };
+    });
+}
+
+// Layouts of shaders/micro_bench.hlsl
+struct RecordedRay {
+    glm::vec3 origin;
+    float t_min;
+    glm::vec3 direction;
+    float t_max;
+};
+
+struct BenchSettings {
+    uint32_t count;
+    uint32_t width;
+    uint32_t iterations;
+    float roughness;
+};
+
+constexpr int kTraceWidth = 1024;  // Dispatch width and height
+constexpr int kTraceCount = kTraceWidth * kTraceWidth;
+constexpr int kTiles = 4;          // Grids per side of the traced height field
+
+enum RaySet {
+    RAY_SET_CAMERA,  // Coherent rays looking down on the field
+    RAY_SET_BOUNCE,  // Random directions from random surface points
+    RAY_SET_SHADOW,  // Segments from random surface points to a light above the field
+};
+
+// kTiles x kTiles grids tiling [0, kTiles]^2 in XY, heights along Z
+std::shared_ptr<Scene> BuildTraceScene(const MicroBenchmarkContext& context) {
+    std::string path = WriteGridObj(context, kGridSize / 2);
+    auto scene = std::make_shared<Scene>(context.core);
+    for (int i = 0; i < kTiles * kTiles; ++i) {
+        auto entity = std::make_shared<Entity>(path, Material(), glm::translate(glm::mat4(1.0f), glm::vec3(i % kTiles, i / kTiles, 0.0f)));
+        if (!entity->IsValid()) {
+            return nullptr;
+        }
+        scene->AddEntity(entity);
+    }
+    scene->BuildAccelerationStructures();
+    return scene;
+}
+
+// Stand-ins for the rays of a recorded frame over BuildTraceScene's field,
+// in dispatch order
+std::vector<RecordedRay> RecordRays(RaySet set) {
+    std::vector<RecordedRay> rays(kTraceCount);
+    std::mt19937 rng(13);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const glm::vec3 eye(kTiles * 0.5f, -1.0f, 3.0f), light(kTiles * 0.25f, kTiles * 0.75f, 4.0f);
+    for (int i = 0; i < kTraceCount; ++i) {
+        RecordedRay& ray = rays[i];
+        if (set == RAY_SET_CAMERA) {
+            glm::vec3 target((i % kTraceWidth + 0.5f) * kTiles / kTraceWidth, (i / kTraceWidth + 0.5f) * kTiles / kTraceWidth, 0.0f);
+            ray = {eye, 0.0f, glm::normalize(target - eye), 1e30f};
+            continue;
+        }
+        float x = unit(rng) * kTiles, y = unit(rng) * kTiles;
+        glm::vec3 point(x, y, GridHeight(x - std::floor(x), y - std::floor(y)) + 0.01f);
+        if (set == RAY_SET_BOUNCE) {
+            float z = unit(rng), phi = unit(rng) * 6.2831853f, r = std::sqrt(1.0f - z * z);
+            ray = {point, 1e-3f, glm::vec3(r * std::cos(phi), r * std::sin(phi), z), 1e30f};
+        } else {
+            float distance = glm::length(light - point);
+            ray = {point, 1e-3f, (light - point) / distance, distance};
+        }
+    }
+    return rays;
+}
+
+// One micro_bench.hlsl ray generation entry point with its inputs bound
+struct GpuKernel {
+    grassland::graphics::Core* core = nullptr;
+    std::shared_ptr<Scene> scene;
+    std::unique_ptr<grassland::graphics::Shader> raygen_shader;
+    std::unique_ptr<grassland::graphics::Shader> miss_shader;
+    std::unique_ptr<grassland::graphics::Shader> closest_hit_shader;
+    std::unique_ptr<grassland::graphics::RayTracingProgram> program;
+    std::unique_ptr<grassland::graphics::Buffer> ray_buffer;
+    std::unique_ptr<grassland::graphics::Buffer> result_buffer;
+    std::unique_ptr<grassland::graphics::Buffer> settings_buffer;
+
+    // Runs every thread and waits for the GPU, so the sample covers the whole dispatch
+    void Dispatch() const {
+        std::unique_ptr<grassland::graphics::CommandContext> command_context;
+        core->CreateCommandContext(&command_context);
+        command_context->CmdBindRayTracingProgram(program.get());
+        command_context->CmdBindResources(0, scene->GetTLAS(), grassland::graphics::BIND_POINT_RAYTRACING);
+        command_context->CmdBindResources(1, { ray_buffer.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
+        command_context->CmdBindResources(2, { result_buffer.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
+        command_context->CmdBindResources(3, { settings_buffer.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
+        command_context->CmdDispatchRays(kTraceWidth, kTraceCount / kTraceWidth, 1);
+        core->SubmitCommandContext(command_context.get());
+        core->WaitGPU();
+    }
+};
+
+// Null if the scene or the shader is unavailable
+std::shared_ptr<GpuKernel> MakeGpuKernel(const MicroBenchmarkContext& context, const std::string& entry_point,
+                                         const std::vector<RecordedRay>& rays, const BenchSettings& settings) {
+    auto kernel = std::make_shared<GpuKernel>();
+    kernel->core = context.core;
+    kernel->scene = BuildTraceScene(context);
+    if (!kernel->scene) {
+        return nullptr;
+    }
+    std::string source = GetShaderCode("shaders/brdf.hlsl") + GetShaderCode("shaders/micro_bench.hlsl");
+    if (context.core->CreateShader(source, entry_point, "lib_6_3", &kernel->raygen_shader) != 0 ||
+        context.core->CreateShader(source, "BenchMiss", "lib_6_3", &kernel->miss_shader) != 0 ||
+        context.core->CreateShader(source, "BenchClosestHit", "lib_6_3", &kernel->closest_hit_shader) != 0) {
+        return nullptr;
+    }
+    context.core->CreateRayTracingProgram(kernel->raygen_shader.get(), kernel->miss_shader.get(),
+                                          kernel->closest_hit_shader.get(), &kernel->program);
+    kernel->program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_ACCELERATION_STRUCTURE, 1);     // space0
+    kernel->program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER, 1);             // space1 - rays
+    kernel->program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_WRITABLE_STORAGE_BUFFER, 1);    // space2 - results
+    kernel->program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_UNIFORM_BUFFER, 1);             // space3 - settings
+    kernel->program->Finalize();
+
+    context.core->CreateBuffer(rays.size() * sizeof(RecordedRay), grassland::graphics::BUFFER_TYPE_STATIC, &kernel->ray_buffer);
+    kernel->ray_buffer->UploadData(rays.data(), rays.size() * sizeof(RecordedRay));
+    context.core->CreateBuffer(kTraceCount * sizeof(float), grassland::graphics::BUFFER_TYPE_STATIC, &kernel->result_buffer);
+    context.core->CreateBuffer(sizeof(BenchSettings), grassland::graphics::BUFFER_TYPE_DYNAMIC, &kernel->settings_buffer);
+    kernel->settings_buffer->UploadData(&settings, sizeof(BenchSettings));
+    return kernel;
+}
+
+// GPU kernels, one dispatch of kTraceCount threads per iteration
+void RegisterTraceCases() {
+    struct TraceCase {
+        const char* name;
+        const char* entry_point;
+        RaySet rays;
+    };
+    static const TraceCase kCases[] = {
+        {"trace/closest_hit_camera_1m", "TraceClosestMain", RAY_SET_CAMERA},
+        {"trace/closest_hit_bounce_1m", "TraceClosestMain", RAY_SET_BOUNCE},
+        {"trace/occlusion_shadow_1m", "TraceOcclusionMain", RAY_SET_SHADOW},
+    };
+    for (const TraceCase& trace_case : kCases) {
+        MicroBenchmark::Register(trace_case.name, true, [trace_case](const MicroBenchmarkContext& context) {
+            BenchSettings settings{kTraceCount, kTraceWidth, 0, 0.0f};
+            auto kernel = MakeGpuKernel(context, trace_case.entry_point, RecordRays(trace_case.rays), settings);
+            return kernel ? MicroBenchmarkKernel([kernel]() { kernel->Dispatch(); }) : MicroBenchmarkKernel();
+        });
+    }
+    // calcD and BsdfPdf of GGX samples (shaders/brdf.hlsl), 64 per thread
+    MicroBenchmark::Register("brdf/ggx_sample_pdf_1m_x64", true, [](const MicroBenchmarkContext& context) {
+        BenchSettings settings{kTraceCount, kTraceWidth, 64, 0.5f};
+        auto kernel = MakeGpuKernel(context, "BrdfMain", {RecordedRay{}}, settings);
+        return kernel ? MicroBenchmarkKernel([kernel]() { kernel->Dispatch(); }) : MicroBenchmarkKernel();
+    });
+}
+}
+
+void RegisterMicroBenchmarks() {
+    RegisterMeshCases();
+    RegisterTextureCases();
+    RegisterLightingCases();
+    RegisterFilmCases();
+    RegisterSceneCases();
+    RegisterTraceCases();
+}
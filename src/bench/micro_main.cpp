@@ -0,0 +1,116 @@
+#include "MicroBenchmark.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// ShortMarchMicroBench: isolated kernel timings, see MicroBenchmark.h
+//   --filter <substring>  --samples <n>  --min-time-ms <ms>  --list
+//   --output <results.json>  --baseline <results.json>  --threshold <fraction>  --fail-on-regression
+//   --gpu [--vulkan | --d3d12]  also run the cases that need a device (film develop, BVH builds, traversal, BRDF)
+int main(int argc, char** argv) {
+  MicroBenchmarkSettings settings;
+  std::string output_path, baseline_path;
+  bool gpu = false, list = false, fail_on_regression = false;
+  grassland::graphics::BackendAPI api = grassland::graphics::BACKEND_API_DEFAULT;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--gpu") {
+      gpu = true;
+    } else if (arg == "--list") {
+      list = true;
+    } else if (arg == "--fail-on-regression") {
+      fail_on_regression = true;
+    } else if (arg == "--vulkan") {
+      api = grassland::graphics::BACKEND_API_VULKAN;
+    } else if (arg == "--d3d12") {
+      api = grassland::graphics::BACKEND_API_D3D12;
+    } else if (i + 1 < argc) {
+      if (arg == "--filter") {
+        settings.filter = argv[++i];
+      } else if (arg == "--samples") {
+        settings.samples = std::atoi(argv[++i]);
+      } else if (arg == "--min-time-ms") {
+        settings.min_sample_seconds = std::atof(argv[++i]) * 1e-3;
+      } else if (arg == "--threshold") {
+        settings.threshold = std::atof(argv[++i]);
+      } else if (arg == "--output") {
+        output_path = argv[++i];
+      } else if (arg == "--baseline") {
+        baseline_path = argv[++i];
+      }
+    }
+  }
+
+  RegisterMicroBenchmarks();
+  if (list) {
+    for (const auto& bench_case : MicroBenchmark::GetCases()) {
+      std::printf("%s%s\n", bench_case.name.c_str(), bench_case.needs_gpu ? " (gpu)" : "");
+    }
+    return 0;
+  }
+
+  std::vector<MicroBenchmarkResult> baseline;
+  if (!baseline_path.empty() && !MicroBenchmark::LoadBaseline(baseline_path, &baseline)) {
+    return 1;
+  }
+
+  MicroBenchmarkContext context;
+  std::filesystem::path temp_directory = std::filesystem::temp_directory_path() / "shortmarch_microbench";
+  std::filesystem::create_directories(temp_directory);
+  context.temp_directory = temp_directory.string();
+  std::shared_ptr<grassland::graphics::Core> core;
+  if (gpu) {
+    grassland::graphics::CreateCore(api, grassland::graphics::Core::Settings{}, &core);
+    core->InitializeLogicalDeviceAutoSelect(true);
+    context.core = core.get();
+  }
+
+  std::vector<MicroBenchmarkResult> results;
+  int regressions = 0;
+  std::printf("%-40s %14s %10s %12s %s\n", "case", "median (us)", "+/- MAD", "iterations", baseline.empty() ? "" : "vs baseline");
+  for (const auto& bench_case : MicroBenchmark::GetCases()) {
+    if (bench_case.name.find(settings.filter) == std::string::npos || (bench_case.needs_gpu && !gpu)) {
+      continue;
+    }
+    MicroBenchmarkKernel kernel = bench_case.setup(context);
+    if (!kernel) {
+      std::printf("%-40s skipped (input unavailable)\n", bench_case.name.c_str());
+      continue;
+    }
+    MicroBenchmarkResult result = MicroBenchmark::Run(bench_case, kernel, settings);
+    results.push_back(result);
+
+    std::string comparison;
+    if (!baseline.empty()) {
+      double ratio = 1.0;
+      static const char* kVerdicts[] = {"new", "unchanged", "faster", "SLOWER"};
+      MicroBenchmarkVerdict verdict = MicroBenchmark::Compare(result, baseline, settings.threshold, &ratio);
+      char buffer[64];
+      std::snprintf(buffer, sizeof(buffer), "%+.1f%% %s", (ratio - 1.0) * 100.0, kVerdicts[verdict]);
+      comparison = buffer;
+      regressions += verdict == MICRO_BENCHMARK_SLOWER ? 1 : 0;
+    }
+    std::printf("%-40s %14.2f %9.1f%% %12llu %s\n", result.name.c_str(), result.median * 1e-3,
+                result.median > 0.0 ? 100.0 * result.mad / result.median : 0.0,
+                static_cast<unsigned long long>(result.iterations), comparison.c_str());
+    std::fflush(stdout);
+  }
+
+  if (!output_path.empty()) {
+    std::ofstream file(output_path);
+    file << MicroBenchmark::ToJson(results);
+    if (!file) {
+      grassland::LogError("Failed to write {}", output_path);
+      return 1;
+    }
+    grassland::LogInfo("Results written to {}", output_path);
+  }
+  if (regressions > 0) {
+    grassland::LogWarning("{} case(s) slower than the baseline", regressions);
+  }
+  return fail_on_regression && regressions > 0 ? 1 : 0;
+}
@@ -1,10 +1,56 @@
 #include "app.h"
+#include "MeshCache.h"
+#include "TextureCache.h"
+#include "Trace.h"
 
-int main() {
+#include <cstdlib>
+#include <string>
+
+int main(int argc, char** argv) {
+  TRACE_THREAD_NAME("main");
   // Create only one application instance to avoid ImGui conflicts
   // Change BACKEND_API_D3D12 to BACKEND_API_VULKAN if you prefer Vulkan
   Application app{grassland::graphics::BACKEND_API_D3D12};
 
+  std::string trace_path;
+  std::string checkpoint_path;
+  int checkpoint_interval = 64;
+  bool checkpoint_compress = true;
+  for (int i = 1; i + 1 < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--skybox") {
+      app.SetSkyboxPath(argv[++i]);
+    } else if (arg == "--scene") {
+      app.SetScenePath(argv[++i]);
+    } else if (arg == "--trace") {
+      trace_path = argv[++i];
+    } else if (arg == "--checkpoint") {
+      checkpoint_path = argv[++i];
+    } else if (arg == "--checkpoint-every") {
+      checkpoint_interval = std::atoi(argv[++i]);
+    } else if (arg == "--checkpoint-compression") {
+      checkpoint_compress = std::atoi(argv[++i]) != 0;
+    } else if (arg == "--resume") {
+      app.SetResumePath(argv[++i]);
+    } else if (arg == "--geometry-budget") {
+      // Out-of-core geometry: meshes are mapped from the mesh cache, GPU residency is capped (MB)
+      MeshCache::SetEnabled(true);
+      app.SetGeometryBudget(static_cast<size_t>(std::atoll(argv[++i])) << 20);
+    } else if (arg == "--mesh-cache") {
+      MeshCache::SetEnabled(true);
+      MeshCache::SetDirectory(argv[++i]);
+    } else if (arg == "--texture-cache") {
+      // BC1/BC5 cache of decoded textures (lossy), so later launches skip decoding
+      TextureCache::SetEnabled(true);
+      TextureCache::SetDirectory(argv[++i]);
+    } else if (arg == "--no-texture-cache") {
+      TextureCache::SetEnabled(false);
+    }
+  }
+
+  if (!checkpoint_path.empty()) {
+    app.SetCheckpoint(checkpoint_path, checkpoint_interval, checkpoint_compress);
+  }
   app.OnInit();
 
   while (app.IsAlive()) {
@@ -17,5 +63,9 @@ int main() {
 
   app.OnClose();
 
+  if (!trace_path.empty()) {
+    Trace::WriteChromeTrace(trace_path);
+  }
+
   return 0;
 }
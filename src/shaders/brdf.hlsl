@@ -0,0 +1,24 @@
+// GGX lobe shared by shader.hlsl and the microbenchmark kernels
+// (micro_bench.hlsl); the host prepends it to both sources
+
+static float PI = 3.1415926536;
+
+float sqr(float x) { return x * x; }
+float calcD(float alpha, float n_h) {
+  return sqr(alpha) / (PI * sqr(sqr(n_h) * sqr(alpha) + (1 - sqr(n_h))));
+}
+
+// Pdf of the mixed specular/diffuse lobe sampled in ClosestHitMain
+float BsdfPdf(float3 N, float3 outDir, float3 inDir, float alpha, float p_mix) {
+  float3 h = normalize(inDir + outDir);
+  float n_h = dot(N, h);
+  return p_mix * calcD(alpha, n_h) * n_h / (4 * dot(outDir, h)) + (1 - p_mix) * dot(N, inDir) / PI;
+}
+
+// Reflect outDir about a GGX half vector drawn from xi; M maps the tangent frame to world.
+// The result may point below the surface, callers reject those.
+float3 SampleGGX(float2 xi, float3x3 M, float alpha2, float3 outDir) {
+  float phi = xi.x * 2 * PI, cosTheta = sqrt(xi.y / ((1 - xi.y) * alpha2 + xi.y)), sinTheta = cosTheta >= 1.0 ? 0 : sqrt(1 - sqr(cosTheta));
+  float3 h = mul(M, float3 (sinTheta * cos(phi), sinTheta * sin(phi), cosTheta));
+  return h * dot(outDir, h) * 2 - outDir;
+}
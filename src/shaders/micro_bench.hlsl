@@ -0,0 +1,94 @@
+// Kernels timed by ShortMarchMicroBench (bench/micro_cases.cpp), compiled after brdf.hlsl.
+// One thread per recorded ray (or per BRDF loop), threads indexed row by row.
+
+struct RecordedRay {
+  float3 origin;
+  float t_min;
+  float3 direction;
+  float t_max;
+};
+
+struct BenchSettings {
+  uint count;       // Rays (or BRDF loops) in the dispatch
+  uint width;       // Dispatch width
+  uint iterations;  // Samples per BRDF loop
+  float roughness;
+};
+
+RaytracingAccelerationStructure as : register(t0, space0);
+StructuredBuffer<RecordedRay> rays : register(t0, space1);
+RWStructuredBuffer<float> results : register(u0, space2);  // Per thread: hit distance, 0 if occluded, -1 on a miss; or the BRDF sum
+ConstantBuffer<BenchSettings> settings : register(b0, space3);
+
+struct BenchPayload {
+  float t;
+};
+
+uint ThreadIndex() {
+  return DispatchRaysIndex().y * settings.width + DispatchRaysIndex().x;
+}
+
+RayDesc LoadRay(uint index) {
+  RecordedRay recorded = rays[index];
+  RayDesc ray;
+  ray.Origin = recorded.origin;
+  ray.Direction = recorded.direction;
+  ray.TMin = recorded.t_min;
+  ray.TMax = recorded.t_max;
+  return ray;
+}
+
+// Nearest hit, as for camera and bounce rays
+[shader("raygeneration")] void TraceClosestMain() {
+  uint index = ThreadIndex();
+  if (index >= settings.count) return;
+  BenchPayload payload;
+  payload.t = -1.0;
+  TraceRay(as, RAY_FLAG_FORCE_OPAQUE, 0xFF, 0, 0, 0, LoadRay(index), payload);
+  results[index] = payload.t;
+}
+
+// Any hit ends the search, with the flags of IsLightVisible in shader.hlsl
+[shader("raygeneration")] void TraceOcclusionMain() {
+  uint index = ThreadIndex();
+  if (index >= settings.count) return;
+  BenchPayload payload;
+  payload.t = 0.0;
+  TraceRay(as, RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_SKIP_CLOSEST_HIT_SHADER | RAY_FLAG_FORCE_OPAQUE,
+           0xFF, 0, 0, 0, LoadRay(index), payload);
+  results[index] = payload.t;
+}
+
+// GGX sampling followed by calcD and BsdfPdf of the sample, chained so every
+// iteration depends on the last
+[shader("raygeneration")] void BrdfMain() {
+  uint index = ThreadIndex();
+  if (index >= settings.count) return;
+  float alpha = sqr(settings.roughness), alpha2 = sqr(alpha);
+  float3 N = float3 (0.0, 0.0, 1.0);
+  float3x3 M = float3x3 (1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0);
+  float3 outDir = normalize(float3 (0.3, 0.2, 1.0));
+  uint state = index * 747796405u + 2891336453u;
+  float sum = 0.0;
+  for (uint i = 0; i < settings.iterations; i++) {
+    float2 xi;
+    state = state * 747796405u + 2891336453u;
+    xi.x = (state >> 8) / 16777216.0;  // High bits, the low ones of an LCG repeat quickly
+    state = state * 747796405u + 2891336453u;
+    xi.y = (state >> 8) / 16777216.0;
+    float3 inDir = SampleGGX(xi, M, alpha2, outDir);
+    if (dot(N, inDir) <= 0.0) continue;
+    float3 h = normalize(inDir + outDir);
+    sum += calcD(alpha, dot(N, h)) + BsdfPdf(N, outDir, inDir, alpha, 0.5);
+    outDir = inDir;
+  }
+  results[index] = sum;
+}
+
+[shader("miss")] void BenchMiss(inout BenchPayload payload) {
+  payload.t = -1.0;
+}
+
+[shader("closesthit")] void BenchClosestHit(inout BenchPayload payload, in BuiltInTriangleIntersectionAttributes attr) {
+  payload.t = RayTCurrent();
+}
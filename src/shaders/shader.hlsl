@@ -4,6 +4,12 @@ struct CameraInfo {
   float4x4 camera_to_world;
   float aperture_size;
   float focal_distance;
+  float2 padding;
+  float4x4 prev_world_to_screen;  // Camera of the accumulated history
+  float3 prev_position;
+  uint reproject;                 // The camera moved or a material changed since the last frame
+  float history_limit;            // Sample count reprojected history is scaled down to
+  int invalidated_entity;         // Entity whose pixels drop their history (-1 for none)
 };
 
 struct Material {
@@ -15,17 +21,28 @@ struct Material {
   float3 emission;
 };
 
-static float PI = 3.1415926536;
+// Stream encodings (keep in sync with StreamFlags in Scene.h)
+#define STREAM_POSITION_16 1     // 3 x 16-bit UNORM in the mesh AABB (else 3 floats)
+#define STREAM_UV_16 2           // 2 x 16-bit UNORM in the mesh UV bounds (else 2 floats)
+#define STREAM_INDEX_16 4        // Two indices per word
+#define STREAM_MATERIAL_ID_16 8  // Two material IDs per word
 
+// All global streams are 32-bit words; offsets are in words
 struct InstanceMetadata {
-  int uv_offset;          // Offset in global UV buffer (-1 if no UV)
-  int material_id_offset; // Offset in global material ID buffer (or direct material index)
+  int uv_offset;          // Offset in global UV stream (-1 if no UV)
+  int material_id_offset; // Offset in global material ID stream (or direct material index)
   int has_uv;             // Boolean flag (0 or 1)
   int has_material_ids;   // Boolean flag (0 or 1)
-  int vertex_count;       // Number of vertices (0 if no UV)
-  int triangle_count;     // Number of triangles (0 if no material IDs)
-  int index_offset;       // Offset in global index buffer
-  int padding[1];         // Align to 32 bytes (reduced from 2 to 1)
+  int vertex_count;       // Number of vertices
+  int triangle_count;     // Number of triangles
+  int index_offset;       // Offset in global index stream
+  uint stream_flags;      // STREAM_* bits
+  float3 position_min;    // 16-bit positions: min + q * scale
+  int position_offset;    // Offset in global position stream (object space)
+  float3 position_scale;
+  int padding;
+  float2 uv_min;          // 16-bit UVs: min + q * scale
+  float2 uv_scale;
 };
 
 struct HoverInfo {
@@ -37,58 +54,232 @@ struct PointLight {
   float3 color;
 };
 
+// Light hierarchy node (see LightBVH): internal nodes point to two adjacent
+// children, leaves carry a light index with LIGHT_BVH_LEAF set
+struct LightBVHNode {
+  float3 bounds_min;
+  float power;
+  float3 bounds_max;
+  uint child_or_light;
+};
+#define LIGHT_BVH_LEAF 0x80000000u
+
+// World-space emissive triangle (see Scene::BuildEmitters)
+struct EmissiveTriangle {
+  float3 p0;
+  float area;
+  float3 p1;
+  uint entity;
+  float3 p2;
+  uint primitive;
+  float3 emission;
+  float power;
+};
+// Range of emissive triangles belonging to one entity
+struct Emitter {
+  uint first_triangle;
+  uint triangle_count;
+  float power;
+  uint padding;
+};
+// Walker/Vose alias table entry (see BuildAliasTable)
+struct AliasEntry {
+  float probability;
+  uint alias;
+};
+// Shadow rays per shading point towards point lights (all lights are traced
+// when there are no more than this)
+#define LIGHT_SAMPLES 2
+
+// Virtual texture (see VirtualTextureSystem): level_count stops at the mip
+// tail, which is always resident
+struct VirtualTextureInfo {
+  uint width;
+  uint height;
+  uint level_count;
+  uint page_table_offset;
+  uint format;  // VT_FORMAT_*
+  uint3 padding;
+};
+
+// Keep in sync with VirtualTextureSystem and BlockFormat
+#define VT_PAGE_SIZE 128
+#define VT_PAGE_BORDER 4
+#define VT_PAGE_BLOCKS 34                                              // 4x4 blocks per page side, border included
+#define VT_PHYSICAL_PAGE_WORDS (VT_PAGE_BLOCKS * VT_PAGE_BLOCKS * 2)  // One 8-byte block per 4x4 texels
+#define VT_FEEDBACK_SIZE 65536
+#define VT_FORMAT_BC1 1
+#define VT_FORMAT_BC5 5
+
 RaytracingAccelerationStructure as : register(t0, space0);
 RWTexture2D<float4> output : register(u0, space1);
 ConstantBuffer<CameraInfo> camera_info : register(b0, space2);
 StructuredBuffer<Material> materials : register(t0, space3);
 ConstantBuffer<HoverInfo> hover_info : register(b0, space4);
 RWTexture2D<int> entity_id_output : register(u0, space5);
-RWTexture2D<float4> accumulated_color : register(u0, space6);
+RWTexture2D<float4> accumulated_color : register(u0, space6);         // RGB sum, A = sum of squared luminance
 RWTexture2D<int> accumulated_samples : register(u0, space7);
 struct FrameIndexCB {
   uint frame_index;
   uint num_point_lights;
-  uint padding[2];
+  uint env_width;   // Environment sampling tables (0 = no explicit environment sampling)
+  uint env_height;
+  uint num_emitters;      // Entities with emissive triangles (0 = no mesh light sampling)
+  float emissive_power;   // Summed luminance x area of all emissive triangles
+  uint count_rays;        // 1 = add traced rays to ray_counters (benchmark runs)
+  uint sampler_type;     // SAMPLER_INDEPENDENT or SAMPLER_SOBOL
+  uint sample_index;     // Index of this frame's sample in the pixel's sequence
+  uint sequence_seed;    // Scrambles the sequence, fixed while the film accumulates
+  uint2 padding;
 };
 ConstantBuffer<FrameIndexCB> misc : register(b0, space8);
-StructuredBuffer<uint> offset : register(t0, space9);
-StructuredBuffer<float3> vertices : register(t1, space9);
-StructuredBuffer<uint3> triangles : register(t2, space9);
-StructuredBuffer<float2> global_uvs : register(t0, space10);           // Global UV coordinates (no padding)
-StructuredBuffer<int> global_material_ids : register(t1, space10);     // Global material IDs (no padding)
+StructuredBuffer<uint> global_positions : register(t0, space9);       // Global object-space positions
+StructuredBuffer<uint> global_uvs : register(t0, space10);             // Global UV coordinates (no padding)
+StructuredBuffer<uint> global_material_ids : register(t1, space10);    // Global material IDs (no padding)
 StructuredBuffer<InstanceMetadata> instance_metadata : register(t0, space11);  // Per-instance metadata
 StructuredBuffer<uint> global_indices : register(t2, space10);         // Global index buffer
-Texture2D<float4> textures[64] : register(t0, space12);                          // Texture array (bindless)
-SamplerState g_Sampler : register(s0, space13);
+StructuredBuffer<uint> vt_pool : register(t0, space12);                          // Physical pages, BC1 or BC4 blocks
+StructuredBuffer<uint> vt_page_table : register(t1, space12);                    // 0 = not resident, else pages + 1 (16 bits each)
+StructuredBuffer<VirtualTextureInfo> vt_textures : register(t2, space12);
+RWStructuredBuffer<uint> vt_feedback : register(u0, space13);                    // Requested page table entries + 1
 StructuredBuffer <PointLight> point_lights : register (t0, space14);
-Texture2D<float4> normalmaps[64] : register(t0, space15); 
-SamplerState normalmap_sampler : register(s0, space16);
-Texture2D<float4>hdr_skybox: register(t0, space17);
-SamplerState skybox_sampler : register(s0, space18);
+StructuredBuffer<LightBVHNode> light_bvh : register(t1, space14);
+Texture2D<float4>hdr_skybox: register(t0, space15);
+SamplerState skybox_sampler : register(s0, space16);
+StructuredBuffer<float> env_marginal_cdf : register(t0, space17);     // env_height + 1
+StructuredBuffer<float> env_conditional_cdf : register(t1, space17);  // env_height * (env_width + 1)
+StructuredBuffer<float> env_pdf : register(t2, space17);              // Per-pixel pdf in UV space
+StructuredBuffer<EmissiveTriangle> emissive_triangles : register(t0, space18);
+StructuredBuffer<AliasEntry> emissive_triangle_alias : register(t1, space18);  // Per emitter, local indices
+StructuredBuffer<Emitter> emitters : register(t2, space18);
+StructuredBuffer<AliasEntry> emitter_alias : register(t3, space18);
+RWTexture2D<float4> accumulated_albedo : register(u0, space19);       // First-hit albedo sum, A = hit distance sum
+RWTexture2D<float4> accumulated_normal : register(u1, space19);       // First-hit world normal sum, W = last instance ID + 1
+RWTexture2D<float4> history_color : register(u0, space20);            // Last accumulation (see Film), read only
+RWTexture2D<float4> history_albedo : register(u1, space20);
+RWTexture2D<float4> history_normal : register(u2, space20);
+RWTexture2D<int> history_samples : register(u0, space21);
+RWStructuredBuffer<uint> ray_counters : register(u0, space22);        // Primary, secondary, shadow rays traced
 
 struct RayPayload {
   float3 color;
   bool hit;
   uint instance_id;
-  uint seed;
+  uint dimension;     // Next sampler dimension group of this path
   uint depth;
+  float cone_width;   // Ray cone footprint at the ray origin
+  float cone_spread;  // Ray cone spread angle (radians)
+  float bsdf_pdf;     // Pdf of the BSDF sample that spawned this ray (0 for camera rays)
+  float3 aov_albedo;  // First-hit albedo (1 for the sky)
+  float aov_distance; // First-hit distance (0 for the sky)
+  float3 aov_normal;  // First-hit world normal (0 for the sky)
+};
+
+#define RAY_COUNTER_PRIMARY 0
+#define RAY_COUNTER_SECONDARY 1
+#define RAY_COUNTER_SHADOW 2
+
+// One atomic per wave so counting barely perturbs the timings it is measured with
+void CountRay(uint counter) {
+  if (misc.count_rays != 0) {
+    uint lanes = WaveActiveCountBits(true);
+    if (WaveIsFirstLane()) {
+      InterlockedAdd(ray_counters[counter], lanes);
+    }
+  }
+}
+
+#define SAMPLER_INDEPENDENT 0
+#define SAMPLER_SOBOL 1
+
+// Sobol direction numbers for the first four dimensions (MSB aligned, Joe-Kuo parameters)
+static const uint sobol_directions[4][32] = {
+  {0x80000000u, 0x40000000u, 0x20000000u, 0x10000000u, 0x08000000u, 0x04000000u, 0x02000000u, 0x01000000u,
+   0x00800000u, 0x00400000u, 0x00200000u, 0x00100000u, 0x00080000u, 0x00040000u, 0x00020000u, 0x00010000u,
+   0x00008000u, 0x00004000u, 0x00002000u, 0x00001000u, 0x00000800u, 0x00000400u, 0x00000200u, 0x00000100u,
+   0x00000080u, 0x00000040u, 0x00000020u, 0x00000010u, 0x00000008u, 0x00000004u, 0x00000002u, 0x00000001u},
+  {0x80000000u, 0xc0000000u, 0xa0000000u, 0xf0000000u, 0x88000000u, 0xcc000000u, 0xaa000000u, 0xff000000u,
+   0x80800000u, 0xc0c00000u, 0xa0a00000u, 0xf0f00000u, 0x88880000u, 0xcccc0000u, 0xaaaa0000u, 0xffff0000u,
+   0x80008000u, 0xc000c000u, 0xa000a000u, 0xf000f000u, 0x88008800u, 0xcc00cc00u, 0xaa00aa00u, 0xff00ff00u,
+   0x80808080u, 0xc0c0c0c0u, 0xa0a0a0a0u, 0xf0f0f0f0u, 0x88888888u, 0xccccccccu, 0xaaaaaaaau, 0xffffffffu},
+  {0x80000000u, 0xc0000000u, 0x60000000u, 0x90000000u, 0xe8000000u, 0x5c000000u, 0x8e000000u, 0xc5000000u,
+   0x68800000u, 0x9cc00000u, 0xee600000u, 0x55900000u, 0x80680000u, 0xc09c0000u, 0x60ee0000u, 0x90550000u,
+   0xe8808000u, 0x5cc0c000u, 0x8e606000u, 0xc5909000u, 0x6868e800u, 0x9c9c5c00u, 0xeeee8e00u, 0x5555c500u,
+   0x8000e880u, 0xc0005cc0u, 0x60008e60u, 0x9000c590u, 0xe8006868u, 0x5c009c9cu, 0x8e00eeeeu, 0xc5005555u},
+  {0x80000000u, 0xc0000000u, 0x20000000u, 0x50000000u, 0xf8000000u, 0x74000000u, 0xa2000000u, 0x93000000u,
+   0xd8800000u, 0x25400000u, 0x59e00000u, 0xe6d00000u, 0x78080000u, 0xb40c0000u, 0x82020000u, 0xc3050000u,
+   0x208f8000u, 0x51474000u, 0xfbea2000u, 0x75d93000u, 0xa0858800u, 0x914e5400u, 0xdbe79e00u, 0x25db6d00u,
+   0x58800080u, 0xe54000c0u, 0x79e00020u, 0xb6d00050u, 0x800800f8u, 0xc00c0074u, 0x200200a2u, 0x50050093u}
 };
 
-float Rand(inout uint state) {
-  state ^= state << 13;
-  state ^= state >> 17;
-  state ^= state << 5;
-  return state * 2.3283064365386962890625e-10;
+uint Hash(uint x) {
+  x ^= x >> 17; x *= 0xed5ad4bbu;
+  x ^= x >> 11; x *= 0xac4c1b51u;
+  x ^= x >> 15; x *= 0x31848babu;
+  x ^= x >> 14;
+  return x;
 }
 
-uint tea(uint val0, uint val1) {
-  uint v0 = val0; uint v1 = val1; uint s0 = 0;
-  for(uint n = 0; n < 16; n++) {
-    s0 += 0x9e3779b9;
-    v0 += ((v1 << 4) + 0xa341316c) ^ (v1 + s0) ^ ((v1 >> 5) + 0xc8013ea4);
-    v1 += ((v0 << 4) + 0xad90777d) ^ (v0 + s0) ^ ((v0 >> 5) + 0x7e95761e);
+uint HashCombine(uint seed, uint v) {
+  return seed ^ (v + (seed << 6) + (seed >> 2));
+}
+
+// Laine-Karras style permutation, bijective on 32 bits and only mixing towards the high bits
+uint LaineKarrasPermutation(uint x, uint seed) {
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return x;
+}
+
+// Owen scrambling of a 32-bit fixed-point value (Burley 2020)
+uint NestedUniformScramble(uint x, uint seed) {
+  return reversebits(LaineKarrasPermutation(reversebits(x), seed));
+}
+
+uint Sobol(uint index, uint dim) {
+  uint x = 0;
+  for (uint bit = 0; index != 0; index >>= 1, bit++) {
+    if (index & 1) x ^= sobol_directions[dim][bit];
+  }
+  return x;
+}
+
+// 24 bits so the result stays strictly below 1
+float ToUnitFloat(uint x) {
+  return (x >> 8) * 5.9604644775390625e-8;
+}
+
+// Next four dimensions of this pixel's sample stream. Every sampling decision takes its own
+// dimension group ("padding"), so each is a well-stratified 4D point over the frames of a pixel.
+// In Sobol mode sample_index walks the sequence; the index is shuffled and every dimension
+// Owen-scrambled with seeds from the pixel, the group and the sequence seed (fixed while
+// accumulating, so the samples of one accumulation stay stratified).
+float4 Sample4D(inout uint dimension) {
+  uint2 pixel = DispatchRaysIndex().xy;
+  uint seed = HashCombine(Hash(pixel.y * DispatchRaysDimensions().x + pixel.x), dimension++);
+  seed = HashCombine(seed, misc.sequence_seed);
+  if (misc.sampler_type == SAMPLER_SOBOL) {
+    uint index = NestedUniformScramble(misc.sample_index, seed);
+    return float4(ToUnitFloat(NestedUniformScramble(Sobol(index, 0), HashCombine(seed, 0))),
+                  ToUnitFloat(NestedUniformScramble(Sobol(index, 1), HashCombine(seed, 1))),
+                  ToUnitFloat(NestedUniformScramble(Sobol(index, 2), HashCombine(seed, 2))),
+                  ToUnitFloat(NestedUniformScramble(Sobol(index, 3), HashCombine(seed, 3))));
   }
-  return v0;
+  uint state = Hash(HashCombine(seed, misc.sample_index));
+  uint4 bits = uint4(state, Hash(state), Hash(state ^ 0x9e3779b9u), Hash(state ^ 0x7f4a7c15u));
+  return float4(ToUnitFloat(bits.x), ToUnitFloat(bits.y), ToUnitFloat(bits.z), ToUnitFloat(bits.w));
+}
+
+// Dimensions 0 and 1 form a (0,2)-sequence, the best 2D stratification of the set
+float2 Sample2D(inout uint dimension) {
+  return Sample4D(dimension).xy;
+}
+
+float Sample1D(inout uint dimension) {
+  return Sample4D(dimension).x;
 }
 
 float2 DirectionToUV(float3 dir) {
@@ -102,6 +293,177 @@ float3 SampleSkybox(float3 direction) {
   return hdr_skybox.SampleLevel(skybox_sampler, uv, 0).rgb;
 }
 
+float PowerHeuristic(float pdf_a, float pdf_b) {
+  float a = pdf_a * pdf_a, b = pdf_b * pdf_b;
+  return a + b > 0.0 ? a / (a + b) : 0.0;
+}
+
+// Last entry i of cdf[offset .. offset + count] with cdf[offset + i] <= xi
+uint FindInterval(StructuredBuffer<float> cdf, uint offset, uint count, float xi) {
+  uint lo = 0, hi = count;
+  while (hi - lo > 1) {
+    uint mid = (lo + hi) / 2;
+    if (cdf[offset + mid] <= xi) lo = mid; else hi = mid;
+  }
+  return lo;
+}
+
+// Solid angle pdf of picking direction with SampleEnvironment
+float EnvPdf(float3 direction) {
+  float sin_theta = sqrt(max(0.0, 1.0 - direction.y * direction.y));
+  if (misc.env_width == 0 || sin_theta < 1e-6) return 0.0;
+  float2 uv = DirectionToUV(direction);
+  uint2 pixel = min(uint2(uv * float2(misc.env_width, misc.env_height)), uint2(misc.env_width, misc.env_height) - 1);
+  return env_pdf[pixel.y * misc.env_width + pixel.x] / (2.0 * PI * PI * sin_theta);
+}
+
+// Direction proportional to sin(theta)-weighted skybox luminance (see EnvironmentMap)
+float3 SampleEnvironment(float2 xi, out float pdf) {
+  float xi_u = xi.x, xi_v = xi.y;
+  uint y = FindInterval(env_marginal_cdf, 0, misc.env_height, xi_v);
+  float c0 = env_marginal_cdf[y], c1 = env_marginal_cdf[y + 1];
+  float v = (y + saturate((xi_v - c0) / max(c1 - c0, 1e-12))) / misc.env_height;
+
+  uint row = y * (misc.env_width + 1);
+  uint x = FindInterval(env_conditional_cdf, row, misc.env_width, xi_u);
+  c0 = env_conditional_cdf[row + x];
+  c1 = env_conditional_cdf[row + x + 1];
+  float u = (x + saturate((xi_u - c0) / max(c1 - c0, 1e-12))) / misc.env_width;
+
+  float phi = (u - 0.5) * 2.0 * PI, theta = v * PI;
+  float sin_theta = sin(theta);
+  pdf = sin_theta > 1e-6 ? env_pdf[y * misc.env_width + x] / (2.0 * PI * PI * sin_theta) : 0.0;
+  return float3(sin_theta * cos(phi), cos(theta), sin_theta * sin(phi));
+}
+
+uint2 VTLevelSize(VirtualTextureInfo info, uint level) {
+  return max(uint2(info.width >> level, info.height >> level), 1u);
+}
+
+uint2 VTPageCount(uint2 size) {
+  return (size + VT_PAGE_SIZE - 1) / VT_PAGE_SIZE;
+}
+
+uint VTPageTableIndex(VirtualTextureInfo info, uint level, uint2 page) {
+  uint index = info.page_table_offset;
+  for (uint l = 0; l < level; l++) {
+    uint2 count = VTPageCount(VTLevelSize(info, l));
+    index += count.x * count.y;
+  }
+  return index + page.y * VTPageCount(VTLevelSize(info, level)).x + page.x;
+}
+
+uint3 UnpackRGB565(uint c) {
+  uint3 v = uint3((c >> 11) & 31, (c >> 5) & 63, c & 31);
+  return uint3((v.x << 3) | (v.x >> 2), (v.y << 2) | (v.y >> 4), (v.z << 3) | (v.z >> 2));
+}
+
+// Texel i (row-major in the 4x4 block) of a BC1 block, as the CPU decoder in TextureCache
+float4 DecodeBC1Texel(uint2 block, uint i) {
+  uint c0 = block.x & 0xFFFF, c1 = block.x >> 16;
+  uint3 p0 = UnpackRGB565(c0), p1 = UnpackRGB565(c1);
+  uint k = (block.y >> (2 * i)) & 3;
+  uint4 c;
+  if (k == 0) c = uint4(p0, 255);
+  else if (k == 1) c = uint4(p1, 255);
+  else if (c0 > c1) c = uint4(k == 2 ? (2 * p0 + p1) / 3 : (p0 + 2 * p1) / 3, 255);
+  else c = k == 2 ? uint4((p0 + p1) / 2, 255) : uint4(0, 0, 0, 0);
+  return c / 255.0;
+}
+
+// Texel i of a BC4 block (3-bit codes from bit 16 on, one may straddle the two words)
+float DecodeBC4Texel(uint2 block, uint i) {
+  int r0 = block.x & 0xFF, r1 = (block.x >> 8) & 0xFF;
+  uint bit = 16 + 3 * i;
+  int k = (bit < 32 ? (block.x >> bit) | (block.y << (32 - bit)) : block.y >> (bit - 32)) & 7;
+  int v;
+  if (k == 0) v = r0;
+  else if (k == 1) v = r1;
+  else if (r0 > r1) v = ((8 - k) * r0 + (k - 1) * r1) / 7;
+  else if (k < 6) v = ((6 - k) * r0 + (k - 1) * r1) / 5;
+  else v = k == 6 ? 0 : 255;
+  return v / 255.0;
+}
+
+// Block of a physical page holding page texel t (-VT_PAGE_BORDER at the top left)
+uint2 VTBlock(uint physical, int2 t, out uint i) {
+  uint2 p = uint2(t + VT_PAGE_BORDER);
+  i = (p.y & 3) * 4 + (p.x & 3);
+  uint word = (physical - 1) * VT_PHYSICAL_PAGE_WORDS + ((p.y >> 2) * VT_PAGE_BLOCKS + (p.x >> 2)) * 2;
+  return uint2(vt_pool[word], vt_pool[word + 1]);
+}
+
+float4 VTTexel(uint format, uint entry, int2 t) {
+  uint i;
+  uint2 block = VTBlock(entry & 0xFFFF, t, i);
+  if (format == VT_FORMAT_BC1) return DecodeBC1Texel(block, i);
+  // BC5: red and green halves in two physical pages, Z of the unit normal reconstructed
+  float2 xy = float2(DecodeBC4Texel(block, i), DecodeBC4Texel(VTBlock(entry >> 16, t, i), i));
+  float2 n = xy * 2.0 - 1.0;
+  return float4(xy, sqrt(saturate(1.0 - dot(n, n))) * 0.5 + 0.5, 1.0);
+}
+
+// Bilinear sample of one level from its page (the page border covers the
+// filter footprint), decoding the four texels; returns false when the page is not resident
+bool VTSampleLevel(VirtualTextureInfo info, float2 uv, uint level, out float4 color, out uint page_index) {
+  uint2 size = VTLevelSize(info, level);
+  float2 pos = frac(uv) * size;
+  uint2 page = min((uint2)pos, size - 1) / VT_PAGE_SIZE;
+  page_index = VTPageTableIndex(info, level, page);
+  uint entry = vt_page_table[page_index];
+  color = float4(0, 0, 0, 1);
+  if (entry == 0) return false;
+
+  float2 f = pos - 0.5 - float2(page * VT_PAGE_SIZE);
+  int2 i0 = (int2)floor(f);
+  float2 t = f - i0;
+  color = lerp(lerp(VTTexel(info.format, entry, i0), VTTexel(info.format, entry, i0 + int2(1, 0)), t.x),
+               lerp(VTTexel(info.format, entry, i0 + int2(0, 1)), VTTexel(info.format, entry, i0 + int2(1, 1)), t.x),
+               t.y);
+  return true;
+}
+
+// Trilinear lookup through the page table. The wanted page is reported in the
+// feedback buffer; until it streams in, the finest resident coarser level is used.
+float4 SampleVirtualTexture(uint id, float2 uv, float lod) {
+  VirtualTextureInfo info = vt_textures[id];
+  lod = clamp(lod, 0.0, float(info.level_count - 1));
+  uint level = (uint)lod;
+
+  float4 color;
+  uint page_index;
+  bool resident = VTSampleLevel(info, uv, level, color, page_index);
+
+  uint2 pixel = DispatchRaysIndex().xy;
+  uint slot = (pixel.y * DispatchRaysDimensions().x + pixel.x) * 2654435761u ^ (misc.frame_index * 40503u + id);
+  vt_feedback[slot & (VT_FEEDBACK_SIZE - 1)] = page_index + 1;
+
+  if (resident) {
+    float4 next;
+    uint next_page;
+    float t = lod - level;
+    if (t > 0.0 && level + 1 < info.level_count && VTSampleLevel(info, uv, level + 1, next, next_page))
+      color = lerp(color, next, t);
+    return color;
+  }
+  for (uint l = level + 1; l < info.level_count; l++) {
+    if (VTSampleLevel(info, uv, l, color, page_index)) break;
+  }
+  return color;
+}
+
+// Ray-cone texture LOD (Akenine-Moller et al.): texel-to-world area ratio of
+// the triangle plus the cone footprint projected onto the surface
+float RayConeLod(VirtualTextureInfo info, float2 uv0, float2 uv1, float2 uv2, float3 p0, float3 p1, float3 p2,
+                 float3 N, float cone_width) {
+  float2 duv1 = uv1 - uv0, duv2 = uv2 - uv0;
+  float texel_area = abs(duv1.x * duv2.y - duv1.y * duv2.x) * info.width * info.height;
+  float world_area = length(cross(p1 - p0, p2 - p0));
+  float cos_theta = abs(dot(N, WorldRayDirection()));
+  return 0.5 * log2(max(texel_area, 1e-12) / max(world_area, 1e-12)) +
+         log2(max(abs(cone_width), 1e-8) / max(cos_theta, 1e-4));
+}
+
 [shader("raygeneration")] void RayGenMain() {
 
   RayPayload payload;
@@ -109,10 +471,15 @@ float3 SampleSkybox(float3 direction) {
   payload.hit = false;
   payload.instance_id = 0;
   uint2 pixel_coords = DispatchRaysIndex().xy;
-  payload.seed = tea(pixel_coords.y * DispatchRaysDimensions().x + pixel_coords.x, misc.frame_index);
+  payload.dimension = 0;
   payload.depth = 0;
+  payload.cone_width = 0.0;
+  payload.bsdf_pdf = 0.0;
+  payload.aov_albedo = float3(1, 1, 1);
+  payload.aov_distance = 0.0;
+  payload.aov_normal = float3(0, 0, 0);
 
-  float2 pixel_center = (float2)DispatchRaysIndex() + float2(Rand(payload. seed), Rand(payload. seed));
+  float2 pixel_center = (float2)DispatchRaysIndex() + Sample2D(payload.dimension);
   float2 uv = pixel_center / float2(DispatchRaysDimensions().xy);
   uv.y = 1.0 - uv.y;
   float2 d = uv * 2.0 - 1.0;
@@ -121,10 +488,15 @@ float3 SampleSkybox(float3 direction) {
   float4 direction = mul(camera_info.camera_to_world, float4(target.xyz, 0));
   float3 ray_direction = normalize(direction.xyz);
 
+  // Angle subtended by one pixel, the initial spread of the ray cone
+  float4 target_dx = mul(camera_info.screen_to_camera, float4(d + float2(2.0 / DispatchRaysDimensions().x, 0), 1, 1));
+  payload.cone_spread = length(normalize(target_dx.xyz) - normalize(target.xyz));
+
   float3 focal_point = origin.xyz + ray_direction * camera_info.focal_distance;
   
-  float theta = Rand(payload.seed) * 2.0 * PI;
-  float r = sqrt(Rand(payload.seed)) * camera_info.aperture_size;
+  float2 xi_aperture = Sample2D(payload.dimension);
+  float theta = xi_aperture.x * 2.0 * PI;
+  float r = sqrt(xi_aperture.y) * camera_info.aperture_size;
   float2 aperture_offset = float2(cos(theta), sin(theta)) * r;
   
 
@@ -149,6 +521,7 @@ float3 SampleSkybox(float3 direction) {
   ray.TMin = t_min;
   ray.TMax = t_max;
 
+  CountRay(RAY_COUNTER_PRIMARY);
   TraceRay(as, RAY_FLAG_NONE, 0xFF, 0, 1, 0, ray, payload);
   // uint2 pixel_coords = DispatchRaysIndex().xy;
   
@@ -159,16 +532,66 @@ float3 SampleSkybox(float3 direction) {
   // If no hit, write -1; otherwise write the instance ID
   entity_id_output[pixel_coords] = payload.hit ? (int)payload.instance_id : -1;
   
-  // Accumulate color for progressive rendering (when camera is stationary)
-  float4 prev_color = accumulated_color[pixel_coords];
-  int prev_samples = accumulated_samples[pixel_coords];
+  // When the camera moved, continue the history of the surface now seen
+  // through this pixel: project the first hit into the previous view and keep
+  // that pixel's history if its instance and depth agree
+  uint2 dims = DispatchRaysDimensions().xy;
+  int2 history_pixel = int2(pixel_coords);
+  float history_weight = 1.0;
+  uint surface_id = payload.hit ? payload.instance_id + 1 : 0;
+  if (camera_info.reproject) {
+    float3 hit_position = ray_origin + new_ray_direction * payload.aov_distance;
+    float4 prev_clip = payload.hit ? mul(camera_info.prev_world_to_screen, float4(hit_position, 1.0))
+                                   : mul(camera_info.prev_world_to_screen, float4(new_ray_direction, 0.0));
+    float2 prev_ndc = prev_clip.xy / prev_clip.w;
+    history_pixel = int2(floor(float2(prev_ndc.x + 1.0, 1.0 - prev_ndc.y) * 0.5 * float2(dims)));
+    history_weight = 0.0;
+    if (prev_clip.w > 0.0 && all(history_pixel >= 0) && all(history_pixel < int2(dims))) {
+      int samples = history_samples[history_pixel];
+      bool consistent = samples > 0 && uint(history_normal[history_pixel].w) == surface_id;
+      if (consistent && payload.hit) {
+        float expected_distance = length(hit_position - camera_info.prev_position);
+        float history_distance = history_albedo[history_pixel].w / samples;
+        consistent = abs(expected_distance - history_distance) < 0.05 * expected_distance;
+      }
+      // Pixels that see an edited material directly start over
+      if (payload.hit && int(payload.instance_id) == camera_info.invalidated_entity)
+        consistent = false;
+      // Resampled history is capped so stale detail fades out as new samples arrive
+      if (consistent)
+        history_weight = min(1.0, camera_info.history_limit / samples);
+    }
+  }
+
+  // Accumulate color for progressive rendering
+  float4 prev_color = float4(0, 0, 0, 0), prev_albedo = float4(0, 0, 0, 0), prev_normal = float4(0, 0, 0, 0);
+  int prev_samples = 0;
+  if (history_weight > 0.0) {
+    prev_color = history_color[history_pixel] * history_weight;
+    prev_albedo = history_albedo[history_pixel] * history_weight;
+    prev_normal = history_normal[history_pixel] * history_weight;
+    prev_samples = int(round(history_samples[history_pixel] * history_weight));
+  }
   
-  accumulated_color[pixel_coords] = prev_color + float4(payload.color, 1);
+  // Alpha collects the second moment of luminance for the denoiser's variance estimate
+  float lum = dot(payload.color, float3(0.2126, 0.7152, 0.0722));
+  accumulated_color[pixel_coords] = prev_color + float4(payload.color, lum * lum);
   accumulated_samples[pixel_coords] = prev_samples + 1;
+  accumulated_albedo[pixel_coords] = prev_albedo + float4(payload.aov_albedo, payload.aov_distance);
+  accumulated_normal[pixel_coords] = float4(prev_normal.xyz + payload.aov_normal, surface_id);
 }
 
 [shader("miss")] void MissMain(inout RayPayload payload) {
+  // Sky pixels have unit albedo and no distance or normal in the AOVs
+  if (payload.depth == 0) {
+    payload.aov_albedo = float3(1.0, 1.0, 1.0);
+    payload.aov_distance = 0.0;
+    payload.aov_normal = float3(0.0, 0.0, 0.0);
+  }
   payload.color = SampleSkybox(WorldRayDirection());
+  // Bounce rays share the environment with explicit samples (MIS)
+  if (payload.bsdf_pdf > 0.0)
+    payload.color *= PowerHeuristic(payload.bsdf_pdf, EnvPdf(WorldRayDirection()));
   payload.hit = false;
   payload.instance_id = 0xFFFFFFFF;
 // Invalid ID for miss
@@ -191,6 +614,7 @@ bool IsLightVisible(float3 origin, float3 dir, float dist_to_light) {
   shadow.TMin = 1e-3;
   shadow.TMax = dist_to_light;
 
+  CountRay(RAY_COUNTER_SHADOW);
   TraceRay(
       as,
       RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH |
@@ -208,13 +632,9 @@ bool IsLightVisible(float3 origin, float3 dir, float dist_to_light) {
 static float p = 0.2;
 
 
-float sqr(float x) { return x * x; }
 float3 calcF0(Material mat) {
   return lerp(float3 (0.04, 0.04, 0.04), mat. base_color, mat. metallic);
 }
-float calcD(float alpha, float n_h) {
-  return sqr(alpha) / (PI * sqr(sqr(n_h) * sqr(alpha) + (1 - sqr(n_h))));
-}
 float3 BRDF(in Material mat, in float3 oi, in float3 oo, in float3 n) {
   float3 h = normalize(oi + oo);
   float n_oi = dot(n, oi), n_oo = dot(n, oo), n_h = dot(n, h);
@@ -232,16 +652,55 @@ float luminance(float3 c) {
   return 0.2126 * c. r + 0.7152 * c. g + 0.0722 * c. b;
 }
 
-Material getMaterial(in uint instance_id, in uint primitive_id, in BuiltInTriangleIntersectionAttributes attr, inout float3 N, in float3 p0, in float3 p1, in float3 p2) {
-  // Load instance metadata
-  InstanceMetadata metadata = instance_metadata[instance_id];
-  
+// Global stream decoding (see Scene::EncodeEntityStreams)
+uint LoadHalfWord(StructuredBuffer<uint> stream, uint offset, uint i) {
+  return (stream[offset + (i >> 1)] >> ((i & 1) * 16)) & 0xFFFF;
+}
+
+uint3 LoadTriangle(InstanceMetadata metadata, uint primitive_id) {
+  uint i = primitive_id * 3;
+  if (metadata.stream_flags & STREAM_INDEX_16) {
+    return uint3(LoadHalfWord(global_indices, metadata.index_offset, i),
+                 LoadHalfWord(global_indices, metadata.index_offset, i + 1),
+                 LoadHalfWord(global_indices, metadata.index_offset, i + 2));
+  }
+  return uint3(global_indices[metadata.index_offset + i],
+               global_indices[metadata.index_offset + i + 1],
+               global_indices[metadata.index_offset + i + 2]);
+}
+
+float3 LoadPosition(InstanceMetadata metadata, uint vertex) {
+  if (metadata.stream_flags & STREAM_POSITION_16) {
+    uint xy = global_positions[metadata.position_offset + vertex * 2];
+    uint z = global_positions[metadata.position_offset + vertex * 2 + 1];
+    return metadata.position_min + float3(xy & 0xFFFF, xy >> 16, z & 0xFFFF) * metadata.position_scale;
+  }
+  uint base = metadata.position_offset + vertex * 3;
+  return asfloat(uint3(global_positions[base], global_positions[base + 1], global_positions[base + 2]));
+}
+
+float2 LoadUV(InstanceMetadata metadata, uint vertex) {
+  if (metadata.stream_flags & STREAM_UV_16) {
+    uint uv = global_uvs[metadata.uv_offset + vertex];
+    return metadata.uv_min + float2(uv & 0xFFFF, uv >> 16) * metadata.uv_scale;
+  }
+  uint base = metadata.uv_offset + vertex * 2;
+  return asfloat(uint2(global_uvs[base], global_uvs[base + 1]));
+}
+
+int LoadMaterialID(InstanceMetadata metadata, uint primitive_id) {
+  if (metadata.stream_flags & STREAM_MATERIAL_ID_16) {
+    return LoadHalfWord(global_material_ids, metadata.material_id_offset, primitive_id);
+  }
+  return global_material_ids[metadata.material_id_offset + primitive_id];
+}
+
+Material getMaterial(in InstanceMetadata metadata, in uint primitive_id, in uint3 vid, in BuiltInTriangleIntersectionAttributes attr, inout float3 N, in float3 p0, in float3 p1, in float3 p2, in float cone_width) {
   // Get material ID based on whether this instance has material IDs
   int material_id;
   if (metadata.has_material_ids == 1) {
     // Instance has per-triangle material IDs - look up in global buffer
-    int mat_offset = metadata.material_id_offset;
-    material_id = global_material_ids[mat_offset + primitive_id];
+    material_id = LoadMaterialID(metadata, primitive_id);
   } else {
     // Instance uses single material - material_id_offset IS the material index
     material_id = metadata.material_id_offset;
@@ -251,24 +710,21 @@ Material getMaterial(in uint instance_id, in uint primitive_id, in BuiltInTriang
   Material mat = materials[material_id];
   if(mat.texture_index != -1) {
     float2 bc = attr.barycentrics;
-    int uv_offset = instance_metadata[instance_id].uv_offset;
-    int index_offset = instance_metadata[instance_id].index_offset;
-    int idx0 = global_indices[index_offset + primitive_id * 3 + 0];
-    int idx1 = global_indices[index_offset + primitive_id * 3 + 1];
-    int idx2 = global_indices[index_offset + primitive_id * 3 + 2];
-    float2 uvx0 = global_uvs[uv_offset + idx0];
-    float2 uvx1 = global_uvs[uv_offset + idx1];
-    float2 uvx2 = global_uvs[uv_offset + idx2];
+    float2 uvx0 = LoadUV(metadata, vid.x);
+    float2 uvx1 = LoadUV(metadata, vid.y);
+    float2 uvx2 = LoadUV(metadata, vid.z);
     float2 uv = (1.0 - bc.x - bc.y) * uvx0 + bc.x * uvx1 + bc.y * uvx2; 
     uv.y = 1 - uv.y;
     
-    // Sample base color texture
-    float4 texture_color = textures[mat.texture_index].SampleLevel(g_Sampler, uv, 0);
+    // Sample base color texture at the ray cone's level of detail
+    float lod = RayConeLod(vt_textures[mat.texture_index], uvx0, uvx1, uvx2, p0, p1, p2, N, cone_width);
+    float4 texture_color = SampleVirtualTexture(mat.texture_index, uv, lod);
     mat.base_color = texture_color.rgb;
     
     // Sample normal map
     if(mat.normal_index != -1) {
-        float3 normalMapSample = normalmaps[mat.normal_index].SampleLevel(normalmap_sampler, uv, 0).xyz;
+        float normal_lod = RayConeLod(vt_textures[mat.normal_index], uvx0, uvx1, uvx2, p0, p1, p2, N, cone_width);
+        float3 normalMapSample = SampleVirtualTexture(mat.normal_index, uv, normal_lod).xyz;
         
         // Convert from [0,1] to [-1,1] range
         float3 tangentNormal = normalMapSample * 2.0 - 1.0;
@@ -295,33 +751,129 @@ Material getMaterial(in uint instance_id, in uint primitive_id, in BuiltInTriang
   return mat;
 }
 
+// Direct light from one point light (zero when occluded)
+float3 PointLightContribution(Material mat, uint i, float3 hitpos, float3 N, float3 outDir) {
+  float3 lightDir = point_lights[i]. position - hitpos;
+  float dis = length(lightDir);
+  if (dis < 1e-4) return float3 (0.0, 0.0, 0.0);
+  lightDir /= dis;
+  if (dot(N, lightDir) <= 0.0f) return float3 (0.0, 0.0, 0.0);
+  if (!IsLightVisible(hitpos + 1e-4 * lightDir, lightDir, dis - 1e-4)) return float3 (0.0, 0.0, 0.0);
+  return BRDF(mat, lightDir, outDir, N) * dot(N, lightDir) * point_lights[i]. color / sqr(dis);
+}
+
+// Estimated contribution of a light BVH node at p: power over squared
+// distance (clamped to the node size), zero below the tangent plane
+float LightNodeImportance(LightBVHNode node, float3 p, float3 n) {
+  float3 center = 0.5 * (node.bounds_min + node.bounds_max);
+  float3 half_extent = 0.5 * (node.bounds_max - node.bounds_min);
+  if (node.power <= 0.0 || dot(n, center - p) + dot(abs(n), half_extent) <= 0.0) return 0.0;
+  float3 d = center - p;
+  return node.power / max(dot(d, d), max(dot(half_extent, half_extent), 1e-6));
+}
+
+// Walk the light BVH choosing children by importance; pmf is the probability
+// of the returned light (0 if no light can contribute). u is reused at every level,
+// rescaled to [0, 1) within the chosen child so one stratified number drives the walk
+uint SampleLightBVH(float3 p, float3 n, float u, out float pmf) {
+  LightBVHNode node = light_bvh[0];
+  pmf = 1.0;
+  while (!(node.child_or_light & LIGHT_BVH_LEAF)) {
+    LightBVHNode left = light_bvh[node.child_or_light];
+    LightBVHNode right = light_bvh[node.child_or_light + 1];
+    float importance_left = LightNodeImportance(left, p, n);
+    float importance_right = LightNodeImportance(right, p, n);
+    float total = importance_left + importance_right;
+    if (total <= 0.0) {
+      pmf = 0.0;
+      return 0;
+    }
+    float p_left = importance_left / total;
+    if (u < p_left) {
+      node = left;
+      pmf *= p_left;
+      u = min(u / p_left, 0.99999994);
+    } else {
+      node = right;
+      pmf *= 1.0 - p_left;
+      u = min((u - p_left) / (1.0 - p_left), 0.99999994);
+    }
+  }
+  return node.child_or_light & ~LIGHT_BVH_LEAF;
+}
+
+// Pick an index from a table of count entries starting at offset in O(1); the
+// fraction of u left after choosing the column decides between it and its alias
+uint SampleAlias(StructuredBuffer<AliasEntry> table, uint offset, uint count, float u) {
+  uint i = min(uint(u * count), count - 1);
+  AliasEntry entry = table[offset + i];
+  return u * count - i < entry.probability ? i : entry.alias;
+}
+
+// Uniform point on an emissive triangle chosen in proportion to its power
+// (xi.x picks the emitter, xi.y its triangle, xi.zw the point)
+EmissiveTriangle SampleEmissiveTriangle(float4 xi, out float3 position) {
+  Emitter emitter = emitters[SampleAlias(emitter_alias, 0, misc.num_emitters, xi.x)];
+  uint t = SampleAlias(emissive_triangle_alias, emitter.first_triangle, emitter.triangle_count, xi.y);
+  EmissiveTriangle tri = emissive_triangles[emitter.first_triangle + t];
+  float su = sqrt(xi.z), v = xi.w;
+  position = tri.p0 * (1 - su) + tri.p1 * (su * (1 - v)) + tri.p2 * (su * v);
+  return tri;
+}
+
+// Area pdf of SampleEmissiveTriangle: (power / total power) / area
+float EmissiveAreaPdf(float3 emission) {
+  return luminance(emission) / misc.emissive_power;
+}
+
 #define assert(cond) if (!(cond)) { while (1); }
 
 [shader("closesthit")] void ClosestHitMain(inout RayPayload payload, in BuiltInTriangleIntersectionAttributes attr) {
   uint material_id = InstanceID(), primitive_id = PrimitiveIndex();
   
-  // Calculate normal
-  uint id = offset[material_id] + primitive_id;
-  uint3 vid = triangles[id];
-  float3 p0 = vertices[vid.x];
-  float3 p1 = vertices[vid.y];
-  float3 p2 = vertices[vid.z];
+  // Calculate normal from the world-space triangle
+  InstanceMetadata metadata = instance_metadata[material_id];
+  uint3 vid = LoadTriangle(metadata, primitive_id);
+  float3x4 object_to_world = ObjectToWorld3x4();
+  float3 p0 = mul(object_to_world, float4(LoadPosition(metadata, vid.x), 1.0));
+  float3 p1 = mul(object_to_world, float4(LoadPosition(metadata, vid.y), 1.0));
+  float3 p2 = mul(object_to_world, float4(LoadPosition(metadata, vid.z), 1.0));
   float3 N = normalize(cross(p1 - p0, p2 - p0));
-  // N = normalize(mul((float3x3) ObjectToWorld3x4(), N));
   if (dot(WorldRayDirection(), N) > 0.0)
     N = - N;
+  float light_cos = abs(dot(N, WorldRayDirection()));
   float3 B = normalize(p1 - p0);
   if (abs(dot(N, B)) > 1e-6)
     B = normalize(B - dot(N, B) * N);
   float3 T = cross(N, B);
   
+  // Propagate the ray cone to the hit point
+  float cone_width = payload.cone_width + payload.cone_spread * RayTCurrent();
+
   // Load material (this will also update N with normal map if available)
-  Material mat = getMaterial(material_id, primitive_id, attr, N, p0, p1, p2);
+  Material mat = getMaterial(metadata, primitive_id, vid, attr, N, p0, p1, p2, cone_width);
   mat. roughness = clamp(mat. roughness, 1e-2, 1.0);
-  if (Rand(payload. seed) < p) {
+
+  // First-hit AOVs for the denoiser and reprojection, accumulated by RayGenMain
+  if (payload. depth == 0) {
+    payload. aov_albedo = mat. base_color;
+    payload. aov_distance = RayTCurrent();
+    payload. aov_normal = N;
+  }
+
+  // Emission reached by a BSDF bounce is also found by next-event estimation
+  float3 emission = mat. emission;
+  if (payload. bsdf_pdf > 0.0 && misc.num_emitters > 0 && luminance(emission) > 0.0) {
+    float light_pdf = EmissiveAreaPdf(emission) * sqr(RayTCurrent()) / max(light_cos, 1e-6);
+    emission *= PowerHeuristic(payload. bsdf_pdf, light_pdf);
+  }
+
+  // One group for both decisions: x = roulette, y = lobe choice
+  float2 xi_choice = Sample2D(payload. dimension);
+  if (xi_choice.x < p) {
     payload. hit = true;
     payload. instance_id = material_id;
-    payload. color = mat. emission;
+    payload. color = emission;
     return ;
   }
   if (payload. depth > 20) {
@@ -330,7 +882,7 @@ Material getMaterial(in uint instance_id, in uint primitive_id, in BuiltInTriang
   }
   float3x3 M = transpose(float3x3 (T, B, N));
   // Sample a direction
-  // float phi = Rand(payload. seed) * 2 * PI, cosTheta = Rand(payload. seed), sinTheta = sqrt(1 - sqr(cosTheta));
+  // float2 xi = Sample2D(payload. dimension); float phi = xi.x * 2 * PI, cosTheta = xi.y, sinTheta = sqrt(1 - sqr(cosTheta));
   // float3 inDir = sinTheta * (cos(phi) * T + sin(phi) * B) + cosTheta * N;
   // float3 outDir = - WorldRayDirection();
   // float P = 1 / (2 * PI);
@@ -338,14 +890,18 @@ Material getMaterial(in uint instance_id, in uint primitive_id, in BuiltInTriang
   float3 F0 = calcF0(mat);
   float p_mix = clamp(luminance(F0) + (1 - mat. roughness) * 0.1, 0.05, 0.95);
   float alpha = sqr(mat. roughness), alpha2 = sqr(alpha);
-  if (Rand(payload. seed) <= p_mix) {
+  // Rough lobes widen the cone, diffuse bounces widen it the most
+  payload. cone_width = cone_width;
+  if (xi_choice.y <= p_mix) {
+    payload. cone_spread += alpha;
     do {
-      float phi = Rand(payload. seed) * 2 * PI, xi = Rand(payload. seed), cosTheta = sqrt(xi / ((1 - xi) * alpha2 + xi)), sinTheta = cosTheta >= 1.0 ? 0 : sqrt(1 - sqr(cosTheta));
-      float3 h = mul(M, float3 (sinTheta * cos(phi), sinTheta * sin(phi), cosTheta));
-      inDir = h * dot(outDir, h) * 2 - outDir;
+      // A rejected direction draws a fresh group
+      inDir = SampleGGX(Sample2D(payload. dimension), M, alpha2, outDir);
     } while (dot(N, inDir) < 0);
   } else {
-    float r = sqrt(Rand(payload. seed)), phi = Rand(payload. seed) * 2 * PI;
+    payload. cone_spread += 0.5;
+    float2 xi_dir = Sample2D(payload. dimension);
+    float r = sqrt(xi_dir.x), phi = xi_dir.y * 2 * PI;
     inDir = mul(M, float3 (r * cos(phi), r * sin(phi), sqrt(1 - sqr(r))));
   }
   float3 h = normalize(inDir + outDir);
@@ -355,14 +911,47 @@ Material getMaterial(in uint instance_id, in uint primitive_id, in BuiltInTriang
 
   float3 light_contribution = float3 (0.0, 0.0, 0.0);
   float3 hitpos = WorldRayOrigin() + WorldRayDirection() * RayTCurrent();
-  for (uint i=0; i<misc.num_point_lights; i++) {
-    float3 lightDir = point_lights[i]. position - hitpos;
-    float dis = length(lightDir);
-    if (dis < 1e-4) continue;
-    lightDir /= dis;
-    if (dot(N, lightDir) <= 0.0f) continue;
-    if (IsLightVisible(hitpos + 1e-4 * inDir, lightDir, dis - 1e-4)) {
-      light_contribution += BRDF(mat, lightDir, outDir, N) * dot(N, lightDir) * point_lights[i]. color / sqr(dis);
+  if (misc.num_point_lights <= LIGHT_SAMPLES) {
+    for (uint i = 0; i < misc.num_point_lights; i++) {
+      light_contribution += PointLightContribution(mat, i, hitpos, N, outDir);
+    }
+  } else {
+    // Pick lights through the light BVH, a fixed number of shadow rays per bounce
+    for (uint s = 0; s < LIGHT_SAMPLES; s++) {
+      float light_pmf;
+      uint light = SampleLightBVH(hitpos, N, Sample1D(payload. dimension), light_pmf);
+      if (light_pmf > 0.0)
+        light_contribution += PointLightContribution(mat, light, hitpos, N, outDir) / (light_pmf * LIGHT_SAMPLES);
+    }
+  }
+
+  // Explicit environment sample, weighted against the BSDF bounce by the power
+  // heuristic (scaled like the bounce, which survives roulette with 1 - p)
+  if (misc.env_width > 0) {
+    float env_sample_pdf;
+    float3 envDir = SampleEnvironment(Sample2D(payload. dimension), env_sample_pdf);
+    float n_e = dot(N, envDir);
+    if (env_sample_pdf > 0.0 && n_e > 0.0 && IsLightVisible(hitpos + 1e-4 * envDir, envDir, 1e4)) {
+      float bsdf_pdf = BsdfPdf(N, outDir, envDir, alpha, p_mix);
+      light_contribution += BRDF(mat, envDir, outDir, N) * n_e * SampleSkybox(envDir) / env_sample_pdf
+                            * PowerHeuristic(env_sample_pdf, bsdf_pdf) / (1 - p);
+    }
+  }
+
+  // Explicit sample of an emissive triangle, weighted like the environment sample
+  if (misc.num_emitters > 0) {
+    float3 light_pos;
+    EmissiveTriangle tri = SampleEmissiveTriangle(Sample4D(payload. dimension), light_pos);
+    float3 toLight = light_pos - hitpos;
+    float dist = length(toLight);
+    float3 lightDir = toLight / max(dist, 1e-6);
+    float n_l = dot(N, lightDir);
+    float cos_light = abs(dot(normalize(cross(tri.p1 - tri.p0, tri.p2 - tri.p0)), lightDir));
+    if (dist > 2e-3 && n_l > 0.0 && cos_light > 1e-6 && IsLightVisible(hitpos + 1e-4 * lightDir, lightDir, dist - 2e-3)) {
+      float light_pdf = EmissiveAreaPdf(tri.emission) * sqr(dist) / cos_light;
+      float bsdf_pdf = BsdfPdf(N, outDir, lightDir, alpha, p_mix);
+      light_contribution += BRDF(mat, lightDir, outDir, N) * n_l * tri.emission / light_pdf
+                            * PowerHeuristic(light_pdf, bsdf_pdf) / (1 - p);
     }
   }
 
@@ -373,9 +962,11 @@ Material getMaterial(in uint instance_id, in uint primitive_id, in BuiltInTriang
   ray. TMin = 1e-3;
   ray. TMax = 1e4;
   payload. depth ++;
+  payload. bsdf_pdf = P;
+  CountRay(RAY_COUNTER_SECONDARY);
   TraceRay(as, RAY_FLAG_NONE, 0xFF, 0, 1, 0, ray, payload);
   // Calculate color
-  payload. color = payload. color * BRDF(mat, inDir, outDir, N) * dot(N, inDir) / P / (1 - p) + mat. emission + light_contribution;
+  payload. color = payload. color * BRDF(mat, inDir, outDir, N) * dot(N, inDir) / P / (1 - p) + emission + light_contribution;
   payload. hit = true;
   payload. instance_id = InstanceID();
 }
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "ShardedRender.h"
+
+#include <cstdlib>
+#include <string>
+
+// ShortMarchRender: headless sharded render, see ShardedRender.h
+//   --scene <file>  --width <px>  --height <px>  --spp <n>  --workers <n>  --update <n samples>
+//   --image <out.png>  --preview <preview.png>  --work-dir <dir>  --vulkan | --d3d12 (default: the platform's backend)
+//   --geometry-budget <MB>  out-of-core geometry: workers map meshes from the mesh cache and cap resident geometry
+// Workers are this program started with --shard-worker --first-sample <n> --partial <file> (and the options above)
+// --merge <a.ckpt> <b.ckpt> ...  sums film checkpoints of one view instead of rendering; writes --image <out.png>
+//   (when given or without --checkpoint) and --checkpoint <merged.ckpt>  --checkpoint-compression <0|1>
+int main(int argc, char** argv) {
+  ShardSettings settings;
+  settings.executable = argv[0];
+  ShardWorkerSettings worker;
+  bool is_worker = false;
+  MergeSettings merge;
+  bool is_merge = false;
+  bool image_set = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--vulkan") {
+      settings.api = grassland::graphics::BACKEND_API_VULKAN;
+    } else if (arg == "--d3d12") {
+      settings.api = grassland::graphics::BACKEND_API_D3D12;
+    } else if (arg == "--shard-worker") {
+      is_worker = true;
+    } else if (arg == "--merge") {
+      is_merge = true;
+      while (i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0) {
+        merge.inputs.push_back(argv[++i]);
+      }
+    } else if (i + 1 < argc) {
+      if (arg == "--scene") {
+        settings.scene_path = argv[++i];
+      } else if (arg == "--width") {
+        settings.width = std::atoi(argv[++i]);
+      } else if (arg == "--height") {
+        settings.height = std::atoi(argv[++i]);
+      } else if (arg == "--spp") {
+        settings.spp = std::atoi(argv[++i]);
+      } else if (arg == "--workers") {
+        settings.workers = std::atoi(argv[++i]);
+      } else if (arg == "--update") {
+        settings.update_interval = std::atoi(argv[++i]);
+      } else if (arg == "--image") {
+        settings.image_path = argv[++i];
+        image_set = true;
+      } else if (arg == "--preview") {
+        settings.preview_path = argv[++i];
+      } else if (arg == "--work-dir") {
+        settings.work_directory = argv[++i];
+      } else if (arg == "--geometry-budget") {
+        settings.geometry_budget_mb = std::atoi(argv[++i]);
+      } else if (arg == "--first-sample") {
+        worker.first_sample = std::atoi(argv[++i]);
+      } else if (arg == "--partial") {
+        worker.partial_path = argv[++i];
+      } else if (arg == "--checkpoint") {
+        merge.checkpoint_path = argv[++i];
+      } else if (arg == "--checkpoint-compression") {
+        merge.compress = std::atoi(argv[++i]) != 0;
+      }
+    }
+  }
+
+  if (is_merge) {
+    merge.api = settings.api;
+    if (image_set || merge.checkpoint_path.empty()) {
+      merge.image_path = settings.image_path;
+    }
+    return ShardedRender::RunMerge(merge);
+  }
+  if (is_worker) {
+    worker.api = settings.api;
+    worker.scene_path = settings.scene_path;
+    worker.width = settings.width;
+    worker.height = settings.height;
+    worker.samples = settings.spp;
+    worker.update_interval = settings.update_interval;
+    worker.geometry_budget_mb = settings.geometry_budget_mb;
+    return ShardedRender::RunWorker(worker);
+  }
+  return ShardedRender::RunCoordinator(settings);
+}